@@ -0,0 +1,163 @@
+/* --------------------------------- Header --------------------------------- */
+
+
+/**
+ * @file    bipbuf_stress.c
+ * @brief   Host stress run of the bipbuf record ring across two threads
+ *
+ * A producer thread pushes variable length records carrying a sequence
+ * number and a payload derived from it, while a consumer thread pops them and
+ * checks both. This stands in for the ISR and main loop on either side of the
+ * network queues, and reports the record rate the ring sustains.
+ *
+ * Built with the host build, see host/CMakeLists.txt:
+ *
+ *      ./build-host/host/bipbuf_stress
+ */
+
+
+/* -------------------------------- Includes -------------------------------- */
+
+
+# include <pthread.h>
+# include <sched.h>
+# include <stdio.h>
+# include <string.h>
+# include <time.h>
+
+# include "bipbuf.h"
+
+
+/* --------------------------------- Defines -------------------------------- */
+
+
+# define STRESS_CAPACITY    ( 1024 )
+# define STRESS_RECORDS     ( 2000000UL )
+# define STRESS_MAX_PAYLOAD ( 255 )
+
+
+/* ----------------------------- Static Globals ----------------------------- */
+
+
+static uint32_t stress_storage[STRESS_CAPACITY / sizeof( uint32_t )];
+static bipbuf_t stress_ring;
+
+
+/* ------------------------------- Functions -------------------------------- */
+
+
+/**
+ * Picks the payload length of a record from its sequence number
+ */
+static inline uint32_t stress_length( uint32_t seq )
+{
+    return ( seq * 2654435761u >> 24 ) % STRESS_MAX_PAYLOAD + sizeof( uint32_t );
+}
+
+
+/**
+ * Pushes every record, yielding while the ring is full
+ */
+static void * stress_producer( void * arg )
+{
+    ( void ) arg;
+
+    for ( uint32_t seq = 0; seq < STRESS_RECORDS; seq++ )
+    {
+        uint32_t size = stress_length( seq );
+        uint8_t * record;
+
+        while ( ( record = bipbuf_reserve( &stress_ring, size ) ) == NULL )
+        {
+            sched_yield( );
+        }
+
+        memcpy( record, &seq, sizeof( seq ) );
+        for ( uint32_t i = sizeof( seq ); i < size; i++ )
+        {
+            record[i] = ( uint8_t ) ( seq + i );
+        }
+        bipbuf_commit( &stress_ring, record, size );
+    }
+
+    return NULL;
+}
+
+
+/**
+ * Pops every record, checking its length, sequence and payload
+ *
+ * @return  Non-NULL if any record was corrupt or out of order
+ */
+static void * stress_consumer( void * arg )
+{
+    ( void ) arg;
+
+    for ( uint32_t seq = 0; seq < STRESS_RECORDS; seq++ )
+    {
+        uint32_t size;
+        const uint8_t * record;
+
+        while ( ( record = bipbuf_peek( &stress_ring, &size ) ) == NULL )
+        {
+            sched_yield( );
+        }
+
+        uint32_t got;
+        memcpy( &got, record, sizeof( got ) );
+        if ( got != seq || size != stress_length( seq ) )
+        {
+            printf( "record %u: got sequence %u size %u\n", seq, got, size );
+            return ( void * ) 1;
+        }
+        for ( uint32_t i = sizeof( seq ); i < size; i++ )
+        {
+            if ( record[i] != ( uint8_t ) ( seq + i ) )
+            {
+                printf( "record %u: payload corrupt at byte %u\n", seq, i );
+                return ( void * ) 1;
+            }
+        }
+        bipbuf_pop( &stress_ring );
+    }
+
+    return NULL;
+}
+
+
+int main( void )
+{
+    pthread_t producer;
+    pthread_t consumer;
+    void * failed;
+    struct timespec start, end;
+
+    if ( !bipbuf_init( &stress_ring, stress_storage, sizeof( stress_storage ) ) )
+    {
+        printf( "bipbuf_init rejected a %u byte ring\n", STRESS_CAPACITY );
+        return 1;
+    }
+
+    clock_gettime( CLOCK_MONOTONIC, &start );
+    pthread_create( &consumer, NULL, stress_consumer, NULL );
+    pthread_create( &producer, NULL, stress_producer, NULL );
+    pthread_join( producer, NULL );
+    pthread_join( consumer, &failed );
+    clock_gettime( CLOCK_MONOTONIC, &end );
+
+    double seconds = ( end.tv_sec - start.tv_sec ) + ( end.tv_nsec - start.tv_nsec ) / 1e9;
+
+    if ( failed != NULL || !bipbuf_is_empty( &stress_ring ) )
+    {
+        printf( "FAIL\n" );
+        return 1;
+    }
+
+    printf( "%lu records in %.2f s, %.1f Mrecords/s\nOK\n",
+            STRESS_RECORDS, seconds, STRESS_RECORDS / seconds / 1e6 );
+
+    return 0;
+}
+
+
+/* -------------------------------------------------------------------------- */
@@ -0,0 +1,374 @@
+/* --------------------------------- Header --------------------------------- */
+
+
+/**
+ * @file    decode_bench.cpp
+ * @brief   Host benchmark of the bulk capture decoder
+ *
+ * Runs every Manchester kernel the CPU supports over the same slots as the
+ * firmware's linecode_decode() and its scalar port, the slicing CRC against
+ * crc8_calculate(), and the whole decoder over a synthesized capture on one
+ * thread with the scalar kernel and on every core with the best one. Every
+ * result is checked against the reference, and the run fails if one
+ * differs.
+ *
+ * Build with the host build and run from the repository root:
+ *
+ *      cmake -S . -B build-host -DCE4951_HOST_BUILD=ON
+ *      cmake --build build-host
+ *      ./build-host/tools/decode/decode_bench [frames]
+ */
+
+
+/* -------------------------------- Includes -------------------------------- */
+
+
+# include <chrono>
+# include <cstdio>
+# include <cstdlib>
+# include <cstring>
+# include <random>
+# include <thread>
+# include <unistd.h>
+
+# include "bulk_decode.hpp"
+
+extern "C" {
+# include "crc8.h"
+# include "linecode.h"
+}
+
+
+/* --------------------------------- Defines -------------------------------- */
+
+
+# define BENCH_DATA_BYTES       ( 4 * 1024 * 1024 )
+# define BENCH_CRC_BYTES        ( 16 * 1024 * 1024 )
+# define BENCH_ROUNDS           ( 5 )
+# define BENCH_FRAMES           ( 200000 )
+# define BENCH_HALF_BIT_US      ( 500 )
+# define BENCH_IDLE_GAP_US      ( 3000 )
+# define BENCH_DAMAGE_ONE_IN    ( 50 )      // frames with a flipped bit
+
+
+/* ------------------------------- Functions -------------------------------- */
+
+
+/**
+ * Gets the best of BENCH_ROUNDS runs of a function in seconds
+ */
+template < typename F >
+static double bench_time( F && run )
+{
+    double best = 1e9;
+
+    for ( int round = 0; round < BENCH_ROUNDS; round++ )
+    {
+        auto start = std::chrono::steady_clock::now( );
+        run( );
+        double seconds = std::chrono::duration< double >( std::chrono::steady_clock::now( ) - start ).count( );
+        best = seconds < best ? seconds : best;
+    }
+
+    return best;
+}
+
+
+static bool bench_report( const char * name, double seconds, double bytes, double baseline, bool ok )
+{
+    if ( !ok )
+    {
+        printf( "%-22s FAIL\n", name );
+        return false;
+    }
+
+    printf( "%-22s %9.1f MB/s  %6.2f ns/byte  x%.1f\n", name, bytes / seconds / 1e6,
+            seconds * 1e9 / bytes, baseline / seconds );
+    return true;
+}
+
+
+/**
+ * Decodes Manchester slots with the firmware's decoder
+ */
+static unsigned int bench_linecode( const uint8_t * slots, uint8_t * out, size_t size )
+{
+    linecode_decoder_t decoder = { };
+    unsigned int violations = 0;
+
+    decoder.code = LINECODE_MANCHESTER;
+    decoder.slots = slots;
+    decoder.slot_count = size * 16;
+    linecode_decode( &decoder, out, size, &violations );
+
+    return violations;
+}
+
+
+/**
+ * Compares every supported kernel with linecode_decode() on Manchester
+ * slots with a code violation every few hundred symbols
+ */
+static bool bench_kernels( std::mt19937 & rng )
+{
+    static uint8_t slots[2 * BENCH_DATA_BYTES];
+    static uint8_t expected[BENCH_DATA_BYTES];
+    static uint8_t out[BENCH_DATA_BYTES];
+    bool passed = true;
+
+    for ( size_t idx = 0; idx < BENCH_DATA_BYTES; idx++ )
+    {
+        uint8_t value = rng( );
+        uint16_t word = 0;
+        for ( int bit_idx = 7; bit_idx >= 0; bit_idx-- )
+        {
+            bool bit = ( value >> bit_idx ) & 0x01;
+            word = ( word << 2 ) | ( !bit << 1 ) | bit;
+        }
+        if ( rng( ) % 64 == 0 )
+        {
+            word ^= 1 << ( rng( ) % 16 );
+        }
+        slots[2 * idx] = word >> 8;
+        slots[2 * idx + 1] = word;
+    }
+
+    unsigned int violations = 0;
+    double baseline = bench_time( [ & ] { violations = bench_linecode( slots, expected, BENCH_DATA_BYTES ); } );
+    passed &= bench_report( "linecode_decode", baseline, BENCH_DATA_BYTES, baseline, true );
+
+    for ( int idx = 0; idx < ( int ) bulk::kernel::count; idx++ )
+    {
+        bulk::kernel k = ( bulk::kernel ) idx;
+        char name[32];
+        unsigned int found = 0;
+
+        snprintf( name, sizeof( name ), "manchester %s", bulk::kernel_name( k ) );
+        if ( !bulk::kernel_supported( k ) )
+        {
+            printf( "%-22s unsupported\n", name );
+            continue;
+        }
+
+        // odd sizes so the tails are checked too
+        memset( out, 0, sizeof( out ) );
+        bool ok = bulk::manchester_decode( k, slots, out, 37 ) == bench_linecode( slots, expected, 37 ) &&
+                  memcmp( out, expected, 37 ) == 0;
+        bench_linecode( slots, expected, BENCH_DATA_BYTES );
+
+        double seconds = bench_time( [ & ] { found = bulk::manchester_decode( k, slots, out, BENCH_DATA_BYTES ); } );
+        ok = ok && found == violations && memcmp( out, expected, BENCH_DATA_BYTES ) == 0;
+        passed &= bench_report( name, seconds, BENCH_DATA_BYTES, baseline, ok );
+    }
+
+    return passed;
+}
+
+
+static bool bench_crc( std::mt19937 & rng )
+{
+    static uint8_t data[BENCH_CRC_BYTES];
+    uint8_t expected = 0;
+    uint8_t found = 0;
+
+    for ( size_t idx = 0; idx < BENCH_CRC_BYTES; idx++ )
+    {
+        data[idx] = rng( );
+    }
+
+    double baseline = bench_time( [ & ] { expected = crc8_calculate( data, BENCH_CRC_BYTES, 0x5A ); } );
+    bench_report( "crc8_calculate", baseline, BENCH_CRC_BYTES, baseline, true );
+
+    bool ok = true;
+    for ( size_t size = 0; size < 40; size++ )
+    {
+        ok = ok && bulk::crc8( data + 3, size, 0x5A ) == crc8_calculate( data + 3, size, 0x5A );
+    }
+
+    double seconds = bench_time( [ & ] { found = bulk::crc8( data, BENCH_CRC_BYTES, 0x5A ); } );
+    return bench_report( "crc8 slicing-by-8", seconds, BENCH_CRC_BYTES, baseline, ok && found == expected );
+}
+
+
+static void bench_varint( FILE * file, uint64_t value )
+{
+    do
+    {
+        uint8_t byte = value & 0x7F;
+        value >>= 7;
+        fputc( byte | ( value ? 0x80 : 0 ), file );
+    } while ( value );
+}
+
+
+/**
+ * Writes a capture of random frames sent back to back, a few of them with
+ * a bit flipped on the line
+ *
+ * @return  The number of undamaged frames
+ */
+static unsigned long bench_capture( std::mt19937 & rng, const char * path, unsigned long frames )
+{
+    static uint8_t slots[BULK_FRAME_SLOT_BYTES];
+    uint8_t message[255];
+    unsigned long clean = 0;
+    FILE * file = fopen( path, "wb" );
+
+    const uint8_t header[CAPTURE_HEADER_SIZE] = { 'C', 'E', 'C', 'P', CAPTURE_VERSION, 1, 0, 0 };
+    fwrite( header, 1, sizeof( header ), file );
+
+    for ( unsigned long idx = 0; idx < frames; idx++ )
+    {
+        frame_header_t frame = { LINECODE_PREAMBLE_MANCHESTER, 1, ( uint8_t ) rng( ), ( uint8_t ) rng( ),
+                                 ( uint8_t ) ( 1 + rng( ) % 255 ), 0x01 };
+        linecode_encoder_t encoder;
+
+        for ( unsigned int byte = 0; byte < frame.length; byte++ )
+        {
+            message[byte] = rng( );
+        }
+        uint8_t fcs = crc8_calculate( message, frame.length, 0 );
+
+        linecode_encoder_init( &encoder, LINECODE_MANCHESTER, slots );
+        linecode_encode( &encoder, ( uint8_t * ) &frame + 1, sizeof( frame ) - 1 );
+        linecode_encode( &encoder, message, frame.length );
+        linecode_encode( &encoder, &fcs, 1 );
+        size_t count = linecode_encoder_finish( &encoder ) * 8;
+
+        // flipping both halves of a symbol flips its bit and keeps the line
+        // code, the crc covers the message and the trailer
+        if ( rng( ) % BENCH_DAMAGE_ONE_IN == 0 )
+        {
+            size_t symbol = LINECODE_PREAMBLE_SLOTS / 2 + 8 * ( sizeof( frame ) - 1 ) + rng( ) % ( 8 * ( frame.length + 1 ) );
+            slots[symbol / 4] ^= 0xC0 >> ( 2 * ( symbol % 4 ) );
+        }
+        else
+        {
+            clean++;
+        }
+
+        // an edge at every change of level, the line idles high around the frame
+        bool level = true;
+        uint64_t since = BENCH_IDLE_GAP_US;
+        for ( size_t slot = 0; slot <= count; slot++ )
+        {
+            bool next = slot < count ? ( slots[slot / 8] >> ( 7 - slot % 8 ) ) & 0x01 : true;
+            if ( next != level )
+            {
+                bench_varint( file, ( since << 1 | next ) + 1 );
+                since = 0;
+                level = next;
+            }
+            since += BENCH_HALF_BIT_US;
+        }
+    }
+
+    fclose( file );
+    return clean;
+}
+
+
+static bool bench_same( const bulk::result & a, const bulk::result & b )
+{
+    if ( a.frames.size( ) != b.frames.size( ) || memcmp( &a.stats, &b.stats, sizeof( a.stats ) ) != 0 )
+    {
+        return false;
+    }
+
+    for ( size_t idx = 0; idx < a.frames.size( ); idx++ )
+    {
+        const bulk::frame & x = a.frames[idx];
+        const bulk::frame & y = b.frames[idx];
+        if ( x.start_us != y.start_us || x.duration_us != y.duration_us || x.status != y.status ||
+             x.violations != y.violations || x.size != y.size || memcmp( a.data( x ), b.data( y ), x.size ) != 0 )
+        {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+
+/**
+ * Decodes a synthesized capture with the scalar kernel on one thread, then
+ * with the best kernel on one thread and on every core
+ */
+static bool bench_files( std::mt19937 & rng, unsigned long frames )
+{
+    char path[] = "/tmp/decode_bench_XXXXXX";
+    int fd = mkstemp( path );
+    if ( fd < 0 )
+    {
+        perror( "mkstemp" );
+        return false;
+    }
+    close( fd );
+
+    unsigned long clean = bench_capture( rng, path, frames );
+    std::vector< std::string > paths = { path };
+    bulk::result reference;
+    bulk::result result;
+    bulk::options opts;
+    bool passed = true;
+
+    opts.manchester = bulk::kernel::scalar;
+    opts.threads = 1;
+    double baseline = bench_time( [ & ] { bulk::decode_files( paths, opts, reference ); } );
+    bool ok = reference.stats.frames == frames && reference.stats.crc_ok == clean &&
+              reference.stats.crc_errors == frames - clean;
+    printf( "%-22s %9.0f frames/s  x1.0\n", "capture scalar x1", frames / baseline );
+    if ( !ok )
+    {
+        printf( "%-22s FAIL %llu frames, %llu crc ok of %lu\n", "", ( unsigned long long ) reference.stats.frames,
+                ( unsigned long long ) reference.stats.crc_ok, clean );
+        passed = false;
+    }
+
+    unsigned int cores = std::max( 1U, std::thread::hardware_concurrency( ) );
+    std::vector< unsigned int > runs = { 1 };
+    if ( cores > 1 )
+    {
+        runs.push_back( cores );
+    }
+
+    for ( unsigned int threads : runs )
+    {
+        char name[32];
+
+        opts.manchester = bulk::best_kernel( );
+        opts.threads = threads;
+        // small chunks so even one core's run splits the capture
+        opts.chunk = threads == 1 ? 256 * 1024 : 0;
+        snprintf( name, sizeof( name ), "capture %s x%u", bulk::kernel_name( opts.manchester ), threads );
+
+        double seconds = bench_time( [ & ] { bulk::decode_files( paths, opts, result ); } );
+        ok = bench_same( reference, result );
+        printf( ok ? "%-22s %9.0f frames/s  x%.1f\n" : "%-22s FAIL\n", name, frames / seconds, baseline / seconds );
+        passed &= ok;
+    }
+
+    unlink( path );
+    return passed;
+}
+
+
+int main( int argc, char ** argv )
+{
+    unsigned long frames = argc > 1 ? strtoul( argv[1], NULL, 0 ) : BENCH_FRAMES;
+    std::mt19937 rng( 4951 );
+    bool passed = true;
+
+    printf( "best kernel %s, %u cores\n", bulk::kernel_name( bulk::best_kernel( ) ),
+            std::thread::hardware_concurrency( ) );
+
+    passed &= bench_kernels( rng );
+    passed &= bench_crc( rng );
+    passed &= bench_files( rng, frames );
+
+    printf( passed ? "OK\n" : "FAIL\n" );
+    return passed ? 0 : 1;
+}
+
+
+/* -------------------------------------------------------------------------- */
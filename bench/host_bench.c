@@ -0,0 +1,247 @@
+/* --------------------------------- Header --------------------------------- */
+
+
+/**
+ * @file    host_bench.c
+ * @brief   Host benchmark of the network stack running on the simulated
+ *          peripherals of the host build
+ *
+ * Brings the stack up the way main() does, then loops messages of several
+ * sizes back through the bridged transmit and receive pins: each one is
+ * queued, clocked out by the half bit timer, received through the edge
+ * interrupt, committed by the idle timeout and decoded by network_service().
+ * Reports the cycles spent queueing, decoding and in each interrupt handler,
+ * and the goodput in simulated time. Every message is checked on the way out,
+ * and one is collided with to check it is backed off and resent.
+ *
+ * Build and run from the repository root:
+ *
+ *      cmake -S . -B build-host -DCE4951_HOST_BUILD=ON
+ *      cmake --build build-host
+ *      ./build-host/host/host_bench
+ */
+
+
+/* -------------------------------- Includes -------------------------------- */
+
+
+# include <stdio.h>
+# include <string.h>
+# include <time.h>
+
+# if defined( __x86_64__ ) || defined( __i386__ )
+# include <x86intrin.h>
+# endif
+
+# include "mock.h"
+# include "channel_monitor.h"
+# include "leds.h"
+# include "network.h"
+# include "state.h"
+# include "timeout.h"
+
+
+/* --------------------------------- Defines -------------------------------- */
+
+
+# define BENCH_TIMEOUT_PERIOD_US    ( 1100U )
+# define BENCH_ITERATIONS           ( 20 )
+# define BENCH_MAX_FRAME_US         ( 5000000U )
+
+
+/* ------------------------------- Functions -------------------------------- */
+
+
+/**
+ * Reads a cycle counter, or nanoseconds where there isn't one
+ */
+static inline unsigned long long bench_cycles( void )
+{
+# if defined( __x86_64__ ) || defined( __i386__ )
+    return __rdtsc();
+# else
+    struct timespec ts;
+    clock_gettime( CLOCK_MONOTONIC, &ts );
+    return ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+# endif
+}
+
+
+/**
+ * Determines whether a looped back frame is waiting to be decoded
+ */
+static bool bench_frame_received( void )
+{
+    return network_tx_queue_is_empty( ) && !network_rx_queue_is_empty( ) && state_get( ) == IDLE;
+}
+
+
+/**
+ * Determines whether the line is colliding
+ */
+static bool bench_colliding( void )
+{
+    return state_get( ) == COLLISION;
+}
+
+
+/**
+ * Determines whether the bus is mid frame
+ */
+static bool bench_busy( void )
+{
+    return state_get( ) == BUSY;
+}
+
+
+/**
+ * Decodes the received frame and checks it holds a message
+ *
+ * @return  bool if the message arrived intact
+ */
+static bool bench_receive( const uint8_t * message, size_t size, unsigned long long * cycles )
+{
+    const network_message_t * received;
+
+    unsigned long long start = bench_cycles( );
+    network_service( );
+    bool ok = network_port_borrow( NETWORK_PORT_DEFAULT, &received );
+    *cycles += bench_cycles( ) - start;
+
+    if ( !ok )
+    {
+        return false;
+    }
+
+    ok = received->length == size && memcmp( received->data, message, size ) == 0;
+    network_port_release( NETWORK_PORT_DEFAULT, 1 );
+
+    return ok;
+}
+
+
+/**
+ * Loops messages of one size back and reports on them
+ *
+ * @return  bool if every message arrived intact
+ */
+static bool bench_loopback( size_t size )
+{
+    uint8_t message[255];
+    unsigned long long tx_cycles = 0;
+    unsigned long long rx_cycles = 0;
+    uint64_t hb_cycles = mock_irq_cycles( TIM4_IRQn );
+    uint32_t hb_calls = mock_irq_count( TIM4_IRQn );
+    uint64_t edge_cycles = mock_irq_cycles( EXTI15_10_IRQn );
+    uint32_t edge_calls = mock_irq_count( EXTI15_10_IRQn );
+    uint64_t sim_start = mock_clock( );
+    bool ok = true;
+
+    for ( int iteration = 0; iteration < BENCH_ITERATIONS && ok; iteration++ )
+    {
+        for ( size_t i = 0; i < size; i++ )
+        {
+            message[i] = ( uint8_t ) ( 'A' + ( i + iteration ) % 26 );
+        }
+
+        unsigned long long start = bench_cycles( );
+        ok = network_tx( get_local_machine_address( ), message, size ) == ERROR_CODE_NO_ERROR;
+        tx_cycles += bench_cycles( ) - start;
+
+        ok = ok && mock_run_until( bench_frame_received, BENCH_MAX_FRAME_US );
+        ok = ok && bench_receive( message, size, &rx_cycles );
+    }
+
+    double sim_seconds = ( double ) ( mock_clock( ) - sim_start ) / MOCK_CLOCK_HZ;
+    hb_calls = mock_irq_count( TIM4_IRQn ) - hb_calls;
+    edge_calls = mock_irq_count( EXTI15_10_IRQn ) - edge_calls;
+
+    if ( !ok )
+    {
+        printf( "%3u bytes  FAIL\n", ( unsigned int ) size );
+        return false;
+    }
+
+    printf( "%3u bytes  tx %8.0f  rx %8.0f cycles/message  "
+            "half bit %5.0f  edge %5.0f cycles/irq  %6.1f bytes/s\n",
+            ( unsigned int ) size,
+            ( double ) tx_cycles / BENCH_ITERATIONS,
+            ( double ) rx_cycles / BENCH_ITERATIONS,
+            ( double ) ( mock_irq_cycles( TIM4_IRQn ) - hb_cycles ) / hb_calls,
+            ( double ) ( mock_irq_cycles( EXTI15_10_IRQn ) - edge_cycles ) / edge_calls,
+            size * BENCH_ITERATIONS / sim_seconds );
+
+    return true;
+}
+
+
+/**
+ * Pulls the bus low under a frame and checks it is backed off and resent
+ *
+ * @return  bool if the message arrived intact after the collision
+ */
+static bool bench_collision( void )
+{
+    static const uint8_t message[] = "collided";
+    unsigned long long cycles = 0;
+    uint32_t backoffs = mock_irq_count( TIM5_IRQn );
+
+    bool ok = network_tx( get_local_machine_address( ), ( uint8_t * ) message, sizeof( message ) ) ==
+              ERROR_CODE_NO_ERROR;
+
+    // hold the line low from a few bits in until the idle timeout sees it
+    ok = ok && mock_run_until( bench_busy, BENCH_MAX_FRAME_US );
+    mock_run_us( 4000 );
+    mock_line_drive( false );
+    ok = ok && mock_run_until( bench_colliding, BENCH_MAX_FRAME_US );
+    mock_line_drive( true );
+
+    ok = ok && mock_run_until( bench_frame_received, BENCH_MAX_FRAME_US );
+    ok = ok && bench_receive( message, sizeof( message ), &cycles );
+    ok = ok && mock_irq_count( TIM5_IRQn ) > backoffs;
+
+    printf( "collision  %s after %u backoff(s)\n", ok ? "resent" : "FAIL",
+            mock_irq_count( TIM5_IRQn ) - backoffs );
+
+    return ok;
+}
+
+
+int main( void )
+{
+    static const size_t sizes[] = { 1, 16, 64, 255 };
+    bool passed = true;
+
+    mock_reset( );
+
+    // bring the stack up as main() does
+    if ( network_init( ) != ERROR_CODE_NO_ERROR ||
+            channel_monitor_init( ) != ERROR_CODE_NO_ERROR ||
+            timeout_init( BENCH_TIMEOUT_PERIOD_US ) != ERROR_CODE_NO_ERROR ||
+            leds_init( ) != ERROR_CODE_NO_ERROR ||
+            state_set( IDLE ) != ERROR_CODE_NO_ERROR )
+    {
+        printf( "FAIL: init\n" );
+        return 1;
+    }
+
+    for ( size_t i = 0; i < sizeof( sizes ) / sizeof( sizes[0] ); i++ )
+    {
+        passed &= bench_loopback( sizes[i] );
+    }
+
+    passed &= bench_collision( );
+
+    netbuf_stats_t stats;
+    netbuf_stats( &stats );
+    passed &= stats.in_use == 0;
+
+    printf( "simulated %.2f s, %u bus edges, %u buffers in use\n",
+            ( double ) mock_clock( ) / MOCK_CLOCK_HZ, mock_line_edges( ), stats.in_use );
+    printf( passed ? "OK\n" : "FAIL\n" );
+
+    return passed ? 0 : 1;
+}
+
+
+/* -------------------------------------------------------------------------- */
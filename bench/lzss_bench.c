@@ -0,0 +1,213 @@
+/* --------------------------------- Header --------------------------------- */
+
+
+/**
+ * @file    lzss_bench.c
+ * @brief   Host benchmark of the lzss payload compressor
+ *
+ * Compresses representative payloads in network sized chunks and reports the
+ * compression ratio and the cycles spent per input byte. Every chunk is
+ * decompressed and compared against the original.
+ *
+ * Built with the host build, see host/CMakeLists.txt:
+ *
+ *      ./build-host/host/lzss_bench
+ */
+
+
+/* -------------------------------- Includes -------------------------------- */
+
+
+# include <stdio.h>
+# include <stdlib.h>
+# include <string.h>
+# include <time.h>
+
+# if defined( __x86_64__ ) || defined( __i386__ )
+# include <x86intrin.h>
+# endif
+
+# include "lzss.h"
+
+
+/* --------------------------------- Defines -------------------------------- */
+
+
+# define BENCH_CHUNK_SIZE   ( 255 )
+# define BENCH_DATA_SIZE    ( 64 * 1024 )
+# define BENCH_ITERATIONS   ( 20 )
+
+
+/* ------------------------------- Functions -------------------------------- */
+
+
+/**
+ * Reads a cycle counter, or nanoseconds where there isn't one
+ */
+static inline unsigned long long bench_cycles( void )
+{
+# if defined( __x86_64__ ) || defined( __i386__ )
+    return __rdtsc();
+# else
+    struct timespec ts;
+    clock_gettime( CLOCK_MONOTONIC, &ts );
+    return ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+# endif
+}
+
+
+/**
+ * Fills a buffer with console log lines
+ */
+static size_t bench_fill_log( uint8_t * data, size_t size )
+{
+    static const char * levels[] = { "INFO", "WARN", "DEBUG" };
+    static const char * events[] = {
+        "frame sent to 0x%02X after %u backoffs",
+        "collision detected, backing off %u ms",
+        "received %u bytes from 0x%02X",
+        "queue depth %u of 10",
+    };
+    size_t used = 0;
+    unsigned int i = 0;
+
+    while ( used + 96 < size )
+    {
+        char line[96];
+        int len = snprintf( line, sizeof( line ), "[%08u] %-5s net: ", i * 37, levels[i % 3] );
+        len += snprintf( line + len, sizeof( line ) - len, events[i % 4], rand( ) % 256, rand( ) % 16 );
+        line[len++] = '\n';
+        memcpy( data + used, line, len );
+        used += len;
+        i++;
+    }
+
+    return used;
+}
+
+
+/**
+ * Fills a buffer with fixed layout telemetry records of slowly changing values
+ */
+static size_t bench_fill_telemetry( uint8_t * data, size_t size )
+{
+    size_t used = 0;
+    uint16_t temperature = 2150;
+    uint16_t voltage = 3300;
+
+    for ( uint32_t seq = 0; used + 16 <= size; seq++ )
+    {
+        temperature += rand( ) % 3 - 1;
+        voltage += rand( ) % 5 - 2;
+        uint8_t record[16] = {
+            0xA5, 0x01, seq, seq >> 8,
+            temperature, temperature >> 8, voltage, voltage >> 8,
+            0, 0, 0, 0,
+            seq % 10 == 0, 0, 0, 0x5A
+        };
+        memcpy( data + used, record, sizeof( record ) );
+        used += sizeof( record );
+    }
+
+    return used;
+}
+
+
+/**
+ * Fills a buffer with random bytes, which shouldn't compress
+ */
+static size_t bench_fill_random( uint8_t * data, size_t size )
+{
+    for ( size_t i = 0; i < size; i++ )
+    {
+        data[i] = rand( );
+    }
+
+    return size;
+}
+
+
+/**
+ * Compresses a data set in chunks and prints its results
+ *
+ * @return  bool if every chunk decompressed back to the original
+ */
+static int bench_run( const char * name, const uint8_t * data, size_t size )
+{
+    uint8_t compressed[BENCH_CHUNK_SIZE];
+    uint8_t decompressed[BENCH_CHUNK_SIZE];
+    unsigned long long compress_cycles = 0;
+    unsigned long long decompress_cycles = 0;
+    size_t sent_bytes = 0;
+    size_t compressed_chunks = 0;
+    size_t chunks = 0;
+
+    for ( int iteration = 0; iteration < BENCH_ITERATIONS; iteration++ )
+    {
+        for ( size_t offset = 0; offset < size; offset += BENCH_CHUNK_SIZE )
+        {
+            size_t chunk = size - offset < BENCH_CHUNK_SIZE ? size - offset : BENCH_CHUNK_SIZE;
+
+            unsigned long long start = bench_cycles( );
+            size_t compressed_size = lzss_compress( data + offset, chunk, compressed, chunk );
+            compress_cycles += bench_cycles( ) - start;
+
+            if ( iteration > 0 )
+            {
+                continue;
+            }
+
+            chunks++;
+            if ( compressed_size == 0 )
+            {
+                // sent uncompressed, as network_tx does
+                sent_bytes += chunk;
+                continue;
+            }
+
+            size_t decompressed_size = 0;
+            start = bench_cycles( );
+            bool valid = lzss_decompress( compressed, compressed_size, decompressed,
+                                          sizeof( decompressed ), &decompressed_size );
+            decompress_cycles += bench_cycles( ) - start;
+
+            if ( !valid || decompressed_size != chunk || memcmp( decompressed, data + offset, chunk ) )
+            {
+                printf( "%s: chunk at %zu did not round trip\n", name, offset );
+                return 0;
+            }
+
+            sent_bytes += compressed_size;
+            compressed_chunks++;
+        }
+    }
+
+    printf( "%-10s %8zu %8zu %7.3f %8zu/%-6zu %10.1f %10.1f\n",
+            name, size, sent_bytes, ( double ) sent_bytes / size,
+            compressed_chunks, chunks,
+            ( double ) compress_cycles / ( ( double ) size * BENCH_ITERATIONS ),
+            ( double ) decompress_cycles / size );
+
+    return 1;
+}
+
+
+int main( void )
+{
+    static uint8_t data[BENCH_DATA_SIZE];
+    int ok = 1;
+
+    srand( 4951 );
+
+    printf( "%-10s %8s %8s %7s %15s %10s %10s\n",
+            "data", "bytes", "sent", "ratio", "chunks", "comp c/B", "decomp c/B" );
+
+    ok &= bench_run( "log", data, bench_fill_log( data, sizeof( data ) ) );
+    ok &= bench_run( "telemetry", data, bench_fill_telemetry( data, sizeof( data ) ) );
+    ok &= bench_run( "random", data, bench_fill_random( data, sizeof( data ) ) );
+
+    return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+
+/* -------------------------------------------------------------------------- */
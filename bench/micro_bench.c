@@ -0,0 +1,71 @@
+/* --------------------------------- Header --------------------------------- */
+
+
+/**
+ * @file    micro_bench.c
+ * @brief   Host runner of the network stack microbenchmarks
+ *
+ * Runs the suite in network_bench.c natively, the same one the /bench
+ * command runs on the target, and prints its comma separated results. Save
+ * the output of two builds and join them on the case and bytes columns to
+ * compare them. Exits non-zero if a decoded frame didn't match.
+ *
+ * Build and run from the repository root:
+ *
+ *      cmake -S . -B build-host -DCE4951_HOST_BUILD=ON
+ *      cmake --build build-host
+ *      ./build-host/host/micro_bench [samples]
+ */
+
+
+/* -------------------------------- Includes -------------------------------- */
+
+
+# include <stdio.h>
+# include <stdlib.h>
+
+# include "mock.h"
+# include "network.h"
+# include "network_bench.h"
+# include "microbench.h"
+
+
+/* --------------------------------- Defines -------------------------------- */
+
+
+# define BENCH_SAMPLES      ( 31 )
+
+
+/* ------------------------------- Functions -------------------------------- */
+
+
+int main( int argc, char ** argv )
+{
+    unsigned int samples = argc > 1 ? strtoul( argv[1], NULL, 0 ) : BENCH_SAMPLES;
+
+    if ( samples == 0 || samples > MICROBENCH_SAMPLES_MAX )
+    {
+        fprintf( stderr, "usage: %s [samples, 1 to %d]\n", argv[0], MICROBENCH_SAMPLES_MAX );
+        return 2;
+    }
+
+    mock_reset( );
+
+    if ( network_init( ) != ERROR_CODE_NO_ERROR )
+    {
+        printf( "FAIL: init\n" );
+        return 1;
+    }
+
+    ERROR_CODE error = network_bench_run( samples );
+    if ( error != ERROR_CODE_NO_ERROR )
+    {
+        printf( "FAIL: error 0x%02X\n", error );
+        return 1;
+    }
+
+    return 0;
+}
+
+
+/* -------------------------------------------------------------------------- */
@@ -0,0 +1,161 @@
+/* --------------------------------- Header --------------------------------- */
+
+
+/**
+ * @file    netbuf_bench.c
+ * @brief   Host benchmark of the reference counted message buffer pool
+ *
+ * Queues a message to several destinations the way the transmit path did
+ * before the pool, copying its Manchester encoded slots into a record for
+ * every destination, and the way it does now, copying it into a pool buffer
+ * once and taking a reference for every destination. Reports the cycles
+ * spent per message and checks the pool's counters balance once every
+ * reference is dropped.
+ *
+ * Built with the host build, see host/CMakeLists.txt:
+ *
+ *      ./build-host/host/netbuf_bench
+ */
+
+
+/* -------------------------------- Includes -------------------------------- */
+
+
+# include <stdio.h>
+# include <stdlib.h>
+# include <string.h>
+# include <time.h>
+
+# if defined( __x86_64__ ) || defined( __i386__ )
+# include <x86intrin.h>
+# endif
+
+# include "netbuf.h"
+
+
+/* --------------------------------- Defines -------------------------------- */
+
+
+# define BENCH_MESSAGE_SIZE     ( 255 )
+# define BENCH_SLOTS_SIZE       ( ( BENCH_MESSAGE_SIZE + 7 ) * 2 )
+# define BENCH_DESTINATIONS     ( 4 )
+# define BENCH_ITERATIONS       ( 200000 )
+
+
+/* ------------------------------- Functions -------------------------------- */
+
+
+/**
+ * Reads a cycle counter, or nanoseconds where there isn't one
+ */
+static inline unsigned long long bench_cycles( void )
+{
+# if defined( __x86_64__ ) || defined( __i386__ )
+    return __rdtsc();
+# else
+    struct timespec ts;
+    clock_gettime( CLOCK_MONOTONIC, &ts );
+    return ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+# endif
+}
+
+
+int main( void )
+{
+    static uint8_t message[BENCH_MESSAGE_SIZE];
+    static uint8_t slots[BENCH_SLOTS_SIZE];
+    static uint8_t records[BENCH_DESTINATIONS][BENCH_SLOTS_SIZE];
+    netbuf_t * refs[BENCH_DESTINATIONS];
+    unsigned long long copy_cycles = 0;
+    unsigned long long pool_cycles = 0;
+    unsigned int checksum = 0;
+
+    for ( size_t i = 0; i < sizeof( message ); i++ )
+    {
+        message[i] = rand( );
+        slots[i * 2] = message[i];
+        slots[i * 2 + 1] = ~message[i];
+    }
+
+    netbuf_init( );
+
+    for ( int iteration = 0; iteration < BENCH_ITERATIONS; iteration++ )
+    {
+        // a copy of the slots per destination, then dequeued
+        unsigned long long start = bench_cycles( );
+        for ( int dest = 0; dest < BENCH_DESTINATIONS; dest++ )
+        {
+            memcpy( records[dest], slots, sizeof( slots ) );
+        }
+        for ( int dest = 0; dest < BENCH_DESTINATIONS; dest++ )
+        {
+            checksum += records[dest][iteration % BENCH_MESSAGE_SIZE];
+        }
+        copy_cycles += bench_cycles( ) - start;
+
+        // one copy into a pool buffer and a reference per destination
+        start = bench_cycles( );
+        netbuf_t * buf = netbuf_alloc( );
+        if ( buf == NULL )
+        {
+            printf( "FAIL: pool empty\n" );
+            return 1;
+        }
+        memcpy( buf->data, message, sizeof( message ) );
+        buf->length = sizeof( message );
+        for ( int dest = 0; dest < BENCH_DESTINATIONS; dest++ )
+        {
+            refs[dest] = netbuf_ref( buf );
+        }
+        netbuf_free( buf );
+        for ( int dest = 0; dest < BENCH_DESTINATIONS; dest++ )
+        {
+            checksum += refs[dest]->data[iteration % BENCH_MESSAGE_SIZE];
+            netbuf_free( refs[dest] );
+        }
+        pool_cycles += bench_cycles( ) - start;
+    }
+
+    // every buffer is back in the pool and can be taken again
+    netbuf_t * all[NETBUF_POOL_SIZE];
+    for ( int i = 0; i < NETBUF_POOL_SIZE; i++ )
+    {
+        all[i] = netbuf_alloc( );
+    }
+    bool exhausted = netbuf_alloc( ) == NULL;
+    for ( int i = 0; i < NETBUF_POOL_SIZE; i++ )
+    {
+        netbuf_free( all[i] );
+    }
+
+    netbuf_stats_t stats;
+    netbuf_stats( &stats );
+
+    printf( "%d byte message to %d destinations, checksum %u\n",
+            BENCH_MESSAGE_SIZE, BENCH_DESTINATIONS, checksum );
+    printf( "copy per destination  %8.1f cycles/message\n", ( double ) copy_cycles / BENCH_ITERATIONS );
+    printf( "pool buffer refs      %8.1f cycles/message\n", ( double ) pool_cycles / BENCH_ITERATIONS );
+    printf( "allocs %u frees %u in use %u peak %u failures %u\n",
+            stats.allocs, stats.frees, stats.in_use, stats.peak, stats.failures );
+
+    for ( int i = 0; i < NETBUF_POOL_SIZE; i++ )
+    {
+        if ( all[i] == NULL )
+        {
+            exhausted = false;
+        }
+    }
+
+    if ( !exhausted || stats.in_use != 0 || stats.peak != NETBUF_POOL_SIZE || stats.failures != 1 )
+    {
+        printf( "FAIL\n" );
+        return 1;
+    }
+
+    printf( "OK\n" );
+
+    return 0;
+}
+
+
+/* -------------------------------------------------------------------------- */
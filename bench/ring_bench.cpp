@@ -0,0 +1,243 @@
+/* --------------------------------- Header --------------------------------- */
+
+
+/**
+ * @file    ring_bench.cpp
+ * @brief   Host benchmark of the ring against the circular queue it replaced
+ *
+ * Moves bytes through the legacy circular queue, the C interface of the ring
+ * a byte at a time and in bulk, and the ring template, reporting the cycles
+ * spent per byte. Every byte is checked on the way out. A producer and a
+ * consumer thread then stream bytes through the C interface to check it
+ * across threads.
+ *
+ * Built with the host build, see host/CMakeLists.txt:
+ *
+ *      ./build-host/host/ring_bench
+ */
+
+
+/* -------------------------------- Includes -------------------------------- */
+
+
+# include <cstdio>
+# include <ctime>
+# include <thread>
+
+# if defined( __x86_64__ ) || defined( __i386__ )
+# include <x86intrin.h>
+# endif
+
+# include "ring.hpp"
+
+extern "C" {
+# include "circular_queue.h"
+}
+
+
+/* --------------------------------- Defines -------------------------------- */
+
+
+# define BENCH_CAPACITY     ( 2048 )
+# define BENCH_BATCH        ( 1024 )
+# define BENCH_ITERATIONS   ( 20000 )
+# define BENCH_STREAM_BYTES ( 50000000UL )
+
+
+/* ------------------------------- Functions -------------------------------- */
+
+
+/**
+ * Reads a cycle counter, or nanoseconds where there isn't one
+ */
+static inline unsigned long long bench_cycles( void )
+{
+# if defined( __x86_64__ ) || defined( __i386__ )
+    return __rdtsc();
+# else
+    struct timespec ts;
+    clock_gettime( CLOCK_MONOTONIC, &ts );
+    return ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+# endif
+}
+
+
+/**
+ * Prints the cycles per byte of a run, or its failure
+ *
+ * @return  bool if the run passed
+ */
+static bool bench_report( const char * name, unsigned long long cycles, bool ok )
+{
+    if ( !ok )
+    {
+        printf( "%-22s FAIL\n", name );
+        return false;
+    }
+
+    printf( "%-22s %8.2f cycles/byte\n", name,
+            ( double ) cycles / ( ( double ) BENCH_BATCH * BENCH_ITERATIONS ) );
+    return true;
+}
+
+
+/**
+ * Streams bytes from a producer thread to a consumer thread
+ *
+ * @return  bool if every byte arrived in order
+ */
+static bool bench_stream( void )
+{
+    static uint8_t storage[BENCH_CAPACITY];
+    static ring_t ring;
+    bool ok = true;
+
+    ring_init( &ring, storage, sizeof( storage ) );
+
+    std::thread producer( [ & ] {
+        uint8_t chunk[97];
+        unsigned long sent = 0;
+        while ( sent < BENCH_STREAM_BYTES )
+        {
+            uint32_t size = BENCH_STREAM_BYTES - sent < sizeof( chunk ) ? BENCH_STREAM_BYTES - sent : sizeof( chunk );
+            for ( uint32_t i = 0; i < size; i++ )
+            {
+                chunk[i] = ( uint8_t ) ( sent + i );
+            }
+
+            // push what fits, yielding while the ring is full
+            uint32_t written = 0;
+            while ( written < size )
+            {
+                written += ring_write( &ring, chunk + written, size - written );
+                if ( written < size )
+                {
+                    std::this_thread::yield( );
+                }
+            }
+            sent += size;
+        }
+    } );
+
+    unsigned long received = 0;
+    while ( received < BENCH_STREAM_BYTES && ok )
+    {
+        const uint8_t * span;
+        uint32_t size = ring_read_span( &ring, &span );
+        if ( size == 0 )
+        {
+            std::this_thread::yield( );
+            continue;
+        }
+
+        for ( uint32_t i = 0; i < size; i++ )
+        {
+            ok = ok && span[i] == ( uint8_t ) ( received + i );
+        }
+        received += size;
+        ring_consume( &ring, size );
+    }
+
+    producer.join( );
+
+    printf( "%-22s %lu bytes %s\n", "threaded stream", received, ok ? "in order" : "CORRUPT" );
+    return ok && ring_is_empty( &ring );
+}
+
+
+int main( void )
+{
+    static circular_queue cq;
+    static uint8_t storage[BENCH_CAPACITY];
+    static uint8_t batch[BENCH_BATCH];
+    static uint8_t out[BENCH_BATCH];
+    static util::ring< uint8_t, BENCH_CAPACITY > template_ring;
+    ring_t ring;
+    unsigned long long cycles;
+    bool ok = true;
+    bool passed = true;
+
+    for ( int i = 0; i < BENCH_BATCH; i++ )
+    {
+        batch[i] = i * 7;
+    }
+
+    // legacy circular queue, a byte at a time
+    cq = cq_init( );
+    cycles = 0;
+    for ( int iteration = 0; iteration < BENCH_ITERATIONS; iteration++ )
+    {
+        unsigned long long start = bench_cycles( );
+        for ( int i = 0; i < BENCH_BATCH; i++ )
+        {
+            cq_push( &cq, batch[i] );
+        }
+        for ( int i = 0; i < BENCH_BATCH; i++ )
+        {
+            out[i] = cq_pull( &cq );
+        }
+        cycles += bench_cycles( ) - start;
+        ok = ok && cq_isempty( &cq ) && out[iteration % BENCH_BATCH] == batch[iteration % BENCH_BATCH];
+    }
+    passed &= bench_report( "cq_push/cq_pull", cycles, ok );
+
+    // ring C interface, a byte at a time
+    ring_init( &ring, storage, sizeof( storage ) );
+    cycles = 0;
+    for ( int iteration = 0; iteration < BENCH_ITERATIONS; iteration++ )
+    {
+        unsigned long long start = bench_cycles( );
+        for ( int i = 0; i < BENCH_BATCH; i++ )
+        {
+            ok = ok && ring_push( &ring, batch[i] );
+        }
+        for ( int i = 0; i < BENCH_BATCH; i++ )
+        {
+            ok = ok && ring_pop( &ring, &out[i] );
+        }
+        cycles += bench_cycles( ) - start;
+        ok = ok && ring_is_empty( &ring ) && out[iteration % BENCH_BATCH] == batch[iteration % BENCH_BATCH];
+    }
+    passed &= bench_report( "ring_push/ring_pop", cycles, ok );
+
+    // ring C interface in bulk, offset so the copies wrap
+    ring_init( &ring, storage, sizeof( storage ) );
+    ring_write( &ring, batch, 100 );
+    ring_read( &ring, out, 100 );
+    cycles = 0;
+    for ( int iteration = 0; iteration < BENCH_ITERATIONS; iteration++ )
+    {
+        unsigned long long start = bench_cycles( );
+        ok = ok && ring_write( &ring, batch, BENCH_BATCH ) == BENCH_BATCH;
+        ok = ok && ring_read( &ring, out, BENCH_BATCH ) == BENCH_BATCH;
+        cycles += bench_cycles( ) - start;
+        ok = ok && out[iteration % BENCH_BATCH] == batch[iteration % BENCH_BATCH];
+    }
+    passed &= bench_report( "ring_write/ring_read", cycles, ok );
+
+    // ring template, a byte at a time
+    cycles = 0;
+    for ( int iteration = 0; iteration < BENCH_ITERATIONS; iteration++ )
+    {
+        unsigned long long start = bench_cycles( );
+        for ( int i = 0; i < BENCH_BATCH; i++ )
+        {
+            ok = ok && template_ring.push( batch[i] );
+        }
+        for ( int i = 0; i < BENCH_BATCH; i++ )
+        {
+            ok = ok && template_ring.pop( out[i] );
+        }
+        cycles += bench_cycles( ) - start;
+        ok = ok && template_ring.empty( ) && out[iteration % BENCH_BATCH] == batch[iteration % BENCH_BATCH];
+    }
+    passed &= bench_report( "util::ring push/pop", cycles, ok );
+
+    passed &= bench_stream( );
+
+    printf( passed ? "OK\n" : "FAIL\n" );
+    return passed ? 0 : 1;
+}
+
+
+/* -------------------------------------------------------------------------- */
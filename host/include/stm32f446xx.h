@@ -0,0 +1,95 @@
+/* --------------------------------- Header --------------------------------- */
+
+
+/**
+ * @file    stm32f446xx.h
+ * @brief   Stands in for the device header in the host build
+ *
+ * Includes the real device header for its register layouts and bit
+ * definitions, then points every peripheral the firmware touches at a
+ * register block in RAM owned by mock.c, and replaces the Cortex-M
+ * intrinsics that can't run on the host. This directory is searched before
+ * the CMSIS ones so the firmware sources build unchanged.
+ */
+
+
+/* ------------------------------ Header Guard ------------------------------ */
+
+
+# ifndef HOST_STM32F446XX_H
+# define HOST_STM32F446XX_H
+
+
+/* -------------------------------- Includes -------------------------------- */
+
+
+# include "../../stm32/cmsis/device/st/stm32f4xx/include/stm32f446xx.h"
+
+
+/* ------------------------------- Peripherals ------------------------------ */
+
+
+# ifdef __cplusplus
+extern "C" {
+# endif
+
+extern GPIO_TypeDef mock_gpiob;
+extern GPIO_TypeDef mock_gpioc;
+extern TIM_TypeDef mock_tim2;
+extern TIM_TypeDef mock_tim3;
+extern TIM_TypeDef mock_tim4;
+extern TIM_TypeDef mock_tim5;
+extern EXTI_TypeDef mock_exti;
+extern SYSCFG_TypeDef mock_syscfg;
+extern RCC_TypeDef mock_rcc;
+extern NVIC_Type mock_nvic;
+extern SysTick_Type mock_systick;
+
+uint32_t mock_get_primask( void );
+void mock_set_primask( uint32_t primask );
+
+# ifdef __cplusplus
+}
+# endif
+
+# undef GPIOB
+# undef GPIOC
+# undef TIM2
+# undef TIM3
+# undef TIM4
+# undef TIM5
+# undef EXTI
+# undef SYSCFG
+# undef RCC
+# undef NVIC
+# undef SysTick
+
+# define GPIOB      ( &mock_gpiob )
+# define GPIOC      ( &mock_gpioc )
+# define TIM2       ( &mock_tim2 )
+# define TIM3       ( &mock_tim3 )
+# define TIM4       ( &mock_tim4 )
+# define TIM5       ( &mock_tim5 )
+# define EXTI       ( &mock_exti )
+# define SYSCFG     ( &mock_syscfg )
+# define RCC        ( &mock_rcc )
+# define NVIC       ( &mock_nvic )
+# define SysTick    ( &mock_systick )
+
+
+/* ------------------------------- Intrinsics ------------------------------- */
+
+
+# define __get_PRIMASK( )           mock_get_primask( )
+# define __set_PRIMASK( primask )   mock_set_primask( primask )
+# define __disable_irq( )           mock_set_primask( 1U )
+# define __enable_irq( )            mock_set_primask( 0U )
+
+
+/* --------------------------------- Footer --------------------------------- */
+
+
+# endif // HOST_STM32F446XX_H
+
+
+/* -------------------------------------------------------------------------- */
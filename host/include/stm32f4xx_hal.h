@@ -0,0 +1,44 @@
+/* --------------------------------- Header --------------------------------- */
+
+
+/**
+ * @file    stm32f4xx_hal.h
+ * @brief   Stands in for the HAL in the host build, which only needs its time
+ *          base. The tick follows the simulated time kept by mock.c.
+ */
+
+
+/* ------------------------------ Header Guard ------------------------------ */
+
+
+# ifndef HOST_STM32F4XX_HAL_H
+# define HOST_STM32F4XX_HAL_H
+
+
+/* -------------------------------- Includes -------------------------------- */
+
+
+# include "stm32f446xx.h"
+
+
+/* ------------------------------- Functions -------------------------------- */
+
+
+# ifdef __cplusplus
+extern "C" {
+# endif
+
+uint32_t HAL_GetTick( void );
+
+# ifdef __cplusplus
+}
+# endif
+
+
+/* --------------------------------- Footer --------------------------------- */
+
+
+# endif // HOST_STM32F4XX_HAL_H
+
+
+/* -------------------------------------------------------------------------- */
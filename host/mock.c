@@ -0,0 +1,643 @@
+/* --------------------------------- Header --------------------------------- */
+
+
+/**
+ * @file    mock.c
+ * @brief   Contains the simulated peripherals of the host build
+ */
+
+
+/* -------------------------------- Includes -------------------------------- */
+
+
+# include <stdarg.h>
+# include <stdio.h>
+# include <string.h>
+# include <time.h>
+
+# if defined( __x86_64__ ) || defined( __i386__ )
+# include <x86intrin.h>
+# endif
+
+# include "mock.h"
+# include "stm32f4xx_hal.h"
+# include "uio.h"
+
+
+/* --------------------------------- Defines -------------------------------- */
+
+
+/**
+ * The SysTick reload for a 1 ms tick at the 168 MHz core clock, which is
+ * twice the timer clock
+ */
+# define MOCK_SYSTICK_LOAD      ( 2U * MOCK_CLOCK_HZ / 1000U - 1U )
+
+
+/**
+ * The number of interrupts the mock keeps counts of
+ */
+# define MOCK_IRQ_COUNT         ( 128 )
+
+
+/**
+ * The bound on handler calls for one instant, reached only by a handler that
+ * never clears its flag
+ */
+# define MOCK_IRQ_STORM_LIMIT   ( 64 )
+
+
+/* ---------------------------------- Types --------------------------------- */
+
+
+/**
+ * A general purpose timer counting up to ARR
+ */
+typedef struct
+{
+    TIM_TypeDef * tim;
+    IRQn_Type irq;
+    uint32_t top;           // the largest count, the counter wraps after it
+    uint32_t prescale;      // clocks counted towards the next increment
+} mock_timer_t;
+
+
+/* -------------------------------- Variables ------------------------------- */
+
+
+GPIO_TypeDef mock_gpiob;
+GPIO_TypeDef mock_gpioc;
+TIM_TypeDef mock_tim2;
+TIM_TypeDef mock_tim3;
+TIM_TypeDef mock_tim4;
+TIM_TypeDef mock_tim5;
+EXTI_TypeDef mock_exti;
+SYSCFG_TypeDef mock_syscfg;
+RCC_TypeDef mock_rcc;
+NVIC_Type mock_nvic;
+SysTick_Type mock_systick;
+
+static mock_timer_t mock_timers[] =
+{
+    { &mock_tim2, TIM2_IRQn, 0xFFFFFFFFU, 0 },
+    { &mock_tim3, TIM3_IRQn, 0xFFFFU, 0 },
+    { &mock_tim4, TIM4_IRQn, 0xFFFFU, 0 },
+    { &mock_tim5, TIM5_IRQn, 0xFFFFFFFFU, 0 },
+};
+
+static uint64_t mock_time;
+static uint32_t mock_primask;
+static unsigned int mock_active;
+static bool mock_external_high;
+static uint32_t mock_edges;
+static uint32_t mock_irq_calls[MOCK_IRQ_COUNT];
+static uint64_t mock_irq_spent[MOCK_IRQ_COUNT];
+static FILE * mock_console_stream;
+static bool mock_console_set;
+
+
+/* ------------------------------- Functions -------------------------------- */
+
+
+void TIM3_IRQHandler( void );
+void TIM4_IRQHandler( void );
+void TIM5_IRQHandler( void );
+void EXTI15_10_IRQHandler( void );
+
+static void mock_service( void );
+static void mock_line_update( void );
+
+
+/**
+ * Reads a cycle counter, or nanoseconds where there isn't one
+ */
+static inline uint64_t mock_cycles( void )
+{
+# if defined( __x86_64__ ) || defined( __i386__ )
+    return __rdtsc( );
+# else
+    struct timespec ts;
+    clock_gettime( CLOCK_MONOTONIC, &ts );
+    return ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+# endif
+}
+
+
+/**
+ * Puts every peripheral in its reset state with the bus idle, must be called
+ * before the firmware is initialized since the firmware's own state isn't
+ * reset with it
+ */
+void mock_reset( void )
+{
+    memset( &mock_gpiob, 0, sizeof( mock_gpiob ) );
+    memset( &mock_gpioc, 0, sizeof( mock_gpioc ) );
+    memset( &mock_tim2, 0, sizeof( mock_tim2 ) );
+    memset( &mock_tim3, 0, sizeof( mock_tim3 ) );
+    memset( &mock_tim4, 0, sizeof( mock_tim4 ) );
+    memset( &mock_tim5, 0, sizeof( mock_tim5 ) );
+    memset( &mock_exti, 0, sizeof( mock_exti ) );
+    memset( &mock_syscfg, 0, sizeof( mock_syscfg ) );
+    memset( &mock_rcc, 0, sizeof( mock_rcc ) );
+    memset( &mock_nvic, 0, sizeof( mock_nvic ) );
+    memset( &mock_systick, 0, sizeof( mock_systick ) );
+    memset( mock_irq_calls, 0, sizeof( mock_irq_calls ) );
+    memset( mock_irq_spent, 0, sizeof( mock_irq_spent ) );
+
+    for ( size_t i = 0; i < sizeof( mock_timers ) / sizeof( mock_timers[0] ); i++ )
+    {
+        mock_timers[i].tim->ARR = mock_timers[i].top;
+        mock_timers[i].prescale = 0;
+    }
+
+    mock_systick.LOAD = MOCK_SYSTICK_LOAD;
+    mock_systick.VAL = MOCK_SYSTICK_LOAD;
+
+    // the bus idles high through its pull up
+    mock_gpioc.IDR = GPIO_IDR_ID11 | GPIO_IDR_ID12;
+
+    mock_time = 0;
+    mock_primask = 0;
+    mock_active = 0;
+    mock_external_high = true;
+    mock_edges = 0;
+}
+
+
+/**
+ * Finds the clocks until a timer's next update or compare event
+ */
+static uint64_t mock_timer_next( const mock_timer_t * timer )
+{
+    const TIM_TypeDef * tim = timer->tim;
+    uint64_t period = ( uint64_t ) tim->PSC + 1;
+    uint32_t count = tim->CNT;
+    uint64_t counts;
+
+    // a counter above ARR runs on to its top and wraps before it updates
+    if ( count <= tim->ARR )
+    {
+        counts = ( uint64_t ) tim->ARR - count + 1;
+    }
+    else
+    {
+        counts = ( uint64_t ) timer->top - count + 1 + tim->ARR + 1;
+    }
+
+    if ( tim->CCR1 > count && tim->CCR1 <= tim->ARR && tim->CCR1 - count < counts )
+    {
+        counts = tim->CCR1 - count;
+    }
+
+    return ( counts - 1 ) * period + ( period - timer->prescale );
+}
+
+
+/**
+ * Counts a timer on by a number of clocks, no further than its next event
+ */
+static void mock_timer_advance( mock_timer_t * timer, uint64_t clocks )
+{
+    TIM_TypeDef * tim = timer->tim;
+    uint64_t period = ( uint64_t ) tim->PSC + 1;
+    uint64_t total = timer->prescale + clocks;
+    uint32_t count = tim->CNT;
+
+    timer->prescale = total % period;
+    if ( total < period )
+    {
+        return;
+    }
+
+    uint64_t next = count + total / period;
+    bool below_arr = count <= tim->ARR;
+
+    if ( !below_arr && next > timer->top )
+    {
+        next -= ( uint64_t ) timer->top + 1;
+        below_arr = true;
+    }
+
+    if ( below_arr && next == ( uint64_t ) tim->ARR + 1 )
+    {
+        tim->CNT = 0;
+        tim->SR |= TIM_SR_UIF;
+    }
+    else
+    {
+        tim->CNT = ( uint32_t ) next;
+        if ( tim->CNT == tim->CCR1 )
+        {
+            tim->SR |= TIM_SR_CC1IF;
+        }
+    }
+}
+
+
+/**
+ * Finds the clocks until the next event of any running timer
+ *
+ * @return  The clocks to the next event, or UINT64_MAX if no timer runs
+ */
+static uint64_t mock_timers_next( void )
+{
+    uint64_t step = UINT64_MAX;
+
+    for ( size_t i = 0; i < sizeof( mock_timers ) / sizeof( mock_timers[0] ); i++ )
+    {
+        if ( mock_timers[i].tim->CR1 & TIM_CR1_CEN )
+        {
+            uint64_t next = mock_timer_next( &mock_timers[i] );
+            step = next < step ? next : step;
+        }
+    }
+
+    return step;
+}
+
+
+/**
+ * Lets time pass, firing the interrupts that come due
+ *
+ * @param   [in]    end     The clock to run until
+ * @param   [in]    done    Stops the run early once it returns true, or NULL
+ *
+ * @return  bool if done returned true
+ */
+static bool mock_advance( uint64_t end, bool ( * done )( void ) )
+{
+    mock_service( );
+
+    while ( mock_time < end )
+    {
+        if ( done != NULL && done( ) )
+        {
+            return true;
+        }
+
+        uint64_t step = mock_timers_next( );
+        step = end - mock_time < step ? end - mock_time : step;
+
+        for ( size_t i = 0; i < sizeof( mock_timers ) / sizeof( mock_timers[0] ); i++ )
+        {
+            if ( mock_timers[i].tim->CR1 & TIM_CR1_CEN )
+            {
+                mock_timer_advance( &mock_timers[i], step );
+            }
+        }
+
+        mock_time += step;
+        mock_systick.VAL = MOCK_SYSTICK_LOAD - ( uint32_t ) ( ( mock_time * 2 ) % ( MOCK_SYSTICK_LOAD + 1 ) );
+
+        mock_service( );
+    }
+
+    return done != NULL && done( );
+}
+
+
+/**
+ * Runs the firmware's interrupts for a number of microseconds
+ */
+void mock_run_us( uint32_t us )
+{
+    mock_advance( mock_time + ( uint64_t ) us * ( MOCK_CLOCK_HZ / 1000000UL ), NULL );
+}
+
+
+/**
+ * Runs the firmware's interrupts up to a clock, for a caller that schedules
+ * several simulated boards against one time line
+ *
+ * @param   [in]    clock   The clock to run until, see mock_clock()
+ */
+void mock_run_to( uint64_t clock )
+{
+    mock_advance( clock, NULL );
+}
+
+
+/**
+ * Finds when the next timer event is due
+ *
+ * @return  The clock of the next event, or UINT64_MAX if no timer runs
+ */
+uint64_t mock_next_event( void )
+{
+    uint64_t step = mock_timers_next( );
+
+    return step == UINT64_MAX ? UINT64_MAX : mock_time + step;
+}
+
+
+/**
+ * Runs the firmware's interrupts until a condition holds
+ *
+ * @param   [in]    done    Checked after every interrupt
+ * @param   [in]    max_us  The most microseconds to run for
+ *
+ * @return  bool if the condition held before the time ran out
+ */
+bool mock_run_until( bool ( * done )( void ), uint32_t max_us )
+{
+    return mock_advance( mock_time + ( uint64_t ) max_us * ( MOCK_CLOCK_HZ / 1000000UL ), done );
+}
+
+
+/**
+ * Gets the timer clocks elapsed since mock_reset()
+ */
+uint64_t mock_clock( void )
+{
+    return mock_time;
+}
+
+
+/**
+ * Drives the bus from outside the board, as another node would
+ *
+ * @param   [in]    high    false to pull the bus low, true to release it
+ */
+void mock_line_drive( bool high )
+{
+    mock_external_high = high;
+    mock_service( );
+}
+
+
+/**
+ * Gets the level of the bus
+ */
+bool mock_line( void )
+{
+    return mock_gpioc.IDR & GPIO_IDR_ID12;
+}
+
+
+/**
+ * Determines whether PC11 is pulling the bus low
+ */
+bool mock_line_pulled_low( void )
+{
+    bool pc11_output = ( mock_gpioc.MODER & GPIO_MODER_MODER11 ) == ( 0b01U << GPIO_MODER_MODER11_Pos );
+
+    return pc11_output && !( mock_gpioc.ODR & GPIO_ODR_OD11 );
+}
+
+
+/**
+ * Gets the number of edges the bus has seen since mock_reset()
+ */
+uint32_t mock_line_edges( void )
+{
+    return mock_edges;
+}
+
+
+/**
+ * Finds the bus level from PC11 and the outside driver, mirrors it on PC12
+ * and raises EXTI line 12 on the edges it is configured for
+ */
+static void mock_line_update( void )
+{
+    bool high = mock_external_high && !mock_line_pulled_low( );
+
+    if ( high == mock_line( ) )
+    {
+        return;
+    }
+
+    if ( high )
+    {
+        mock_gpioc.IDR |= GPIO_IDR_ID11 | GPIO_IDR_ID12;
+    }
+    else
+    {
+        mock_gpioc.IDR &= ~( GPIO_IDR_ID11 | GPIO_IDR_ID12 );
+    }
+    mock_edges++;
+
+    uint32_t trigger = high ? mock_exti.RTSR : mock_exti.FTSR;
+    if ( trigger & mock_exti.IMR & EXTI_IMR_IM12 )
+    {
+        mock_exti.PR |= EXTI_PR_PR12;
+    }
+}
+
+
+/**
+ * Determines whether a peripheral is requesting an interrupt
+ */
+static bool mock_irq_requested( IRQn_Type irq )
+{
+    switch ( irq )
+    {
+        case TIM3_IRQn:
+            return mock_tim3.SR & mock_tim3.DIER & ( TIM_SR_UIF | TIM_SR_CC1IF );
+        case TIM4_IRQn:
+            return mock_tim4.SR & mock_tim4.DIER & ( TIM_SR_UIF | TIM_SR_CC1IF );
+        case TIM5_IRQn:
+            return mock_tim5.SR & mock_tim5.DIER & ( TIM_SR_UIF | TIM_SR_CC1IF );
+        case EXTI15_10_IRQn:
+            return mock_exti.PR & mock_exti.IMR & EXTI_IMR_IM12;
+        default:
+            return false;
+    }
+}
+
+
+/**
+ * Calls the handler of an interrupt and times it
+ */
+static void mock_irq_call( IRQn_Type irq )
+{
+    uint64_t start = mock_cycles( );
+
+    mock_active++;
+    switch ( irq )
+    {
+        case TIM3_IRQn:
+            TIM3_IRQHandler( );
+            break;
+        case TIM4_IRQn:
+            TIM4_IRQHandler( );
+            break;
+        case TIM5_IRQn:
+            TIM5_IRQHandler( );
+            break;
+        case EXTI15_10_IRQn:
+            EXTI15_10_IRQHandler( );
+            // PR is write one to clear, which RAM can't do, so take the
+            // handler's write of the line as the clear it is on the device
+            mock_exti.PR &= ~EXTI_PR_PR12;
+            break;
+        default:
+            break;
+    }
+    mock_active--;
+
+    mock_irq_calls[irq]++;
+    mock_irq_spent[irq] += mock_cycles( ) - start;
+}
+
+
+/**
+ * Requests an interrupt, which runs now if NVIC enables it and interrupts
+ * aren't masked, or stays pending until they are unmasked
+ */
+void mock_irq( IRQn_Type irq )
+{
+    mock_nvic.ISPR[irq >> 5] |= 1U << ( irq & 0x1F );
+    mock_service( );
+}
+
+
+/**
+ * Runs every pending and requested interrupt, lowest number first as they all
+ * share a priority, until none are left
+ */
+static void mock_service( void )
+{
+    static const IRQn_Type order[] = { TIM3_IRQn, TIM4_IRQn, EXTI15_10_IRQn, TIM5_IRQn };
+
+    // handlers don't nest, and masked interrupts wait for critical_exit()
+    if ( mock_primask || mock_active )
+    {
+        return;
+    }
+
+    for ( int calls = 0; calls < MOCK_IRQ_STORM_LIMIT; calls++ )
+    {
+        mock_line_update( );
+
+        size_t i;
+        for ( i = 0; i < sizeof( order ) / sizeof( order[0] ); i++ )
+        {
+            IRQn_Type irq = order[i];
+            uint32_t bit = 1U << ( irq & 0x1F );
+
+            if ( mock_irq_requested( irq ) )
+            {
+                mock_nvic.ISPR[irq >> 5] |= bit;
+            }
+
+            if ( ( mock_nvic.ISPR[irq >> 5] & bit ) && ( mock_nvic.ISER[irq >> 5] & bit ) )
+            {
+                mock_nvic.ISPR[irq >> 5] &= ~bit;
+                mock_irq_call( irq );
+                break;
+            }
+        }
+
+        if ( i == sizeof( order ) / sizeof( order[0] ) )
+        {
+            return;
+        }
+    }
+
+    fprintf( stderr, "mock: interrupt storm at clock %llu\n", ( unsigned long long ) mock_time );
+}
+
+
+/**
+ * Gets the number of times an interrupt's handler has run
+ */
+uint32_t mock_irq_count( IRQn_Type irq )
+{
+    return mock_irq_calls[irq];
+}
+
+
+/**
+ * Gets the cycles spent in an interrupt's handler, on the host's cycle
+ * counter, or nanoseconds where there isn't one
+ */
+uint64_t mock_irq_cycles( IRQn_Type irq )
+{
+    return mock_irq_spent[irq];
+}
+
+
+/* ------------------------------- Intrinsics ------------------------------- */
+
+
+uint32_t mock_get_primask( void )
+{
+    return mock_primask;
+}
+
+
+void mock_set_primask( uint32_t primask )
+{
+    mock_primask = primask & 1U;
+    mock_service( );
+}
+
+
+/* ----------------------------------- HAL ---------------------------------- */
+
+
+uint32_t HAL_GetTick( void )
+{
+    return ( uint32_t ) ( mock_time / ( MOCK_CLOCK_HZ / 1000UL ) );
+}
+
+
+/* ----------------------------------- UIO ---------------------------------- */
+
+
+/**
+ * Sends what the firmware prints to a stream instead of stdout
+ *
+ * @param   [in]    stream  The stream, or NULL to discard it
+ */
+void mock_console( FILE * stream )
+{
+    mock_console_stream = stream;
+    mock_console_set = true;
+}
+
+
+ERROR_CODE uprintf( const char * fmt, ... )
+{
+    FILE * stream = mock_console_set ? mock_console_stream : stdout;
+    va_list args;
+
+    if ( stream != NULL )
+    {
+        va_start( args, fmt );
+        vfprintf( stream, fmt, args );
+        va_end( args );
+    }
+
+    RETURN_NO_ERROR();
+}
+
+
+ERROR_CODE uwrite( const void * data, uint32_t size )
+{
+    FILE * stream = mock_console_set ? mock_console_stream : stdout;
+
+    if ( stream != NULL )
+    {
+        fwrite( data, 1, size, stream );
+    }
+
+    RETURN_NO_ERROR();
+}
+
+
+ERROR_CODE udump( void * address, uint32_t size )
+{
+    const uint8_t * bytes = address;
+
+    for ( uint32_t i = 0; i < size; i++ )
+    {
+        uprintf( i % 16 == 15 || i + 1 == size ? "%02x\n" : "%02x ", bytes[i] );
+    }
+
+    RETURN_NO_ERROR();
+}
+
+
+/* -------------------------------------------------------------------------- */
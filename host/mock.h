@@ -0,0 +1,82 @@
+/* --------------------------------- Header --------------------------------- */
+
+
+/**
+ * @file    mock.h
+ * @brief   Contains the simulated peripherals of the host build
+ *
+ * The firmware reads and writes the register blocks declared in the host
+ * stm32f446xx.h like it would the real ones. Time only passes in
+ * mock_run_us(), which counts the enabled timers up at the APB1 timer clock,
+ * raises their update and compare flags and calls their IRQ handlers when
+ * NVIC and DIER enable them. The open drain bus on PC11 is bridged to PC12 as
+ * on the board, and its edges raise EXTI line 12.
+ *
+ * Everything runs on the caller's thread, so an interrupt never preempts
+ * firmware code that the caller is running.
+ */
+
+
+/* ------------------------------ Header Guard ------------------------------ */
+
+
+# ifndef HOST_MOCK_H
+# define HOST_MOCK_H
+
+
+/* -------------------------------- Includes -------------------------------- */
+
+
+# include <stdbool.h>
+# include <stdint.h>
+# include <stdio.h>
+# include "stm32f446xx.h"
+
+
+/* --------------------------------- Defines -------------------------------- */
+
+
+/**
+ * The clock the simulated time is kept in, the APB1 timer clock
+ */
+# define MOCK_CLOCK_HZ  ( 84000000UL )
+
+
+/* ------------------------------- Functions -------------------------------- */
+
+
+# ifdef __cplusplus
+extern "C" {
+# endif
+
+void mock_reset( void );
+
+void mock_run_us( uint32_t us );
+bool mock_run_until( bool ( * done )( void ), uint32_t max_us );
+void mock_run_to( uint64_t clock );
+uint64_t mock_next_event( void );
+uint64_t mock_clock( void );
+
+void mock_line_drive( bool high );
+bool mock_line( void );
+bool mock_line_pulled_low( void );
+uint32_t mock_line_edges( void );
+
+void mock_irq( IRQn_Type irq );
+uint32_t mock_irq_count( IRQn_Type irq );
+uint64_t mock_irq_cycles( IRQn_Type irq );
+
+void mock_console( FILE * stream );
+
+# ifdef __cplusplus
+}
+# endif
+
+
+/* --------------------------------- Footer --------------------------------- */
+
+
+# endif // HOST_MOCK_H
+
+
+/* -------------------------------------------------------------------------- */
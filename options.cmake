@@ -0,0 +1,44 @@
+# build options of the firmware and the host build, included by CMakeLists.txt
+# ahead of project() so the host build can keep the native toolchain
+
+# build natively against the simulated peripherals in host/ instead
+option(CE4951_HOST_BUILD "Build the network stack for the host against mock peripherals" OFF)
+
+if (NOT CE4951_HOST_BUILD)
+    set(CMAKE_SYSTEM_NAME Generic)
+    set(CMAKE_SYSTEM_VERSION 1)
+endif ()
+
+# build the channel impairment hooks in for soak tests, see phy_impair.h
+option(CE4951_PHY_IMPAIR "Build the channel impairment hooks into the firmware" OFF)
+
+# build the microbenchmarks and the /bench command in, see network_bench.h
+option(CE4951_BENCH "Build the network microbenchmarks into the firmware" OFF)
+
+# build the bus edge capture and the /capture command in, see capture.h
+option(CE4951_CAPTURE "Build the bus edge capture into the firmware" OFF)
+
+# build the pcap sniffer and the /sniff command in, see sniffer.h
+option(CE4951_SNIFF "Build the pcap sniffer into the firmware" OFF)
+
+# build the bit error rate tester and the /bert command in, see bert.h
+option(CE4951_BERT "Build the bit error rate tester into the firmware" OFF)
+
+# the host build defines every feature itself, see host/CMakeLists.txt
+if (NOT CE4951_HOST_BUILD)
+    if (CE4951_PHY_IMPAIR)
+        add_definitions(-DNETWORK_PHY_IMPAIR)
+    endif ()
+    if (CE4951_BENCH)
+        add_definitions(-DNETWORK_BENCH)
+    endif ()
+    if (CE4951_CAPTURE)
+        add_definitions(-DNETWORK_CAPTURE)
+    endif ()
+    if (CE4951_SNIFF)
+        add_definitions(-DNETWORK_SNIFF)
+    endif ()
+    if (CE4951_BERT)
+        add_definitions(-DNETWORK_BERT)
+    endif ()
+endif ()
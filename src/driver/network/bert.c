@@ -0,0 +1,880 @@
+/* --------------------------------- Header --------------------------------- */
+
+
+/**
+ * @file    bert.c
+ * @brief   Contains a bit error rate tester sending PRBS patterns between two
+ *          boards at a chosen half bit period, and a sweep finding the
+ *          fastest period a segment carries
+ *
+ * The sender and the receiver of a test each step through their part from
+ * bert_service(), since a period can only be switched while the line and
+ * the transmitter are idle. Both switch back to the period they started at
+ * even when frames go missing: the sender once its last frame went out, the
+ * receiver once it counted every frame or its deadline passed. The receiver
+ * then waits for the sender to have switched back too before it reports.
+ * The pattern frames go in the bulk class and the tester's own messages in
+ * the control class, so frames held back by collisions can't keep them out.
+ */
+
+
+/* -------------------------------- Includes -------------------------------- */
+
+
+# ifdef NETWORK_BERT
+
+
+# include <string.h>
+# include "bert.h"
+# include "network.h"
+# include "linecode.h"
+# include "netbuf.h"
+# include "systime.h"
+
+
+/* --------------------------------- Defines -------------------------------- */
+
+
+# define BERT_TYPE_START        ( 0x01 )
+# define BERT_TYPE_RESULT       ( 0x02 )
+
+# define BERT_START_SIZE        ( 12 )
+# define BERT_RESULT_SIZE       ( 18 )
+
+/**
+ * How long a board waits after switching periods before sending to the
+ * other, which may still be noticing the frame that made it switch
+ */
+# define BERT_SETTLE_MS         ( 50U )
+
+/**
+ * Time allowed for every frame of a test beyond twice its time on the bus,
+ * and for the receiver's report once the test should be over
+ */
+# define BERT_FRAME_SLACK_MS    ( 20U )
+# define BERT_RESULT_TIMEOUT_MS ( 2000U )
+
+/**
+ * Bits that must follow the sequence before a lock is taken, and errors in
+ * the last 32 bits locked that drop it
+ */
+# define BERT_VERIFY_BITS       ( 32 )
+# define BERT_LOSS_ERRORS       ( 8 )
+
+/**
+ * The furthest the sequence may move for a new lock to count as a slip
+ */
+# define BERT_SLIP_MAX          ( 8 )
+
+/**
+ * Bits a test of a rate takes by default, enough for no errors in them to
+ * show the threshold was met with 95% confidence, and bounds on its frames
+ */
+# define BERT_CONFIDENCE_BITS_PPM   ( 3000000UL )
+# define BERT_FRAMES_MIN        ( 8 )
+# define BERT_FRAMES_MAX        ( 65535 )
+
+/**
+ * Bytes of a frame around its pattern, the header, port and trailer
+ */
+# define BERT_FRAME_OVERHEAD    ( sizeof( frame_header_t ) + 1 + sizeof( frame_trailer_t ) )
+
+
+/* ---------------------------------- Types --------------------------------- */
+
+
+/**
+ * Steps of a test on the sending board
+ */
+typedef enum
+{
+    BERT_TX_IDLE,
+    BERT_TX_START,          // the test is announced at the starting period
+    BERT_TX_SETTLE,         // switched, waiting for the receiver to switch too
+    BERT_TX_SEND,           // queueing the frames
+    BERT_TX_DRAIN,          // waiting for the last frame to go out
+    BERT_TX_RESTORE,        // switching back to the starting period
+    BERT_TX_RESULT          // waiting for the receiver's report
+} bert_tx_state_t;
+
+
+/**
+ * Counts of the receiving board
+ */
+typedef struct
+{
+    uint32_t frames;
+    uint32_t bits;
+    uint32_t errors;
+    uint16_t slips;
+    uint16_t sync_losses;
+} bert_counts_t;
+
+
+/**
+ * A test on the receiving board
+ */
+typedef struct
+{
+    bool active;
+    bool switched;          // running at the test's period
+    bool restored;          // back at the starting period, about to report
+    bool promiscuous;       // to restore once switched back
+    uint8_t source;
+    uint8_t session;
+    bert_pattern_t pattern;
+    uint8_t size;
+    uint16_t frames;
+    uint16_t half_bit_us;
+    uint16_t restore_half_bit_us;
+    uint32_t deadline_ms;
+    uint32_t last_ms;       // a frame was received
+    uint32_t restored_ms;
+    bert_counts_t counts;
+} bert_rx_t;
+
+
+/* ----------------------------- Static Globals ----------------------------- */
+
+
+static const uint8_t bert_orders[BERT_PATTERN_COUNT] = { 7, 15 };
+
+static bert_config_t bert_config;
+static bert_stats_t bert_run;
+static bert_tx_state_t bert_tx_state = BERT_TX_IDLE;
+static uint16_t bert_base_half_bit_us;
+static uint16_t bert_frames;            // to send at the current rate
+static uint16_t bert_sent;
+static uint16_t bert_prbs;              // the generator, run on across frames
+static uint8_t bert_session;
+static network_tx_handle_t bert_handle;
+static uint32_t bert_state_ms;
+static uint32_t bert_window_end_ms;     // the receiver stops listening about then
+static uint32_t bert_deadline_ms;
+static bool bert_done;
+
+static bert_rx_t bert_rx;
+static uint32_t bert_received;
+
+
+/* ---------------------------- Static Functions ---------------------------- */
+
+
+static uint8_t * bert_put16( uint8_t * out, uint16_t value )
+{
+    out[0] = value;
+    out[1] = value >> 8;
+    return out + 2;
+}
+
+
+static uint8_t * bert_put32( uint8_t * out, uint32_t value )
+{
+    out = bert_put16( out, value );
+    return bert_put16( out, value >> 16 );
+}
+
+
+static uint16_t bert_get16( const uint8_t * in )
+{
+    return in[0] | in[1] << 8;
+}
+
+
+static uint32_t bert_get32( const uint8_t * in )
+{
+    return bert_get16( in ) | ( uint32_t ) bert_get16( in + 2 ) << 16;
+}
+
+
+/**
+ * Gets the bit the sequence continues with after the last bits in state
+ */
+static inline bool bert_prbs_next( bert_pattern_t pattern, uint16_t state )
+{
+    uint8_t order = bert_orders[pattern];
+    return ( ( state >> ( order - 1 ) ) ^ ( state >> ( order - 2 ) ) ) & 1;
+}
+
+
+/**
+ * Adds a bit to the last bits of the sequence in state
+ */
+static inline uint16_t bert_prbs_shift( bert_pattern_t pattern, uint16_t state, bool bit )
+{
+    return ( ( state << 1 ) | bit ) & ( ( 1U << bert_orders[pattern] ) - 1 );
+}
+
+
+/**
+ * Fills a frame's pattern from the generator, most significant bit first
+ */
+static void bert_fill( uint8_t * data, uint8_t size )
+{
+    for ( uint8_t idx = 0; idx < size; idx++ )
+    {
+        uint8_t value = 0;
+
+        for ( int bit_idx = 7; bit_idx >= 0; bit_idx-- )
+        {
+            bool bit = bert_prbs_next( bert_config.pattern, bert_prbs );
+            bert_prbs = bert_prbs_shift( bert_config.pattern, bert_prbs, bit );
+            value |= bit << bit_idx;
+        }
+        data[idx] = value;
+    }
+}
+
+
+/**
+ * Determines whether a sequence reaches a state within BERT_SLIP_MAX bits
+ */
+static bool bert_is_near( bert_pattern_t pattern, uint16_t from, uint16_t to )
+{
+    for ( int idx = 0; idx < BERT_SLIP_MAX; idx++ )
+    {
+        from = bert_prbs_shift( pattern, from, bert_prbs_next( pattern, from ) );
+        if ( from == to )
+        {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+
+/**
+ * Checks the pattern of a received frame against the sequence, locking onto
+ * it from the frame's first bits
+ *
+ * NOTE:
+ * Out of lock the last bits received are taken as the sequence until enough
+ * bits follow it. The bits before those that locked were out of sync and
+ * count as errors, as do those left at the end of a frame never locked.
+ *
+ * @param   [in]    data    The pattern bytes received
+ * @param   [in]    size    The number of bytes of data
+ * @param   [out]   counts  Counts to add the frame's to
+ */
+static void bert_check( const uint8_t * data, size_t size, bert_counts_t * counts )
+{
+    bert_pattern_t pattern = bert_rx.pattern;
+    uint8_t order = bert_orders[pattern];
+    uint16_t expected = 0;      // the sequence locked onto, or being tried
+    uint16_t lost = 0;          // the sequence locked onto before, run on
+    uint32_t history = 0;       // errors in the last bits locked
+    uint32_t pending = 0;       // bits out of lock
+    uint8_t verified = 0;
+    bool locked = false;
+    bool relocking = false;
+
+    for ( size_t idx = 0; idx < size * 8; idx++ )
+    {
+        bool bit = data[idx / 8] >> ( 7 - idx % 8 ) & 1;
+        bool predicted = bert_prbs_next( pattern, expected );
+
+        // the first bits seed the sequence
+        if ( idx < order )
+        {
+            expected = bert_prbs_shift( pattern, expected, bit );
+            continue;
+        }
+
+        if ( locked )
+        {
+            bool error = bit != predicted;
+
+            counts->bits++;
+            counts->errors += error;
+            history = history << 1 | error;
+
+            if ( __builtin_popcount( history ) <= BERT_LOSS_ERRORS )
+            {
+                expected = bert_prbs_shift( pattern, expected, predicted );
+                continue;
+            }
+
+            // too many errors, try the bits as received from here
+            lost = bert_prbs_shift( pattern, expected, predicted );
+            locked = false;
+            relocking = true;
+            verified = 0;
+            pending = 0;
+        }
+        else
+        {
+            pending++;
+            if ( relocking )
+            {
+                lost = bert_prbs_shift( pattern, lost, bert_prbs_next( pattern, lost ) );
+            }
+        }
+
+        verified = bit == predicted ? verified + 1 : 0;
+        expected = bert_prbs_shift( pattern, expected, bit );
+
+        // the sequence never has order zeros in a row
+        if ( expected == 0 )
+        {
+            verified = 0;
+        }
+        if ( verified < BERT_VERIFY_BITS )
+        {
+            continue;
+        }
+
+        locked = true;
+        history = 0;
+        counts->bits += pending;
+        counts->errors += pending - BERT_VERIFY_BITS;
+        pending = 0;
+
+        if ( relocking && expected != lost )
+        {
+            if ( bert_is_near( pattern, lost, expected ) || bert_is_near( pattern, expected, lost ) )
+            {
+                counts->slips++;
+            }
+            else
+            {
+                counts->sync_losses++;
+            }
+        }
+        relocking = false;
+    }
+
+    if ( !locked )
+    {
+        counts->bits += pending;
+        counts->errors += pending;
+        counts->sync_losses++;
+    }
+}
+
+
+/**
+ * Counts a frame received during a test, called from network_service() with
+ * the slots of every frame in place of decoding them
+ */
+static void bert_rx_frame( const uint8_t * slots, size_t size )
+{
+    uint8_t header[sizeof( frame_header_t )];
+    uint8_t data[BERT_SIZE_MAX];
+    linecode_decoder_t decoder;
+    unsigned int violations = 0;
+    size_t decoded = 0;
+
+    bert_rx.counts.frames++;
+    bert_rx.last_ms = systime_ms( );
+
+    // the header and port are skipped rather than checked, so a damaged one
+    // doesn't lose the frame
+    if ( linecode_decoder_init( &decoder, slots, size * 8 ) &&
+         linecode_decode( &decoder, header, sizeof( header ), &violations ) )
+    {
+        while ( decoded < bert_rx.size && linecode_decode( &decoder, data + decoded, 1, &violations ) )
+        {
+            decoded++;
+        }
+    }
+
+    bert_check( data, decoded, &bert_rx.counts );
+
+    // the bits of a frame cut short are errors
+    uint32_t missing = ( bert_rx.size - decoded ) * 8;
+    bert_rx.counts.bits += missing;
+    bert_rx.counts.errors += missing;
+}
+
+
+/**
+ * Takes part in a test another board announced
+ */
+static void bert_rx_start( const network_message_t * message )
+{
+    const uint8_t * data = message->data;
+    uint16_t half_bit_us = bert_get16( data + 6 );
+
+    // a board running a test only receives its own
+    if ( message->length < BERT_START_SIZE || bert_rx.active ||
+         ( bert_tx_state != BERT_TX_IDLE && message->source != get_local_machine_address( ) ) ||
+         data[2] >= BERT_PATTERN_COUNT || data[3] < BERT_SIZE_MIN || data[3] > BERT_SIZE_MAX ||
+         half_bit_us < NETWORK_HALF_BIT_MIN_US || half_bit_us > NETWORK_HALF_BIT_MAX_US )
+    {
+        return;
+    }
+
+    bert_rx = ( bert_rx_t ) {
+        .active = true,
+        .source = message->source,
+        .session = data[1],
+        .pattern = data[2],
+        .size = data[3],
+        .frames = bert_get16( data + 4 ),
+        .half_bit_us = half_bit_us,
+        .restore_half_bit_us = network_get_half_bit_period( ),
+        .deadline_ms = systime_ms( ) + bert_get32( data + 8 )
+    };
+    bert_received++;
+}
+
+
+/**
+ * Reports the counts of a test back to its sender
+ */
+static void bert_rx_report( void )
+{
+    network_tx_params_t params = {
+        .tx_class = NETWORK_TX_CLASS_CONTROL,
+        .ttl_ms = NETWORK_TX_NO_TTL,
+        .port = BERT_PORT
+    };
+
+    netbuf_t * buf = netbuf_alloc( );
+    if ( buf == NULL )
+    {
+        return;
+    }
+
+    uint8_t * out = buf->data;
+    *out++ = BERT_TYPE_RESULT;
+    *out++ = bert_rx.session;
+    out = bert_put32( out, bert_rx.counts.frames );
+    out = bert_put32( out, bert_rx.counts.bits );
+    out = bert_put32( out, bert_rx.counts.errors );
+    out = bert_put16( out, bert_rx.counts.slips );
+    out = bert_put16( out, bert_rx.counts.sync_losses );
+    buf->length = out - buf->data;
+
+    network_tx_buf( bert_rx.source, buf, &params, NULL );
+    netbuf_free( buf );
+}
+
+
+/**
+ * Switches to the period of the test being received and back
+ */
+static void bert_rx_service( uint32_t now_ms )
+{
+    if ( !bert_rx.active )
+    {
+        return;
+    }
+
+    // frames cut in two count twice, so the line must have gone quiet as well
+    bool over = ( bert_rx.counts.frames >= bert_rx.frames && now_ms - bert_rx.last_ms >= BERT_SETTLE_MS ) ||
+                ( int32_t ) ( now_ms - bert_rx.deadline_ms ) >= 0;
+
+    if ( bert_rx.restored )
+    {
+        if ( now_ms - bert_rx.restored_ms >= BERT_SETTLE_MS )
+        {
+            bert_rx_report( );
+            bert_rx.active = false;
+        }
+    }
+    else if ( !bert_rx.switched )
+    {
+        if ( over )
+        {
+            // never got to switch, report at once
+            bert_rx.restored = true;
+            bert_rx.restored_ms = now_ms - BERT_SETTLE_MS;
+        }
+        else if ( network_set_half_bit_period( bert_rx.half_bit_us ) == ERROR_CODE_NO_ERROR )
+        {
+            bert_rx.switched = true;
+            bert_rx.promiscuous = network_rx_is_promiscuous( );
+            network_rx_set_promiscuous( true );
+            network_rx_set_raw( bert_rx_frame );
+        }
+    }
+    else if ( over && network_set_half_bit_period( bert_rx.restore_half_bit_us ) == ERROR_CODE_NO_ERROR )
+    {
+        network_rx_set_raw( NULL );
+        network_rx_set_promiscuous( bert_rx.promiscuous );
+        bert_rx.switched = false;
+        bert_rx.restored = true;
+        bert_rx.restored_ms = now_ms;
+    }
+}
+
+
+/**
+ * Gets the frames a rate is tested with
+ */
+static uint16_t bert_frames_for( void )
+{
+    if ( bert_config.frames > 0 )
+    {
+        return bert_config.frames;
+    }
+
+    uint32_t frame_bits = bert_config.size * 8;
+    uint32_t frames = ( BERT_CONFIDENCE_BITS_PPM / bert_config.threshold_ppm + frame_bits - 1 ) / frame_bits;
+
+    return frames < BERT_FRAMES_MIN ? BERT_FRAMES_MIN : frames > BERT_FRAMES_MAX ? BERT_FRAMES_MAX : frames;
+}
+
+
+/**
+ * Gets how long the receiver of a test waits for its frames
+ */
+static uint32_t bert_window_ms( uint16_t half_bit_us, uint16_t frames )
+{
+    // a Manchester frame takes 16 half bits a byte, the stuffed code fewer
+    uint64_t frame_us = ( uint64_t ) ( bert_config.size + BERT_FRAME_OVERHEAD ) * 16 * half_bit_us;
+    uint64_t window_ms = BERT_SETTLE_MS + frames * ( 2 * frame_us / 1000 + BERT_FRAME_SLACK_MS );
+
+    return window_ms < UINT32_MAX / 2 ? window_ms : UINT32_MAX / 2;
+}
+
+
+static void bert_tx_begin( uint16_t half_bit_us );
+
+
+/**
+ * Judges the rate just tested and moves on to the next one or finishes
+ *
+ * @param   [in]    answered    The receiver reported back
+ */
+static void bert_tx_end( bool answered )
+{
+    bert_result_t * result = &bert_run.results[bert_run.steps++];
+
+    result->answered = answered;
+    result->passed = answered && result->bits > 0 &&
+                     ( uint64_t ) result->errors * 1000000U <= ( uint64_t ) bert_config.threshold_ppm * result->bits;
+    if ( result->passed )
+    {
+        bert_run.safe_half_bit_us = result->half_bit_us;
+    }
+
+    uint16_t next_half_bit_us = result->half_bit_us * 4 / 5;
+    if ( bert_run.sweep && result->passed && bert_run.steps < BERT_SWEEP_STEPS_MAX &&
+         next_half_bit_us >= NETWORK_HALF_BIT_MIN_US )
+    {
+        bert_tx_begin( next_half_bit_us );
+        return;
+    }
+
+    bert_tx_state = BERT_TX_IDLE;
+    bert_run.running = false;
+    bert_done = true;
+}
+
+
+/**
+ * Announces a test of a rate to the receiver
+ */
+static void bert_tx_begin( uint16_t half_bit_us )
+{
+    network_tx_params_t params = {
+        .tx_class = NETWORK_TX_CLASS_CONTROL,
+        .ttl_ms = NETWORK_TX_NO_TTL,
+        .port = BERT_PORT
+    };
+    uint32_t now_ms = systime_ms( );
+
+    bert_frames = bert_frames_for( );
+    bert_sent = 0;
+    bert_session++;
+    bert_run.results[bert_run.steps] = ( bert_result_t ) { .half_bit_us = half_bit_us };
+
+    uint32_t window_ms = bert_window_ms( half_bit_us, bert_frames );
+    bert_window_end_ms = now_ms + window_ms;
+    bert_deadline_ms = bert_window_end_ms + BERT_RESULT_TIMEOUT_MS;
+    bert_tx_state = BERT_TX_START;
+
+    netbuf_t * buf = netbuf_alloc( );
+    if ( buf == NULL )
+    {
+        bert_tx_end( false );
+        return;
+    }
+
+    uint8_t * out = buf->data;
+    *out++ = BERT_TYPE_START;
+    *out++ = bert_session;
+    *out++ = bert_config.pattern;
+    *out++ = bert_config.size;
+    out = bert_put16( out, bert_frames );
+    out = bert_put16( out, half_bit_us );
+    out = bert_put32( out, window_ms );
+    buf->length = out - buf->data;
+
+    ERROR_CODE error = network_tx_buf( bert_config.destination, buf, &params, &bert_handle );
+    netbuf_free( buf );
+    if ( error != ERROR_CODE_NO_ERROR )
+    {
+        bert_tx_end( false );
+    }
+}
+
+
+/**
+ * Takes the receiver's report of the rate being tested
+ */
+static void bert_tx_result( const network_message_t * message )
+{
+    const uint8_t * data = message->data;
+
+    if ( message->length < BERT_RESULT_SIZE || bert_tx_state != BERT_TX_RESULT ||
+         message->source != bert_config.destination || data[1] != bert_session )
+    {
+        return;
+    }
+
+    bert_result_t * result = &bert_run.results[bert_run.steps];
+    result->frames_received = bert_get32( data + 2 );
+    result->bits = bert_get32( data + 6 );
+    result->errors = bert_get32( data + 10 );
+    result->slips = bert_get16( data + 14 );
+    result->sync_losses = bert_get16( data + 16 );
+
+    // every bit of a frame that never arrived is an error
+    if ( result->frames_sent > result->frames_received )
+    {
+        uint32_t lost_bits = ( result->frames_sent - result->frames_received ) * bert_config.size * 8;
+        result->bits += lost_bits;
+        result->errors += lost_bits;
+    }
+
+    bert_tx_end( true );
+}
+
+
+/**
+ * Steps through the test of a rate
+ *
+ * NOTE:
+ * Collisions can hold frames back past the receiver's window, so frames
+ * expire at its end and the sender gives up queueing them, rather than
+ * sending on at a rate the receiver no longer listens at.
+ */
+static void bert_tx_service( uint32_t now_ms )
+{
+    network_tx_params_t params = {
+        .tx_class = NETWORK_TX_CLASS_BULK,
+        .ttl_ms = NETWORK_TX_NO_TTL,
+        .port = BERT_DATA_PORT,
+        .uncoded = true
+    };
+    bert_result_t * result = &bert_run.results[bert_run.steps];
+    network_tx_status_t status;
+
+    switch ( bert_tx_state )
+    {
+        case BERT_TX_START:
+            status = network_tx_status( bert_handle );
+            if ( status == NETWORK_TX_STATUS_PENDING )
+            {
+                break;
+            }
+            if ( status != NETWORK_TX_STATUS_SENT )
+            {
+                bert_tx_end( false );
+                break;
+            }
+            if ( network_set_half_bit_period( result->half_bit_us ) == ERROR_CODE_NO_ERROR )
+            {
+                bert_tx_state = BERT_TX_SETTLE;
+                bert_state_ms = now_ms;
+            }
+            break;
+
+        case BERT_TX_SETTLE:
+            if ( now_ms - bert_state_ms >= BERT_SETTLE_MS )
+            {
+                bert_tx_state = BERT_TX_SEND;
+            }
+            break;
+
+        case BERT_TX_SEND:
+            if ( ( int32_t ) ( now_ms - bert_window_end_ms ) >= 0 )
+            {
+                bert_frames = bert_sent;
+            }
+            else if ( bert_window_end_ms - now_ms < UINT16_MAX )
+            {
+                params.ttl_ms = bert_window_end_ms - now_ms;
+            }
+
+            while ( bert_sent < bert_frames && !network_tx_class_is_full( params.tx_class ) )
+            {
+                netbuf_t * buf = netbuf_alloc( );
+                if ( buf == NULL )
+                {
+                    break;
+                }
+
+                bert_fill( buf->data, bert_config.size );
+                buf->length = bert_config.size;
+                ERROR_CODE error = network_tx_buf( bert_config.destination, buf, &params, &bert_handle );
+                netbuf_free( buf );
+                if ( error != ERROR_CODE_NO_ERROR )
+                {
+                    break;
+                }
+                bert_sent++;
+            }
+            if ( bert_sent == bert_frames )
+            {
+                result->frames_sent = bert_sent;
+                bert_tx_state = BERT_TX_DRAIN;
+            }
+            break;
+
+        case BERT_TX_DRAIN:
+            // frames still held back at the end of the window expire unsent
+            if ( bert_sent > 0 && network_tx_status( bert_handle ) == NETWORK_TX_STATUS_PENDING &&
+                 ( int32_t ) ( now_ms - bert_window_end_ms ) < 0 )
+            {
+                break;
+            }
+            bert_tx_state = BERT_TX_RESTORE;
+            // fall through
+
+        case BERT_TX_RESTORE:
+            if ( network_set_half_bit_period( bert_base_half_bit_us ) == ERROR_CODE_NO_ERROR )
+            {
+                bert_tx_state = BERT_TX_RESULT;
+            }
+            break;
+
+        case BERT_TX_RESULT:
+            if ( ( int32_t ) ( now_ms - bert_deadline_ms ) >= 0 )
+            {
+                bert_tx_end( false );
+            }
+            break;
+
+        default:
+            break;
+    }
+}
+
+
+/**
+ * Handles the messages of tests, announcements from senders and reports
+ * from receivers
+ */
+static void bert_receive( const network_message_t * message )
+{
+    if ( message->length < 2 )
+    {
+        return;
+    }
+
+    if ( message->data[0] == BERT_TYPE_START )
+    {
+        bert_rx_start( message );
+    }
+    else if ( message->data[0] == BERT_TYPE_RESULT )
+    {
+        bert_tx_result( message );
+    }
+}
+
+
+/* ------------------------------- Functions -------------------------------- */
+
+
+/**
+ * Opens the tester's port so this board takes part in tests
+ *
+ * @return  Error code
+ */
+ERROR_CODE bert_init( void )
+{
+    return network_port_open( BERT_PORT, bert_receive );
+}
+
+
+/**
+ * Starts testing a rate, or sweeping up from the current one until a rate
+ * fails the threshold, see bert_service()
+ *
+ * @param   [in]    config  The test to run
+ *
+ * @return  Error code
+ */
+ERROR_CODE bert_start( const bert_config_t * config )
+{
+    if ( bert_run.running )
+    {
+        THROW_ERROR( ERROR_CODE_BERT_ALREADY_RUNNING );
+    }
+    if ( config->pattern >= BERT_PATTERN_COUNT || config->size < BERT_SIZE_MIN || config->size > BERT_SIZE_MAX ||
+         config->destination == 0x00 || config->threshold_ppm == 0 ||
+         ( config->half_bit_us != 0 && ( config->half_bit_us < NETWORK_HALF_BIT_MIN_US ||
+                                         config->half_bit_us > NETWORK_HALF_BIT_MAX_US ) ) )
+    {
+        THROW_ERROR( ERROR_CODE_BERT_INVALID_CONFIG );
+    }
+
+    bert_config = *config;
+    bert_base_half_bit_us = network_get_half_bit_period( );
+    bert_run = ( bert_stats_t ) {
+        .running = true,
+        .sweep = config->half_bit_us == 0,
+        .destination = config->destination,
+        .pattern = config->pattern,
+        .threshold_ppm = config->threshold_ppm
+    };
+
+    // the generator starts from all ones
+    bert_prbs = ( 1U << bert_orders[config->pattern] ) - 1;
+
+    bert_tx_begin( config->half_bit_us != 0 ? config->half_bit_us : bert_base_half_bit_us );
+
+    RETURN_NO_ERROR();
+}
+
+
+/**
+ * Stops after the frames queued so far, the receiver still reports them
+ */
+void bert_stop( void )
+{
+    bert_run.sweep = false;
+    if ( bert_tx_state <= BERT_TX_SEND )
+    {
+        bert_frames = bert_sent;
+    }
+}
+
+
+/**
+ * Runs this board's part of the tests going on, called from the main loop
+ *
+ * @return  bool if the test this board started finished in this call
+ */
+bool bert_service( void )
+{
+    uint32_t now_ms = systime_ms( );
+
+    bert_rx_service( now_ms );
+    bert_tx_service( now_ms );
+
+    bool done = bert_done;
+    bert_done = false;
+    return done;
+}
+
+
+/**
+ * Gets the rates tried by the last test this board started
+ */
+void bert_stats( bert_stats_t * stats )
+{
+    *stats = bert_run;
+    stats->received = bert_received;
+}
+
+
+# endif // NETWORK_BERT
+
+
+/* -------------------------------------------------------------------------- */
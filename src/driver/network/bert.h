@@ -0,0 +1,151 @@
+/* --------------------------------- Header --------------------------------- */
+
+
+/**
+ * @file    bert.h
+ * @brief   Contains a bit error rate tester sending PRBS patterns between two
+ *          boards at a chosen half bit period, and a sweep finding the
+ *          fastest period a segment carries
+ *
+ * Only built with NETWORK_BERT defined, which the host build always does and
+ * the firmware does with the CE4951_BERT option.
+ *
+ * A test is run by the sending board. It tells the receiving board the
+ * period, pattern and frames of the test on BERT_PORT at the current period,
+ * both switch to the test's period with network_set_half_bit_period(), and
+ * the sender queues frames to BERT_DATA_PORT carrying the pattern. They go
+ * through the transmit queue and the hb timer like any other frame, and the
+ * receiver samples them like any other, but hands their slots to the tester
+ * rather than decoding them. Once the frames are done both switch back and
+ * the receiver reports what it counted.
+ *
+ * The pattern is PRBS-7 (x^7 + x^6 + 1) or PRBS-15 (x^15 + x^14 + 1), run on
+ * from frame to frame and sent most significant bit first. The receiver
+ * locks onto every frame from its first bits, then counts the bits that
+ * differ from the sequence. A burst of errors drops the lock, and once it
+ * locks again the new lock is counted as a slip when the sequence moved by
+ * a few bits, bits the receiver sampled twice or missed, and as a lost sync
+ * when it didn't lock again or locked elsewhere. Bits received out of sync
+ * are counted as errors, and so are the bits of frames that never arrived.
+ *
+ * Other boards on the bus can't follow a test, so the segment should be
+ * otherwise quiet while one runs.
+ */
+
+
+/* ------------------------------ Header Guard ------------------------------ */
+
+
+# ifndef DRIVER_BERT_H
+# define DRIVER_BERT_H
+
+
+/* -------------------------------- Includes -------------------------------- */
+
+
+# include <stdint.h>
+# include <stdbool.h>
+# include "error.h"
+
+
+/* --------------------------------- Defines -------------------------------- */
+
+
+# define BERT_PORT                  ( 0xF3 )
+
+/**
+ * The port of the pattern frames, which no board opens so boards that don't
+ * take part drop them
+ */
+# define BERT_DATA_PORT             ( 0xF4 )
+
+/**
+ * Bounds of the pattern carried in a frame, the largest message that fits a
+ * frame along with its port
+ */
+# define BERT_SIZE_MIN              ( 16 )
+# define BERT_SIZE_MAX              ( 254 )
+
+/**
+ * Rates a sweep tries, each 4/5 of the half bit period before
+ */
+# define BERT_SWEEP_STEPS_MAX       ( 16 )
+
+
+/* ---------------------------------- Types --------------------------------- */
+
+
+typedef enum
+{
+    BERT_PRBS7,
+    BERT_PRBS15,
+    BERT_PATTERN_COUNT
+} bert_pattern_t;
+
+
+/**
+ * A test to run
+ */
+typedef struct
+{
+    uint8_t destination;
+    bert_pattern_t pattern;
+    uint8_t size;               // pattern bytes of every frame
+    uint16_t frames;            // for every rate, 0 for enough to resolve the threshold
+    uint16_t half_bit_us;       // the rate to test, 0 to sweep up from the current one
+    uint32_t threshold_ppm;     // the highest bit error rate a rate passes with
+} bert_config_t;
+
+
+/**
+ * The outcome of one rate
+ */
+typedef struct
+{
+    uint16_t half_bit_us;
+    bool answered;              // the receiver reported back
+    bool passed;
+    uint32_t frames_sent;
+    uint32_t frames_received;
+    uint32_t bits;
+    uint32_t errors;
+    uint16_t slips;
+    uint16_t sync_losses;
+} bert_result_t;
+
+
+/**
+ * The rates tried by the last test this board ran
+ */
+typedef struct
+{
+    bool running;
+    bool sweep;
+    uint8_t destination;
+    bert_pattern_t pattern;
+    uint32_t threshold_ppm;
+    uint16_t safe_half_bit_us;  // the fastest rate that passed, 0 if none
+    uint8_t steps;
+    bert_result_t results[BERT_SWEEP_STEPS_MAX];
+    uint32_t received;          // tests received from other boards
+} bert_stats_t;
+
+
+/* ------------------------------- Functions -------------------------------- */
+
+
+ERROR_CODE bert_init( void );
+
+ERROR_CODE bert_start( const bert_config_t * config );
+void bert_stop( void );
+bool bert_service( void );
+void bert_stats( bert_stats_t * stats );
+
+
+/* --------------------------------- Footer --------------------------------- */
+
+
+# endif // DRIVER_BERT_H
+
+
+/* -------------------------------------------------------------------------- */
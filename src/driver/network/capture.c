@@ -0,0 +1,233 @@
+/* --------------------------------- Header --------------------------------- */
+
+
+/**
+ * @file    capture.c
+ * @brief   Contains a recorder of the raw edges on the bus, streamed out over
+ *          the serial port for offline replay
+ *
+ * The channel monitor interrupt is the only producer of the ring and the
+ * main loop the only consumer. An edge that doesn't fit is counted and the
+ * next one that does is preceded by a gap record, so a replay knows the
+ * line levels it missed.
+ */
+
+
+/* -------------------------------- Includes -------------------------------- */
+
+
+# include "stm32f446xx.h"
+# include "capture.h"
+# include "ring.h"
+# include "systime.h"
+# include "uio.h"
+
+
+/* ----------------------------- Static Globals ----------------------------- */
+
+
+static ring_t capture_ring;
+static uint8_t capture_storage[CAPTURE_RING_SIZE];
+
+static volatile bool capture_running;
+static bool capture_streaming;          // until the ring is drained after stopping
+static capture_stats_t capture_counts;
+
+static uint32_t capture_last_us;        // of the last edge recorded
+static uint32_t capture_gap;            // edges dropped since the last recorded
+
+
+static const char capture_base64_digits[] =
+    "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+
+
+/* ---------------------------- Static Functions ---------------------------- */
+
+
+/**
+ * Packs a value as an unsigned LEB128 varint
+ *
+ * @return  The number of bytes written, up to CAPTURE_RECORD_MAX
+ */
+static uint32_t capture_varint( uint8_t * out, uint64_t value )
+{
+    uint32_t size = 0;
+
+    while ( value >= 0x80 )
+    {
+        out[size++] = ( uint8_t ) value | 0x80;
+        value >>= 7;
+    }
+    out[size++] = ( uint8_t ) value;
+
+    return size;
+}
+
+
+/**
+ * Encodes bytes as base64, padded and terminated
+ */
+static void capture_base64( const uint8_t * data, uint32_t size, char * out )
+{
+    for ( uint32_t i = 0; i < size; i += 3 )
+    {
+        uint32_t group = ( uint32_t ) data[i] << 16;
+
+        group |= i + 1 < size ? ( uint32_t ) data[i + 1] << 8 : 0;
+        group |= i + 2 < size ? data[i + 2] : 0;
+
+        *out++ = capture_base64_digits[( group >> 18 ) & 0x3F];
+        *out++ = capture_base64_digits[( group >> 12 ) & 0x3F];
+        *out++ = i + 1 < size ? capture_base64_digits[( group >> 6 ) & 0x3F] : '=';
+        *out++ = i + 2 < size ? capture_base64_digits[group & 0x3F] : '=';
+    }
+    *out = '\0';
+}
+
+
+/* ------------------------------- Functions -------------------------------- */
+
+
+/**
+ * Starts recording the edges on the bus, streamed out by capture_service()
+ *
+ * @return  ERROR_CODE_CAPTURE_ALREADY_RUNNING until the last capture has
+ *          been streamed out
+ */
+ERROR_CODE capture_start( void )
+{
+    if ( capture_streaming )
+    {
+        THROW_ERROR( ERROR_CODE_CAPTURE_ALREADY_RUNNING );
+    }
+
+    uint8_t header[CAPTURE_HEADER_SIZE] = {
+        'C', 'E', 'C', 'P', CAPTURE_VERSION, ( GPIOC->IDR & GPIO_IDR_ID12 ) != 0, 0, 0
+    };
+
+    // the interrupt doesn't produce until capture_running is set
+    ring_init( &capture_ring, capture_storage, sizeof( capture_storage ) );
+    ring_write( &capture_ring, header, sizeof( header ) );
+
+    capture_counts = ( capture_stats_t ) { .running = true };
+    capture_gap = 0;
+    capture_last_us = systime_us( );
+    capture_streaming = true;
+
+    uprintf( "#cap begin\n" );
+    capture_running = true;
+
+    RETURN_NO_ERROR( );
+}
+
+
+/**
+ * Stops recording, leaving what's left in the ring to be streamed out
+ */
+void capture_stop( void )
+{
+    capture_running = false;
+    capture_counts.running = false;
+}
+
+
+/**
+ * Streams a line of the capture out on the console, called from the main loop
+ *
+ * Lines are only sent whole while the capture runs. A line blocks the main
+ * loop for as long as the serial port takes to send it.
+ *
+ * @return  bool if a stopped capture has just been streamed out completely
+ */
+bool capture_service( void )
+{
+    uint8_t data[CAPTURE_LINE_BYTES];
+    char line[CAPTURE_LINE_BYTES / 3 * 4 + 1];
+
+    if ( !capture_streaming )
+    {
+        return false;
+    }
+
+    if ( ring_count( &capture_ring ) >= CAPTURE_LINE_BYTES ||
+         ( !capture_running && !ring_is_empty( &capture_ring ) ) )
+    {
+        capture_base64( data, capture_read( data, sizeof( data ) ), line );
+        uprintf( "#cap %s\n", line );
+        return false;
+    }
+
+    if ( capture_running )
+    {
+        return false;
+    }
+
+    uprintf( "#cap end %lu %lu\n", capture_counts.edges, capture_counts.dropped );
+    capture_streaming = false;
+
+    return true;
+}
+
+
+/**
+ * Takes the capture out of the ring as it is, instead of capture_service()
+ *
+ * @return  The number of bytes taken
+ */
+uint32_t capture_read( uint8_t * data, uint32_t size )
+{
+    size = ring_read( &capture_ring, data, size );
+    capture_counts.bytes += size;
+
+    return size;
+}
+
+
+/**
+ * Gets the counters of the capture running or last run
+ */
+void capture_stats( capture_stats_t * stats )
+{
+    *stats = capture_counts;
+}
+
+
+/**
+ * Records an edge, called from the channel monitor interrupt
+ *
+ * @param   [in]    level   The level of the line after the edge
+ */
+void capture_edge( bool level )
+{
+    uint8_t record[CAPTURE_RECORD_MAX * 2 + 1];
+    uint32_t size = 0;
+
+    if ( !capture_running )
+    {
+        return;
+    }
+
+    uint32_t now = systime_us( );
+
+    if ( capture_gap )
+    {
+        record[size++] = 0;
+        size += capture_varint( record + size, capture_gap );
+    }
+    size += capture_varint( record + size, ( ( uint64_t ) ( now - capture_last_us ) << 1 | level ) + 1 );
+
+    if ( CAPTURE_RING_SIZE - ring_count( &capture_ring ) < size )
+    {
+        capture_gap++;
+        capture_counts.dropped++;
+        return;
+    }
+
+    ring_write( &capture_ring, record, size );
+    capture_counts.edges++;
+    capture_last_us = now;
+    capture_gap = 0;
+}
+
+
+/* -------------------------------------------------------------------------- */
@@ -0,0 +1,110 @@
+/* --------------------------------- Header --------------------------------- */
+
+
+/**
+ * @file    capture.h
+ * @brief   Contains a recorder of the raw edges on the bus, streamed out over
+ *          the serial port for offline replay
+ *
+ * Every edge the channel monitor sees is stamped by the microsecond time
+ * base and packed into a byte ring by the interrupt. The main loop streams
+ * the ring out on the console, so a capture runs for as long as the serial
+ * port keeps up with the bus. tools/replay/edge_replay.c feeds the edges
+ * back through the receive path of the host build.
+ *
+ * The hook into the channel monitor is only built with NETWORK_CAPTURE
+ * defined, which the host build always does and the firmware does with the
+ * CE4951_CAPTURE option.
+ *
+ * A capture is a header followed by records:
+ *
+ *      'C' 'E' 'C' 'P'     magic
+ *      version             CAPTURE_VERSION
+ *      level               of the line when the capture started
+ *      0x00 0x00           reserved
+ *
+ * Every record is an unsigned LEB128 varint v. A v of zero is a gap, which
+ * is followed by a varint of the edges the full ring dropped before the next
+ * record. Otherwise the record is an edge, to the level ( v - 1 ) & 1 after
+ * ( v - 1 ) >> 1 us since the last edge recorded, or the start.
+ *
+ * On the console the capture is sent as lines of base64:
+ *
+ *      #cap begin
+ *      #cap <up to CAPTURE_LINE_BYTES of the capture>
+ *      #cap end <edges> <dropped>
+ */
+
+
+/* ------------------------------ Header Guard ------------------------------ */
+
+
+# ifndef DRIVER_CAPTURE_H
+# define DRIVER_CAPTURE_H
+
+
+/* -------------------------------- Includes -------------------------------- */
+
+
+# include <stdint.h>
+# include <stdbool.h>
+# include "error.h"
+
+
+/* --------------------------------- Defines -------------------------------- */
+
+
+# define CAPTURE_VERSION        ( 1 )
+# define CAPTURE_HEADER_SIZE    ( 8 )
+
+/**
+ * The ring between the interrupt and the main loop, two bytes an edge at
+ * the bit rate
+ */
+# define CAPTURE_RING_SIZE      ( 4096 )
+
+/**
+ * The longest record, a 33 bit varint
+ */
+# define CAPTURE_RECORD_MAX     ( 5 )
+
+/**
+ * Bytes of the capture on one console line
+ */
+# define CAPTURE_LINE_BYTES     ( 48 )
+
+
+/* ---------------------------------- Types --------------------------------- */
+
+
+/**
+ * Counters of the capture running or last run
+ */
+typedef struct
+{
+    bool running;
+    uint32_t edges;         // recorded
+    uint32_t dropped;       // lost to a full ring
+    uint32_t bytes;         // of the capture streamed out
+} capture_stats_t;
+
+
+/* ------------------------------- Functions -------------------------------- */
+
+
+ERROR_CODE capture_start( void );
+void capture_stop( void );
+bool capture_service( void );
+uint32_t capture_read( uint8_t * data, uint32_t size );
+void capture_stats( capture_stats_t * stats );
+
+void capture_edge( bool level );
+
+
+/* --------------------------------- Footer --------------------------------- */
+
+
+# endif // DRIVER_CAPTURE_H
+
+
+/* -------------------------------------------------------------------------- */
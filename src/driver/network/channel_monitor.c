@@ -8,6 +8,9 @@
 #include "timeout.h"
 #include "network.h"
 #include "uio.h"
+#ifdef NETWORK_CAPTURE
+#include "capture.h"
+#endif
 
 #define EXTI_15_10_NVIC 8
 
@@ -41,6 +44,10 @@ void EXTI15_10_IRQHandler()
     {
         bool isHigh = GPIOC->IDR & GPIO_IDR_ID12;
 
+#ifdef NETWORK_CAPTURE
+        capture_edge(isHigh);
+#endif
+
         timeout_reset();
 
         if (!timeout_is_running())
@@ -0,0 +1,450 @@
+/* --------------------------------- Header --------------------------------- */
+
+
+/**
+ * @file    flood.c
+ * @brief   Contains a traffic generator and the receiver that measures it
+ *
+ * Flood messages start with a header of the sender's session, the pattern
+ * and a sequence number, and the rest is filled by the pattern from the
+ * sequence number so the receiver can check it. A new session restarts the
+ * receiver's counters for that sender.
+ *
+ * The receiver remembers which of the FLOOD_WINDOW sequence numbers behind
+ * the latest arrived. A skipped sequence number counts as lost until it
+ * turns up, when it counts as reordered instead, and one that arrives again
+ * counts as a duplicate.
+ *
+ * Floods are sent in the bulk class so messages typed at the console still
+ * get through.
+ */
+
+
+/* -------------------------------- Includes -------------------------------- */
+
+
+# include <string.h>
+# include "flood.h"
+# include "network.h"
+# include "netbuf.h"
+# include "systime.h"
+
+
+/* --------------------------------- Defines -------------------------------- */
+
+
+# define FLOOD_HEADER_SIZE  ( 6 )   // session, pattern, little endian sequence number
+# define FLOOD_WINDOW       ( 32 )
+
+
+/* ---------------------------------- Types --------------------------------- */
+
+
+/**
+ * Receive state of one sender
+ */
+typedef struct
+{
+    flood_rx_stats_t stats;
+    bool active;            // counting a session
+    uint32_t next_seq;      // one past the latest sequence number received
+    uint32_t window;        // bit n is set if next_seq - 1 - n arrived
+} flood_source_t;
+
+
+/* ----------------------------- Static Globals ----------------------------- */
+
+
+static const char * const flood_pattern_names[FLOOD_PATTERN_COUNT] = { "zeros", "ones", "counter", "random" };
+
+static flood_config_t flood_config;
+static flood_tx_stats_t flood_tx;
+static uint32_t flood_start_ms;
+static uint32_t flood_random_state = 1;
+
+static flood_source_t flood_sources[FLOOD_SOURCES_MAX];
+static unsigned int flood_source_count;
+
+static uint8_t flood_expected[FLOOD_SIZE_MAX];
+
+
+/* ---------------------------- Static Functions ---------------------------- */
+
+
+/**
+ * Draws the next number of an xorshift32 generator
+ */
+static uint32_t flood_random( uint32_t * state )
+{
+    *state ^= *state << 13;
+    *state ^= *state >> 17;
+    *state ^= *state << 5;
+    return *state;
+}
+
+
+/**
+ * Fills the bytes after a header with a pattern
+ *
+ * @param   [out]   data    The bytes to fill
+ * @param   [in]    size    The number of bytes
+ * @param   [in]    pattern The pattern
+ * @param   [in]    seq     The sequence number of the message
+ */
+static void flood_fill( uint8_t * data, size_t size, flood_pattern_t pattern, uint32_t seq )
+{
+    uint32_t state = seq * 2654435761UL | 1;
+
+    for ( size_t i = 0; i < size; i++ )
+    {
+        switch ( pattern )
+        {
+            case FLOOD_PATTERN_ZEROS:   data[i] = 0x00; break;
+            case FLOOD_PATTERN_ONES:    data[i] = 0xFF; break;
+            case FLOOD_PATTERN_COUNTER: data[i] = ( uint8_t ) ( seq + i ); break;
+            default:                    data[i] = ( uint8_t ) flood_random( &state ); break;
+        }
+    }
+}
+
+
+/**
+ * Draws the size of the next message
+ */
+static uint8_t flood_draw_size( void )
+{
+    uint8_t min = flood_config.size_min;
+    uint8_t max = flood_config.size_max;
+
+    switch ( flood_config.sizes )
+    {
+        case FLOOD_SIZES_UNIFORM:
+            return min + flood_random( &flood_random_state ) % ( max - min + 1U );
+        case FLOOD_SIZES_IMIX:
+        {
+            uint32_t pick = flood_random( &flood_random_state ) % 12;
+            return pick < 7 ? min : pick < 11 ? ( uint8_t ) ( ( min + max ) / 2 ) : max;
+        }
+        default:
+            return max;
+    }
+}
+
+
+/**
+ * Queues the next message of the flood
+ *
+ * @return  bool if the transmit queue took it
+ */
+static bool flood_send( void )
+{
+    network_tx_params_t params = {
+        .tx_class = NETWORK_TX_CLASS_BULK,
+        .ttl_ms = NETWORK_TX_NO_TTL,
+        .port = FLOOD_PORT
+    };
+    uint32_t seq = flood_tx.sent;
+
+    // a full queue would refuse the message after it has claimed a status handle
+    if ( network_tx_class_is_full( params.tx_class ) )
+    {
+        return false;
+    }
+
+    netbuf_t * buf = netbuf_alloc( );
+    if ( buf == NULL )
+    {
+        return false;
+    }
+
+    buf->length = flood_draw_size( );
+    buf->data[0] = flood_tx.session;
+    buf->data[1] = flood_config.pattern;
+    buf->data[2] = seq;
+    buf->data[3] = seq >> 8;
+    buf->data[4] = seq >> 16;
+    buf->data[5] = seq >> 24;
+    flood_fill( buf->data + FLOOD_HEADER_SIZE, buf->length - FLOOD_HEADER_SIZE, flood_config.pattern, seq );
+
+    bool queued = network_tx_buf( flood_config.destination, buf, &params, NULL ) == ERROR_CODE_NO_ERROR;
+    if ( queued )
+    {
+        flood_tx.sent++;
+        flood_tx.bytes += buf->length;
+    }
+    netbuf_free( buf );
+
+    return queued;
+}
+
+
+/**
+ * Finds the receive state of a sender, taking a free one for a new sender
+ *
+ * @return  The state, or NULL if every one is taken
+ */
+static flood_source_t * flood_source_find( uint8_t source )
+{
+    for ( unsigned int i = 0; i < flood_source_count; i++ )
+    {
+        if ( flood_sources[i].stats.source == source )
+        {
+            return &flood_sources[i];
+        }
+    }
+
+    if ( flood_source_count == FLOOD_SOURCES_MAX )
+    {
+        return NULL;
+    }
+
+    flood_source_t * entry = &flood_sources[flood_source_count++];
+    memset( entry, 0, sizeof( *entry ) );
+    entry->stats.source = source;
+    return entry;
+}
+
+
+/**
+ * Checks a flood message and counts it against its sender
+ */
+static void flood_receive( const network_message_t * message )
+{
+    uint32_t now = systime_ms( );
+    flood_source_t * entry = flood_source_find( message->source );
+    if ( entry == NULL )
+    {
+        return;
+    }
+
+    flood_rx_stats_t * stats = &entry->stats;
+    if ( message->length < FLOOD_HEADER_SIZE )
+    {
+        stats->corrupt++;
+        return;
+    }
+
+    const uint8_t * data = message->data;
+    uint8_t session = data[0];
+    flood_pattern_t pattern = data[1];
+    uint32_t seq = data[2] | ( uint32_t ) data[3] << 8 | ( uint32_t ) data[4] << 16 | ( uint32_t ) data[5] << 24;
+
+    // a new session from the sender starts its counters over
+    if ( !entry->active || session != stats->session )
+    {
+        memset( entry, 0, sizeof( *entry ) );
+        entry->active = true;
+        stats->source = message->source;
+        stats->session = session;
+        stats->first_ms = now;
+    }
+
+    size_t size = message->length - FLOOD_HEADER_SIZE;
+    if ( pattern >= FLOOD_PATTERN_COUNT )
+    {
+        stats->corrupt++;
+        return;
+    }
+    flood_fill( flood_expected, size, pattern, seq );
+    if ( memcmp( data + FLOOD_HEADER_SIZE, flood_expected, size ) != 0 )
+    {
+        stats->corrupt++;
+        return;
+    }
+
+    if ( seq - entry->next_seq < 0x80000000UL )
+    {
+        // the latest yet, anything skipped is lost until it turns up
+        uint32_t gap = seq - entry->next_seq;
+        stats->lost += gap;
+        entry->window = gap + 1 < FLOOD_WINDOW ? entry->window << ( gap + 1 ) : 0;
+        entry->window |= 1;
+        entry->next_seq = seq + 1;
+    }
+    else
+    {
+        uint32_t back = entry->next_seq - 1 - seq;
+        if ( back < FLOOD_WINDOW && entry->window & ( 1UL << back ) )
+        {
+            stats->duplicates++;
+            return;
+        }
+        if ( back < FLOOD_WINDOW )
+        {
+            entry->window |= 1UL << back;
+        }
+        stats->reordered++;
+        if ( stats->lost > 0 )
+        {
+            stats->lost--;
+        }
+    }
+
+    stats->received++;
+    stats->bytes += message->length;
+    stats->last_ms = now;
+}
+
+
+/* ------------------------------- Functions -------------------------------- */
+
+
+/**
+ * Opens the flood port so this board counts floods sent to it
+ *
+ * @return  Error code
+ */
+ERROR_CODE flood_init( void )
+{
+    flood_source_count = 0;
+    return network_port_open( FLOOD_PORT, flood_receive );
+}
+
+
+/**
+ * Starts generating a flood, see flood_service()
+ *
+ * @param   [in]    config  The flood to generate
+ *
+ * @return  Error code
+ */
+ERROR_CODE flood_start( const flood_config_t * config )
+{
+    if ( flood_tx.running )
+    {
+        THROW_ERROR( ERROR_CODE_FLOOD_ALREADY_RUNNING );
+    }
+    if ( config->size_min < FLOOD_SIZE_MIN || config->size_max > FLOOD_SIZE_MAX ||
+         config->size_min > config->size_max || config->sizes > FLOOD_SIZES_IMIX ||
+         config->pattern >= FLOOD_PATTERN_COUNT || config->duration_ms == 0 )
+    {
+        THROW_ERROR( ERROR_CODE_FLOOD_INVALID_CONFIG );
+    }
+
+    flood_start_ms = systime_ms( );
+
+    // receivers tell runs apart by the session, which must change across resets too
+    uint8_t session = ( uint8_t ) flood_start_ms;
+    flood_tx = ( flood_tx_stats_t ) {
+        .running = true,
+        .session = session == flood_tx.session ? session + 1 : session
+    };
+    flood_config = *config;
+    flood_random_state = flood_start_ms | 1;
+
+    RETURN_NO_ERROR();
+}
+
+
+/**
+ * Stops the flood being generated
+ */
+void flood_stop( void )
+{
+    if ( flood_tx.running )
+    {
+        flood_tx.running = false;
+        flood_tx.elapsed_ms = systime_ms( ) - flood_start_ms;
+    }
+}
+
+
+/**
+ * Queues the messages of the flood that are due, called from the main loop.
+ * Without a rate the transmit queue is kept full.
+ *
+ * @return  bool if the flood finished in this call
+ */
+bool flood_service( void )
+{
+    if ( !flood_tx.running )
+    {
+        return false;
+    }
+
+    uint32_t elapsed_ms = systime_ms( ) - flood_start_ms;
+    if ( elapsed_ms >= flood_config.duration_ms )
+    {
+        flood_tx.running = false;
+        flood_tx.elapsed_ms = flood_config.duration_ms;
+        return true;
+    }
+
+    // the first message goes at once, the rest at the rate
+    uint32_t due = UINT32_MAX;
+    if ( flood_config.rate > 0 )
+    {
+        due = ( uint32_t ) ( ( uint64_t ) elapsed_ms * flood_config.rate / 1000 ) + 1;
+    }
+
+    while ( flood_tx.sent < due && flood_send( ) )
+    {
+    }
+
+    flood_tx.behind = flood_config.rate > 0 ? due - flood_tx.sent : 0;
+    flood_tx.elapsed_ms = elapsed_ms;
+
+    return false;
+}
+
+
+/**
+ * Gets the counters of the flood being generated or last generated
+ */
+void flood_tx_stats( flood_tx_stats_t * stats )
+{
+    *stats = flood_tx;
+}
+
+
+/**
+ * Gets the counters of every board that flooded this one
+ *
+ * @param   [out]   stats   Room for max boards' counters
+ * @param   [in]    max     The most boards to get
+ *
+ * @return  The number of boards
+ */
+unsigned int flood_rx_stats( flood_rx_stats_t * stats, unsigned int max )
+{
+    unsigned int count = flood_source_count < max ? flood_source_count : max;
+
+    for ( unsigned int i = 0; i < count; i++ )
+    {
+        stats[i] = flood_sources[i].stats;
+    }
+
+    return count;
+}
+
+
+/**
+ * Forgets every board that flooded this one
+ */
+void flood_rx_reset( void )
+{
+    flood_source_count = 0;
+}
+
+
+/**
+ * Looks a pattern up by its name
+ *
+ * @return  bool if the name is a pattern
+ */
+bool flood_pattern_from_name( const char * name, flood_pattern_t * pattern )
+{
+    for ( int i = 0; i < FLOOD_PATTERN_COUNT; i++ )
+    {
+        if ( strcmp( name, flood_pattern_names[i] ) == 0 )
+        {
+            *pattern = i;
+            return true;
+        }
+    }
+
+    return false;
+}
+
+
+/* -------------------------------------------------------------------------- */
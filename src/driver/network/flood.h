@@ -0,0 +1,143 @@
+/* --------------------------------- Header --------------------------------- */
+
+
+/**
+ * @file    flood.h
+ * @brief   Contains a traffic generator and the receiver that measures it
+ *
+ * Every board listens on FLOOD_PORT and keeps the counters of each board
+ * flooding it, so several boards may flood at once to find what the bus
+ * carries in total.
+ */
+
+
+/* ------------------------------ Header Guard ------------------------------ */
+
+
+# ifndef DRIVER_FLOOD_H
+# define DRIVER_FLOOD_H
+
+
+/* -------------------------------- Includes -------------------------------- */
+
+
+# include <stdint.h>
+# include <stdbool.h>
+# include "error.h"
+
+
+/* --------------------------------- Defines -------------------------------- */
+
+
+# define FLOOD_PORT             ( 0xF1 )
+
+/**
+ * Bounds of a flood message, a header of a session and sequence number and
+ * the largest message that fits a frame along with its port
+ */
+# define FLOOD_SIZE_MIN         ( 6 )
+# define FLOOD_SIZE_MAX         ( 254 )
+
+/**
+ * Boards flooding this one that are counted apart
+ */
+# define FLOOD_SOURCES_MAX      ( 8 )
+
+
+/* ---------------------------------- Types --------------------------------- */
+
+
+/**
+ * How message sizes are drawn
+ */
+typedef enum
+{
+    FLOOD_SIZES_FIXED,      // always the largest size
+    FLOOD_SIZES_UNIFORM,    // evenly between the smallest and largest
+    FLOOD_SIZES_IMIX,       // 7 of the smallest to 4 halfway to 1 of the largest
+} flood_sizes_t;
+
+
+/**
+ * What fills messages after their header
+ */
+typedef enum
+{
+    FLOOD_PATTERN_ZEROS,
+    FLOOD_PATTERN_ONES,
+    FLOOD_PATTERN_COUNTER,
+    FLOOD_PATTERN_RANDOM,
+    FLOOD_PATTERN_COUNT
+} flood_pattern_t;
+
+
+/**
+ * A flood to generate
+ */
+typedef struct
+{
+    uint8_t destination;
+    flood_sizes_t sizes;
+    uint8_t size_min;
+    uint8_t size_max;
+    uint16_t rate;          // messages per second, 0 to keep the transmit queue full
+    uint32_t duration_ms;
+    flood_pattern_t pattern;
+} flood_config_t;
+
+
+/**
+ * Counters of the flood being generated or last generated
+ */
+typedef struct
+{
+    bool running;
+    uint8_t session;
+    uint32_t sent;
+    uint32_t bytes;
+    uint32_t behind;        // messages due that the queue had no room for yet
+    uint32_t elapsed_ms;
+} flood_tx_stats_t;
+
+
+/**
+ * Counters of the latest flood from one board
+ */
+typedef struct
+{
+    uint8_t source;
+    uint8_t session;
+    uint32_t received;
+    uint32_t bytes;
+    uint32_t lost;          // sequence numbers skipped and not received since
+    uint32_t duplicates;
+    uint32_t reordered;     // received after a later sequence number
+    uint32_t corrupt;       // pattern or size didn't match the header
+    uint32_t first_ms;
+    uint32_t last_ms;
+} flood_rx_stats_t;
+
+
+/* ------------------------------- Functions -------------------------------- */
+
+
+ERROR_CODE flood_init( void );
+
+ERROR_CODE flood_start( const flood_config_t * config );
+void flood_stop( void );
+bool flood_service( void );
+void flood_tx_stats( flood_tx_stats_t * stats );
+
+unsigned int flood_rx_stats( flood_rx_stats_t * stats, unsigned int max );
+void flood_rx_reset( void );
+
+bool flood_pattern_from_name( const char * name, flood_pattern_t * pattern );
+
+
+/* --------------------------------- Footer --------------------------------- */
+
+
+# endif // DRIVER_FLOOD_H
+
+
+/* -------------------------------------------------------------------------- */
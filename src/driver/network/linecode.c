@@ -0,0 +1,409 @@
+/* --------------------------------- Header --------------------------------- */
+
+
+/**
+ * @file    linecode.c
+ * @brief   Contains the line codes frames are sent on the bus with
+ *
+ * Frames are sent as a sequence of half bit period slots, each one the level
+ * of the line for that period. The receiver samples a slot at every edge and
+ * repeats the last one when no edge has come 1.5 slots later, so no code may
+ * hold the line for more than two slots, or the receiver would see an idle
+ * line (high) or a collision (low).
+ *
+ * Manchester spends two slots on every bit. The stuffed code sends every bit
+ * as a single slot and inserts an opposite slot after every two equal slots.
+ * That takes 1.5 slots per bit on random data, 33% more payload per second
+ * than Manchester, where no code with the same two slot limit can do better
+ * than about 39%.
+ *
+ * The preamble is always sent in Manchester so any receiver can tell which
+ * code the rest of the frame uses.
+ */
+
+
+/* -------------------------------- Includes -------------------------------- */
+
+
+# include "linecode.h"
+
+
+/* --------------------------------- Defines -------------------------------- */
+
+
+/**
+ * The longest run of equal slots the receiver can sample
+ */
+# define LINECODE_MAX_RUN   ( 2 )
+
+
+/* ----------------------------- Static Globals ----------------------------- */
+
+
+/**
+ * The 16 Manchester slots of every byte, most significant bit first, so
+ * Manchester frames are encoded a byte at a time rather than a slot at a time
+ */
+static const uint16_t linecode_manchester_table[256] = {
+    0xAAAA, 0xAAA9, 0xAAA6, 0xAAA5, 0xAA9A, 0xAA99, 0xAA96, 0xAA95,
+    0xAA6A, 0xAA69, 0xAA66, 0xAA65, 0xAA5A, 0xAA59, 0xAA56, 0xAA55,
+    0xA9AA, 0xA9A9, 0xA9A6, 0xA9A5, 0xA99A, 0xA999, 0xA996, 0xA995,
+    0xA96A, 0xA969, 0xA966, 0xA965, 0xA95A, 0xA959, 0xA956, 0xA955,
+    0xA6AA, 0xA6A9, 0xA6A6, 0xA6A5, 0xA69A, 0xA699, 0xA696, 0xA695,
+    0xA66A, 0xA669, 0xA666, 0xA665, 0xA65A, 0xA659, 0xA656, 0xA655,
+    0xA5AA, 0xA5A9, 0xA5A6, 0xA5A5, 0xA59A, 0xA599, 0xA596, 0xA595,
+    0xA56A, 0xA569, 0xA566, 0xA565, 0xA55A, 0xA559, 0xA556, 0xA555,
+    0x9AAA, 0x9AA9, 0x9AA6, 0x9AA5, 0x9A9A, 0x9A99, 0x9A96, 0x9A95,
+    0x9A6A, 0x9A69, 0x9A66, 0x9A65, 0x9A5A, 0x9A59, 0x9A56, 0x9A55,
+    0x99AA, 0x99A9, 0x99A6, 0x99A5, 0x999A, 0x9999, 0x9996, 0x9995,
+    0x996A, 0x9969, 0x9966, 0x9965, 0x995A, 0x9959, 0x9956, 0x9955,
+    0x96AA, 0x96A9, 0x96A6, 0x96A5, 0x969A, 0x9699, 0x9696, 0x9695,
+    0x966A, 0x9669, 0x9666, 0x9665, 0x965A, 0x9659, 0x9656, 0x9655,
+    0x95AA, 0x95A9, 0x95A6, 0x95A5, 0x959A, 0x9599, 0x9596, 0x9595,
+    0x956A, 0x9569, 0x9566, 0x9565, 0x955A, 0x9559, 0x9556, 0x9555,
+    0x6AAA, 0x6AA9, 0x6AA6, 0x6AA5, 0x6A9A, 0x6A99, 0x6A96, 0x6A95,
+    0x6A6A, 0x6A69, 0x6A66, 0x6A65, 0x6A5A, 0x6A59, 0x6A56, 0x6A55,
+    0x69AA, 0x69A9, 0x69A6, 0x69A5, 0x699A, 0x6999, 0x6996, 0x6995,
+    0x696A, 0x6969, 0x6966, 0x6965, 0x695A, 0x6959, 0x6956, 0x6955,
+    0x66AA, 0x66A9, 0x66A6, 0x66A5, 0x669A, 0x6699, 0x6696, 0x6695,
+    0x666A, 0x6669, 0x6666, 0x6665, 0x665A, 0x6659, 0x6656, 0x6655,
+    0x65AA, 0x65A9, 0x65A6, 0x65A5, 0x659A, 0x6599, 0x6596, 0x6595,
+    0x656A, 0x6569, 0x6566, 0x6565, 0x655A, 0x6559, 0x6556, 0x6555,
+    0x5AAA, 0x5AA9, 0x5AA6, 0x5AA5, 0x5A9A, 0x5A99, 0x5A96, 0x5A95,
+    0x5A6A, 0x5A69, 0x5A66, 0x5A65, 0x5A5A, 0x5A59, 0x5A56, 0x5A55,
+    0x59AA, 0x59A9, 0x59A6, 0x59A5, 0x599A, 0x5999, 0x5996, 0x5995,
+    0x596A, 0x5969, 0x5966, 0x5965, 0x595A, 0x5959, 0x5956, 0x5955,
+    0x56AA, 0x56A9, 0x56A6, 0x56A5, 0x569A, 0x5699, 0x5696, 0x5695,
+    0x566A, 0x5669, 0x5666, 0x5665, 0x565A, 0x5659, 0x5656, 0x5655,
+    0x55AA, 0x55A9, 0x55A6, 0x55A5, 0x559A, 0x5599, 0x5596, 0x5595,
+    0x556A, 0x5569, 0x5566, 0x5565, 0x555A, 0x5559, 0x5556, 0x5555
+};
+
+
+/* ------------------------------- Functions -------------------------------- */
+
+
+/**
+ * Gets the preamble frames in a line code are sent with
+ *
+ * @param   [in]    code    The line code
+ *
+ * @return  The preamble
+ */
+uint8_t linecode_preamble( linecode_t code )
+{
+    return code == LINECODE_STUFFED ? LINECODE_PREAMBLE_STUFFED : LINECODE_PREAMBLE_MANCHESTER;
+}
+
+
+/**
+ * Gets the line code a preamble selects
+ *
+ * @param   [in]    preamble    The received preamble
+ * @param   [out]   code        The line code
+ *
+ * @return  bool if the preamble selects a known code
+ */
+bool linecode_from_preamble( uint8_t preamble, linecode_t * code )
+{
+    switch ( preamble )
+    {
+        case LINECODE_PREAMBLE_MANCHESTER:
+            *code = LINECODE_MANCHESTER;
+            return true;
+
+        case LINECODE_PREAMBLE_STUFFED:
+            *code = LINECODE_STUFFED;
+            return true;
+
+        default:
+            return false;
+    }
+}
+
+
+/**
+ * Writes a slot
+ */
+static void linecode_put_slot( linecode_encoder_t * encoder, bool level )
+{
+    uint8_t * byte = &encoder->slots[encoder->slot_idx / 8];
+    uint8_t bit = 7 - encoder->slot_idx % 8;
+
+    if ( bit == 7 )
+    {
+        *byte = 0;
+    }
+    *byte |= level << bit;
+    encoder->slot_idx++;
+
+    if ( level == encoder->level )
+    {
+        encoder->run++;
+    }
+    else
+    {
+        encoder->level = level;
+        encoder->run = 1;
+    }
+}
+
+
+/**
+ * Writes a bit in Manchester
+ */
+static void linecode_put_manchester( linecode_encoder_t * encoder, bool bit )
+{
+    linecode_put_slot( encoder, !bit );
+    linecode_put_slot( encoder, bit );
+}
+
+
+/**
+ * Starts encoding a frame, writing its preamble
+ *
+ * @param   [out]   encoder     The encoder to start
+ * @param   [in]    code        The line code of the frame
+ * @param   [in]    slots       Buffer for the encoded slots, big enough for
+ *                              the frame in Manchester
+ */
+void linecode_encoder_init( linecode_encoder_t * encoder, linecode_t code, uint8_t * slots )
+{
+    encoder->code = code;
+    encoder->slots = slots;
+    encoder->slot_idx = 0;
+    encoder->level = true;
+    encoder->run = 0;
+
+    uint8_t preamble = linecode_preamble( code );
+    for ( int bit_idx = 7; bit_idx >= 0; bit_idx-- )
+    {
+        linecode_put_manchester( encoder, ( preamble >> bit_idx ) & 0x01 );
+    }
+}
+
+
+/**
+ * Encodes bytes onto the end of a frame
+ *
+ * @param   [in]    encoder     The encoder
+ * @param   [in]    buffer      The bytes to encode
+ * @param   [in]    size        The number of bytes to encode
+ */
+void linecode_encode( linecode_encoder_t * encoder, const uint8_t * buffer, size_t size )
+{
+    // Manchester frames stay byte aligned after the preamble, and every
+    // symbol ends on its bit after a change, a run of one
+    if ( encoder->code == LINECODE_MANCHESTER && encoder->slot_idx % 8 == 0 && size > 0 )
+    {
+        uint8_t * slots = &encoder->slots[encoder->slot_idx / 8];
+
+        for ( size_t byte_idx = 0; byte_idx < size; byte_idx++ )
+        {
+            uint16_t symbols = linecode_manchester_table[buffer[byte_idx]];
+            *slots++ = symbols >> 8;
+            *slots++ = symbols;
+        }
+
+        encoder->slot_idx += size * 16;
+        encoder->level = buffer[size - 1] & 0x01;
+        encoder->run = 1;
+        return;
+    }
+
+    for ( size_t byte_idx = 0; byte_idx < size; byte_idx++ )
+    {
+        for ( int bit_idx = 7; bit_idx >= 0; bit_idx-- )
+        {
+            bool bit = ( buffer[byte_idx] >> bit_idx ) & 0x01;
+
+            if ( encoder->code == LINECODE_MANCHESTER )
+            {
+                linecode_put_manchester( encoder, bit );
+                continue;
+            }
+
+            if ( encoder->run == LINECODE_MAX_RUN )
+            {
+                linecode_put_slot( encoder, !encoder->level );
+            }
+            linecode_put_slot( encoder, bit );
+        }
+    }
+}
+
+
+/**
+ * Finishes encoding a frame, padding it to a whole number of bytes
+ *
+ * @param   [in]    encoder     The encoder
+ *
+ * @return  The number of bytes of slots in the frame
+ */
+size_t linecode_encoder_finish( linecode_encoder_t * encoder )
+{
+    // the receiver ignores slots past the end of the frame
+    while ( encoder->slot_idx % 8 )
+    {
+        linecode_put_slot( encoder, !encoder->level );
+    }
+
+    return encoder->slot_idx / 8;
+}
+
+
+/**
+ * Reads a slot
+ */
+static bool linecode_get_slot( linecode_decoder_t * decoder )
+{
+    bool level = ( decoder->slots[decoder->slot_idx / 8] >> ( 7 - decoder->slot_idx % 8 ) ) & 0x01;
+    decoder->slot_idx++;
+
+    return level;
+}
+
+
+/**
+ * Reads a bit in Manchester
+ *
+ * NOTE:
+ * An invalid symbol has one of its half bits flipped, and which one can't be
+ * told, so the bit is taken from the second half bit
+ */
+static bool linecode_get_manchester( linecode_decoder_t * decoder, unsigned int * violations )
+{
+    bool first = linecode_get_slot( decoder );
+    bool second = linecode_get_slot( decoder );
+
+    if ( first == second )
+    {
+        ( *violations )++;
+    }
+
+    return second;
+}
+
+
+/**
+ * Starts decoding a received frame, reading its preamble
+ *
+ * @param   [out]   decoder     The decoder to start
+ * @param   [in]    slots       The received slots
+ * @param   [in]    slot_count  The number of received slots
+ *
+ * @return  bool if the frame starts with a valid preamble
+ */
+bool linecode_decoder_init( linecode_decoder_t * decoder, const uint8_t * slots, size_t slot_count )
+{
+    decoder->code = LINECODE_MANCHESTER;
+    decoder->slots = slots;
+    decoder->slot_count = slot_count;
+    decoder->slot_idx = 0;
+
+    uint8_t preamble;
+    unsigned int violations = 0;
+    if ( !linecode_decode( decoder, &preamble, 1, &violations ) || violations )
+    {
+        return false;
+    }
+
+    // the stuffed code continues from the level the preamble ends on
+    decoder->level = preamble & 0x01;
+    decoder->run = 1;
+
+    return linecode_from_preamble( preamble, &decoder->code );
+}
+
+
+/**
+ * Decodes bytes from a received frame
+ *
+ * NOTE:
+ * Slots that break the code are counted in violations and decoded as best
+ * they can be, so forward error correction gets a chance to fix them
+ *
+ * @param   [in]    decoder     The decoder
+ * @param   [out]   buffer      Buffer to place the decoded bytes in
+ * @param   [in]    size        The number of bytes to decode
+ * @param   [out]   violations  Incremented by the number of code violations
+ *
+ * @return  bool if enough slots were received to decode every byte
+ */
+bool linecode_decode( linecode_decoder_t * decoder, uint8_t * buffer, size_t size, unsigned int * violations )
+{
+    for ( size_t byte_idx = 0; byte_idx < size; byte_idx++ )
+    {
+        uint8_t value = 0;
+
+        for ( int bit_idx = 7; bit_idx >= 0; bit_idx-- )
+        {
+            bool bit;
+
+            if ( decoder->code == LINECODE_MANCHESTER )
+            {
+                if ( decoder->slot_count - decoder->slot_idx < 2 )
+                {
+                    return false;
+                }
+                bit = linecode_get_manchester( decoder, violations );
+            }
+            else
+            {
+                // skip the opposite slot stuffed after two equal slots
+                if ( decoder->run == LINECODE_MAX_RUN )
+                {
+                    if ( decoder->slot_idx >= decoder->slot_count )
+                    {
+                        return false;
+                    }
+                    bool stuffed = linecode_get_slot( decoder );
+                    if ( stuffed == decoder->level )
+                    {
+                        ( *violations )++;
+                    }
+                    decoder->level = stuffed;
+                    decoder->run = 1;
+                }
+
+                if ( decoder->slot_idx >= decoder->slot_count )
+                {
+                    return false;
+                }
+                bit = linecode_get_slot( decoder );
+
+                if ( bit == decoder->level )
+                {
+                    decoder->run++;
+                }
+                else
+                {
+                    decoder->level = bit;
+                    decoder->run = 1;
+                }
+            }
+
+            value |= bit << bit_idx;
+        }
+
+        buffer[byte_idx] = value;
+    }
+
+    return true;
+}
+
+
+/**
+ * Gets the number of received slots not yet decoded
+ *
+ * @param   [in]    decoder     The decoder
+ *
+ * @return  The number of slots left
+ */
+size_t linecode_decoder_remaining( linecode_decoder_t * decoder )
+{
+    return decoder->slot_count - decoder->slot_idx;
+}
+
+
+/* -------------------------------------------------------------------------- */
@@ -0,0 +1,103 @@
+/* --------------------------------- Header --------------------------------- */
+
+
+/**
+ * @file    linecode.h
+ * @brief   Contains the line codes frames are sent on the bus with
+ */
+
+
+/* ------------------------------ Header Guard ------------------------------ */
+
+
+# ifndef DRIVER_LINECODE_H
+# define DRIVER_LINECODE_H
+
+
+/* -------------------------------- Includes -------------------------------- */
+
+
+# include <stddef.h>
+# include <stdint.h>
+# include <stdbool.h>
+
+
+/* --------------------------------- Defines -------------------------------- */
+
+
+/**
+ * The preamble is always sent in Manchester and selects the code of the rest
+ * of the frame
+ */
+# define LINECODE_PREAMBLE_MANCHESTER   ( 0x55 )
+# define LINECODE_PREAMBLE_STUFFED      ( 0x56 )
+
+/**
+ * The number of half bit slots the preamble takes
+ */
+# define LINECODE_PREAMBLE_SLOTS        ( 16 )
+
+
+/* ---------------------------------- Types --------------------------------- */
+
+
+/**
+ * Line codes
+ */
+typedef enum
+{
+    LINECODE_MANCHESTER,    // two slots per bit
+    LINECODE_STUFFED,       // one slot per bit, opposite slot after every two equal slots
+    LINECODE_COUNT
+} linecode_t;
+
+
+/**
+ * Encoder state, slots are packed most significant bit first
+ */
+typedef struct
+{
+    linecode_t code;
+    uint8_t * slots;
+    size_t slot_idx;
+    bool level;
+    uint8_t run;
+} linecode_encoder_t;
+
+
+/**
+ * Decoder state
+ */
+typedef struct
+{
+    linecode_t code;
+    const uint8_t * slots;
+    size_t slot_count;
+    size_t slot_idx;
+    bool level;
+    uint8_t run;
+} linecode_decoder_t;
+
+
+/* ------------------------------- Functions -------------------------------- */
+
+
+uint8_t linecode_preamble( linecode_t code );
+bool linecode_from_preamble( uint8_t preamble, linecode_t * code );
+
+void linecode_encoder_init( linecode_encoder_t * encoder, linecode_t code, uint8_t * slots );
+void linecode_encode( linecode_encoder_t * encoder, const uint8_t * buffer, size_t size );
+size_t linecode_encoder_finish( linecode_encoder_t * encoder );
+
+bool linecode_decoder_init( linecode_decoder_t * decoder, const uint8_t * slots, size_t slot_count );
+bool linecode_decode( linecode_decoder_t * decoder, uint8_t * buffer, size_t size, unsigned int * violations );
+size_t linecode_decoder_remaining( linecode_decoder_t * decoder );
+
+
+/* --------------------------------- Footer --------------------------------- */
+
+
+# endif // DRIVER_LINECODE_H
+
+
+/* -------------------------------------------------------------------------- */
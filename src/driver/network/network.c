@@ -4,7 +4,17 @@
 #include "stm32f446xx.h"
 
 #include "hb_timer.h"
+#include "timeout.h"
 #include "backoff.h"
+#include "systime.h"
+#include "shaper.h"
+#include "lzss.h"
+#include "hamming.h"
+#include "crc8.h"
+#include "linecode.h"
+#include "phy_impair.h"
+#include "bipbuf.h"
+#include "critical.h"
 #include "network.h"
 #include "state.h"
 
@@ -14,28 +24,100 @@
 
 #define HALF_BIT_PERIOD_US              (500)
 
-#define HEADER_PREAMBLE                 (0x55)
+// the receiver samples the line again when no edge came for one and a half
+// half bits and ends the frame when none came for 2.2, main.c and timeout.c
+// set them up for HALF_BIT_PERIOD_US
+#define RX_REPEAT_PERIOD_US(half_bit)   ((half_bit) * 3 / 2)
+#define RX_IDLE_PERIOD_US(half_bit)     ((half_bit) * 11 / 5)
+
 #define PROTOCOL_VERSION                (0x01)
 
 #define MAX_MESSAGE_SIZE                (255)
 #define MAX_FRAME_SIZE                  (MAX_MESSAGE_SIZE + sizeof(frame_header_t) + sizeof(frame_trailer_t))
 #define MAX_FRAME_SIZE_MANCHESTER       (MAX_FRAME_SIZE * 2)
 
-#define TX_QUEUE_SIZE                   (10)
-#define RX_QUEUE_SIZE                   (10)
+// smallest frame in slot bytes, an empty message in the stuffed code
+#define RX_MIN_FRAME_SLOT_BYTES         ((LINECODE_PREAMBLE_SLOTS / 8) + sizeof(frame_header_t) - 1 + sizeof(frame_trailer_t))
+
+// slots a receiver may sample past the end of a frame, padding and the line idling
+#define RX_TRAILING_SLOTS_MAX           (16)
+
+// queue capacities in bytes, a transmit frame takes a record referencing its
+// message buffer and a received frame its slots plus a small header, the rings
+// index with a mask so every capacity must be a power of two
+#define TX_QUEUE_BYTES                  (1024)
+#define TX_QUEUE_BYTES_CONTROL          (256)
+#define TX_QUEUE_BYTES_BULK             (512)
+#define RX_QUEUE_BYTES                  (4096)
+
+// a received record is the slots of a frame, followed when sniffing by the
+// times and status of the frame
+#ifdef NETWORK_SNIFF
+#define RX_RECORD_INFO_SIZE             (sizeof(rx_record_info_t))
+#else
+#define RX_RECORD_INFO_SIZE             (0)
+#endif
+#define RX_RECORD_MAX_SIZE              (MAX_FRAME_SIZE_MANCHESTER + RX_RECORD_INFO_SIZE)
 
-#define CRC_POLYNOMIAL 0b00000111
 #define CRC_FLAG_ON 0x01
 #define CRC_FLAG_OFF 0x00
 #define CRC_OFF_TRAILER_VALUE 0xAA
 
+// the upper bits of the crc_flag header byte carry extension flags
+#define FRAME_FLAG_CRC_MASK             (0x01)
+#define FRAME_FLAG_FEC                  (0x10)  // the message is hamming (8,4) encoded
+#define FRAME_FLAG_COMPRESSED           (0x20)  // the message data is lzss compressed
+#define FRAME_FLAG_PORT                 (0x40)  // the first message byte is the port
+#define FRAME_FLAG_CONTROL              (0x80)
+#define FRAME_FLAG_KNOWN_MASK           (FRAME_FLAG_CRC_MASK | FRAME_FLAG_FEC | FRAME_FLAG_COMPRESSED | FRAME_FLAG_PORT | FRAME_FLAG_CONTROL)
+
+#define BROADCAST_ADDRESS               (0x00)
+
+#define CONTROL_OPCODE_NONE             (0x00)
+#define CONTROL_OPCODE_PAUSE            (0x01)
+#define CONTROL_OPCODE_RESUME           (0x02)
+
+// receive queue occupancy at which we ask senders to pause/resume
+#define FLOW_RX_HIGH_WATERMARK          (RX_QUEUE_BYTES - 3 * BIPBUF_RECORD_BYTES(RX_RECORD_MAX_SIZE))
+#define FLOW_RX_LOW_WATERMARK           (RX_QUEUE_BYTES / 4)
+// and the occupancy of a port without a callback, leaving a message of room
+// for a frame already on the wire
+#define FLOW_PORT_HIGH_WATERMARK        (NETWORK_PORT_QUEUE_DEPTH - 1)
+#define FLOW_PORT_LOW_WATERMARK         (NETWORK_PORT_QUEUE_DEPTH / 2)
+
+// a pause we received is forgotten after this long in case the resume is lost
+#define FLOW_PAUSE_TIMEOUT_MS           (2000)
+// a pause we sent is repeated after this long if our queue is still full
+#define FLOW_PAUSE_REFRESH_MS           (FLOW_PAUSE_TIMEOUT_MS / 2)
+#define FLOW_PAUSE_TABLE_SIZE           (8)
+
+// number of recent transmit handles whose completion status is remembered
+#define TX_STATUS_TABLE_SIZE            (16)
+
+// number of multicast groups the receive filter accepts besides our address
+#define RX_GROUP_TABLE_SIZE             (4)
+
+// slot bytes holding the preamble, version, source and destination header
+// fields in Manchester, which the other line codes fit in too
+#define RX_FILTER_HEADER_BYTES          (3)
+#define RX_FILTER_SLOT_BYTES            ((1 + RX_FILTER_HEADER_BYTES) * 2)
+
+// number of ports that can be open at once and slots of each one's queue,
+// one of which is always free
+#define PORT_TABLE_SIZE                 (4)
+#define PORT_QUEUE_SIZE                 (NETWORK_PORT_QUEUE_DEPTH + 1)
+
+// smallest message chunk worth trying to compress
+#define COMPRESS_MIN_SIZE               (8)
+
+// longest a shaped queue sleeps before rechecking, this bounds how long a
+// newly queued frame of another class can wait for the backoff timer
+#define SHAPER_MAX_DEFER_MS             (20)
+
 #define RANDOM_BACKOFF_MASK             (0xFF)
 #define RANDOM_BACKOFF_DENOM_MAX        (255)
 #define RANDOM_BACKOFF_MAX_PERIOD_MS    (1000)
 
-// #define NETWORK_TX_DBG
-// #define MANCHESTER_DBG
-
 
 /**
  * Initialization flag
@@ -44,17 +126,62 @@ static bool network_is_init = false;
 
 
 /**
- * Node structure for the network's circular queues
+ * Record of a frame in the transmit queue
+ *
+ * NOTE:
+ * The message is the prefix followed by length bytes of the buffer from
+ * offset, and the record holds a reference to the buffer until the frame is
+ * sent or expires. Frames are encoded in the line code once selected.
  */
 typedef struct
 {
-    char buffer[MAX_FRAME_SIZE_MANCHESTER];
-    size_t size;
+    netbuf_t * buf;
+    uint8_t offset;
+    uint8_t length;
+    uint8_t prefix;
+    uint8_t prefix_size;
+    uint8_t crc_flag;
+    uint8_t crc;
+    uint16_t frame_size;
+    uint8_t destination;
+    uint8_t tx_class;
+    bool sent;
+    bool has_deadline;
+    network_tx_handle_t handle;
+    uint32_t enqueue_ms;
+    uint32_t start_ms;
+    uint32_t deadline_ms;
+    uint32_t enqueue_us;
+    uint32_t first_start_us;
+    uint32_t start_us;
+    uint8_t attempts;
 } queue_node_t;
 
 
 /**
- * Transmit queue variables
+ * Completion status of a message passed to network_tx_ex()
+ */
+typedef struct
+{
+    network_tx_handle_t handle;
+    network_tx_status_t status;
+    unsigned int frames_pending;
+    network_tx_timing_t timing;     // of the last frame sent
+} tx_status_entry_t;
+
+
+/**
+ * A received message in a port's receive queue
+ */
+typedef struct
+{
+    uint8_t payload[MAX_MESSAGE_SIZE + 1];
+    network_message_t message;
+} port_slot_t;
+
+
+/**
+ * An open port and its circular receive queue
  *
  * NOTE:
  * Push index references the index of the location where the next element will be pushed
@@ -63,32 +190,258 @@ typedef struct
  * NOTE:
  * Pop index references the index of the most recently popped element of the queue
  */
-static queue_node_t tx_queue[TX_QUEUE_SIZE];
-static unsigned int tx_queue_push_idx = 1;
-static unsigned int tx_queue_pop_idx = 0;
+typedef struct
+{
+    bool open;
+    uint8_t port;
+    network_port_callback_t callback;
+    port_slot_t slots[PORT_QUEUE_SIZE];
+    unsigned int push_idx;
+    unsigned int pop_idx;
+    uint32_t dropped;
+} port_entry_t;
 
 
 /**
- * Receive queue variables
+ * Entry in the table of destinations that have asked us to pause
+ */
+typedef struct
+{
+    uint8_t address;
+    bool active;
+    uint32_t expires_ms;
+} flow_pause_entry_t;
+
+#ifdef NETWORK_SNIFF
+/**
+ * The end of a received record when sniffing
+ */
+typedef struct
+{
+    uint32_t start_us;
+    uint32_t end_us;
+    uint8_t status;         // NETWORK_SNIFF_COLLISION and _LENGTH_ERROR records aren't decoded
+} rx_record_info_t;
+#endif
+
+
+/**
+ * Transmit queue variables, one record ring per traffic class in priority order
  *
  * NOTE:
- * Push index references the index of the location where the next element will be pushed
- * onto the queue
+ * Frames of a class may be sent out of order when their destination is
+ * paused or shaped, in which case they are marked as sent and popped once
+ * they reach the head of the ring
+ */
+static uint32_t tx_queue_control[TX_QUEUE_BYTES_CONTROL / sizeof(uint32_t)];
+static uint32_t tx_queue_normal[TX_QUEUE_BYTES / sizeof(uint32_t)];
+static uint32_t tx_queue_bulk[TX_QUEUE_BYTES_BULK / sizeof(uint32_t)];
+
+static bipbuf_t tx_queue[NETWORK_TX_CLASS_COUNT];
+
+
+/**
+ * Transmit scheduler variables
  *
  * NOTE:
- * Pop index references the index of the most recently popped element of the queue
+ * With weighted scheduling each class may send up to its weight in frames per
+ * round, visited in priority order. Credits are charged when a frame completes.
+ */
+static network_tx_sched_t tx_sched = NETWORK_TX_SCHED_STRICT;
+static uint8_t tx_class_weight[NETWORK_TX_CLASS_COUNT] = { 4, 2, 1 };
+static uint8_t tx_class_credit[NETWORK_TX_CLASS_COUNT] = { 4, 2, 1 };
+static network_tx_class_stats_t tx_class_stats[NETWORK_TX_CLASS_COUNT];
+
+
+/**
+ * Transmit completion variables
+ *
+ * NOTE:
+ * A handle's status lives at handle % TX_STATUS_TABLE_SIZE until a newer
+ * handle reuses the slot
+ */
+static tx_status_entry_t tx_status_table[TX_STATUS_TABLE_SIZE];
+static uint32_t tx_shaper_wait_ms = 0;
+static network_tx_handle_t tx_next_handle = 1;
+static uint32_t tx_expired_count = 0;
+
+// the message being split into frames, which are not sent until all of them
+// are queued so a message that doesn't fit is dropped whole
+static volatile network_tx_handle_t tx_queuing_handle = NETWORK_TX_INVALID_HANDLE;
+
+
+/**
+ * Receive queue variables
+ *
+ * NOTE:
+ * Every record holds the raw slots of one frame. The "under-construction"
+ * element is space for the largest frame reserved in the ring when its
+ * first edge arrives, and is committed at its actual size once the line
+ * idles.
  */
-static queue_node_t rx_queue[RX_QUEUE_SIZE];
-static unsigned int rx_queue_push_idx = 1;
-static unsigned int rx_queue_pop_idx = 0;
+static uint32_t rx_queue_storage[RX_QUEUE_BYTES / sizeof(uint32_t)];
+static bipbuf_t rx_queue;
+static uint8_t * rx_queue_push_slots = NULL;
 static unsigned int rx_queue_push_bit_idx = 0;
 static unsigned int rx_queue_push_byte_idx = 0;
+static bool rx_queue_last_bit = 1;
+static bool rx_queue_overflow = false;
+#ifdef NETWORK_SNIFF
+static uint32_t rx_queue_push_start_us = 0;
+static network_sniff_callback_t rx_sniffer = NULL;
+#endif
+#ifdef NETWORK_BERT
+static network_raw_callback_t rx_raw = NULL;
+#endif
+
+
+/**
+ * Receive filter variables
+ *
+ * NOTE:
+ * The "under-construction" element is discarded as soon as its destination
+ * byte has been received and matches neither our address, the broadcast
+ * address nor a joined group, so it never takes a receive queue slot.
+ */
+static bool rx_filter_promiscuous = false;
+static bool rx_filter_discard = false;
+static uint8_t rx_filter_groups[RX_GROUP_TABLE_SIZE];
+static uint8_t rx_filter_group_count = 0;
+static uint32_t rx_filtered_count = 0;
+
+
+/**
+ * Port variables
+ *
+ * NOTE:
+ * network_service() decodes every received frame straight into the receive
+ * queue of its port, or into the scratch slot for ports with a callback
+ */
+static port_entry_t port_table[PORT_TABLE_SIZE];
+static port_slot_t port_scratch_slot;
+static uint32_t port_unknown_count = 0;
+
+
+/**
+ * Compression variables
+ *
+ * NOTE:
+ * Compression is off by default since nodes running older firmware drop
+ * frames with the compressed flag
+ */
+static bool compress_enabled = false;
+static uint8_t compress_rx_buffer[MAX_MESSAGE_SIZE];
+static network_compress_stats_t compress_stats;
+
+
+/**
+ * Forward error correction variables
+ *
+ * NOTE:
+ * The fec buffer holds a received message's codewords
+ */
+static bool fec_enabled = false;
+static uint8_t fec_buffer[MAX_MESSAGE_SIZE];
+static network_fec_stats_t fec_stats;
+
+
+/**
+ * Line code frames are transmitted in
+ *
+ * NOTE:
+ * Every node receives both codes, but nodes running older firmware only
+ * receive Manchester
+ */
+static linecode_t tx_linecode = LINECODE_MANCHESTER;
+
+
+/**
+ * Half bit period frames are sent and sampled at
+ *
+ * NOTE:
+ * Every node on the bus must use the same period
+ */
+static uint16_t half_bit_period_us = HALF_BIT_PERIOD_US;
+
+
+/**
+ * Transmit selection variables
+ *
+ * NOTE:
+ * The current node is the frame the hb timer ISR is transmitting. Frames may
+ * be sent out of queue order when their destination is paused, in which case
+ * they are marked as sent and reclaimed once they reach the head of the queue.
+ * A selected frame is claimed and encoded into the staging buffer with
+ * interrupts enabled, then the buffers are swapped as it starts.
+ */
+static queue_node_t * tx_current = NULL;
+static uint8_t tx_slot_buffers[2][MAX_FRAME_SIZE_MANCHESTER];
+static const uint8_t * tx_slots = tx_slot_buffers[0];
+static uint8_t * tx_staging = tx_slot_buffers[1];
+static unsigned int tx_slots_size = 0;
+static volatile bool tx_claimed = false;
+
+
+/**
+ * Control frame variables
+ *
+ * NOTE:
+ * Control frames bypass the transmit queue so they can be raised from an ISR
+ * and never wait behind data frames. Only the most recent opcode is sent.
+ */
+static queue_node_t tx_control_storage;
+static queue_node_t * const tx_control_node = &tx_control_storage;
+static volatile uint8_t tx_control_opcode = CONTROL_OPCODE_NONE;
+static uint8_t tx_control_sending_opcode = CONTROL_OPCODE_NONE;
+
+
+/**
+ * Flow control variables
+ */
+static flow_pause_entry_t flow_pause_table[FLOW_PAUSE_TABLE_SIZE];
+static bool flow_rx_paused = false;
+static uint32_t flow_rx_pause_ms = 0;
 
 /**
  * Local Machine Address
  */
 static uint8_t local_machine_address = 0xFF;
 
+
+static bool network_tx_can_start();
+static uint32_t network_tx_dest_pause_ms(uint8_t dest, uint32_t now);
+static ERROR_CODE network_tx_defer_locked();
+static ERROR_CODE network_tx_begin_locked(queue_node_t * node, uint8_t opcode, unsigned int size);
+static queue_node_t * network_tx_select(uint8_t * opcode);
+static queue_node_t * network_tx_select_class(network_tx_class_t tx_class, uint32_t * wait_ms);
+static ERROR_CODE network_tx_check(const network_tx_params_t * params);
+static unsigned int network_tx_chunk_max(const network_tx_params_t * params);
+static tx_status_entry_t * network_tx_claim(size_t frames, network_tx_handle_t * handle);
+static void network_tx_abort(tx_status_entry_t * status, network_tx_class_t tx_class);
+static ERROR_CODE network_tx_queue_buf(uint8_t dest, netbuf_t * buf, const network_tx_params_t * params,
+                                       network_tx_handle_t handle);
+static bool network_tx_queue_push(const network_tx_params_t * params, network_tx_handle_t handle,
+                                  const queue_node_t * frame);
+static unsigned int network_encode_node(uint8_t * slots, const queue_node_t * node);
+static unsigned int network_encode_control(uint8_t * slots, uint8_t opcode);
+static bool network_tx_queue_release(queue_node_t * node);
+static bool network_tx_queue_expire(queue_node_t * node);
+static void network_tx_queue_retire(queue_node_t * node);
+static bool network_tx_node_is_expired(queue_node_t * node, uint32_t now);
+static void network_tx_status_update(network_tx_handle_t handle, bool expired);
+static bool tx_ring_is_full(bipbuf_t * ring);
+static void network_control_handle(frame_t * frame);
+static void network_flow_update();
+static unsigned int network_port_max_used();
+static void network_rx_filter_check();
+static void network_rx_decode(const uint8_t * slots, size_t size);
+static void network_rx_queue_commit(uint8_t status);
+#ifdef NETWORK_SNIFF
+static void network_rx_sniff(const uint8_t * slots, size_t size, const rx_record_info_t * info);
+#endif
+static void node_crc_apply(queue_node_t * node);
+static port_entry_t * network_port_find(uint8_t port);
+
 /**
  * Initializes the network component
  *
@@ -115,19 +468,22 @@ ERROR_CODE network_init()
     GPIOC->MODER |= 0b01 << GPIO_MODER_MODER11_Pos;
     GPIOC->OTYPER |= GPIO_OTYPER_OT11;
 
-    // zero the receive queue so we don't have to do this in an ISR
-    for (int i = 0; i < RX_QUEUE_SIZE; i++)
+    if (!bipbuf_init(&tx_queue[NETWORK_TX_CLASS_CONTROL], tx_queue_control, sizeof(tx_queue_control)) ||
+            !bipbuf_init(&tx_queue[NETWORK_TX_CLASS_NORMAL], tx_queue_normal, sizeof(tx_queue_normal)) ||
+            !bipbuf_init(&tx_queue[NETWORK_TX_CLASS_BULK], tx_queue_bulk, sizeof(tx_queue_bulk)) ||
+            !bipbuf_init(&rx_queue, rx_queue_storage, sizeof(rx_queue_storage)))
     {
-        memset(rx_queue[i].buffer, 0, MAX_FRAME_SIZE_MANCHESTER);
+        THROW_ERROR(ERROR_CODE_MEMORY_ERROR);
     }
-
-    // push the first bit (preamble bit) onto the rx queue since this is
-    // normally handled by _push() but that neither have been called yet
-    network_rx_queue_push_bit(1);
+    network_rx_queue_reset();
+    netbuf_init();
 
     // initialize random backoff timer
     backoff_init();
 
+    // open the default port read by network_rx()
+    ELEVATE_IF_ERROR(network_port_open(NETWORK_PORT_DEFAULT, NULL));
+
     network_is_init = true;
 
     RETURN_NO_ERROR();
@@ -152,36 +508,191 @@ ERROR_CODE set_local_machine_address(uint8_t newAddress)
     RETURN_NO_ERROR();
 }
 
-//handy function to print bytes for debugging
-static void printBytesHex(char * name, uint8_t * bytes, size_t size)
+/**
+ * Queues a frame in the normal class transmit queue and attempts to begin
+ * transmission.
+ *
+ * @param   [in]    dest    The destination address of the message
+ * @param   [in]    buffer  The buffer to transmit
+ * @param   [in]    size    The size of the buffer in bytes
+ *
+ * @return  Error code
+ */
+ERROR_CODE network_tx(uint8_t dest, uint8_t * buffer, size_t size)
+{
+    return network_tx_class(dest, NETWORK_TX_CLASS_NORMAL, buffer, size);
+}
+
+
+/**
+ * Queues a frame in a traffic class' transmit queue and attempts to begin
+ * transmission.
+ *
+ * @param   [in]    dest        The destination address of the message
+ * @param   [in]    tx_class    The traffic class to queue the message in
+ * @param   [in]    buffer      The buffer to transmit
+ * @param   [in]    size        The size of the buffer in bytes
+ *
+ * @return  Error code
+ */
+ERROR_CODE network_tx_class(uint8_t dest, network_tx_class_t tx_class, uint8_t * buffer, size_t size)
+{
+    network_tx_params_t params = {
+        .tx_class = tx_class,
+        .ttl_ms = NETWORK_TX_NO_TTL
+    };
+
+    return network_tx_ex(dest, buffer, size, &params, NULL);
+}
+
+
+/**
+ * Queues a frame with transmit parameters and attempts to begin transmission.
+ * Frames still queued once their time to live passes are dropped without
+ * being sent.
+ *
+ * @param   [in]    dest    The destination address of the message
+ * @param   [in]    buffer  The buffer to transmit
+ * @param   [in]    size    The size of the buffer in bytes
+ * @param   [in]    params  The traffic class and time to live of the message
+ * @param   [out]   handle  Handle for network_tx_status() (may be NULL)
+ *
+ * @return  Error code
+ */
+ERROR_CODE network_tx_ex(uint8_t dest, uint8_t * buffer, size_t size,
+                         const network_tx_params_t * params, network_tx_handle_t * handle)
+{
+    network_iovec_t iov = {
+        .base = buffer,
+        .length = size
+    };
+
+    return network_txv(dest, &iov, 1, params, handle);
+}
+
+
+/**
+ * Queues a message gathered from several buffers with transmit parameters and
+ * attempts to begin transmission. Frames are filled from the segments in
+ * order and may span segment boundaries.
+ *
+ * @param   [in]    dest        The destination address of the message
+ * @param   [in]    iov         The segments of the message
+ * @param   [in]    iov_count   The number of segments
+ * @param   [in]    params      The traffic class and time to live of the message
+ * @param   [out]   handle      Handle for network_tx_status() (may be NULL)
+ *
+ * @return  Error code
+ */
+ERROR_CODE network_txv(uint8_t dest, const network_iovec_t * iov, unsigned int iov_count,
+                       const network_tx_params_t * params, network_tx_handle_t * handle)
 {
-    uprintf("%s:", name);
-    for (int i = 0; i < size; i++)
+    ELEVATE_IF_ERROR(network_tx_check(params));
+
+    size_t size = 0;
+    for (unsigned int idx = 0; idx < iov_count; idx++)
+    {
+        size += iov[idx].length;
+    }
+
+    unsigned int chunk_max = network_tx_chunk_max(params);
+    tx_status_entry_t * status = network_tx_claim((size + chunk_max - 1) / chunk_max, handle);
+    tx_queuing_handle = status->handle;
+
+    // position in the segments, carried from one frame to the next
+    unsigned int seg = 0;
+    size_t seg_offset = 0;
+
+    // gather the message into pool buffers a frame's worth at a time
+    for (size_t queued_bytes = 0; queued_bytes < size; queued_bytes += chunk_max)
     {
-        if (i % 64 == 0)
+        netbuf_t * buf = netbuf_alloc();
+        if (buf == NULL)
+        {
+            network_tx_abort(status, params->tx_class);
+            THROW_ERROR(ERROR_CODE_NETWORK_BUF_POOL_EMPTY);
+        }
+
+        buf->length = MIN(chunk_max, size - queued_bytes);
+        for (unsigned int filled = 0; filled < buf->length; )
         {
-            uprintf("\n");
+            // skip exhausted and empty segments
+            if (seg_offset == iov[seg].length)
+            {
+                seg++;
+                seg_offset = 0;
+                continue;
+            }
+
+            size_t piece = MIN(buf->length - filled, iov[seg].length - seg_offset);
+            memcpy(buf->data + filled, (const uint8_t *) iov[seg].base + seg_offset, piece);
+            filled += piece;
+            seg_offset += piece;
         }
-        else if (i % 2 == 0)
+
+        // the queue holds its own references
+        ERROR_CODE error = network_tx_queue_buf(dest, buf, params, status->handle);
+        netbuf_free(buf);
+        if (error != ERROR_CODE_NO_ERROR)
         {
-            uprintf(" ");
+            network_tx_abort(status, params->tx_class);
+            return error;
         }
-        uprintf("%02X", bytes[i]);
     }
-    uprintf("\n\n");
+    tx_queuing_handle = NETWORK_TX_INVALID_HANDLE;
+
+    // attempt to start a transmission
+    ELEVATE_IF_ERROR(network_start_tx());
+
+    RETURN_NO_ERROR();
 }
 
 
 /**
- * Queues a frame in the transmit queue and attempts to begin transmission.
+ * Queues a message already in a pool buffer without copying it and attempts
+ * to begin transmission. The queue takes its own references to the buffer,
+ * so the caller may queue it again, to other destinations too, and frees its
+ * reference once it no longer needs it.
  *
  * @param   [in]    dest    The destination address of the message
- * @param   [in]    buffer  The buffer to transmit
- * @param   [in]    size    The size of the buffer in bytes
+ * @param   [in]    buf     The buffer to transmit, unchanged until it's sent
+ * @param   [in]    params  The traffic class and time to live of the message
+ * @param   [out]   handle  Handle for network_tx_status() (may be NULL)
  *
  * @return  Error code
  */
-ERROR_CODE network_tx(uint8_t dest, uint8_t * buffer, size_t size)
+ERROR_CODE network_tx_buf(uint8_t dest, netbuf_t * buf,
+                          const network_tx_params_t * params, network_tx_handle_t * handle)
+{
+    ELEVATE_IF_ERROR(network_tx_check(params));
+
+    unsigned int chunk_max = network_tx_chunk_max(params);
+    tx_status_entry_t * status = network_tx_claim((buf->length + chunk_max - 1) / chunk_max, handle);
+    tx_queuing_handle = status->handle;
+
+    ERROR_CODE error = network_tx_queue_buf(dest, buf, params, status->handle);
+    if (error != ERROR_CODE_NO_ERROR)
+    {
+        network_tx_abort(status, params->tx_class);
+        return error;
+    }
+    tx_queuing_handle = NETWORK_TX_INVALID_HANDLE;
+
+    // attempt to start a transmission
+    ELEVATE_IF_ERROR(network_start_tx());
+
+    RETURN_NO_ERROR();
+}
+
+
+/**
+ * Checks that the network can take a message with the given parameters
+ *
+ * @param   [in]    params  The parameters of the message
+ *
+ * @return  Error code
+ */
+static ERROR_CODE network_tx_check(const network_tx_params_t * params)
 {
     // throw an error if the network is not initialized
     if (!network_is_init)
@@ -189,336 +700,1868 @@ ERROR_CODE network_tx(uint8_t dest, uint8_t * buffer, size_t size)
         THROW_ERROR(ERROR_CODE_NETWORK_NOT_INITIALIZED);
     }
 
-    frame_t frame = {
-        .header = {
-            .preamble = HEADER_PREAMBLE,
-            .version = PROTOCOL_VERSION,
-            .source = local_machine_address,
-            .destination = dest,
-            .length = 0x0,
-            .crc_flag = CRC_FLAG_ON
-        },
-        .message = (char *) buffer,
-        .trailer = {
-            .crc8_fcs = 0x00
-        }
-    };
+    if (params->tx_class >= NETWORK_TX_CLASS_COUNT)
+    {
+        THROW_ERROR(ERROR_CODE_NETWORK_INVALID_TX_CLASS);
+    }
+
+    RETURN_NO_ERROR();
+}
+
+
+/**
+ * Gets the most bytes of message data one frame carries
+ *
+ * @param   [in]    params  The parameters of the message
+ *
+ * @return  The size of the largest chunk a message is split into
+ */
+static unsigned int network_tx_chunk_max(const network_tx_params_t * params)
+{
+    // every byte of an error corrected message takes two on the wire
+    bool use_fec = !params->uncoded && (params->fec || fec_enabled);
+    unsigned int message_max = use_fec ? MAX_MESSAGE_SIZE / 2 : MAX_MESSAGE_SIZE;
+
+    // messages to other ports carry their port ahead of the data
+    return params->port != NETWORK_PORT_DEFAULT ? message_max - 1 : message_max;
+}
+
+
+/**
+ * Claims a handle and its status slot for a new message
+ *
+ * @param   [in]    frames  The number of frames the message is sent in
+ * @param   [out]   handle  The claimed handle (may be NULL)
+ *
+ * @return  The status slot of the handle
+ */
+static tx_status_entry_t * network_tx_claim(size_t frames, network_tx_handle_t * handle)
+{
+    // skip the invalid handle
+    network_tx_handle_t tx_handle = tx_next_handle++;
+    if (tx_next_handle == NETWORK_TX_INVALID_HANDLE)
+    {
+        tx_next_handle++;
+    }
 
-    unsigned int queued_bytes = 0;
-    unsigned char manchester[MAX_FRAME_SIZE_MANCHESTER];
+    tx_status_entry_t * status = &tx_status_table[tx_handle % TX_STATUS_TABLE_SIZE];
+    status->handle = tx_handle;
+    status->status = frames == 0 ? NETWORK_TX_STATUS_SENT : NETWORK_TX_STATUS_PENDING;
+    status->frames_pending = frames;
 
-    // break buffer into chunks and queue
-    while (size - queued_bytes)
+    if (handle != NULL)
     {
-        frame.header.length = MIN(MAX_MESSAGE_SIZE, size - queued_bytes);
-        frame.message = (char *) buffer + queued_bytes;
-        frame_crc_apply(&frame);
+        *handle = tx_handle;
+    }
 
-        // uprintf("[ CRC: 0x%02X ]\n", frame.trailer.crc8_fcs);
+    return status;
+}
 
-        // encode in manchester
-        unsigned int manchester_size = network_encode_frame_manchester(manchester, &frame);
 
-        #ifdef NETWORK_TX_DBG
-            printBytesHex("ORIGINAL HEADER", (uint8_t *) &frame.header, sizeof(msg_header_t));
-            printBytesHex("ORIGINAL MESSAGE", frame.message, frame.header.length);
-            printBytesHex("ORIGINAL TRAILER", (uint8_t *) &frame.trailer, sizeof(msg_trailer_t));
-            printBytesHex("ENTIRE MANCHESTER FRAME ENCODED", manchester, manchesterSize);
-            msg_frame_t retFrame;
-            char buf[256];
-            retFrame.message = buf;
-            network_decode_manchester_frame(&retFrame, manchester);
-            printBytesHex("DECODED HEADER", (uint8_t *) &retFrame.header, sizeof(msg_header_t));
-            printBytesHex("DECODED MESSAGE", frame.message, retFrame.header.length);
-            printBytesHex("DECODED TRAILER", (uint8_t *) &retFrame.trailer, sizeof(msg_trailer_t));
-        #endif
+/**
+ * Drops a message that could not be queued whole. None of its frames have
+ * been sent while it was being queued, so they are removed from the queue
+ * and the receiver never sees part of it.
+ *
+ * @param   [in]    status      The status slot of the message
+ * @param   [in]    tx_class    The traffic class the message was queued in
+ */
+static void network_tx_abort(tx_status_entry_t * status, network_tx_class_t tx_class)
+{
+    bipbuf_t * ring = &tx_queue[tx_class];
+    queue_node_t * node;
 
-        if (!network_tx_queue_push(manchester, manchester_size))
+    // the transmit ISRs pop the ring as their frames finish
+    uint32_t primask = critical_enter();
+    for (node = bipbuf_peek(ring, NULL); node != NULL; node = bipbuf_next(ring, node, NULL))
+    {
+        if (!node->sent && node->handle == status->handle)
         {
-            THROW_ERROR(ERROR_CODE_NETWORK_MSG_QUEUE_FULL);
+            netbuf_free(node->buf);
+            node->buf = NULL;
+            node->sent = true;
         }
-        queued_bytes += frame.header.length;
     }
 
-    // attempt to start a transmission
-    ELEVATE_IF_ERROR(network_start_tx());
+    while ((node = bipbuf_peek(ring, NULL)) != NULL && node->sent)
+    {
+        bipbuf_pop(ring);
+    }
+    critical_exit(primask);
 
-    RETURN_NO_ERROR();
+    status->status = NETWORK_TX_STATUS_DROPPED;
+    tx_queuing_handle = NETWORK_TX_INVALID_HANDLE;
 }
 
 
 /**
- * Receive a single message from the network queue, if there is one available
+ * Splits a buffer into frames and queues them
  *
- * @param   [out]   messageBuf  buffer of size 256 to place the message in (MAX_MESSAGE_SIZE + 1 for null terminator)
- * @param   [out]   sourceAddr    the address of the source machine of the message
+ * NOTE:
+ * Frames reference the buffer itself unless their message has to be
+ * compressed or error corrected, which is done into another pool buffer
  *
- * @return  bool if a valid message was placed in messageBuf
+ * @param   [in]    dest    The destination address of the message
+ * @param   [in]    buf     The buffer to transmit
+ * @param   [in]    params  The traffic class and time to live of the message
+ * @param   [in]    handle  The handle of the message
+ *
+ * @return  Error code
  */
-bool network_rx(uint8_t * messageBuf, uint8_t * sourceAddr, uint8_t * destAddr)
+static ERROR_CODE network_tx_queue_buf(uint8_t dest, netbuf_t * buf, const network_tx_params_t * params,
+                                       network_tx_handle_t handle)
 {
-    while (!network_rx_queue_is_empty())
+    bool use_fec = !params->uncoded && (params->fec || fec_enabled);
+    unsigned int chunk_max = network_tx_chunk_max(params);
+
+    queue_node_t frame = {
+        .destination = dest,
+        .prefix = params->port
+    };
+    uint8_t flags = CRC_FLAG_ON;
+    if (params->port != NETWORK_PORT_DEFAULT)
+    {
+        flags |= FRAME_FLAG_PORT;
+    }
+    if (use_fec)
+    {
+        flags |= FRAME_FLAG_FEC;
+    }
+
+    unsigned int chunk_size;
+    for (unsigned int offset = 0; offset < buf->length; offset += chunk_size)
     {
-        
-        queue_node_t * element = &rx_queue[(rx_queue_pop_idx + 1) % RX_QUEUE_SIZE];
-        frame_t frame = {.message = messageBuf};
+        chunk_size = MIN(chunk_max, buf->length - offset);
+        netbuf_t * coded = NULL;
+
+        frame.buf = buf;
+        frame.offset = offset;
+        frame.length = chunk_size;
+        frame.prefix_size = params->port != NETWORK_PORT_DEFAULT ? 1 : 0;
+        frame.crc_flag = flags;
 
-        ERROR_CODE error = network_decode_manchester_header(&frame.header, element->buffer);
-        ERROR_HANDLE_NON_FATAL(error);
-        if (!error)
+        if (compress_enabled && !params->uncoded && chunk_size >= COMPRESS_MIN_SIZE && (coded = netbuf_alloc()) != NULL)
         {
-            if ((frame.header.preamble != HEADER_PREAMBLE))
+            // only send compressed when it's smaller than the chunk itself
+            coded->length = lzss_compress(buf->data + offset, chunk_size, coded->data, chunk_size);
+            compress_stats.raw_bytes += chunk_size;
+            compress_stats.sent_bytes += coded->length > 0 ? coded->length : chunk_size;
+
+            if (coded->length > 0)
             {
-                ERROR_HANDLE_NON_FATAL(ERROR_CODE_INCORRECT_PREAMBLE_RECEIVED);
+                frame.buf = coded;
+                frame.offset = 0;
+                frame.length = coded->length;
+                frame.crc_flag |= FRAME_FLAG_COMPRESSED;
             }
-            else if ((sizeof(frame_header_t) + (frame.header.length) + sizeof(frame_trailer_t) != element->size / 2))
-            {
-                ERROR_HANDLE_NON_FATAL(ERROR_CODE_INCORRECT_MESSAGE_LENGTH);
-            } 
-            else if (frame.header.version != PROTOCOL_VERSION)
+        }
+
+        // the crc covers the message before it's encoded
+        node_crc_apply(&frame);
+
+        if (use_fec)
+        {
+            netbuf_t * fec = netbuf_alloc();
+            if (fec == NULL)
             {
-                ERROR_HANDLE_NON_FATAL(ERROR_CODE_INVALID_MESSAGE_VERSION_RECEIVED);
+                netbuf_free(coded);
+                THROW_ERROR(ERROR_CODE_NETWORK_BUF_POOL_EMPTY);
             }
-            else //if (frame.header.destination != LOCAL_MACHINE_ADDRESS) <= uncomment to only read messages matching my address
-            { // header appears valid, continue decoding frame
-                error = network_decode_manchester_frame_message_trailer(&frame, element->buffer + sizeof(frame_header_t) * 2);
-                ERROR_HANDLE_NON_FATAL(error);
-                if (!error)
+
+            // the port is error corrected along with the data
+            hamming84_encode(&frame.prefix, frame.prefix_size, fec->data);
+            hamming84_encode(frame.buf->data + frame.offset, frame.length, fec->data + frame.prefix_size * 2);
+            fec->length = (frame.prefix_size + frame.length) * 2;
+
+            netbuf_free(coded);
+            coded = fec;
+            frame.buf = fec;
+            frame.offset = 0;
+            frame.length = fec->length;
+            frame.prefix_size = 0;
+        }
+
+        frame.frame_size = sizeof(frame_header_t) + frame.prefix_size + frame.length + sizeof(frame_trailer_t);
+
+        bool queued = network_tx_queue_push(params, handle, &frame);
+        netbuf_free(coded);
+        if (!queued)
+        {
+            THROW_ERROR(ERROR_CODE_NETWORK_MSG_QUEUE_FULL);
+        }
+    }
+
+    RETURN_NO_ERROR();
+}
+
+
+/**
+ * Receive a single message sent to the default port, if there is one available
+ *
+ * @param   [out]   messageBuf  buffer of size 256 to place the message in (MAX_MESSAGE_SIZE + 1 for null terminator)
+ * @param   [out]   sourceAddr    the address of the source machine of the message
+ * @param   [out]   destAddr      the address the message was sent to
+ *
+ * @return  bool if a valid message was placed in messageBuf
+ */
+bool network_rx(uint8_t * messageBuf, uint8_t * sourceAddr, uint8_t * destAddr)
+{
+    network_service();
+    return network_port_rx(NETWORK_PORT_DEFAULT, messageBuf, NULL, sourceAddr, destAddr);
+}
+
+
+/**
+ * Decodes every frame in the receive queue and hands it to its port, either
+ * by calling the port's callback or by queueing it in the port's receive queue
+ */
+void network_service()
+{
+    uint8_t * slots;
+    uint32_t size;
+
+    while ((slots = bipbuf_peek(&rx_queue, &size)) != NULL)
+    {
+#ifdef NETWORK_SNIFF
+        rx_record_info_t info;
+        size -= sizeof(info);
+        memcpy(&info, slots + size, sizeof(info));
+
+        if (rx_sniffer != NULL)
+        {
+            network_rx_sniff(slots, size, &info);
+        }
+
+        // collided and runt frames are only committed for the sniffer
+        if (info.status == 0)
+        {
+            network_rx_decode(slots, size);
+        }
+#else
+        network_rx_decode(slots, size);
+#endif
+        network_rx_queue_pop();
+    }
+}
+
+
+/**
+ * Decodes a received frame and delivers it to its port
+ *
+ * @param   [in]    slots   The received slots of the frame
+ * @param   [in]    size    The number of bytes of slots
+ */
+static void network_rx_decode(const uint8_t * slots, size_t size)
+{
+    frame_t frame;
+    linecode_decoder_t decoder;
+    unsigned int violations = 0;
+
+#ifdef NETWORK_BERT
+    // a bit error rate test takes the slots as they were sampled
+    if (rx_raw != NULL)
+    {
+        rx_raw(slots, size);
+        return;
+    }
+#endif
+
+    // the preamble selects the line code of the rest of the frame
+    if (!linecode_decoder_init(&decoder, slots, size * 8))
+    {
+        ERROR_HANDLE_NON_FATAL(ERROR_CODE_INCORRECT_PREAMBLE_RECEIVED);
+        return;
+    }
+    frame.header.preamble = linecode_preamble(decoder.code);
+
+    if (!linecode_decode(&decoder, (uint8_t *) &frame.header + 1, sizeof(frame_header_t) - 1, &violations) ||
+        violations)
+    {
+        ERROR_HANDLE_NON_FATAL(ERROR_CODE_INVALID_MANCHESTER_RECEIVED);
+        return;
+    }
+
+    if (frame.header.version != PROTOCOL_VERSION)
+    {
+        ERROR_HANDLE_NON_FATAL(ERROR_CODE_INVALID_MESSAGE_VERSION_RECEIVED);
+        return;
+    }
+    else if (frame.header.crc_flag & ~FRAME_FLAG_KNOWN_MASK)
+    {
+        ERROR_HANDLE_NON_FATAL(ERROR_CODE_INVALID_CRC_FLAG);
+        return;
+    }
+
+    // header appears valid, find where the message goes before decoding it
+    bool is_control = frame.header.crc_flag & FRAME_FLAG_CONTROL;
+    bool is_fec = frame.header.crc_flag & FRAME_FLAG_FEC;
+    uint8_t payload_header_size = 0;
+    uint8_t port = NETWORK_PORT_DEFAULT;
+
+    if (is_fec)
+    {
+        // code violations become bit errors for the fec to correct rather than losing the frame
+        unsigned int corrected_violations = 0;
+        if (frame.header.length % 2 ||
+            !linecode_decode(&decoder, fec_buffer, frame.header.length, &corrected_violations))
+        {
+            ERROR_HANDLE_NON_FATAL(ERROR_CODE_INCORRECT_MESSAGE_LENGTH);
+            return;
+        }
+        frame.header.length /= 2;
+        fec_stats.frames++;
+    }
+
+    if (frame.header.crc_flag & FRAME_FLAG_PORT)
+    {
+        payload_header_size = 1;
+        if (frame.header.length < payload_header_size ||
+            (!is_fec && !linecode_decode(&decoder, &port, 1, &violations)))
+        {
+            ERROR_HANDLE_NON_FATAL(ERROR_CODE_INCORRECT_MESSAGE_LENGTH);
+            return;
+        }
+        if (is_fec && !hamming84_decode(fec_buffer, 1, &port, NULL))
+        {
+            ERROR_HANDLE_NON_FATAL(ERROR_CODE_NETWORK_FEC_UNCORRECTABLE);
+            return;
+        }
+    }
+
+    port_entry_t * entry = NULL;
+    port_slot_t * slot = &port_scratch_slot;
+    if (!is_control)
+    {
+        entry = network_port_find(port);
+        if (entry == NULL)
+        {
+            port_unknown_count++;
+            return;
+        }
+
+        // ports without a callback receive straight into their queue
+        if (entry->callback == NULL)
+        {
+            if (entry->pop_idx == entry->push_idx)
+            {
+                entry->dropped++;
+                return;
+            }
+            slot = &entry->slots[entry->push_idx];
+        }
+    }
+
+    // compressed messages are decoded aside and decompressed into the slot
+    bool is_compressed = frame.header.crc_flag & FRAME_FLAG_COMPRESSED;
+    frame.message = is_compressed ? (char *) compress_rx_buffer : (char *) slot->payload;
+    uint8_t flags = 0;
+    if (is_fec)
+    {
+        // correct the message before the crc check
+        unsigned int corrected_bits = 0;
+        if (!hamming84_decode(fec_buffer, frame.header.length, (uint8_t *) frame.message, &corrected_bits))
+        {
+            fec_stats.uncorrectable++;
+            ERROR_HANDLE_NON_FATAL(ERROR_CODE_NETWORK_FEC_UNCORRECTABLE);
+            return;
+        }
+        fec_stats.corrected_bits += corrected_bits;
+        flags |= NETWORK_MESSAGE_FEC | (corrected_bits > 0 ? NETWORK_MESSAGE_CORRECTED : 0);
+    }
+    else
+    {
+        if (payload_header_size > 0)
+        {
+            frame.message[0] = port;
+        }
+        if (!linecode_decode(&decoder, (uint8_t *) frame.message + payload_header_size,
+                             frame.header.length - payload_header_size, &violations))
+        {
+            ERROR_HANDLE_NON_FATAL(ERROR_CODE_INCORRECT_MESSAGE_LENGTH);
+            return;
+        }
+    }
+
+    // the frame must end with its trailer, give or take the slots sampled while the line idles
+    if (!linecode_decode(&decoder, (uint8_t *) &frame.trailer, sizeof(frame_trailer_t), &violations) ||
+        linecode_decoder_remaining(&decoder) >= RX_TRAILING_SLOTS_MAX)
+    {
+        ERROR_HANDLE_NON_FATAL(ERROR_CODE_INCORRECT_MESSAGE_LENGTH);
+        return;
+    }
+    else if (violations)
+    {
+        ERROR_HANDLE_NON_FATAL(ERROR_CODE_INVALID_MANCHESTER_RECEIVED);
+        return;
+    }
+
+    ERROR_CODE error = ERROR_CODE_NO_ERROR;
+    uint8_t crc_flag = frame.header.crc_flag & FRAME_FLAG_CRC_MASK;
+    if (crc_flag == CRC_FLAG_ON)
+    {
+        if (!frame_crc_isValid(&frame))
+        {
+            error = ERROR_CODE_CRC_ON_CRC_CHECK_FAIL;
+        }
+    }
+    else if (frame.trailer.crc8_fcs != CRC_OFF_TRAILER_VALUE)
+    {
+        error = ERROR_CODE_CRC_ON_CRC_CHECK_FAIL;
+    }
+    ERROR_HANDLE_NON_FATAL(error);
+    if (error)
+    {
+        return;
+    }
+
+    if (is_control)
+    {
+        // control frames are consumed by the driver
+        network_control_handle(&frame);
+        return;
+    }
+
+    size_t length = frame.header.length - payload_header_size;
+    if (is_compressed)
+    {
+        if (!lzss_decompress(compress_rx_buffer + payload_header_size, length,
+                             slot->payload + payload_header_size,
+                             MAX_MESSAGE_SIZE - payload_header_size, &length))
+        {
+            ERROR_HANDLE_NON_FATAL(ERROR_CODE_NETWORK_INVALID_COMPRESSED_MESSAGE);
+            return;
+        }
+    }
+
+    slot->payload[payload_header_size + length] = 0; // end with null termination
+    slot->message.source = frame.header.source;
+    slot->message.destination = frame.header.destination;
+    slot->message.port = port;
+    slot->message.length = length;
+    slot->message.flags = flags | (is_compressed ? NETWORK_MESSAGE_COMPRESSED : 0);
+    slot->message.data = slot->payload + payload_header_size;
+
+    if (entry->callback != NULL)
+    {
+        entry->callback(&slot->message);
+    }
+    else
+    {
+        entry->push_idx = (entry->push_idx + 1) % PORT_QUEUE_SIZE;
+    }
+}
+
+
+/**
+ * Opens a port so messages sent to it are received
+ *
+ * NOTE:
+ * Ports with a callback have it called from network_service() for every
+ * message, ports without one queue messages for network_port_rx()
+ *
+ * @param   [in]    port        The port number
+ * @param   [in]    callback    Function to call with each message (may be NULL)
+ *
+ * @return  Error code
+ */
+ERROR_CODE network_port_open(uint8_t port, network_port_callback_t callback)
+{
+    if (network_port_find(port) != NULL)
+    {
+        THROW_ERROR(ERROR_CODE_NETWORK_PORT_ALREADY_OPEN);
+    }
+
+    for (int i = 0; i < PORT_TABLE_SIZE; i++)
+    {
+        port_entry_t * entry = &port_table[i];
+        if (!entry->open)
+        {
+            entry->port = port;
+            entry->callback = callback;
+            entry->push_idx = 1;
+            entry->pop_idx = 0;
+            entry->dropped = 0;
+            entry->open = true;
+            RETURN_NO_ERROR();
+        }
+    }
+
+    THROW_ERROR(ERROR_CODE_NETWORK_PORT_TABLE_FULL);
+}
+
+
+/**
+ * Closes a port, discarding any messages it has queued
+ *
+ * @param   [in]    port    The port number
+ *
+ * @return  Error code
+ */
+ERROR_CODE network_port_close(uint8_t port)
+{
+    port_entry_t * entry = network_port_find(port);
+    if (entry == NULL)
+    {
+        THROW_ERROR(ERROR_CODE_NETWORK_PORT_NOT_OPEN);
+    }
+
+    entry->open = false;
+
+    // its waiting messages no longer hold senders back
+    network_flow_update();
+
+    RETURN_NO_ERROR();
+}
+
+
+/**
+ * Receive a single message from a port's receive queue, if there is one
+ * available
+ *
+ * @param   [in]    port        The port number
+ * @param   [out]   messageBuf  buffer of size 256 to place the message in (MAX_MESSAGE_SIZE + 1 for null terminator)
+ * @param   [out]   size        the size of the message (may be NULL)
+ * @param   [out]   sourceAddr  the address of the source machine of the message (may be NULL)
+ * @param   [out]   destAddr    the address the message was sent to (may be NULL)
+ *
+ * @return  bool if a valid message was placed in messageBuf
+ */
+bool network_port_rx(uint8_t port, uint8_t * messageBuf, size_t * size, uint8_t * sourceAddr, uint8_t * destAddr)
+{
+    const network_message_t * message;
+
+    // fail if the port is closed or its queue is empty
+    if (!network_port_borrow(port, &message))
+    {
+        return false;
+    }
+
+    memcpy(messageBuf, message->data, message->length + 1);
+    if (size != NULL)
+    {
+        *size = message->length;
+    }
+    if (sourceAddr != NULL)
+    {
+        *sourceAddr = message->source;
+    }
+    if (destAddr != NULL)
+    {
+        *destAddr = message->destination;
+    }
+
+    network_port_release(port, 1);
+
+    return true;
+}
+
+
+/**
+ * Borrows the oldest message of a port's receive queue without copying it
+ *
+ * NOTE:
+ * The message stays in the queue, and its data valid, until it's released
+ * with network_port_release()
+ *
+ * @param   [in]    port        The port number
+ * @param   [out]   message     The oldest message
+ *
+ * @return  bool if there was a message to borrow
+ */
+bool network_port_borrow(uint8_t port, const network_message_t ** message)
+{
+    return network_port_borrow_batch(port, message, 1) == 1;
+}
+
+
+/**
+ * Borrows every message waiting in a port's receive queue, oldest first,
+ * without copying them
+ *
+ * NOTE:
+ * The messages stay in the queue, and their data valid, until they're
+ * released with network_port_release()
+ *
+ * @param   [in]    port        The port number
+ * @param   [out]   messages    The borrowed messages
+ * @param   [in]    max         The most messages to borrow, at most
+ *                              NETWORK_PORT_QUEUE_DEPTH are ever waiting
+ *
+ * @return  The number of messages borrowed
+ */
+unsigned int network_port_borrow_batch(uint8_t port, const network_message_t ** messages, unsigned int max)
+{
+    port_entry_t * entry = network_port_find(port);
+    unsigned int count = 0;
+
+    if (entry == NULL)
+    {
+        return 0;
+    }
+
+    for (unsigned int idx = (entry->pop_idx + 1) % PORT_QUEUE_SIZE;
+         idx != entry->push_idx && count < max;
+         idx = (idx + 1) % PORT_QUEUE_SIZE)
+    {
+        messages[count++] = &entry->slots[idx].message;
+    }
+
+    return count;
+}
+
+
+/**
+ * Releases the oldest borrowed messages of a port, freeing their slots for
+ * new messages
+ *
+ * @param   [in]    port    The port number
+ * @param   [in]    count   The number of messages to release
+ */
+void network_port_release(uint8_t port, unsigned int count)
+{
+    port_entry_t * entry = network_port_find(port);
+
+    if (entry == NULL)
+    {
+        return;
+    }
+
+    while (count-- > 0 && (entry->pop_idx + 1) % PORT_QUEUE_SIZE != entry->push_idx)
+    {
+        entry->pop_idx = (entry->pop_idx + 1) % PORT_QUEUE_SIZE;
+    }
+
+    // resume senders paused by a full port queue
+    network_flow_update();
+}
+
+
+/**
+ * Gets the number of messages dropped because a port's queue was full, or
+ * because they were sent to a port that isn't open
+ *
+ * @param   [in]    port    The port number, or NETWORK_PORT_UNKNOWN
+ *
+ * @return  The number of dropped messages
+ */
+uint32_t network_port_dropped_count(uint16_t port)
+{
+    if (port == NETWORK_PORT_UNKNOWN)
+    {
+        return port_unknown_count;
+    }
+
+    port_entry_t * entry = network_port_find(port);
+    return entry != NULL ? entry->dropped : 0;
+}
+
+
+/**
+ * Finds an open port
+ *
+ * @param   [in]    port    The port number
+ *
+ * @return  The port's entry or NULL if it isn't open
+ */
+static port_entry_t * network_port_find(uint8_t port)
+{
+    for (int i = 0; i < PORT_TABLE_SIZE; i++)
+    {
+        if (port_table[i].open && port_table[i].port == port)
+        {
+            return &port_table[i];
+        }
+    }
+
+    return NULL;
+}
+
+
+/**
+ * Enables or disables compressing transmitted messages
+ *
+ * NOTE:
+ * Only enable compression when every node on the network understands it
+ *
+ * @param   [in]    enabled     Whether to compress messages that get smaller
+ */
+void network_tx_set_compression(bool enabled)
+{
+    compress_enabled = enabled;
+}
+
+
+/**
+ * Gets the number of message bytes compression was tried on and how many
+ * were sent for them
+ *
+ * @param   [out]   stats   The compression statistics
+ */
+void network_tx_compress_stats(network_compress_stats_t * stats)
+{
+    *stats = compress_stats;
+}
+
+
+/**
+ * Enables or disables forward error correction of every transmitted message
+ *
+ * NOTE:
+ * Messages sent with the fec parameter are always error corrected
+ *
+ * @param   [in]    enabled     Whether to error correct every message
+ */
+void network_tx_set_fec(bool enabled)
+{
+    fec_enabled = enabled;
+}
+
+
+/**
+ * Gets the number of error corrected frames received and the errors found
+ * in them
+ *
+ * @param   [out]   stats   The forward error correction statistics
+ */
+void network_rx_fec_stats(network_fec_stats_t * stats)
+{
+    *stats = fec_stats;
+}
+
+
+/**
+ * Selects the line code frames are transmitted in
+ *
+ * @param   [in]    code    The line code
+ *
+ * @return  Error code
+ */
+ERROR_CODE network_tx_set_linecode(linecode_t code)
+{
+    if (code >= LINECODE_COUNT)
+    {
+        THROW_ERROR(ERROR_CODE_NETWORK_INVALID_LINECODE);
+    }
+
+    tx_linecode = code;
+
+    RETURN_NO_ERROR();
+}
+
+
+/**
+ * Sets the half bit period frames are sent and sampled at, scaling the
+ * receiver's timeouts along with it
+ *
+ * NOTE:
+ * A frame must be sent and sampled at one period, so this fails while a
+ * frame is being sent or received. Every node on the bus must be switched.
+ *
+ * @param   [in]    us  The half bit period in microseconds
+ *
+ * @return  Error code
+ */
+ERROR_CODE network_set_half_bit_period(uint16_t us)
+{
+    // throw an error if the network is not initialized
+    if (!network_is_init)
+    {
+        THROW_ERROR(ERROR_CODE_NETWORK_NOT_INITIALIZED);
+    }
+
+    if (us < NETWORK_HALF_BIT_MIN_US || us > NETWORK_HALF_BIT_MAX_US)
+    {
+        THROW_ERROR(ERROR_CODE_NETWORK_INVALID_HALF_BIT_PERIOD);
+    }
+
+    uint32_t primask = critical_enter();
+    if (state_get() != IDLE || hb_timer_is_running() || tx_current != NULL || tx_claimed)
+    {
+        critical_exit(primask);
+        THROW_ERROR(ERROR_CODE_NETWORK_BUSY);
+    }
+
+    ERROR_CODE error = hb_timer_set_timeout(us);
+    if (error == ERROR_CODE_NO_ERROR)
+    {
+        error = timeout_set_timeout(RX_IDLE_PERIOD_US(us));
+    }
+    if (error == ERROR_CODE_NO_ERROR)
+    {
+        error = timeout_set_compare(RX_REPEAT_PERIOD_US(us));
+    }
+    if (error == ERROR_CODE_NO_ERROR)
+    {
+        half_bit_period_us = us;
+    }
+    critical_exit(primask);
+
+    return error;
+}
+
+
+/**
+ * Gets the half bit period frames are sent and sampled at
+ *
+ * @return  The half bit period in microseconds
+ */
+uint16_t network_get_half_bit_period()
+{
+    return half_bit_period_us;
+}
+
+
+/**
+ * Signals the network component to begin transmitting messages from its
+ * internal message queue
+ *
+ * NOTE:
+ * This is called from the main loop and from the timer ISRs, so a frame is
+ * selected and started with interrupts masked. Encoding it takes hundreds of
+ * microseconds for a long frame, so it happens in between with interrupts
+ * enabled while the frame is claimed, and callers meanwhile leave it to the
+ * claiming one. If the line was taken while encoding, the frame stays queued
+ * and is selected again once the line idles.
+ *
+ * @return  Error code
+ */
+ERROR_CODE network_start_tx()
+{
+    // throw an error if the network is not initialized
+    if (!network_is_init)
+    {
+        THROW_ERROR(ERROR_CODE_NETWORK_NOT_INITIALIZED);
+    }
+
+    uint32_t primask = critical_enter();
+    if (tx_claimed || !network_tx_can_start())
+    {
+        critical_exit(primask);
+        RETURN_NO_ERROR();
+    }
+
+    uint8_t opcode = CONTROL_OPCODE_NONE;
+    queue_node_t * node = network_tx_select(&opcode);
+    if (node == NULL)
+    {
+        ERROR_CODE error = network_tx_defer_locked();
+        critical_exit(primask);
+        return error;
+    }
+    tx_claimed = true;
+    critical_exit(primask);
+
+    // nothing else touches the claimed frame or the staging buffer
+    unsigned int size = node == tx_control_node ? network_encode_control(tx_staging, opcode) :
+                                                  network_encode_node(tx_staging, node);
+
+    primask = critical_enter();
+    tx_claimed = false;
+    ERROR_CODE error = ERROR_CODE_NO_ERROR;
+    if (network_tx_can_start())
+    {
+        error = network_tx_begin_locked(node, opcode, size);
+    }
+    critical_exit(primask);
+
+    return error;
+}
+
+
+/**
+ * Arms the backoff timer to retry once the shapers holding back every queued
+ * frame have earned enough tokens or their destinations' pauses expire, must
+ * be called with interrupts masked
+ *
+ * @return  Error code
+ */
+static ERROR_CODE network_tx_defer_locked()
+{
+    if (tx_shaper_wait_ms > 0)
+    {
+        ELEVATE_IF_ERROR(backoff_set_period(MIN(tx_shaper_wait_ms, SHAPER_MAX_DEFER_MS)));
+        ELEVATE_IF_ERROR(backoff_reset());
+        ELEVATE_IF_ERROR(backoff_start());
+    }
+
+    RETURN_NO_ERROR();
+}
+
+
+/**
+ * Starts transmitting an encoded frame from the staging buffer, must be
+ * called with interrupts masked
+ *
+ * @param   [in]    node    The frame to transmit
+ * @param   [in]    opcode  The control opcode if the node is the control node
+ * @param   [in]    size    The number of encoded bytes in the staging buffer
+ *
+ * @return  Error code
+ */
+static ERROR_CODE network_tx_begin_locked(queue_node_t * node, uint8_t opcode, unsigned int size)
+{
+    if (node == tx_control_node)
+    {
+        tx_control_sending_opcode = opcode;
+    }
+    else
+    {
+        node->start_ms = systime_ms();
+        node->start_us = systime_us();
+        if (node->attempts++ == 0)
+        {
+            node->first_start_us = node->start_us;
+        }
+    }
+
+    // swap the staging buffer in, the one sent last becomes the next staging
+    uint8_t * slots = tx_staging;
+    tx_staging = (uint8_t *) tx_slots;
+    tx_slots = slots;
+    tx_slots_size = size;
+    tx_current = node;
+
+    ELEVATE_IF_ERROR(hb_timer_reset());
+    ELEVATE_IF_ERROR(hb_timer_start());
+
+    RETURN_NO_ERROR();
+}
+
+
+/**
+ * Determines whether the line and the transmitter are free to start a frame,
+ * must be called with interrupts masked
+ *
+ * @return  True if a frame may be started
+ */
+static bool network_tx_can_start()
+{
+    return state_get() == IDLE && !backoff_is_running() && !hb_timer_is_running() && tx_current == NULL;
+}
+
+
+/**
+ * Selects the next frame to transmit. Pending control frames are sent first,
+ * followed by the oldest queued frame whose destination has not paused us and
+ * whose shapers have enough tokens.
+ *
+ * @param   [out]   opcode  The control opcode to send if the control node is
+ *                          selected
+ *
+ * @return  The node to transmit, or NULL if nothing can be sent
+ */
+static queue_node_t * network_tx_select(uint8_t * opcode)
+{
+    // the latest control opcode goes first
+    *opcode = tx_control_opcode;
+    if (*opcode != CONTROL_OPCODE_NONE)
+    {
+        tx_control_node->destination = BROADCAST_ADDRESS;
+        return tx_control_node;
+    }
+
+    queue_node_t * node = NULL;
+    uint32_t wait_ms = 0;
+
+    if (tx_sched == NETWORK_TX_SCHED_STRICT)
+    {
+        // the highest priority class with a sendable frame wins
+        for (int cls = 0; cls < NETWORK_TX_CLASS_COUNT && node == NULL; cls++)
+        {
+            node = network_tx_select_class(cls, &wait_ms);
+        }
+    }
+    else
+    {
+        // visit classes with credit left in priority order, refilling
+        // every class' credit once none of them can send
+        for (int pass = 0; pass < 2 && node == NULL; pass++)
+        {
+            for (int cls = 0; cls < NETWORK_TX_CLASS_COUNT && node == NULL; cls++)
+            {
+                if (tx_class_credit[cls] > 0)
                 {
-                    if (frame.header.crc_flag == CRC_FLAG_ON)
-                    {
-                        if (!frame_crc_isValid(&frame))
-                        {
-                            error = ERROR_CODE_CRC_ON_CRC_CHECK_FAIL;
-                        }
-                    }
-                    else if (frame.header.crc_flag == CRC_FLAG_OFF)
-                    {
-                        if (frame.trailer.crc8_fcs != CRC_OFF_TRAILER_VALUE)
-                        {
-                            error = ERROR_CODE_CRC_ON_CRC_CHECK_FAIL;
-                        }
-                    } else
-                    {
-                        error = ERROR_CODE_INVALID_CRC_FLAG;
-                    }
-                    ERROR_HANDLE_NON_FATAL(error);
-                    if (!error)
-                    {
-                        network_rx_queue_pop();
-                        frame.message[frame.header.length] = 0; // end with null termination
-                        if (sourceAddr != NULL)
-                        {
-                            *sourceAddr = frame.header.source;
-                        }
-                        if (destAddr != NULL)
-                        {
-                            *destAddr = frame.header.destination;
-                        }
-                        return true;
-                    }
+                    node = network_tx_select_class(cls, &wait_ms);
+                }
+            }
+
+            if (node == NULL)
+            {
+                memcpy(tx_class_credit, tx_class_weight, sizeof(tx_class_credit));
+            }
+        }
+    }
+
+    tx_shaper_wait_ms = node == NULL ? wait_ms : 0;
+
+    return node;
+}
+
+
+/**
+ * Finds the oldest unsent frame of a traffic class that is not held by flow
+ * control or its shapers
+ *
+ * @param   [in]    tx_class    The traffic class to search
+ * @param   [out]   wait_ms     Raised to the time until a shaped frame conforms
+ *                              or a paused destination's pause expires
+ *
+ * @return  The node to transmit, or NULL if the class cannot send
+ */
+static queue_node_t * network_tx_select_class(network_tx_class_t tx_class, uint32_t * wait_ms)
+{
+    bipbuf_t * ring = &tx_queue[tx_class];
+    uint32_t now = systime_ms();
+
+    // destinations with a shaped frame, later frames for them must not
+    // overtake it
+    uint32_t held[256 / 32] = { 0 };
+
+    queue_node_t * node = bipbuf_peek(ring, NULL);
+    while (node != NULL)
+    {
+        // frames of a message still being queued wait until all of it is
+        if (node->sent || node->handle == tx_queuing_handle)
+        {
+            node = bipbuf_next(ring, node, NULL);
+            continue;
+        }
+
+        // stale frames are dropped before they take the bus, which may pop
+        // them off the ring, so the walk starts over from its head
+        if (network_tx_node_is_expired(node, now))
+        {
+            network_tx_queue_expire(node);
+            node = bipbuf_peek(ring, NULL);
+            continue;
+        }
+
+        // a paused destination is retried once its pause runs out, in case
+        // its resume is lost
+        uint32_t pause_ms = network_tx_dest_pause_ms(node->destination, now);
+        if (pause_ms > 0)
+        {
+            if (pause_ms > *wait_ms)
+            {
+                *wait_ms = pause_ms;
+            }
+        }
+        else if (!((held[node->destination / 32] >> (node->destination % 32)) & 1))
+        {
+            if (shaper_conforms(tx_class, node->destination, node->frame_size, now, wait_ms))
+            {
+                return node;
+            }
+            held[node->destination / 32] |= 1UL << (node->destination % 32);
+        }
+        node = bipbuf_next(ring, node, NULL);
+    }
+
+    return NULL;
+}
+
+
+/**
+ * Gets the completion status of a message passed to network_tx_ex()
+ *
+ * @param   [in]    handle  The handle returned by network_tx_ex()
+ *
+ * @return  The message's status, or NETWORK_TX_STATUS_UNKNOWN if the handle
+ *          is too old to be remembered
+ */
+network_tx_status_t network_tx_status(network_tx_handle_t handle)
+{
+    tx_status_entry_t * entry = &tx_status_table[handle % TX_STATUS_TABLE_SIZE];
+
+    if (handle == NETWORK_TX_INVALID_HANDLE || entry->handle != handle)
+    {
+        return NETWORK_TX_STATUS_UNKNOWN;
+    }
+
+    return entry->status;
+}
+
+
+/**
+ * Gets when the last frame of a sent message was queued, took the line and
+ * went out
+ *
+ * @param   [in]    handle  The handle returned by network_tx_ex()
+ * @param   [out]   timing  The times of the message's last frame
+ *
+ * @return  True if the message was sent and its handle is still remembered
+ */
+bool network_tx_timing(network_tx_handle_t handle, network_tx_timing_t * timing)
+{
+    uint32_t primask = critical_enter();
+    tx_status_entry_t * entry = &tx_status_table[handle % TX_STATUS_TABLE_SIZE];
+    bool sent = handle != NETWORK_TX_INVALID_HANDLE && entry->handle == handle &&
+                entry->status == NETWORK_TX_STATUS_SENT;
+
+    if (sent)
+    {
+        *timing = entry->timing;
+    }
+    critical_exit(primask);
+
+    return sent;
+}
+
+
+/**
+ * Gets the number of frames dropped because their time to live passed
+ *
+ * @return  The number of expired frames
+ */
+uint32_t network_tx_expired_count()
+{
+    return tx_expired_count;
+}
+
+
+/**
+ * Selects how the transmit queue picks between traffic classes
+ *
+ * @param   [in]    sched   The scheduling discipline
+ *
+ * @return  Error code
+ */
+ERROR_CODE network_tx_set_sched(network_tx_sched_t sched)
+{
+    if (sched >= NETWORK_TX_SCHED_COUNT)
+    {
+        THROW_ERROR(ERROR_CODE_NETWORK_INVALID_TX_SCHED);
+    }
+
+    tx_sched = sched;
+    RETURN_NO_ERROR();
+}
+
+
+/**
+ * Sets the number of frames a traffic class may send per weighted round
+ *
+ * @param   [in]    tx_class    The traffic class
+ * @param   [in]    weight      Frames per round (at least 1)
+ *
+ * @return  Error code
+ */
+ERROR_CODE network_tx_set_class_weight(network_tx_class_t tx_class, uint8_t weight)
+{
+    if (tx_class >= NETWORK_TX_CLASS_COUNT || weight == 0)
+    {
+        THROW_ERROR(ERROR_CODE_NETWORK_INVALID_TX_CLASS);
+    }
+
+    tx_class_weight[tx_class] = weight;
+    RETURN_NO_ERROR();
+}
+
+
+/**
+ * Gets the queueing delay statistics of a traffic class
+ *
+ * @param   [in]    tx_class    The traffic class
+ * @param   [out]   stats       The statistics of the class
+ *
+ * @return  Error code
+ */
+ERROR_CODE network_tx_class_stats(network_tx_class_t tx_class, network_tx_class_stats_t * stats)
+{
+    if (tx_class >= NETWORK_TX_CLASS_COUNT)
+    {
+        THROW_ERROR(ERROR_CODE_NETWORK_INVALID_TX_CLASS);
+    }
+
+    *stats = tx_class_stats[tx_class];
+    RETURN_NO_ERROR();
+}
+
+
+/**
+ * Clears the queueing delay statistics of every traffic class
+ */
+void network_tx_class_stats_reset()
+{
+    memset(tx_class_stats, 0, sizeof(tx_class_stats));
+}
+
+
+/**
+ * Determines whether a destination has asked us to pause transmissions to it
+ *
+ * @param   [in]    dest    The destination address
+ *
+ * @return  True if frames for the destination are being held
+ */
+bool network_tx_dest_is_paused(uint8_t dest)
+{
+    return network_tx_dest_pause_ms(dest, systime_ms()) > 0;
+}
 
-                } 
+
+/**
+ * Gets how long a destination's pause has left to run
+ *
+ * @param   [in]    dest    The destination address
+ * @param   [in]    now     The current system time in milliseconds
+ *
+ * @return  Milliseconds until the pause expires, 0 if the destination is not
+ *          paused
+ */
+static uint32_t network_tx_dest_pause_ms(uint8_t dest, uint32_t now)
+{
+    for (int i = 0; i < FLOW_PAUSE_TABLE_SIZE; i++)
+    {
+        flow_pause_entry_t * entry = &flow_pause_table[i];
+        if (entry->active && entry->address == dest)
+        {
+            // expire pauses whose resume never arrived
+            if ((int32_t) (now - entry->expires_ms) >= 0)
+            {
+                entry->active = false;
+                return 0;
             }
+            return entry->expires_ms - now;
         }
-        network_rx_queue_pop();
     }
-    return false;
+
+    return 0;
+}
+
+
+/**
+ * Handles a control frame received from another node
+ *
+ * @param   [in]    frame   The decoded control frame
+ */
+static void network_control_handle(frame_t * frame)
+{
+    // ignore our own control frames and malformed ones
+    if (frame->header.source == local_machine_address || frame->header.length < 1)
+    {
+        return;
+    }
+
+    uint8_t opcode = frame->message[0];
+    flow_pause_entry_t * slot = NULL;
+
+    for (int i = 0; i < FLOW_PAUSE_TABLE_SIZE; i++)
+    {
+        flow_pause_entry_t * entry = &flow_pause_table[i];
+        if (entry->active && entry->address == frame->header.source)
+        {
+            slot = entry;
+            break;
+        }
+        if (!entry->active && slot == NULL)
+        {
+            slot = entry;
+        }
+    }
+
+    if (opcode == CONTROL_OPCODE_PAUSE && slot != NULL)
+    {
+        slot->address = frame->header.source;
+        slot->expires_ms = systime_ms() + FLOW_PAUSE_TIMEOUT_MS;
+        slot->active = true;
+    }
+    else if (opcode == CONTROL_OPCODE_RESUME)
+    {
+        if (slot != NULL && slot->active && slot->address == frame->header.source)
+        {
+            slot->active = false;
+        }
+        ERROR_HANDLE_NON_FATAL(network_start_tx());
+    }
+}
+
+
+/**
+ * Compares the occupancy of the receive queue and of the port queues against
+ * the flow control watermarks and asks senders to pause or resume accordingly
+ *
+ * NOTE:
+ * Messages for a port without a callback wait in its queue until they're
+ * read, so a slow reader pauses senders before its queue drops messages
+ */
+static void network_flow_update()
+{
+    // the receive ISR and the main loop both update the flow state
+    uint32_t primask = critical_enter();
+    uint32_t used = bipbuf_used(&rx_queue);
+    unsigned int port_used = network_port_max_used();
+    uint32_t now = systime_ms();
+    bool raised = false;
+
+    if (used >= FLOW_RX_HIGH_WATERMARK || port_used >= FLOW_PORT_HIGH_WATERMARK)
+    {
+        // repeat the pause periodically so senders don't time it out
+        if (!flow_rx_paused || (now - flow_rx_pause_ms) >= FLOW_PAUSE_REFRESH_MS)
+        {
+            flow_rx_paused = true;
+            flow_rx_pause_ms = now;
+            tx_control_opcode = CONTROL_OPCODE_PAUSE;
+            raised = true;
+        }
+    }
+    else if (used <= FLOW_RX_LOW_WATERMARK && port_used <= FLOW_PORT_LOW_WATERMARK && flow_rx_paused)
+    {
+        flow_rx_paused = false;
+        tx_control_opcode = CONTROL_OPCODE_RESUME;
+        raised = true;
+    }
+    critical_exit(primask);
+
+    // the control frame is encoded outside the critical section
+    if (raised)
+    {
+        ERROR_HANDLE_NON_FATAL(network_start_tx());
+    }
+}
+
+
+/**
+ * Finds the most messages waiting in the queue of any open port without a
+ * callback
+ *
+ * @return  The number of messages in the fullest port queue
+ */
+static unsigned int network_port_max_used()
+{
+    unsigned int max_used = 0;
+
+    for (int i = 0; i < PORT_TABLE_SIZE; i++)
+    {
+        port_entry_t * entry = &port_table[i];
+        if (entry->open && entry->callback == NULL)
+        {
+            unsigned int used = (entry->push_idx + PORT_QUEUE_SIZE - entry->pop_idx - 1) % PORT_QUEUE_SIZE;
+            if (used > max_used)
+            {
+                max_used = used;
+            }
+        }
+    }
+
+    return max_used;
+}
+
+
+/**
+ * Determines whether every class of the network's transmit queue is full
+ *
+ * @return  True if the queue is full, false otherwise.
+ */
+bool network_tx_queue_is_full()
+{
+    for (int cls = 0; cls < NETWORK_TX_CLASS_COUNT; cls++)
+    {
+        if (!tx_ring_is_full(&tx_queue[cls]))
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+
+/**
+ * Determines whether one class of the network's transmit queue is full
+ *
+ * @param   [in]    tx_class    The traffic class to check
+ *
+ * @return  True if the class can't take another frame, false otherwise.
+ */
+bool network_tx_class_is_full(network_tx_class_t tx_class)
+{
+    return tx_class >= NETWORK_TX_CLASS_COUNT || tx_ring_is_full(&tx_queue[tx_class]);
+}
+
+
+/**
+ * Determines whether every class of the network's transmit queue is empty
+ *
+ * @return  True if the queue is empty, false otherwise.
+ */
+bool network_tx_queue_is_empty()
+{
+    for (int cls = 0; cls < NETWORK_TX_CLASS_COUNT; cls++)
+    {
+        if (!bipbuf_is_empty(&tx_queue[cls]))
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+
+/**
+ * Gets the number of messages in the queue across all classes
+ *
+ * @return  The number of messages in the message queue
+ */
+unsigned int network_tx_queue_count()
+{
+    unsigned int count = 0;
+    for (int cls = 0; cls < NETWORK_TX_CLASS_COUNT; cls++)
+    {
+        count += bipbuf_count(&tx_queue[cls]);
+    }
+    return count;
+}
+
+
+/**
+ * Determines whether a transmit ring is too full to take another frame
+ *
+ * @param   [in]    ring    The ring to check
+ *
+ * @return  True if a frame of the largest size would not fit
+ */
+static bool tx_ring_is_full(bipbuf_t * ring)
+{
+    return bipbuf_reserve(ring, sizeof(queue_node_t)) == NULL;
+}
+
+
+/**
+ * Pushes an element into one class of this network's transmit queue
+ *
+ * @param   [in]    params      The traffic class and time to live of the frame
+ * @param   [in]    handle      The handle of the message the frame belongs to
+ * @param   [in]    frame       The frame's message, destination and size
+ *
+ * @return  False if the class' transmit queue is full, true otherwise
+ */
+static bool network_tx_queue_push(const network_tx_params_t * params, network_tx_handle_t handle,
+                                  const queue_node_t * frame)
+{
+    bipbuf_t * ring = &tx_queue[params->tx_class];
+
+    // return false if the frame doesn't fit in the queue
+    queue_node_t * node = bipbuf_reserve(ring, sizeof(queue_node_t));
+    if (node == NULL)
+    {
+        return false;
+    }
+
+    // the queue references the message rather than copying it, the buffer
+    // must not change until the frame is sent
+    *node = *frame;
+    node->buf = netbuf_ref(frame->buf);
+    node->tx_class = params->tx_class;
+    node->sent = false;
+    node->handle = handle;
+    node->enqueue_ms = systime_ms();
+    node->enqueue_us = systime_us();
+    node->attempts = 0;
+    node->has_deadline = params->ttl_ms != NETWORK_TX_NO_TTL;
+    node->deadline_ms = node->enqueue_ms + params->ttl_ms;
+
+    bipbuf_commit(ring, node, sizeof(queue_node_t));
+
+    return true;
+}
+
+
+/**
+ * Releases a transmitted element of this network's transmit queue, records
+ * its queueing delay and pops every sent element from the head of its ring
+ *
+ * @param   [in]    node    The transmitted element
+ *
+ * @return True if the element belongs to the queue, false otherwise
+ */
+static bool network_tx_queue_release(queue_node_t * node)
+{
+    // return false if the queue is empty (cannot release element)
+    if ( bipbuf_is_empty(&tx_queue[node->tx_class]))
+    {
+        return false;
+    }
+
+    node->sent = true;
+
+    network_tx_class_stats_t * stats = &tx_class_stats[node->tx_class];
+    uint32_t delay_ms = node->start_ms - node->enqueue_ms;
+    stats->frames++;
+    stats->delay_total_ms += delay_ms;
+    if (delay_ms > stats->delay_max_ms)
+    {
+        stats->delay_max_ms = delay_ms;
+    }
+
+    if (tx_class_credit[node->tx_class] > 0)
+    {
+        tx_class_credit[node->tx_class]--;
+    }
+
+    shaper_consume(node->tx_class, node->destination, node->frame_size);
+
+    tx_status_entry_t * entry = &tx_status_table[node->handle % TX_STATUS_TABLE_SIZE];
+    if (entry->handle == node->handle)
+    {
+        entry->timing = (network_tx_timing_t) {
+            .queued_us = node->enqueue_us,
+            .first_us = node->first_start_us,
+            .start_us = node->start_us,
+            .end_us = systime_us(),
+            .attempts = node->attempts
+        };
+    }
+
+    network_tx_status_update(node->handle, false);
+    network_tx_queue_retire(node);
+    return true;
+}
+
+
+/**
+ * Drops an element of this network's transmit queue whose time to live has
+ * passed without transmitting it
+ *
+ * @param   [in]    node    The expired element
+ *
+ * @return True if the element belongs to the queue, false otherwise
+ */
+static bool network_tx_queue_expire(queue_node_t * node)
+{
+    // return false if the queue is empty (cannot drop element)
+    if ( bipbuf_is_empty(&tx_queue[node->tx_class]))
+    {
+        return false;
+    }
+
+    tx_expired_count++;
+    network_tx_status_update(node->handle, true);
+    network_tx_queue_retire(node);
+    return true;
+}
+
+
+/**
+ * Marks an element of the transmit queue as finished, drops its buffer
+ * reference and pops every finished element from the head of its ring
+ *
+ * @param   [in]    node    The finished element
+ */
+static void network_tx_queue_retire(queue_node_t * node)
+{
+    bipbuf_t * ring = &tx_queue[node->tx_class];
+    queue_node_t * head;
+
+    netbuf_free(node->buf);
+    node->buf = NULL;
+    node->sent = true;
+
+    while ((head = bipbuf_peek(ring, NULL)) != NULL && head->sent)
+    {
+        bipbuf_pop(ring);
+    }
+}
+
+
+/**
+ * Determines whether a transmit queue element's time to live has passed
+ *
+ * @param   [in]    node    The element to check
+ * @param   [in]    now     The current system time in milliseconds
+ *
+ * @return  True if the element has expired
+ */
+static bool network_tx_node_is_expired(queue_node_t * node, uint32_t now)
+{
+    return node->has_deadline && (int32_t) (now - node->deadline_ms) >= 0;
+}
+
+
+/**
+ * Accounts for one finished frame of a message in its completion status
+ *
+ * @param   [in]    handle      The handle of the message
+ * @param   [in]    expired     True if the frame was dropped as expired
+ */
+static void network_tx_status_update(network_tx_handle_t handle, bool expired)
+{
+    tx_status_entry_t * entry = &tx_status_table[handle % TX_STATUS_TABLE_SIZE];
+
+    // the slot was reused by a newer message
+    if (entry->handle != handle)
+    {
+        return;
+    }
+
+    if (expired)
+    {
+        entry->status = NETWORK_TX_STATUS_EXPIRED;
+    }
+
+    if (entry->frames_pending > 0 && --entry->frames_pending == 0 &&
+        entry->status == NETWORK_TX_STATUS_PENDING)
+    {
+        entry->status = NETWORK_TX_STATUS_SENT;
+    }
+}
+
+
+/**
+ * Determines whether the network's receive queue is too full to receive
+ * another frame
+ *
+ * @return  True if the queue is full, false otherwise.
+ */
+bool network_rx_queue_is_full()
+{
+    return bipbuf_reserve(&rx_queue, RX_RECORD_MAX_SIZE) == NULL;
+}
+
+
+/**
+ * Determines whether the network's receive queue is empty
+ *
+ * @return  True if the queue is empty, false otherwise.
+ */
+bool network_rx_queue_is_empty()
+{
+    return bipbuf_is_empty(&rx_queue);
+}
+
+
+/**
+ * Gets the number of messages in the receive queue
+ *
+ * @return  The number of messages in the message queue
+ */
+unsigned int network_rx_queue_count()
+{
+    return bipbuf_count(&rx_queue);
+}
+
+
+/**
+ * Resets the "under-construction" element in the receive queue.
+ */
+void network_rx_queue_reset()
+{
+    rx_queue_push_slots = NULL;
+    rx_queue_push_byte_idx = 0;
+    rx_queue_push_bit_idx = 0;
+    rx_queue_last_bit = 1;
+    rx_queue_overflow = false;
+    rx_filter_discard = false;
 }
 
 
 /**
- * Signals the network component to begin transmitting messages from its
- * internal message queue
+ * Pushes a singular bit into the "under-construction" element in the
+ * receive queue.
  *
- * @return  Error code
+ * @param   [in]    bit     The bit to push
+ *
+ * @return  True if the bit is added successfully, false otherwise
  */
-ERROR_CODE network_start_tx()
+bool network_rx_queue_push_bit(bool bit)
 {
-    // throw an error if the network is not initialized
-    if (!network_is_init)
+    rx_queue_last_bit = bit;
+
+    // the last bit keeps the line level, the impairment only corrupts the sample
+    #ifdef NETWORK_PHY_IMPAIR
+        bit = phy_impair_rx_slot(bit);
+    #endif
+
+    // drop the rest of a frame that is not addressed to us
+    if (rx_filter_discard)
     {
-        THROW_ERROR(ERROR_CODE_NETWORK_NOT_INITIALIZED);
+        return 1;
     }
 
-    if ( !network_tx_queue_is_empty() &&
-            ( state_get() == IDLE ) && !backoff_is_running() )
+    if (rx_queue_overflow)
     {
-        if (!hb_timer_is_running())
+        return 0;
+    }
+
+    // reserve room for the largest frame when the first edge arrives
+    if (rx_queue_push_slots == NULL)
+    {
+        rx_queue_push_slots = bipbuf_reserve(&rx_queue, RX_RECORD_MAX_SIZE);
+        if (rx_queue_push_slots == NULL)
         {
-            ELEVATE_IF_ERROR(hb_timer_reset());
+            rx_queue_overflow = true;
+            return 0;
         }
-        ELEVATE_IF_ERROR(hb_timer_start());
+#ifdef NETWORK_SNIFF
+        rx_queue_push_start_us = systime_us();
+#endif
+
+        // the first bit will always be 1 with the preamble the line idled in
+        rx_queue_push_slots[0] = 0x80;
+        rx_queue_push_bit_idx = 1;
     }
 
-    RETURN_NO_ERROR();
-}
+    // fail to add bit if it lands outside the buffer
+    if ((rx_queue_push_byte_idx * 8 + rx_queue_push_bit_idx) >=
+        (MAX_FRAME_SIZE_MANCHESTER * 8))
+    {
+        return 0;
+    }
 
+    // push bit into buffer, clearing each byte as it is started
+    if (rx_queue_push_bit_idx == 0)
+    {
+        rx_queue_push_slots[rx_queue_push_byte_idx] = 0;
+    }
+    rx_queue_push_slots[rx_queue_push_byte_idx] |= bit << (7 - rx_queue_push_bit_idx);
 
-/**
- * Determines whether the network's transmit queue is full
- *
- * @return  True if the queue is full, false otherwise.
- */
-bool network_tx_queue_is_full()
-{
-    return tx_queue_pop_idx == tx_queue_push_idx;
-}
+    if (++rx_queue_push_bit_idx > 7)
+    {
+        rx_queue_push_bit_idx = 0;
+        rx_queue_push_byte_idx++;
 
+        // the destination byte has just been completed
+        if (rx_queue_push_byte_idx == RX_FILTER_SLOT_BYTES)
+        {
+            network_rx_filter_check();
+        }
+    }
 
-/**
- * Determines whether the network's transmit queue is full
- *
- * @return  True if the queue is full, false otherwise.
- */
-bool network_tx_queue_is_empty()
-{
-    return ( tx_queue_pop_idx + 1) % TX_QUEUE_SIZE == tx_queue_push_idx;
+    return 1;
 }
 
 
 /**
- * Gets the number of messages in the queue
- *
- * @return  The number of messages in the message queue
+ * Decodes the header of the "under-construction" element up to its
+ * destination and marks the element for discarding if it isn't for us
  */
-unsigned int network_tx_queue_count()
+static void network_rx_filter_check()
 {
-    if ( tx_queue_push_idx > tx_queue_pop_idx)
+    frame_header_t header;
+
+    if (rx_filter_promiscuous)
     {
-        return tx_queue_push_idx - tx_queue_pop_idx - 1;
+        return;
     }
-    else
+
+    // malformed headers are left for network_service() to report, the slots
+    // received so far hold the destination in every line code
+    linecode_decoder_t decoder;
+    unsigned int violations = 0;
+    if (!linecode_decoder_init(&decoder, rx_queue_push_slots, RX_FILTER_SLOT_BYTES * 8) ||
+        !linecode_decode(&decoder, (uint8_t *) &header + 1, RX_FILTER_HEADER_BYTES, &violations) ||
+        violations)
+    {
+        return;
+    }
+
+    if (!network_rx_filter_accepts(header.destination))
     {
-        return ( tx_queue_push_idx + TX_QUEUE_SIZE) - tx_queue_pop_idx - 1;
+        rx_filter_discard = true;
     }
 }
 
+
 /**
- * Pushes an element into this network's transmit queue
+ * Determines whether the receive filter accepts frames for a destination
  *
- * @param   [in]    buffer  The buffer to enqueue
- * @param   [in]    size    The size of the buffer
+ * @param   [in]    dest    The destination address
  *
- * @return  False if the transmit queue is full, true otherwise
+ * @return  True if frames for the destination are received
  */
-static bool network_tx_queue_push(uint8_t * buffer, size_t size)
+bool network_rx_filter_accepts(uint8_t dest)
 {
-    // return false if the queue is full
-    if ( network_tx_queue_is_full())
+    if (rx_filter_promiscuous || dest == local_machine_address || dest == BROADCAST_ADDRESS)
     {
-        return false;
+        return true;
     }
 
-    // it is important that we make a copy of the buffer in the queue,
-    // otherwise we risk modifying the data before it can be transmitted
-    memcpy( tx_queue[tx_queue_push_idx].buffer, buffer, size);
-    tx_queue[tx_queue_push_idx].size = size;
-
-    tx_queue_push_idx = ( tx_queue_push_idx + 1) % TX_QUEUE_SIZE;
+    for (int i = 0; i < rx_filter_group_count; i++)
+    {
+        if (rx_filter_groups[i] == dest)
+        {
+            return true;
+        }
+    }
 
-    return true;
+    return false;
 }
 
 
 /**
- * Pops an element from this network's transmit queue
+ * Joins a multicast group so frames addressed to it are received
+ *
+ * @param   [in]    group   The group address
  *
- * @return True if an element is successfully popped, false otherwise
+ * @return  Error code
  */
-static bool network_tx_queue_pop()
+ERROR_CODE network_rx_group_join(uint8_t group)
 {
-    // return false if the queue is empty (cannot pop element)
-    if ( network_tx_queue_is_empty())
+    if (network_rx_filter_accepts(group) && !rx_filter_promiscuous)
     {
-        return false;
+        RETURN_NO_ERROR();
     }
 
-    tx_queue_pop_idx = ( tx_queue_pop_idx + 1) % TX_QUEUE_SIZE;
-    return true;
-}
+    if (rx_filter_group_count == RX_GROUP_TABLE_SIZE)
+    {
+        THROW_ERROR(ERROR_CODE_NETWORK_GROUP_TABLE_FULL);
+    }
 
+    rx_filter_groups[rx_filter_group_count++] = group;
 
-/**
- * Determines whether the network's receive queue is full
- *
- * @return  True if the queue is full, false otherwise.
- */
-bool network_rx_queue_is_full()
-{
-    return rx_queue_pop_idx == rx_queue_push_idx;
+    RETURN_NO_ERROR();
 }
 
 
 /**
- * Determines whether the network's receive queue is full
+ * Leaves a multicast group
  *
- * @return  True if the queue is full, false otherwise.
+ * @param   [in]    group   The group address
+ *
+ * @return  Error code
  */
-bool network_rx_queue_is_empty()
+ERROR_CODE network_rx_group_leave(uint8_t group)
 {
-    return ( rx_queue_pop_idx + 1) % TX_QUEUE_SIZE == rx_queue_push_idx;
+    for (int i = 0; i < rx_filter_group_count; i++)
+    {
+        if (rx_filter_groups[i] == group)
+        {
+            rx_filter_groups[i] = rx_filter_groups[--rx_filter_group_count];
+            break;
+        }
+    }
+
+    RETURN_NO_ERROR();
 }
 
 
 /**
- * Gets the number of messages in the receive queue
+ * Enables or disables receiving frames for every destination
  *
- * @return  The number of messages in the message queue
+ * @param   [in]    enable  True to receive every frame on the bus
  */
-unsigned int network_rx_queue_count()
+void network_rx_set_promiscuous(bool enable)
 {
-    if ( rx_queue_push_idx > rx_queue_pop_idx)
-    {
-        return rx_queue_push_idx - rx_queue_pop_idx - 1;
-    }
-    else
-    {
-        return ( rx_queue_push_idx + RX_QUEUE_SIZE) - rx_queue_pop_idx - 1;
-    }
+    rx_filter_promiscuous = enable;
 }
 
 
 /**
- * Resets the "under-construction" element in the receive queue.
+ * Gets whether frames for every destination are received
  */
-void network_rx_queue_reset()
+bool network_rx_is_promiscuous()
 {
-    memset(rx_queue[rx_queue_push_idx].buffer, 0, rx_queue_push_byte_idx + 1);
-    rx_queue_push_byte_idx = 0;
-    rx_queue_push_bit_idx = 0;
-    network_rx_queue_push_bit(1);
+    return rx_filter_promiscuous;
 }
 
 
 /**
- * Pushes a singular bit into the "under-construction" element in the
- * receive queue.
- *
- * @param   [in]    bit     The bit to push
+ * Gets the number of frames discarded by the receive filter
  *
- * @return  True if the bit is added successfully, false otherwise
+ * @return  The number of filtered frames
  */
-bool network_rx_queue_push_bit(bool bit)
+uint32_t network_rx_filtered_count()
 {
-    // fail to add bit if it lands outside the buffer
-    if ((rx_queue_push_byte_idx * 8 + rx_queue_push_bit_idx) >
-        (MAX_FRAME_SIZE_MANCHESTER * 8))
-    {
-        return 0;
-    }
-
-    // push bit into buffer
-    rx_queue[rx_queue_push_idx].buffer[rx_queue_push_byte_idx] |=
-        bit << (7 - rx_queue_push_bit_idx);
-
-    if (++rx_queue_push_bit_idx > 7)
-    {
-        rx_queue_push_bit_idx = 0;
-        rx_queue_push_byte_idx++;
-    }
-
-    return 1;
+    return rx_filtered_count;
 }
 
 /**
@@ -529,15 +2572,7 @@ bool network_rx_queue_push_bit(bool bit)
  */
 bool network_rx_queue_get_last_bit()
 {
-    // the last byte index will be the same as the push byte index unless we're
-    // on the zeroth bit index, in which case the last byte index was one less
-    unsigned int last_byte_idx = rx_queue_push_byte_idx -
-        (rx_queue_push_bit_idx == 0);
-
-    unsigned int last_bit_idx = (rx_queue_push_bit_idx - 1) % 8;
-
-    return rx_queue[rx_queue_push_idx].buffer[last_byte_idx] &
-        (0b01 << (7 - last_bit_idx));
+    return rx_queue_last_bit;
 }
 
 /**
@@ -547,40 +2582,87 @@ bool network_rx_queue_get_last_bit()
  */
 bool network_rx_queue_push()
 {
-    // fail if the queue is full and reset push byte/bit values to zero
-    // so the old message can be written over again
-    if (network_rx_queue_is_full())
+    // fail if the element was discarded by the receive filter
+    if (rx_filter_discard)
+    {
+        rx_filtered_count++;
+        network_rx_queue_reset();
+        return 0;
+    }
+
+    // fail if the queue had no room for the element
+    if (rx_queue_overflow)
     {
         network_rx_queue_reset();
         return 0;
     }
 
     // fail if there is no element "under-construction"
-    if (rx_queue_push_byte_idx < 14)
+    if (rx_queue_push_slots == NULL || rx_queue_push_byte_idx < RX_MIN_FRAME_SLOT_BYTES)
     {
+#ifdef NETWORK_SNIFF
+        // the sniffer sees glitches and runts too
+        if (rx_sniffer != NULL && rx_queue_push_slots != NULL && rx_queue_push_byte_idx > 0)
+        {
+            network_rx_queue_commit(NETWORK_SNIFF_LENGTH_ERROR);
+            return 0;
+        }
+#endif
         network_rx_queue_reset();
         return 0;
     }
 
-    // set "under-construction" element size
-    rx_queue[rx_queue_push_idx].size = rx_queue_push_byte_idx;
+    network_rx_queue_commit(0);
 
-    // increment the push index and reset bit/byte indices
-    rx_queue_push_idx = (rx_queue_push_idx + 1) % RX_QUEUE_SIZE;
-    rx_queue_push_byte_idx = 0;
-    rx_queue_push_bit_idx = 0;
+    return 1;
+}
 
-    // push a 1 because the first bit will always be 1 with an 0x55 preamble
-    network_rx_queue_push_bit(1);
 
-    return 1;
+/**
+ * Discards the "under-construction" element after the line was held low, or
+ * commits it marked as collided when sniffing
+ */
+void network_rx_queue_collide()
+{
+#ifdef NETWORK_SNIFF
+    if (rx_sniffer != NULL && rx_queue_push_slots != NULL && !rx_queue_overflow &&
+        !rx_filter_discard && rx_queue_push_byte_idx > 0)
+    {
+        network_rx_queue_commit(NETWORK_SNIFF_COLLISION);
+        return;
+    }
+#endif
+
+    network_rx_queue_reset();
 }
 
 
 /**
- * Pushes an element from the receive queue
+ * Commits the "under-construction" element at its complete size and starts
+ * the next one
  *
- * @return  True if the element pushes successfully, false otherwise
+ * @param   [in]    status  NETWORK_SNIFF_ flags of a record not to be decoded
+ */
+static void network_rx_queue_commit(uint8_t status)
+{
+#ifdef NETWORK_SNIFF
+    rx_record_info_t info = { rx_queue_push_start_us, systime_us(), status };
+    memcpy(rx_queue_push_slots + rx_queue_push_byte_idx, &info, sizeof(info));
+#else
+    (void) status;
+#endif
+
+    bipbuf_commit(&rx_queue, rx_queue_push_slots, rx_queue_push_byte_idx + RX_RECORD_INFO_SIZE);
+    network_rx_queue_reset();
+
+    network_flow_update();
+}
+
+
+/**
+ * Pops an element from the receive queue
+ *
+ * @return  True if the element pops successfully, false otherwise
  */
 bool network_rx_queue_pop()
 {
@@ -590,238 +2672,277 @@ bool network_rx_queue_pop()
         return 0;
     }
 
-    // zero out popped element
-    memset(rx_queue[rx_queue_pop_idx].buffer, 0, MAX_FRAME_SIZE_MANCHESTER);
+    bipbuf_pop(&rx_queue);
 
-    // increase popped element index
-    rx_queue_pop_idx = (rx_queue_pop_idx + 1) % RX_QUEUE_SIZE;
+    network_flow_update();
 
     return 1;
 }
 
 /**
- * Decodes a manchester encoded message into a frame
+ * Encodes a frame in the transmit line code
+ *
+ * @param   [out]   slots   Buffer to encode the frame into. Must be at least the max size of a manchester encoded frame
+ * @param   [in]    frame   Frame to encode
  *
- * @param   [out]   frame       Frame to decode into (must have message buffer pre-allocated)
- * @param   [in]    manchester  The input buffer of a manchester encoded frame
- * @return  error code
+ * @return  number of bytes filled into the slots buffer
  */
-static ERROR_CODE network_decode_manchester_frame( frame_t * frame, uint8_t * manchester)
+static unsigned int network_encode_frame(uint8_t * slots, frame_t * frame)
 {
-    ERROR_HANDLE_NON_FATAL(network_decode_manchester_header(&frame->header, manchester));
-    return network_decode_manchester_frame_message_trailer(
-        frame,
-        manchester + sizeof(frame_header_t) * 2
-    );
-    RETURN_NO_ERROR();  
+    linecode_encoder_t encoder;
+
+    // the encoder sends the preamble of its code
+    linecode_encoder_init(&encoder, tx_linecode, slots);
+    linecode_encode(&encoder, (uint8_t *) &frame->header + 1, sizeof(frame_header_t) - 1);
+    linecode_encode(&encoder, (uint8_t *) frame->message, frame->header.length);
+    linecode_encode(&encoder, (uint8_t *) &frame->trailer, sizeof(frame_trailer_t));
+
+    return linecode_encoder_finish(&encoder);
 }
 
+
 /**
- * Decodes a manchester encoded frame header
+ * Encodes a queued frame in the transmit line code
+ *
+ * @param   [out]   slots   Buffer to encode the frame into. Must be at least the max size of a manchester encoded frame
+ * @param   [in]    node    Queued frame to encode
  *
- * @param   [out]   header      Frame header to decode into
- * @param   [in]    manchester  Pointer to the start of a Manchester encoded frame header
- * @return  error code
+ * @return  number of bytes filled into the slots buffer
  */
-static ERROR_CODE network_decode_manchester_header( frame_header_t * header, uint8_t * manchester)
+static unsigned int network_encode_node(uint8_t * slots, const queue_node_t * node)
 {
-    return network_decode_manchester((uint8_t *) header, manchester, sizeof(frame_header_t));
+    frame_header_t header = {
+        .preamble = linecode_preamble(tx_linecode),
+        .version = PROTOCOL_VERSION,
+        .source = local_machine_address,
+        .destination = node->destination,
+        .length = node->prefix_size + node->length,
+        .crc_flag = node->crc_flag
+    };
+    linecode_encoder_t encoder;
+
+    // the message is sent straight from the buffer it was queued in
+    linecode_encoder_init(&encoder, tx_linecode, slots);
+    linecode_encode(&encoder, (uint8_t *) &header + 1, sizeof(frame_header_t) - 1);
+    linecode_encode(&encoder, &node->prefix, node->prefix_size);
+    linecode_encode(&encoder, node->buf->data + node->offset, node->length);
+    linecode_encode(&encoder, &node->crc, sizeof(frame_trailer_t));
+
+    return linecode_encoder_finish(&encoder);
 }
 
 /**
- * Decodes a manchester encoded message and trailer into a frame with an existing header
+ * Encodes a control frame carrying an opcode in the transmit line code
+ *
+ * @param   [out]   slots   Buffer to encode the frame into. Must be at least the max size of a manchester encoded frame
+ * @param   [in]    opcode  The control opcode to send
  *
- * @param   [out]   frame       Frame to decode into (must have message buffer pre-allocated and header already decoded)
- * @param   [in]    manchester  Pointer to the start of the message in a Manchester encoded frame
- * @return  error code
+ * @return  number of bytes filled into the slots buffer
  */
-static ERROR_CODE network_decode_manchester_frame_message_trailer( frame_t * frame, uint8_t * manchester)
+static unsigned int network_encode_control(uint8_t * slots, uint8_t opcode)
 {
-    ERROR_HANDLE_NON_FATAL(network_decode_manchester(
-        (uint8_t *)frame->message, 
-        manchester, 
-        frame->header.length)
-    );
-    ERROR_HANDLE_NON_FATAL(network_decode_manchester(
-        (uint8_t *)&frame->trailer, 
-        manchester + frame->header.length * 2, 
-        sizeof(frame_trailer_t))
-    );
-    RETURN_NO_ERROR();
+    frame_t frame = {
+        .header = {
+            .preamble = linecode_preamble(tx_linecode),
+            .version = PROTOCOL_VERSION,
+            .source = local_machine_address,
+            .destination = BROADCAST_ADDRESS,
+            .length = 1,
+            .crc_flag = CRC_FLAG_ON | FRAME_FLAG_CONTROL
+        },
+        .message = (char *) &opcode
+    };
+    frame_crc_apply(&frame);
+
+    return network_encode_frame(slots, &frame);
 }
 
 /**
- * Encodes a frame into a manchester encoded buffer
- * 
- * @param   [in]    manchester  Buffer to encode frame into. Must be at least the max size of a manchester encoded frame
- * @param   [out]   frame       Frame to encode
-
- * @return  number of bytes filled into the manchester buffer
+ * Calculates the crc of a queued frame's port and message
+ *
+ * @param   [in]   node  The queued frame to apply CRC calculation to
  */
-static unsigned int network_encode_frame_manchester( uint8_t * manchester, frame_t * frame)
+static void node_crc_apply(queue_node_t * node)
 {
-    unsigned int size = 0;
-    size += network_encode_manchester(manchester,  (uint8_t *) &(frame->header), sizeof(frame_header_t));
-    size += network_encode_manchester(manchester + size, frame->message, frame->header.length);
-    size += network_encode_manchester(manchester + size, (uint8_t *) &(frame->trailer), sizeof(frame_trailer_t));
-    return size;
+    node->crc = crc8_calculate(node->buf->data + node->offset, node->length,
+                               crc8_calculate(&node->prefix, node->prefix_size, 0));
 }
 
-
 /**
- * Encodes a buffer into Manchester encoding
+ * Calculates crc_fs value for the frame and sets the trailer accordingly
  *
- * @param   [out] buffer      The out buffer to decode from Manchester
- * @param   [in]  manchester  The input Manchester encoded buffer
- * @param   [in]  size        The number of DECODED BYTES expected from 
- *                              the manchester buffer (1/2 x size of manchester input buffer)
+ * @param   [in]   frame  The frame to apply CRC calculation to
  */
-static ERROR_CODE network_decode_manchester(uint8_t * buffer, uint8_t * manchester, size_t size)
+static void frame_crc_apply(frame_t * frame)
 {
-    #ifdef MANCHESTER_DBG
-    printBytesHex("MANCHESTER", manchester, size*2);
-    #endif
-
-    // zero the buffer
-    memset(buffer, 0, size);
-
+    frame->trailer.crc8_fcs = crc8_calculate((uint8_t *) frame->message, frame->header.length, 0);
+}
 
-    // decoding loop
-    for (unsigned int byteIdx = 0; byteIdx < size; byteIdx++)
-    {
-        uint8_t * bytePtr = &(buffer[byteIdx]);
+/**
+ * Validates that the crc_fs value for the frame is correct for the received data in the frame
+ *
+ * @param   [in]   frame  The frame to validate CRC on
+ * @return bool if crc value is valid
+ */
+static bool frame_crc_isValid(frame_t * frame)
+{
+    uint8_t messageResult = crc8_calculate((uint8_t *) frame->message, frame->header.length, 0);
+    return !crc8_calculate((uint8_t *) &frame->trailer, sizeof(frame_trailer_t), messageResult);
+}
 
-        for (unsigned int bitIdx = 0; bitIdx <8; bitIdx++)
-        {
-            unsigned int manchesterBitIdx = (bitIdx * 2) % 8;
 
-            unsigned int manchesterValue = (manchester[bitIdx > 3 ? byteIdx * 2 +1: byteIdx * 2] 
-                                                >> (6 - manchesterBitIdx)) & 0b11;
-            bool bitValue;  
-            if (manchesterValue == 0b01){
-                bitValue = true;
-            }
-            else if (manchesterValue == 0b10)
-            {
-                bitValue = false;
-            }
-            else {
-                THROW_ERROR(ERROR_CODE_INVALID_MANCHESTER_RECEIVED); //todo error code, invalid manchester
-            }
-            *bytePtr |= bitValue << (7 - bitIdx);
-        }
-    }
+#ifdef NETWORK_SNIFF
+_Static_assert(NETWORK_SNIFF_FRAME_MAX == MAX_FRAME_SIZE, "sniffed frames must hold any frame");
 
-    #ifdef MANCHESTER_DBG
-    printBytesHex("BUFFER", buffer, size);
-    #endif
-    RETURN_NO_ERROR();
+/**
+ * Hands every received frame to a sniffer before it is decoded, including
+ * those cut off by a collision and glitches too short to be a frame
+ *
+ * @param   [in]    callback    Called from network_service(), NULL to stop
+ */
+void network_rx_set_sniffer(network_sniff_callback_t callback)
+{
+    rx_sniffer = callback;
 }
 
-
-
 /**
- * Encodes a buffer into Manchester encoding
+ * Decodes a received record for the sniffer as far as its slots go and
+ * checks it the way network_rx_decode() would
  *
- * @param   [out]   manchester  The output Manchester encoded buffer (will be
- *                              twice the size of the input buffer)
- * @param   [in]    buffer      The input buffer to encode in Manchester
- * @param   [in]    size        The size of the input buffer
+ * @param   [in]    slots   The received slots of the frame
+ * @param   [in]    size    The number of bytes of slots
+ * @param   [in]    info    The times and status the record was committed with
  */
-static unsigned int
-network_encode_manchester(uint8_t * manchester, uint8_t * buffer, size_t size)
+static void network_rx_sniff(const uint8_t * slots, size_t size, const rx_record_info_t * info)
 {
-    #ifdef MANCHESTER_DBG
-    printBytesHex("BUFFER", buffer, size);
-    #endif
+    static network_sniff_frame_t sniffed;
+    static uint8_t fec_message[MAX_MESSAGE_SIZE];
+    linecode_decoder_t decoder;
+    unsigned int violations = 0;
+    size_t expected = sizeof(frame_header_t) + sizeof(frame_trailer_t);
+
+    sniffed.start_us = info->start_us;
+    sniffed.end_us = info->end_us;
+    sniffed.status = info->status;
+    sniffed.linecode = NETWORK_SNIFF_LINECODE_UNKNOWN;
+    sniffed.violations = 0;
+    sniffed.size = 0;
+
+    if (!linecode_decoder_init(&decoder, slots, size * 8))
+    {
+        sniffed.status |= NETWORK_SNIFF_PREAMBLE_ERROR;
+        rx_sniffer(&sniffed);
+        return;
+    }
+    sniffed.linecode = decoder.code;
+    sniffed.bytes[sniffed.size++] = linecode_preamble(decoder.code);
 
-    // zero the manchester buffer
-    memset(manchester, 0, size * 2);
+    // the header's length says how many bytes follow it
+    while (sniffed.size < expected &&
+           linecode_decode(&decoder, &sniffed.bytes[sniffed.size], 1, &violations))
+    {
+        if (++sniffed.size == sizeof(frame_header_t))
+        {
+            expected += ((frame_header_t *) sniffed.bytes)->length;
+        }
+    }
 
-    // encoding loop
-    for (unsigned int byteIdx = 0; byteIdx < size; byteIdx++)
+    sniffed.violations = violations;
+    if (violations)
     {
-        uint8_t inputByteValue = buffer[byteIdx];
-        uint8_t * manchesterBytePtr = &(manchester[byteIdx * 2]);
+        sniffed.status |= NETWORK_SNIFF_LINECODE_ERROR;
+    }
 
-        for (unsigned int bitIdx = 0; bitIdx < 8; bitIdx++)
-        {
-            bool inputBitValue = (inputByteValue >> (7 - bitIdx)) & 0x01;
+    if (sniffed.size < expected || linecode_decoder_remaining(&decoder) >= RX_TRAILING_SLOTS_MAX)
+    {
+        sniffed.status |= NETWORK_SNIFF_LENGTH_ERROR;
+        rx_sniffer(&sniffed);
+        return;
+    }
 
-            unsigned int manchesterBitIdx = (bitIdx * 2) % 8;
-            unsigned int manchesterBitsValue = inputBitValue ? 0b01 : 0b10;
+    frame_t frame = { .header = *(frame_header_t *) sniffed.bytes };
+    frame.message = (char *) sniffed.bytes + sizeof(frame_header_t);
+    frame.trailer = *(frame_trailer_t *) (frame.message + frame.header.length);
 
-            manchesterBytePtr[bitIdx > 3 ? 1 : 0] |= manchesterBitsValue << (6 - manchesterBitIdx);
+    // the crc covers the message once the fec has corrected it
+    if (frame.header.crc_flag & FRAME_FLAG_FEC)
+    {
+        unsigned int corrected_bits = 0;
+        if (frame.header.length % 2 ||
+            !hamming84_decode((uint8_t *) frame.message, frame.header.length / 2, fec_message, &corrected_bits))
+        {
+            sniffed.status |= NETWORK_SNIFF_CRC_ERROR;
+            rx_sniffer(&sniffed);
+            return;
         }
+        frame.message = (char *) fec_message;
+        frame.header.length /= 2;
+        sniffed.status |= corrected_bits > 0 ? NETWORK_SNIFF_FEC_CORRECTED : 0;
     }
 
-    #ifdef MANCHESTER_DBG
-    printBytesHex("MANCHESTER", manchester, size*2);
-    #endif
+    bool crc_ok = (frame.header.crc_flag & FRAME_FLAG_CRC_MASK) == CRC_FLAG_ON ?
+                  frame_crc_isValid(&frame) : frame.trailer.crc8_fcs == CRC_OFF_TRAILER_VALUE;
+    sniffed.status |= crc_ok ? NETWORK_SNIFF_CRC_OK : NETWORK_SNIFF_CRC_ERROR;
 
-    return size * 2;
+    rx_sniffer(&sniffed);
 }
+#endif
 
+#ifdef NETWORK_BERT
 /**
- * Calculates crc_fs value for the frame and sets the trailer accordingly
+ * Hands the slots of every received frame to a callback in place of decoding
+ * them, so a bit error rate test sees every frame however damaged
  *
- * @param   [in]   frame  The frame to apply CRC calculation to
+ * @param   [in]    callback    Called from network_service(), NULL to decode again
  */
-static void frame_crc_apply(frame_t * frame)
+void network_rx_set_raw(network_raw_callback_t callback)
 {
-    frame->trailer.crc8_fcs = crc8_calculate(frame->message, frame->header.length, 0);
+    rx_raw = callback;
 }
+#endif
+
+#ifdef NETWORK_BENCH
+_Static_assert(NETWORK_BENCH_SLOTS_SIZE == MAX_FRAME_SIZE_MANCHESTER, "bench slots must hold any frame");
 
 /**
- * Validates that the crc_fs value for the frame is correct for the received data in the frame
+ * Builds and encodes a frame the way a message queued by network_tx() is
+ * sent, without queueing it
  *
- * @param   [in]   frame  The frame to validate CRC on
- * @return bool if crc value is valid
+ * @param   [out]   slots   Buffer of NETWORK_BENCH_SLOTS_SIZE to encode the frame into
+ * @param   [in]    dest    The destination address of the message
+ * @param   [in]    port    The port of the message
+ * @param   [in]    buf     The message, one byte shorter than the largest with a port
+ *
+ * @return  number of bytes filled into the slots buffer
  */
-static bool frame_crc_isValid(frame_t * frame)
+unsigned int network_bench_build_frame(uint8_t * slots, uint8_t dest, uint8_t port, netbuf_t * buf)
 {
-    uint8_t messageResult = crc8_calculate(frame->message, frame->header.length, 0);
-    return !crc8_calculate((uint8_t *) &frame->trailer, sizeof(frame_trailer_t), messageResult);
+    queue_node_t node = {
+        .destination = dest,
+        .buf = buf,
+        .length = buf->length,
+        .prefix = port,
+        .prefix_size = port != NETWORK_PORT_DEFAULT ? 1 : 0,
+        .crc_flag = CRC_FLAG_ON | (port != NETWORK_PORT_DEFAULT ? FRAME_FLAG_PORT : 0)
+    };
+
+    node_crc_apply(&node);
+    return network_encode_node(slots, &node);
 }
 
 
 /**
- * Calculates an 8-bit CRC value for a given buffer of bytes
+ * Decodes a frame and delivers it to its port the way network_service() does
  *
- * @param   [in]    buffer      The input buffer to calcualte CRC from
- * @param   [in]    size        The size of the input buffer
- * @param   [in]    initialValue initial value for the remainder byte.
- *           Can be used to save state between multiple calls, or use a non-zero initial value, as some protocols do
- * @return  the result of the CRC calculation on the buffer
+ * @param   [in]    slots   The slots of the frame
+ * @param   [in]    size    The number of bytes of slots
  */
-static uint8_t crc8_calculate(uint8_t * buffer, unsigned int size, uint8_t initialValue)
+void network_bench_decode_frame(const uint8_t * slots, size_t size)
 {
-    uint8_t result = initialValue;
-    for (unsigned int byteIdx = 0; byteIdx < size; ++byteIdx)
-    {
-        uint8_t input = buffer[byteIdx];
-        for (unsigned short bitIdx = 0; bitIdx < 8; ++bitIdx)
-        {
-            /*
-            * instead of xoring each bit of the result specific to the polynomial with the input
-            * we can xor the entire byte with the polynmomial bits if the input XOR MSB of result is a 1
-            * xor-ing with 0 causes no change and xor-ing with 1 causes bit toggle
-            * therefore only the bits with a 1 in the polynomial (corresponding to xor in the circuit in class)
-            * will be toggled, and only when the input bit is a 1 and would have toggled the bits 
-            */
-            bool invert = ((input >> (7 - bitIdx)) & 0x01) ^ (result >> 7);
-
-            //shift, LSB of result will be 0, and will take the value of invert since LSB of CRC_POLYNOMIAL is always a 1
-            result = result << 1;
-
-            if (invert)
-            {
-                result ^= CRC_POLYNOMIAL;
-            }
-        }
-    }
-    return result;
+    network_rx_decode(slots, size);
 }
+#endif
+
 
 /**
  * IRQ Handler for hb_timer
@@ -829,26 +2950,35 @@ static uint8_t crc8_calculate(uint8_t * buffer, unsigned int size, uint8_t initi
 void TIM4_IRQHandler()
 
 {
-    static int byteIdx = 0; // A value 0 - 511
-    static int bitIdx = 0; // A value 0 - 7
+    static unsigned int byteIdx = 0; // A value 0 - 511
+    static unsigned int bitIdx = 0; // A value 0 - 7
 
     if ( TIM4->SR & TIM_SR_UIF )
     {
         // clear update interrupt
         TIM4->SR &= ~( TIM_SR_UIF );
 
-        // Get the message index of the circular buffer
-        int msg_idx = ( tx_queue_pop_idx + 1) % TX_QUEUE_SIZE;
+        // Get the frame selected by network_start_tx()
+        queue_node_t * node = tx_current;
 
         // Get the current state
         STATE_TYPE state = state_get();
 
-        if(state != COLLISION)
+        if (node == NULL)
+        {
+            // Nothing was selected, this update is spurious
+            hb_timer_stop();
+        }
+        else if(state != COLLISION)
         {
             hb_timer_reset();
             hb_timer_start();
 
-            if( byteIdx == tx_queue[msg_idx].size)
+            #ifdef NETWORK_PHY_IMPAIR
+                hb_timer_set_timeout(phy_impair_tx_period(half_bit_period_us));
+            #endif
+
+            if( byteIdx == tx_slots_size)
             {
                 // The transmission of the message is complete
 
@@ -857,9 +2987,18 @@ void TIM4_IRQHandler()
                 // Set the byteIdx and bitIdx to default
                 byteIdx = 0;
                 bitIdx = 0;
+                tx_current = NULL;
+
+                if (node == tx_control_node)
+                {
+                    // clear the opcode unless a newer one was raised meanwhile
+                    if (tx_control_opcode == tx_control_sending_opcode)
+                    {
+                        tx_control_opcode = CONTROL_OPCODE_NONE;
+                    }
+                }
                 // Should always return True because when we call this method there is always a message present
-                bool status = network_tx_queue_pop();
-                if (!status)
+                else if (!network_tx_queue_release(node))
                 {
                     ERROR_HANDLE_NON_FATAL(ERROR_CODE_NETWORK_MSG_POP_FAILURE)
                 }
@@ -870,7 +3009,7 @@ void TIM4_IRQHandler()
             } else
             {
                 // Get the next bit from the message buffer
-                bool bit = tx_queue[msg_idx].buffer[byteIdx] >> ( 7 - bitIdx) & 0b01;
+                bool bit = tx_slots[byteIdx] >> ( 7 - bitIdx) & 0b01;
 
                 if(bit == 1)
                 {
@@ -900,9 +3039,16 @@ void TIM4_IRQHandler()
             // Stop the timer we are in COLLISION State
             hb_timer_stop();
 
-            // Reset Transmission of the data
+            // Reset Transmission of the data, the frame is reselected after backoff
             byteIdx = 0;
             bitIdx = 0;
+            tx_current = NULL;
+
+            // don't retry a frame that went stale while we were colliding
+            if (node != tx_control_node && network_tx_node_is_expired(node, systime_ms()))
+            {
+                network_tx_queue_expire(node);
+            }
 
             // Output a 1 to PC11
             GPIOC->ODR |= GPIO_ODR_OD11;
@@ -3,8 +3,11 @@
 
 
 #include <stddef.h>
+#include <stdint.h>
 #include <stdbool.h>
 #include "error.h"
+#include "linecode.h"
+#include "netbuf.h"
 
 
 typedef struct
@@ -29,20 +32,184 @@ typedef struct
     frame_trailer_t trailer;
 } frame_t;
 
+/**
+ * A received message, data is null terminated and valid until the callback
+ * returns or the message is popped or released
+ */
+typedef struct
+{
+    uint8_t source;
+    uint8_t destination;
+    uint8_t port;
+    uint8_t length;
+    uint8_t flags;
+    const uint8_t * data;
+} network_message_t;
+
+#define NETWORK_MESSAGE_COMPRESSED  (0x01)
+#define NETWORK_MESSAGE_FEC         (0x02)
+#define NETWORK_MESSAGE_CORRECTED   (0x04)  // the fec corrected bit errors in it
+
+typedef void (* network_port_callback_t)(const network_message_t * message);
+
+#define NETWORK_PORT_DEFAULT        (0)
+#define NETWORK_PORT_UNKNOWN        (0x100)
+#define NETWORK_PORT_QUEUE_DEPTH    (4)     // messages a port without a callback holds
+
+/**
+ * Bytes of message data compression was tried on and the bytes sent for them
+ */
+typedef struct
+{
+    uint32_t raw_bytes;
+    uint32_t sent_bytes;
+} network_compress_stats_t;
+
+/**
+ * Error corrected frames received, bits corrected in them and frames with
+ * too many errors to correct
+ */
+typedef struct
+{
+    uint32_t frames;
+    uint32_t corrected_bits;
+    uint32_t uncorrectable;
+} network_fec_stats_t;
+
+/**
+ * Transmit traffic classes in priority order
+ */
+typedef enum
+{
+    NETWORK_TX_CLASS_CONTROL,
+    NETWORK_TX_CLASS_NORMAL,
+    NETWORK_TX_CLASS_BULK,
+    NETWORK_TX_CLASS_COUNT
+} network_tx_class_t;
+
+/**
+ * Disciplines for choosing between transmit traffic classes
+ */
+typedef enum
+{
+    NETWORK_TX_SCHED_STRICT,
+    NETWORK_TX_SCHED_WEIGHTED,
+    NETWORK_TX_SCHED_COUNT
+} network_tx_sched_t;
+
+/**
+ * Optional parameters of a transmission
+ */
+typedef struct
+{
+    network_tx_class_t tx_class;
+    uint16_t ttl_ms;    // NETWORK_TX_NO_TTL to never expire
+    uint8_t port;
+    bool fec;           // hamming encode the message, halving the bytes per frame
+    bool uncoded;       // never compress or error correct the message, for test patterns
+} network_tx_params_t;
+
+#define NETWORK_TX_NO_TTL           (0)
+
+/**
+ * Bounds of the half bit period, see network_set_half_bit_period()
+ */
+#define NETWORK_HALF_BIT_MIN_US     (20)
+#define NETWORK_HALF_BIT_MAX_US     (20000)
+
+/**
+ * A segment of a message passed to network_txv()
+ */
+typedef struct
+{
+    const void * base;
+    size_t length;
+} network_iovec_t;
+
+/**
+ * Identifies a message passed to network_tx_ex()
+ */
+typedef uint16_t network_tx_handle_t;
+
+#define NETWORK_TX_INVALID_HANDLE   (0)
+
+/**
+ * Completion status of a message passed to network_tx_ex()
+ */
+typedef enum
+{
+    NETWORK_TX_STATUS_UNKNOWN,
+    NETWORK_TX_STATUS_PENDING,
+    NETWORK_TX_STATUS_SENT,
+    NETWORK_TX_STATUS_EXPIRED,
+    NETWORK_TX_STATUS_DROPPED
+} network_tx_status_t;
+
+/**
+ * Times in systime_us() of the last frame of a sent message
+ */
+typedef struct
+{
+    uint32_t queued_us;     // the frame was queued
+    uint32_t first_us;      // the frame first took the line
+    uint32_t start_us;      // the attempt that got through took the line
+    uint32_t end_us;        // the last half bit went out
+    uint8_t attempts;       // one more than the collisions backed off from
+} network_tx_timing_t;
+
+/**
+ * Queueing delay (enqueue to start of transmission) of a traffic class
+ */
+typedef struct
+{
+    uint32_t frames;
+    uint32_t delay_total_ms;
+    uint32_t delay_max_ms;
+} network_tx_class_stats_t;
+
 
 uint8_t get_local_machine_address();
 ERROR_CODE set_local_machine_address(uint8_t newAddress);
 
 ERROR_CODE network_init();
 ERROR_CODE network_tx(uint8_t dest, uint8_t * buffer, size_t size);
+ERROR_CODE network_tx_class(uint8_t dest, network_tx_class_t tx_class, uint8_t * buffer, size_t size);
+ERROR_CODE network_tx_ex(uint8_t dest, uint8_t * buffer, size_t size,
+                         const network_tx_params_t * params, network_tx_handle_t * handle);
+ERROR_CODE network_txv(uint8_t dest, const network_iovec_t * iov, unsigned int iov_count,
+                       const network_tx_params_t * params, network_tx_handle_t * handle);
+ERROR_CODE network_tx_buf(uint8_t dest, netbuf_t * buf,
+                          const network_tx_params_t * params, network_tx_handle_t * handle);
+network_tx_status_t network_tx_status(network_tx_handle_t handle);
+bool network_tx_timing(network_tx_handle_t handle, network_tx_timing_t * timing);
+uint32_t network_tx_expired_count();
 bool network_rx(uint8_t * messageBuf, uint8_t * sourceAddr, uint8_t * destinationAddr);
+void network_service();
+void network_tx_set_compression(bool enabled);
+void network_tx_compress_stats(network_compress_stats_t * stats);
+void network_tx_set_fec(bool enabled);
+void network_rx_fec_stats(network_fec_stats_t * stats);
+ERROR_CODE network_tx_set_linecode(linecode_t code);
+ERROR_CODE network_set_half_bit_period(uint16_t us);
+uint16_t network_get_half_bit_period();
+ERROR_CODE network_port_open(uint8_t port, network_port_callback_t callback);
+ERROR_CODE network_port_close(uint8_t port);
+bool network_port_rx(uint8_t port, uint8_t * messageBuf, size_t * size, uint8_t * sourceAddr, uint8_t * destAddr);
+bool network_port_borrow(uint8_t port, const network_message_t ** message);
+unsigned int network_port_borrow_batch(uint8_t port, const network_message_t ** messages, unsigned int max);
+void network_port_release(uint8_t port, unsigned int count);
+uint32_t network_port_dropped_count(uint16_t port);
 ERROR_CODE network_start_tx();
+bool network_tx_dest_is_paused(uint8_t dest);
+ERROR_CODE network_tx_set_sched(network_tx_sched_t sched);
+ERROR_CODE network_tx_set_class_weight(network_tx_class_t tx_class, uint8_t weight);
+ERROR_CODE network_tx_class_stats(network_tx_class_t tx_class, network_tx_class_stats_t * stats);
+void network_tx_class_stats_reset();
 
 bool network_tx_queue_is_full();
+bool network_tx_class_is_full(network_tx_class_t tx_class);
 bool network_tx_queue_is_empty();
 unsigned int network_tx_queue_count();
-static bool network_tx_queue_push(uint8_t * buffer, size_t size);
-static bool network_tx_queue_pop();
 
 bool network_rx_queue_is_full();
 bool network_rx_queue_is_empty();
@@ -50,17 +217,66 @@ unsigned int network_rx_queue_count();
 void network_rx_queue_reset();
 bool network_rx_queue_push_bit(bool bit);
 bool network_rx_queue_get_last_bit();
+bool network_rx_filter_accepts(uint8_t dest);
+ERROR_CODE network_rx_group_join(uint8_t group);
+ERROR_CODE network_rx_group_leave(uint8_t group);
+void network_rx_set_promiscuous(bool enable);
+bool network_rx_is_promiscuous();
+uint32_t network_rx_filtered_count();
 bool network_rx_queue_push();
+void network_rx_queue_collide();
 bool network_rx_queue_pop();
 
-static unsigned int network_encode_manchester(uint8_t * manchester, uint8_t * buffer, size_t size);
-static unsigned int network_encode_frame_manchester( uint8_t * manchester, frame_t * frame);
-static ERROR_CODE network_decode_manchester(uint8_t * buffer, uint8_t * manchester, size_t size);
-static ERROR_CODE network_decode_manchester_frame( frame_t * frame, uint8_t * manchester);
-static ERROR_CODE network_decode_manchester_frame_message_trailer( frame_t * frame, uint8_t * manchester);
-static ERROR_CODE network_decode_manchester_header( frame_header_t * header, uint8_t * manchester);
+#ifdef NETWORK_SNIFF
+// the bytes of the largest frame, preamble to trailer
+#define NETWORK_SNIFF_FRAME_MAX     (255 + sizeof(frame_header_t) + sizeof(frame_trailer_t))
+
+// status of a sniffed frame
+#define NETWORK_SNIFF_CRC_OK            (0x01)
+#define NETWORK_SNIFF_CRC_ERROR         (0x02)  // or the fec couldn't correct it
+#define NETWORK_SNIFF_LINECODE_ERROR    (0x04)  // code violations, e.g. invalid Manchester
+#define NETWORK_SNIFF_PREAMBLE_ERROR    (0x08)
+#define NETWORK_SNIFF_LENGTH_ERROR      (0x10)  // ended before or well after its length
+#define NETWORK_SNIFF_COLLISION         (0x20)  // cut off by the line held low
+#define NETWORK_SNIFF_FEC_CORRECTED     (0x40)
+
+#define NETWORK_SNIFF_LINECODE_UNKNOWN  (0xFF)
+
+/**
+ * Every frame received, decoded from its slots as far as it goes
+ */
+typedef struct
+{
+    uint32_t start_us;      // systime_us() of its first edge
+    uint32_t end_us;        // and of the line idling or colliding after it
+    uint8_t status;
+    uint8_t linecode;       // a linecode_t, or NETWORK_SNIFF_LINECODE_UNKNOWN
+    uint16_t violations;
+    uint16_t size;
+    uint8_t bytes[NETWORK_SNIFF_FRAME_MAX];
+} network_sniff_frame_t;
+
+typedef void (* network_sniff_callback_t)(const network_sniff_frame_t * frame);
+
+void network_rx_set_sniffer(network_sniff_callback_t callback);
+#endif
+
+#ifdef NETWORK_BERT
+typedef void (* network_raw_callback_t)(const uint8_t * slots, size_t size);
+
+void network_rx_set_raw(network_raw_callback_t callback);
+#endif
+
+#ifdef NETWORK_BENCH
+// a Manchester encoded frame of the largest message, see network_bench.h
+#define NETWORK_BENCH_SLOTS_SIZE    (2 * (255 + sizeof(frame_header_t) + sizeof(frame_trailer_t)))
+
+unsigned int network_bench_build_frame(uint8_t * slots, uint8_t dest, uint8_t port, netbuf_t * buf);
+void network_bench_decode_frame(const uint8_t * slots, size_t size);
+#endif
+
+static unsigned int network_encode_frame(uint8_t * slots, frame_t * frame);
 
-static uint8_t crc8_calculate(uint8_t * buffer, unsigned int size, uint8_t initialValue);
 static bool frame_crc_isValid(frame_t * frame);
 static void frame_crc_apply(frame_t * frame);
 
@@ -0,0 +1,307 @@
+/* --------------------------------- Header --------------------------------- */
+
+
+/**
+ * @file    network_bench.c
+ * @brief   Contains the microbenchmarks of the network stack's hot paths
+ *
+ * Times the line codes, the CRC, building a frame the way network_tx()
+ * queues and sends it, decoding a frame the way network_service() does and
+ * the byte ring, for payloads from a byte to the largest message. Decoded
+ * frames are checked as they are delivered.
+ */
+
+
+/* -------------------------------- Includes -------------------------------- */
+
+
+# include <string.h>
+
+# include "network_bench.h"
+# include "network.h"
+# include "linecode.h"
+# include "crc8.h"
+# include "ring.h"
+# include "netbuf.h"
+# include "microbench.h"
+
+
+# ifdef NETWORK_BENCH
+
+
+/* --------------------------------- Defines -------------------------------- */
+
+
+/**
+ * Every case is timed over this many bytes a sample, so small payloads are
+ * batched up
+ */
+# define NETWORK_BENCH_SAMPLE_BYTES     ( 256U )
+
+# define NETWORK_BENCH_RING_SIZE        ( 256U )
+
+
+/* ---------------------------------- Types --------------------------------- */
+
+
+/**
+ * State shared by the cases
+ */
+typedef struct
+{
+    size_t size;
+    linecode_t code;
+    netbuf_t * buf;                         // the payload
+    uint8_t slots[NETWORK_BENCH_SLOTS_SIZE];
+    size_t slots_size;
+    uint8_t decoded[NETWORK_BENCH_RING_SIZE];
+    ring_t ring;
+    uint8_t ring_storage[NETWORK_BENCH_RING_SIZE];
+} network_bench_t;
+
+
+/**
+ * A timed operation
+ */
+typedef struct
+{
+    const char * name;
+    microbench_fn_t fn;
+    void ( * prepare )( network_bench_t * bench );
+} network_bench_case_t;
+
+
+/* ----------------------------- Static Globals ----------------------------- */
+
+
+// largest message that still fits a frame along with its port
+static const size_t network_bench_sizes[] = { 1, 16, 64, 128, 254 };
+
+static network_bench_t network_bench;
+
+static volatile uint8_t network_bench_sink;
+static uint32_t network_bench_delivered;
+static uint32_t network_bench_mismatched;
+
+
+/* ---------------------------- Static Functions ---------------------------- */
+
+
+/**
+ * Counts frames delivered to the bench port and checks their payload
+ */
+static void network_bench_deliver( const network_message_t * message )
+{
+    const network_bench_t * bench = &network_bench;
+
+    network_bench_delivered++;
+    if ( message->length != bench->size || memcmp( message->data, bench->buf->data, bench->size ) != 0 )
+    {
+        network_bench_mismatched++;
+    }
+}
+
+
+/**
+ * Prepares the input of a case, the payload is always ready
+ */
+static void network_bench_prepare_none( network_bench_t * bench )
+{
+    ( void ) bench;
+}
+
+
+static void network_bench_prepare_slots( network_bench_t * bench )
+{
+    linecode_encoder_t encoder;
+
+    linecode_encoder_init( &encoder, bench->code, bench->slots );
+    linecode_encode( &encoder, bench->buf->data, bench->size );
+    bench->slots_size = linecode_encoder_finish( &encoder );
+}
+
+
+static void network_bench_prepare_frame( network_bench_t * bench )
+{
+    bench->slots_size = network_bench_build_frame( bench->slots, 0, NETWORK_BENCH_PORT, bench->buf );
+}
+
+
+/**
+ * The cases, each handles one payload
+ */
+static void network_bench_crc8( void * context )
+{
+    network_bench_t * bench = context;
+    network_bench_sink = crc8_calculate( bench->buf->data, bench->size, 0 );
+}
+
+
+static void network_bench_encode( void * context )
+{
+    network_bench_t * bench = context;
+    linecode_encoder_t encoder;
+
+    linecode_encoder_init( &encoder, bench->code, bench->slots );
+    linecode_encode( &encoder, bench->buf->data, bench->size );
+    bench->slots_size = linecode_encoder_finish( &encoder );
+}
+
+
+static void network_bench_decode( void * context )
+{
+    network_bench_t * bench = context;
+    linecode_decoder_t decoder;
+    unsigned int violations = 0;
+
+    linecode_decoder_init( &decoder, bench->slots, bench->slots_size * 8 );
+    linecode_decode( &decoder, bench->decoded, bench->size, &violations );
+    network_bench_sink = bench->decoded[0] + violations;
+}
+
+
+static void network_bench_frame_build( void * context )
+{
+    network_bench_t * bench = context;
+    bench->slots_size = network_bench_build_frame( bench->slots, 0, NETWORK_BENCH_PORT, bench->buf );
+}
+
+
+static void network_bench_frame_decode( void * context )
+{
+    network_bench_t * bench = context;
+    network_bench_decode_frame( bench->slots, bench->slots_size );
+}
+
+
+static void network_bench_ring_bytes( void * context )
+{
+    network_bench_t * bench = context;
+    uint8_t value = 0;
+
+    for ( size_t i = 0; i < bench->size; i++ )
+    {
+        ring_push( &bench->ring, bench->buf->data[i] );
+    }
+    for ( size_t i = 0; i < bench->size; i++ )
+    {
+        ring_pop( &bench->ring, &value );
+    }
+    network_bench_sink = value;
+}
+
+
+static void network_bench_ring_bulk( void * context )
+{
+    network_bench_t * bench = context;
+
+    ring_write( &bench->ring, bench->buf->data, bench->size );
+    ring_read( &bench->ring, bench->decoded, bench->size );
+    network_bench_sink = bench->decoded[0];
+}
+
+
+/* ------------------------------- Variables -------------------------------- */
+
+
+static const network_bench_case_t network_bench_cases[] =
+{
+    { "crc8",               network_bench_crc8,             network_bench_prepare_none },
+    { "encode_manchester",  network_bench_encode,           network_bench_prepare_none },
+    { "decode_manchester",  network_bench_decode,           network_bench_prepare_slots },
+    { "encode_stuffed",     network_bench_encode,           network_bench_prepare_none },
+    { "decode_stuffed",     network_bench_decode,           network_bench_prepare_slots },
+    { "frame_build",        network_bench_frame_build,      network_bench_prepare_none },
+    { "frame_decode",       network_bench_frame_decode,     network_bench_prepare_frame },
+    { "ring_bytes",         network_bench_ring_bytes,       network_bench_prepare_none },
+    { "ring_bulk",          network_bench_ring_bulk,        network_bench_prepare_none },
+};
+
+
+/* ------------------------------- Functions -------------------------------- */
+
+
+/**
+ * Times every case at every payload size and prints the results, see
+ * microbench_report()
+ *
+ * @param   [in]    samples     Samples of every case, up to MICROBENCH_SAMPLES_MAX
+ *
+ * @return  Error code
+ */
+ERROR_CODE network_bench_run( unsigned int samples )
+{
+    network_bench_t * bench = &network_bench;
+    ERROR_CODE error = ERROR_CODE_NO_ERROR;
+
+    bench->buf = netbuf_alloc( );
+    if ( bench->buf == NULL )
+    {
+        THROW_ERROR( ERROR_CODE_NETWORK_BUF_POOL_EMPTY );
+    }
+    for ( size_t i = 0; i < NETWORK_BENCH_RING_SIZE; i++ )
+    {
+        bench->buf->data[i] = ( uint8_t ) ( i * 151 + 17 );
+    }
+    ring_init( &bench->ring, bench->ring_storage, NETWORK_BENCH_RING_SIZE );
+
+    error = network_port_open( NETWORK_BENCH_PORT, network_bench_deliver );
+    if ( error != ERROR_CODE_NO_ERROR )
+    {
+        netbuf_free( bench->buf );
+        return error;
+    }
+
+    network_bench_delivered = 0;
+    network_bench_mismatched = 0;
+    uint32_t expected = 0;
+
+    microbench_init( );
+    microbench_report_header( );
+
+    for ( size_t c = 0; c < sizeof( network_bench_cases ) / sizeof( network_bench_cases[0] ) && !error; c++ )
+    {
+        const network_bench_case_t * test = &network_bench_cases[c];
+
+        for ( size_t s = 0; s < sizeof( network_bench_sizes ) / sizeof( network_bench_sizes[0] ); s++ )
+        {
+            unsigned int batch = NETWORK_BENCH_SAMPLE_BYTES / network_bench_sizes[s];
+            microbench_result_t result;
+
+            bench->size = network_bench_sizes[s];
+            bench->buf->length = bench->size;
+            bench->code = strstr( test->name, "stuffed" ) ? LINECODE_STUFFED : LINECODE_MANCHESTER;
+            test->prepare( bench );
+
+            if ( !microbench_measure( test->fn, bench, samples, batch, &result ) )
+            {
+                error = ERROR_CODE_NETWORK_BENCH_FAILED;
+                break;
+            }
+            microbench_report( test->name, bench->size, &result );
+
+            // one warm up call and a batch per sample
+            if ( test->fn == network_bench_frame_decode )
+            {
+                expected += 1 + samples * batch;
+            }
+        }
+    }
+
+    network_port_close( NETWORK_BENCH_PORT );
+    netbuf_free( bench->buf );
+
+    ELEVATE_IF_ERROR( error );
+    if ( network_bench_delivered != expected || network_bench_mismatched != 0 )
+    {
+        THROW_ERROR( ERROR_CODE_NETWORK_BENCH_FAILED );
+    }
+
+    RETURN_NO_ERROR();
+}
+
+
+# endif // NETWORK_BENCH
+
+
+/* -------------------------------------------------------------------------- */
@@ -0,0 +1,49 @@
+/* --------------------------------- Header --------------------------------- */
+
+
+/**
+ * @file    network_bench.h
+ * @brief   Contains the microbenchmarks of the network stack's hot paths
+ *
+ * Only built with NETWORK_BENCH defined, which the host build always does
+ * and the firmware does with the CE4951_BENCH option. On the target the
+ * suite runs from the /bench command and is best run on an idle bus, since
+ * the bus interrupts land in the samples.
+ */
+
+
+/* ------------------------------ Header Guard ------------------------------ */
+
+
+# ifndef DRIVER_NETWORK_BENCH_H
+# define DRIVER_NETWORK_BENCH_H
+
+
+/* -------------------------------- Includes -------------------------------- */
+
+
+# include "error.h"
+
+
+/* --------------------------------- Defines -------------------------------- */
+
+
+/**
+ * The port decoded frames are delivered to while the suite runs
+ */
+# define NETWORK_BENCH_PORT     ( 0xBE )
+
+
+/* ------------------------------- Functions -------------------------------- */
+
+
+ERROR_CODE network_bench_run( unsigned int samples );
+
+
+/* --------------------------------- Footer --------------------------------- */
+
+
+# endif // DRIVER_NETWORK_BENCH_H
+
+
+/* -------------------------------------------------------------------------- */
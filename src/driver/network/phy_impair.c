@@ -0,0 +1,180 @@
+/* --------------------------------- Header --------------------------------- */
+
+
+/**
+ * @file    phy_impair.c
+ * @brief   Contains channel impairments injected at the line interface for
+ *          robustness testing
+ *
+ * Received slots, the line levels pushed into the receive queue, are
+ * inverted at random, either alone or in bursts that follow a two state
+ * Gilbert-Elliott model. Transmitted edges are displaced by a uniform jitter
+ * around their nominal times and the whole transmit clock can be skewed,
+ * which covers the skew between two boards since the receiver's timing is
+ * relative to its own clock.
+ *
+ * Only the interrupts call the hooks, and they share a priority, so the
+ * generator needs no locking. Configuration is swapped in with interrupts
+ * masked.
+ */
+
+
+/* -------------------------------- Includes -------------------------------- */
+
+
+# include "phy_impair.h"
+# include "critical.h"
+
+
+/* --------------------------------- Defines -------------------------------- */
+
+
+# define PPM    ( 1000000UL )
+
+
+/* ---------------------------- Global Variables ---------------------------- */
+
+
+static phy_impair_config_t phy_impair_config;
+static phy_impair_stats_t phy_impair_counts;
+
+static uint32_t phy_impair_state = 1;   // xorshift32 state, never zero
+static bool phy_impair_in_burst;
+static int32_t phy_impair_displacement; // of the last transmitted edge, in us
+
+
+/* ---------------------------- Static Functions ---------------------------- */
+
+
+/**
+ * Draws the next number of an xorshift32 generator
+ */
+static uint32_t phy_impair_random( void )
+{
+    phy_impair_state ^= phy_impair_state << 13;
+    phy_impair_state ^= phy_impair_state >> 17;
+    phy_impair_state ^= phy_impair_state << 5;
+    return phy_impair_state;
+}
+
+
+/**
+ * Draws an event with a probability in parts per million
+ */
+static bool phy_impair_chance( uint32_t ppm )
+{
+    return ppm && ( ( ( uint64_t ) phy_impair_random( ) * PPM ) >> 32 ) < ppm;
+}
+
+
+/* ------------------------------- Functions -------------------------------- */
+
+
+/**
+ * Sets the impairments and restarts the generator from their seed
+ *
+ * @param   [in]    config  The impairments, all zero for a clean channel
+ */
+void phy_impair_configure( const phy_impair_config_t * config )
+{
+    uint32_t primask = critical_enter( );
+
+    phy_impair_config = *config;
+    phy_impair_state = config->seed ? config->seed : 1;
+    phy_impair_in_burst = false;
+    phy_impair_displacement = 0;
+    phy_impair_counts = ( phy_impair_stats_t ) { 0 };
+
+    critical_exit( primask );
+}
+
+
+/**
+ * Gets the impairments in effect
+ */
+void phy_impair_get_config( phy_impair_config_t * config )
+{
+    *config = phy_impair_config;
+}
+
+
+/**
+ * Gets the counts of injected impairments since the last configuration
+ */
+void phy_impair_stats( phy_impair_stats_t * stats )
+{
+    uint32_t primask = critical_enter( );
+    *stats = phy_impair_counts;
+    critical_exit( primask );
+}
+
+
+/**
+ * Passes a received slot through the channel
+ *
+ * @param   [in]    slot    The level sampled from the line
+ *
+ * @return  The level the receiver sees
+ */
+bool phy_impair_rx_slot( bool slot )
+{
+    bool flip;
+
+    phy_impair_counts.slots++;
+
+    if ( phy_impair_in_burst )
+    {
+        // bursts last burst_length slots on average
+        phy_impair_in_burst = phy_impair_config.burst_length > 1 &&
+                              !phy_impair_chance( PPM / phy_impair_config.burst_length );
+    }
+    else if ( phy_impair_chance( phy_impair_config.burst_start_ppm ) )
+    {
+        phy_impair_in_burst = true;
+        phy_impair_counts.bursts++;
+    }
+
+    if ( phy_impair_in_burst )
+    {
+        flip = phy_impair_random( ) & 0x80000000UL;
+    }
+    else
+    {
+        flip = phy_impair_chance( phy_impair_config.bit_flip_ppm );
+    }
+
+    phy_impair_counts.flips += flip;
+
+    return slot ^ flip;
+}
+
+
+/**
+ * Times the next transmitted half bit
+ *
+ * @param   [in]    us  The nominal half bit period
+ *
+ * @return  The period to the next edge, skewed and moved by the jitter
+ */
+uint16_t phy_impair_tx_period( uint16_t us )
+{
+    int32_t period = us + ( int32_t ) us * phy_impair_config.skew_ppm / ( int32_t ) PPM;
+
+    phy_impair_counts.edges++;
+
+    if ( phy_impair_config.jitter_us )
+    {
+        // every edge is displaced on its own, so the period spans the
+        // difference between two displacements
+        uint32_t span = 2U * phy_impair_config.jitter_us + 1U;
+        int32_t displacement = ( int32_t ) ( phy_impair_random( ) % span ) - phy_impair_config.jitter_us;
+
+        period += displacement - phy_impair_displacement;
+        phy_impair_displacement = displacement;
+    }
+
+    return period < 1 ? 1 : ( uint16_t ) period;
+}
+
+
+/* -------------------------------------------------------------------------- */
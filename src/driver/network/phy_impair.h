@@ -0,0 +1,76 @@
+/* --------------------------------- Header --------------------------------- */
+
+
+/**
+ * @file    phy_impair.h
+ * @brief   Contains channel impairments injected at the line interface for
+ *          robustness testing
+ *
+ * The hooks into the network driver are only built with NETWORK_PHY_IMPAIR
+ * defined, which the host build always does and the firmware does with the
+ * CE4951_PHY_IMPAIR option. Everything is off until phy_impair_configure()
+ * is called.
+ */
+
+
+/* ------------------------------ Header Guard ------------------------------ */
+
+
+# ifndef DRIVER_PHY_IMPAIR_H
+# define DRIVER_PHY_IMPAIR_H
+
+
+/* -------------------------------- Includes -------------------------------- */
+
+
+# include <stdint.h>
+# include <stdbool.h>
+
+
+/* ---------------------------------- Types --------------------------------- */
+
+
+/**
+ * Impairments of the channel, probabilities in parts per million
+ */
+typedef struct
+{
+    uint32_t seed;              // the same seed repeats the same impairments
+    uint32_t bit_flip_ppm;      // a received slot is inverted
+    uint32_t burst_start_ppm;   // a burst of errors starts at a received slot
+    uint16_t burst_length;      // mean slots in a burst, each inverted with probability 1/2
+    uint16_t jitter_us;         // transmitted edges move by up to this much either way
+    int16_t skew_ppm;           // the transmit clock runs fast (positive) or slow
+} phy_impair_config_t;
+
+
+/**
+ * Counts of injected impairments
+ */
+typedef struct
+{
+    uint32_t slots;             // received slots passed through
+    uint32_t flips;             // received slots inverted, in bursts or not
+    uint32_t bursts;
+    uint32_t edges;             // transmitted half bits timed
+} phy_impair_stats_t;
+
+
+/* ------------------------------- Functions -------------------------------- */
+
+
+void phy_impair_configure( const phy_impair_config_t * config );
+void phy_impair_get_config( phy_impair_config_t * config );
+void phy_impair_stats( phy_impair_stats_t * stats );
+
+bool phy_impair_rx_slot( bool slot );
+uint16_t phy_impair_tx_period( uint16_t us );
+
+
+/* --------------------------------- Footer --------------------------------- */
+
+
+# endif // DRIVER_PHY_IMPAIR_H
+
+
+/* -------------------------------------------------------------------------- */
@@ -0,0 +1,360 @@
+/* --------------------------------- Header --------------------------------- */
+
+
+/**
+ * @file    ping.c
+ * @brief   Contains an echo responder and round trip probes timed by the
+ *          microsecond time base
+ *
+ * A probe is sent with its transmit handle remembered, and once its reply
+ * arrives the handle's timing splits the outbound leg into queueing, backoff
+ * and wire time. Whatever is left of the round trip is the return: the
+ * responder noticing the frame ended, queueing its reply, sending it and
+ * this board noticing the reply ended.
+ */
+
+
+/* -------------------------------- Includes -------------------------------- */
+
+
+# include <string.h>
+# include "ping.h"
+# include "network.h"
+# include "netbuf.h"
+# include "systime.h"
+
+
+/* --------------------------------- Defines -------------------------------- */
+
+
+# define PING_TYPE_REQUEST      ( 0x01 )
+# define PING_TYPE_REPLY        ( 0x02 )
+
+/**
+ * Probes awaiting replies, and how long they wait before they're lost
+ */
+# define PING_OUTSTANDING_MAX   ( 16 )
+# define PING_TIMEOUT_MS        ( 5000U )
+
+
+/* ---------------------------------- Types --------------------------------- */
+
+
+/**
+ * A probe awaiting its reply
+ */
+typedef struct
+{
+    bool active;
+    uint16_t seq;
+    uint32_t sent_us;
+    uint32_t sent_ms;
+    network_tx_handle_t handle;
+} ping_probe_t;
+
+
+/* ----------------------------- Static Globals ----------------------------- */
+
+
+static ping_config_t ping_config;
+static ping_stats_t ping_counts;
+static ping_probe_t ping_probes[PING_OUTSTANDING_MAX];
+static uint32_t ping_last_ms;
+
+static uint32_t ping_samples[PING_SAMPLES_MAX];
+static uint64_t ping_total_us;
+static uint64_t ping_part_us[4];    // queue, backoff, wire and return summed
+static uint32_t ping_timed;         // round trips whose outbound leg was timed
+
+
+/* ---------------------------- Static Functions ---------------------------- */
+
+
+/**
+ * Answers a probe from another board with its own payload
+ */
+static void ping_echo( const network_message_t * message )
+{
+    network_tx_params_t params = {
+        .tx_class = NETWORK_TX_CLASS_NORMAL,
+        .ttl_ms = NETWORK_TX_NO_TTL,
+        .port = PING_PORT
+    };
+
+    netbuf_t * buf = netbuf_alloc( );
+    if ( buf == NULL )
+    {
+        return;
+    }
+
+    memcpy( buf->data, message->data, message->length );
+    buf->data[0] = PING_TYPE_REPLY;
+    buf->length = message->length;
+
+    if ( network_tx_buf( message->source, buf, &params, NULL ) == ERROR_CODE_NO_ERROR )
+    {
+        ping_counts.echoed++;
+    }
+    netbuf_free( buf );
+}
+
+
+/**
+ * Records the round trip of an answered probe
+ */
+static void ping_record( ping_probe_t * probe, uint32_t now_us )
+{
+    uint32_t rtt = now_us - probe->sent_us;
+    network_tx_timing_t timing;
+
+    if ( ping_counts.received == 0 || rtt < ping_counts.min_us )
+    {
+        ping_counts.min_us = rtt;
+    }
+    if ( rtt > ping_counts.max_us )
+    {
+        ping_counts.max_us = rtt;
+    }
+
+    ping_samples[ping_counts.received % PING_SAMPLES_MAX] = rtt;
+    ping_total_us += rtt;
+    ping_counts.received++;
+
+    unsigned int bucket = 0;
+    while ( bucket < PING_HISTOGRAM_BUCKETS - 1 && rtt >> ( bucket + 1 ) )
+    {
+        bucket++;
+    }
+    ping_counts.histogram[bucket]++;
+
+    // the outbound leg is known once its frame went out
+    if ( network_tx_timing( probe->handle, &timing ) )
+    {
+        ping_part_us[0] += timing.first_us - probe->sent_us;
+        ping_part_us[1] += timing.start_us - timing.first_us;
+        ping_part_us[2] += timing.end_us - timing.start_us;
+        ping_part_us[3] += now_us - timing.end_us;
+        ping_counts.collisions += timing.attempts - 1;
+        ping_timed++;
+    }
+
+    probe->active = false;
+}
+
+
+/**
+ * Answers probes and matches replies to the probes awaiting them
+ */
+static void ping_receive( const network_message_t * message )
+{
+    uint32_t now_us = systime_us( );
+
+    if ( message->length < PING_SIZE_MIN )
+    {
+        return;
+    }
+
+    if ( message->data[0] == PING_TYPE_REQUEST )
+    {
+        ping_echo( message );
+        return;
+    }
+
+    uint16_t seq = message->data[1] | message->data[2] << 8;
+    for ( int i = 0; i < PING_OUTSTANDING_MAX; i++ )
+    {
+        // only the first reply counts when probing a group
+        if ( ping_probes[i].active && ping_probes[i].seq == seq )
+        {
+            ping_record( &ping_probes[i], now_us );
+            return;
+        }
+    }
+}
+
+
+/**
+ * Sends the next probe in a free slot, losing the oldest one if none are free
+ */
+static void ping_send( void )
+{
+    network_tx_params_t params = {
+        .tx_class = NETWORK_TX_CLASS_NORMAL,
+        .ttl_ms = NETWORK_TX_NO_TTL,
+        .port = PING_PORT
+    };
+    ping_probe_t * probe = &ping_probes[ping_counts.sent % PING_OUTSTANDING_MAX];
+
+    if ( probe->active )
+    {
+        ping_counts.lost++;
+        probe->active = false;
+    }
+
+    netbuf_t * buf = netbuf_alloc( );
+    if ( buf == NULL )
+    {
+        return;
+    }
+
+    probe->seq = ( uint16_t ) ping_counts.sent;
+    probe->sent_ms = systime_ms( );
+    probe->sent_us = systime_us( );
+
+    memset( buf->data, 0, ping_config.size );
+    buf->data[0] = PING_TYPE_REQUEST;
+    buf->data[1] = probe->seq;
+    buf->data[2] = probe->seq >> 8;
+    memcpy( buf->data + 3, &probe->sent_us, sizeof( probe->sent_us ) );
+    buf->length = ping_config.size;
+
+    probe->active = network_tx_buf( ping_config.destination, buf, &params, &probe->handle ) == ERROR_CODE_NO_ERROR;
+    ping_counts.sent++;
+    if ( !probe->active )
+    {
+        ping_counts.lost++;
+    }
+    netbuf_free( buf );
+}
+
+
+/* ------------------------------- Functions -------------------------------- */
+
+
+/**
+ * Opens the ping port so this board answers probes
+ *
+ * @return  Error code
+ */
+ERROR_CODE ping_init( void )
+{
+    return network_port_open( PING_PORT, ping_receive );
+}
+
+
+/**
+ * Starts sending probes, see ping_service()
+ *
+ * @param   [in]    config  The probes to send
+ *
+ * @return  Error code
+ */
+ERROR_CODE ping_start( const ping_config_t * config )
+{
+    if ( ping_counts.running )
+    {
+        THROW_ERROR( ERROR_CODE_PING_ALREADY_RUNNING );
+    }
+    if ( config->size < PING_SIZE_MIN || config->size > PING_SIZE_MAX || config->interval_ms == 0 )
+    {
+        THROW_ERROR( ERROR_CODE_PING_INVALID_CONFIG );
+    }
+
+    ping_config = *config;
+    ping_counts = ( ping_stats_t ) { .running = true, .destination = config->destination };
+    memset( ping_probes, 0, sizeof( ping_probes ) );
+    memset( ping_part_us, 0, sizeof( ping_part_us ) );
+    ping_total_us = 0;
+    ping_timed = 0;
+
+    // the first probe goes at once
+    ping_last_ms = systime_ms( ) - config->interval_ms;
+
+    RETURN_NO_ERROR();
+}
+
+
+/**
+ * Stops sending probes, those awaiting replies still count if answered
+ */
+void ping_stop( void )
+{
+    ping_config.count = ping_counts.sent;
+    if ( ping_counts.sent == 0 )
+    {
+        ping_counts.running = false;
+    }
+}
+
+
+/**
+ * Sends the probes that are due and loses those that waited too long for a
+ * reply, called from the main loop
+ *
+ * @return  bool if the last probe was answered or lost in this call
+ */
+bool ping_service( void )
+{
+    if ( !ping_counts.running )
+    {
+        return false;
+    }
+
+    uint32_t now_ms = systime_ms( );
+    bool waiting = false;
+
+    for ( int i = 0; i < PING_OUTSTANDING_MAX; i++ )
+    {
+        if ( ping_probes[i].active && now_ms - ping_probes[i].sent_ms >= PING_TIMEOUT_MS )
+        {
+            ping_probes[i].active = false;
+            ping_counts.lost++;
+        }
+        waiting |= ping_probes[i].active;
+    }
+
+    if ( ping_config.count == 0 || ping_counts.sent < ping_config.count )
+    {
+        if ( now_ms - ping_last_ms >= ping_config.interval_ms )
+        {
+            ping_last_ms += ping_config.interval_ms;
+            ping_send( );
+        }
+        return false;
+    }
+
+    ping_counts.running = waiting;
+    return !waiting;
+}
+
+
+/**
+ * Gets the round trips of the probes sent so far
+ */
+void ping_stats( ping_stats_t * stats )
+{
+    uint32_t sorted[PING_SAMPLES_MAX];
+    uint32_t count = ping_counts.received < PING_SAMPLES_MAX ? ping_counts.received : PING_SAMPLES_MAX;
+
+    *stats = ping_counts;
+    if ( count == 0 )
+    {
+        return;
+    }
+
+    // insertion sort, the samples are few
+    for ( uint32_t i = 0; i < count; i++ )
+    {
+        uint32_t j = i;
+        for ( ; j > 0 && sorted[j - 1] > ping_samples[i]; j-- )
+        {
+            sorted[j] = sorted[j - 1];
+        }
+        sorted[j] = ping_samples[i];
+    }
+
+    stats->mean_us = ( uint32_t ) ( ping_total_us / ping_counts.received );
+    stats->p50_us = sorted[count / 2];
+    stats->p99_us = sorted[( count * 99 ) / 100];
+
+    if ( ping_timed > 0 )
+    {
+        stats->queue_us = ( uint32_t ) ( ping_part_us[0] / ping_timed );
+        stats->backoff_us = ( uint32_t ) ( ping_part_us[1] / ping_timed );
+        stats->wire_us = ( uint32_t ) ( ping_part_us[2] / ping_timed );
+        stats->return_us = ( uint32_t ) ( ping_part_us[3] / ping_timed );
+    }
+}
+
+
+/* -------------------------------------------------------------------------- */
@@ -0,0 +1,111 @@
+/* --------------------------------- Header --------------------------------- */
+
+
+/**
+ * @file    ping.h
+ * @brief   Contains an echo responder and round trip probes timed by the
+ *          microsecond time base
+ *
+ * Every board answers probes on PING_PORT. Round trips are split into the
+ * time the probe waited in the transmit queue, the time lost to collisions
+ * and backoff once it first took the line, the time it took to send, and the
+ * return, which covers the responder and its reply.
+ */
+
+
+/* ------------------------------ Header Guard ------------------------------ */
+
+
+# ifndef DRIVER_PING_H
+# define DRIVER_PING_H
+
+
+/* -------------------------------- Includes -------------------------------- */
+
+
+# include <stdint.h>
+# include <stdbool.h>
+# include "error.h"
+
+
+/* --------------------------------- Defines -------------------------------- */
+
+
+# define PING_PORT                  ( 0xF2 )
+
+/**
+ * Bounds of a probe, a header of a type, sequence number and time stamp and
+ * the largest message that fits a frame along with its port
+ */
+# define PING_SIZE_MIN              ( 7 )
+# define PING_SIZE_MAX              ( 254 )
+
+/**
+ * Bucket n of the histogram counts round trips of 2^n to 2^(n+1) - 1 us
+ */
+# define PING_HISTOGRAM_BUCKETS     ( 24 )
+
+/**
+ * The latest round trips the percentiles are taken over
+ */
+# define PING_SAMPLES_MAX           ( 128 )
+
+
+/* ---------------------------------- Types --------------------------------- */
+
+
+/**
+ * Probes to send
+ */
+typedef struct
+{
+    uint8_t destination;
+    uint8_t size;
+    uint16_t interval_ms;
+    uint16_t count;         // 0 to send until stopped
+} ping_config_t;
+
+
+/**
+ * Round trips of the probes sent, in microseconds
+ */
+typedef struct
+{
+    bool running;
+    uint8_t destination;
+    uint32_t sent;
+    uint32_t received;
+    uint32_t lost;          // not answered within PING_TIMEOUT_MS
+    uint32_t echoed;        // probes from other boards answered
+    uint32_t min_us;
+    uint32_t mean_us;
+    uint32_t p50_us;
+    uint32_t p99_us;
+    uint32_t max_us;
+    uint32_t queue_us;      // mean parts of a round trip
+    uint32_t backoff_us;
+    uint32_t wire_us;
+    uint32_t return_us;
+    uint32_t collisions;
+    uint32_t histogram[PING_HISTOGRAM_BUCKETS];
+} ping_stats_t;
+
+
+/* ------------------------------- Functions -------------------------------- */
+
+
+ERROR_CODE ping_init( void );
+
+ERROR_CODE ping_start( const ping_config_t * config );
+void ping_stop( void );
+bool ping_service( void );
+void ping_stats( ping_stats_t * stats );
+
+
+/* --------------------------------- Footer --------------------------------- */
+
+
+# endif // DRIVER_PING_H
+
+
+/* -------------------------------------------------------------------------- */
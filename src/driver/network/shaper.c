@@ -0,0 +1,362 @@
+/* --------------------------------- Header --------------------------------- */
+
+
+/**
+ * @file    shaper.c
+ * @brief   Contains token bucket traffic shapers for the transmit queue
+ *
+ * Every traffic class and up to SHAPER_DEST_TABLE_SIZE destinations may have
+ * a token bucket. A frame may only start transmitting once every bucket that
+ * applies to it holds at least as many tokens as the frame has bytes, and the
+ * tokens are taken once the frame has been sent.
+ *
+ * Buckets are consumed from the transmit path in interrupts, so the main loop
+ * only changes or reads them with interrupts masked.
+ */
+
+
+/* -------------------------------- Includes -------------------------------- */
+
+
+# include "shaper.h"
+# include "critical.h"
+# include "systime.h"
+
+
+/* --------------------------------- Defines -------------------------------- */
+
+
+/**
+ * Tokens are kept in thousandths of a byte so millisecond refills of slow
+ * rates don't round away
+ */
+# define SHAPER_TOKEN_SCALE ( 1000UL )
+
+
+/* ---------------------------------- Types --------------------------------- */
+
+
+/**
+ * Token bucket state
+ */
+typedef struct
+{
+    bool enabled;
+    uint8_t address;
+    uint16_t rate_bytes_per_s;
+    uint16_t burst_bytes;
+    uint32_t tokens;
+    uint32_t last_ms;
+} shaper_bucket_t;
+
+
+/* ---------------------------- Global Variables ---------------------------- */
+
+
+/**
+ * Per class and per destination buckets
+ */
+static shaper_bucket_t shaper_class_buckets[NETWORK_TX_CLASS_COUNT];
+static shaper_bucket_t shaper_dest_buckets[SHAPER_DEST_TABLE_SIZE];
+
+
+/* ---------------------------- Static Functions ---------------------------- */
+
+
+/**
+ * Configures a bucket and fills it to its burst size
+ *
+ * @param   bucket              The bucket to configure
+ * @param   rate_bytes_per_s    The refill rate, 0 to disable the bucket
+ * @param   burst_bytes         The bucket depth
+ */
+static void shaper_bucket_set( shaper_bucket_t * bucket, uint16_t rate_bytes_per_s, uint16_t burst_bytes )
+{
+    uint32_t primask = critical_enter( );
+
+    bucket->enabled = rate_bytes_per_s != 0;
+    bucket->rate_bytes_per_s = rate_bytes_per_s;
+    bucket->burst_bytes = burst_bytes;
+    bucket->tokens = burst_bytes * SHAPER_TOKEN_SCALE;
+    bucket->last_ms = systime_ms();
+
+    critical_exit( primask );
+}
+
+
+/**
+ * Adds the tokens earned since the bucket was last refilled
+ *
+ * @param   bucket  The bucket to refill
+ * @param   now_ms  The current system time in milliseconds
+ */
+static void shaper_bucket_refill( shaper_bucket_t * bucket, uint32_t now_ms )
+{
+    uint32_t limit = bucket->burst_bytes * SHAPER_TOKEN_SCALE;
+
+    // rate * SHAPER_TOKEN_SCALE / 1000 tokens are earned per millisecond
+    uint64_t tokens = bucket->tokens + ( uint64_t ) ( now_ms - bucket->last_ms ) * bucket->rate_bytes_per_s;
+    bucket->tokens = tokens > limit ? limit : ( uint32_t ) tokens;
+
+    bucket->last_ms = now_ms;
+}
+
+
+/**
+ * Checks a bucket for enough tokens to send a frame
+ *
+ * @param   bucket  The bucket to check (may be NULL)
+ * @param   bytes   The size of the frame
+ * @param   now_ms  The current system time in milliseconds
+ * @param   wait_ms Raised to the time until the bucket conforms
+ *
+ * @return  True if the frame may be sent
+ */
+static bool shaper_bucket_conforms( shaper_bucket_t * bucket, uint16_t bytes, uint32_t now_ms, uint32_t * wait_ms )
+{
+    if ( bucket == NULL || !bucket->enabled )
+    {
+        return true;
+    }
+
+    shaper_bucket_refill( bucket, now_ms );
+
+    // frames larger than the bucket are let through on a full bucket
+    uint32_t needed = ( bytes < bucket->burst_bytes ? bytes : bucket->burst_bytes ) * SHAPER_TOKEN_SCALE;
+    if ( bucket->tokens >= needed )
+    {
+        return true;
+    }
+
+    uint32_t wait = ( needed - bucket->tokens + bucket->rate_bytes_per_s - 1 ) / bucket->rate_bytes_per_s;
+    if ( wait > *wait_ms )
+    {
+        *wait_ms = wait;
+    }
+
+    return false;
+}
+
+
+/**
+ * Takes a frame's tokens from a bucket
+ *
+ * @param   bucket  The bucket to take from (may be NULL)
+ * @param   bytes   The size of the frame
+ */
+static void shaper_bucket_consume( shaper_bucket_t * bucket, uint16_t bytes )
+{
+    if ( bucket == NULL || !bucket->enabled )
+    {
+        return;
+    }
+
+    uint32_t taken = bytes * SHAPER_TOKEN_SCALE;
+    bucket->tokens = bucket->tokens > taken ? bucket->tokens - taken : 0;
+}
+
+
+/**
+ * Finds the bucket of a destination
+ *
+ * @param   dest    The destination address
+ *
+ * @return  The destination's bucket or NULL if it has none
+ */
+static shaper_bucket_t * shaper_dest_bucket( uint8_t dest )
+{
+    for ( int i = 0; i < SHAPER_DEST_TABLE_SIZE; i++ )
+    {
+        if ( shaper_dest_buckets[i].enabled && shaper_dest_buckets[i].address == dest )
+        {
+            return &shaper_dest_buckets[i];
+        }
+    }
+
+    return NULL;
+}
+
+
+/**
+ * Copies a bucket's state into a display snapshot, counting the tokens it
+ * would hold if refilled now without refilling it
+ *
+ * @param   bucket  The bucket to display
+ * @param   info    The snapshot to fill
+ */
+static void shaper_bucket_info( const shaper_bucket_t * bucket, shaper_info_t * info )
+{
+    uint32_t primask = critical_enter( );
+    shaper_bucket_t snapshot = *bucket;
+    critical_exit( primask );
+
+    if ( snapshot.enabled )
+    {
+        shaper_bucket_refill( &snapshot, systime_ms() );
+    }
+
+    info->enabled = snapshot.enabled;
+    info->address = snapshot.address;
+    info->rate_bytes_per_s = snapshot.rate_bytes_per_s;
+    info->burst_bytes = snapshot.burst_bytes;
+    info->tokens_bytes = snapshot.tokens / SHAPER_TOKEN_SCALE;
+}
+
+
+/* ------------------------------- Functions -------------------------------- */
+
+
+/**
+ * Configures the shaper of a traffic class
+ *
+ * @param   tx_class            The traffic class
+ * @param   rate_bytes_per_s    The sustained rate, 0 to disable shaping
+ * @param   burst_bytes         The largest burst sent at line rate, at least
+ *                              1 when shaping
+ *
+ * @return  Error code
+ */
+ERROR_CODE shaper_set_class( network_tx_class_t tx_class, uint16_t rate_bytes_per_s, uint16_t burst_bytes )
+{
+    if ( tx_class >= NETWORK_TX_CLASS_COUNT )
+    {
+        THROW_ERROR( ERROR_CODE_NETWORK_INVALID_TX_CLASS );
+    }
+
+    // an empty bucket would need no tokens, letting every frame through
+    if ( rate_bytes_per_s != 0 && burst_bytes == 0 )
+    {
+        THROW_ERROR( ERROR_CODE_SHAPER_INVALID_BURST );
+    }
+
+    shaper_bucket_set( &shaper_class_buckets[tx_class], rate_bytes_per_s, burst_bytes );
+
+    RETURN_NO_ERROR();
+}
+
+
+/**
+ * Configures the shaper of a destination
+ *
+ * @param   dest                The destination address
+ * @param   rate_bytes_per_s    The sustained rate, 0 to remove the shaper
+ * @param   burst_bytes         The largest burst sent at line rate, at least
+ *                              1 when shaping
+ *
+ * @return  Error code
+ */
+ERROR_CODE shaper_set_dest( uint8_t dest, uint16_t rate_bytes_per_s, uint16_t burst_bytes )
+{
+    if ( rate_bytes_per_s != 0 && burst_bytes == 0 )
+    {
+        THROW_ERROR( ERROR_CODE_SHAPER_INVALID_BURST );
+    }
+
+    shaper_bucket_t * bucket = shaper_dest_bucket( dest );
+
+    // claim a free slot for a new destination
+    for ( int i = 0; i < SHAPER_DEST_TABLE_SIZE && bucket == NULL; i++ )
+    {
+        if ( !shaper_dest_buckets[i].enabled )
+        {
+            bucket = &shaper_dest_buckets[i];
+        }
+    }
+
+    if ( bucket == NULL )
+    {
+        // removing an unknown destination is not an error
+        if ( rate_bytes_per_s == 0 )
+        {
+            RETURN_NO_ERROR();
+        }
+        THROW_ERROR( ERROR_CODE_SHAPER_TABLE_FULL );
+    }
+
+    uint32_t primask = critical_enter( );
+    bucket->address = dest;
+    shaper_bucket_set( bucket, rate_bytes_per_s, burst_bytes );
+    critical_exit( primask );
+
+    RETURN_NO_ERROR();
+}
+
+
+/**
+ * Determines whether a frame may start transmitting under its class and
+ * destination shapers
+ *
+ * @param   tx_class    The traffic class of the frame
+ * @param   dest        The destination address of the frame
+ * @param   bytes       The size of the frame
+ * @param   now_ms      The current system time in milliseconds
+ * @param   wait_ms     Raised to the time until the frame conforms
+ *
+ * @return  True if the frame may be sent
+ */
+bool shaper_conforms( network_tx_class_t tx_class, uint8_t dest, uint16_t bytes, uint32_t now_ms, uint32_t * wait_ms )
+{
+    bool class_ok = shaper_bucket_conforms( &shaper_class_buckets[tx_class], bytes, now_ms, wait_ms );
+    bool dest_ok = shaper_bucket_conforms( shaper_dest_bucket( dest ), bytes, now_ms, wait_ms );
+
+    return class_ok && dest_ok;
+}
+
+
+/**
+ * Takes a sent frame's tokens from its class and destination shapers
+ *
+ * @param   tx_class    The traffic class of the frame
+ * @param   dest        The destination address of the frame
+ * @param   bytes       The size of the frame
+ */
+void shaper_consume( network_tx_class_t tx_class, uint8_t dest, uint16_t bytes )
+{
+    shaper_bucket_consume( &shaper_class_buckets[tx_class], bytes );
+    shaper_bucket_consume( shaper_dest_bucket( dest ), bytes );
+}
+
+
+/**
+ * Gets the current state of a traffic class' shaper
+ *
+ * @param   tx_class    The traffic class
+ * @param   info        The shaper's state
+ *
+ * @return  Error code
+ */
+ERROR_CODE shaper_get_class( network_tx_class_t tx_class, shaper_info_t * info )
+{
+    if ( tx_class >= NETWORK_TX_CLASS_COUNT )
+    {
+        THROW_ERROR( ERROR_CODE_NETWORK_INVALID_TX_CLASS );
+    }
+
+    shaper_bucket_info( &shaper_class_buckets[tx_class], info );
+
+    RETURN_NO_ERROR();
+}
+
+
+/**
+ * Gets the current state of a destination shaper slot
+ *
+ * @param   idx     The slot index (below SHAPER_DEST_TABLE_SIZE)
+ * @param   info    The shaper's state
+ *
+ * @return  Error code
+ */
+ERROR_CODE shaper_get_dest( unsigned int idx, shaper_info_t * info )
+{
+    if ( idx >= SHAPER_DEST_TABLE_SIZE )
+    {
+        THROW_ERROR( ERROR_CODE_SHAPER_INVALID_INDEX );
+    }
+
+    shaper_bucket_info( &shaper_dest_buckets[idx], info );
+
+    RETURN_NO_ERROR();
+}
+
+
+/* -------------------------------------------------------------------------- */
@@ -0,0 +1,71 @@
+/* --------------------------------- Header --------------------------------- */
+
+
+/**
+ * @file    shaper.h
+ * @brief   Contains token bucket traffic shapers for the transmit queue
+ */
+
+
+/* ------------------------------ Header Guard ------------------------------ */
+
+
+# ifndef DRIVER_SHAPER_H
+# define DRIVER_SHAPER_H
+
+
+/* -------------------------------- Includes -------------------------------- */
+
+
+# include <stdint.h>
+# include <stdbool.h>
+
+# include "error.h"
+# include "network.h"
+
+
+/* --------------------------------- Defines -------------------------------- */
+
+
+/**
+ * The number of destinations that can have their own shaper
+ */
+# define SHAPER_DEST_TABLE_SIZE ( 4 )
+
+
+/* ---------------------------------- Types --------------------------------- */
+
+
+/**
+ * Snapshot of a token bucket for display
+ */
+typedef struct
+{
+    bool enabled;
+    uint8_t address;            // destination shapers only
+    uint16_t rate_bytes_per_s;
+    uint16_t burst_bytes;
+    uint16_t tokens_bytes;
+} shaper_info_t;
+
+
+/* ------------------------------- Functions -------------------------------- */
+
+
+ERROR_CODE shaper_set_class( network_tx_class_t tx_class, uint16_t rate_bytes_per_s, uint16_t burst_bytes );
+ERROR_CODE shaper_set_dest( uint8_t dest, uint16_t rate_bytes_per_s, uint16_t burst_bytes );
+
+bool shaper_conforms( network_tx_class_t tx_class, uint8_t dest, uint16_t bytes, uint32_t now_ms, uint32_t * wait_ms );
+void shaper_consume( network_tx_class_t tx_class, uint8_t dest, uint16_t bytes );
+
+ERROR_CODE shaper_get_class( network_tx_class_t tx_class, shaper_info_t * info );
+ERROR_CODE shaper_get_dest( unsigned int idx, shaper_info_t * info );
+
+
+/* --------------------------------- Footer --------------------------------- */
+
+
+# endif // DRIVER_SHAPER_H
+
+
+/* -------------------------------------------------------------------------- */
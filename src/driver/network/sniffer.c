@@ -0,0 +1,257 @@
+/* --------------------------------- Header --------------------------------- */
+
+
+/**
+ * @file    sniffer.c
+ * @brief   Contains a sniffer streaming every frame on the bus out over the
+ *          serial port as pcap records
+ *
+ * The network driver hands over every frame from network_service(), so the
+ * records are written from the main loop. A record of the largest frame
+ * takes about 30 ms at 115200 baud, far less than the frame took on the bus.
+ */
+
+
+/* -------------------------------- Includes -------------------------------- */
+
+
+# ifdef NETWORK_SNIFF
+
+
+# include "sniffer.h"
+# include "network.h"
+# include "systime.h"
+# include "crc8.h"
+# include "uio.h"
+
+
+/* --------------------------------- Defines -------------------------------- */
+
+
+# define SNIFFER_PCAP_MAGIC         ( 0xA1B2C3D4UL )
+# define SNIFFER_PCAP_HEADER_SIZE   ( 24 )
+# define SNIFFER_PCAP_RECORD_SIZE   ( 16 )
+
+/**
+ * The largest record before and after COBS adds a byte per 254 and the
+ * delimiters
+ */
+# define SNIFFER_RECORD_MAX         ( 2 + SNIFFER_PCAP_RECORD_SIZE + SNIFFER_PSEUDO_HEADER_SIZE + \
+                                      NETWORK_SNIFF_FRAME_MAX + 1 )
+# define SNIFFER_ENCODED_MAX        ( SNIFFER_RECORD_MAX + SNIFFER_RECORD_MAX / 254 + 3 )
+
+# define SNIFFER_SNAPLEN            ( SNIFFER_PSEUDO_HEADER_SIZE + NETWORK_SNIFF_FRAME_MAX )
+
+
+/* ----------------------------- Static Globals ----------------------------- */
+
+
+static bool sniffer_running;
+static bool sniffer_promiscuous;    // to restore once stopped
+static sniffer_stats_t sniffer_counts;
+static uint64_t sniffer_clock;      // systime_us() without its wraps
+
+static uint8_t sniffer_record[SNIFFER_RECORD_MAX];
+static uint8_t sniffer_encoded[SNIFFER_ENCODED_MAX];
+
+
+/* ---------------------------- Static Functions ---------------------------- */
+
+
+static uint8_t * sniffer_put16( uint8_t * out, uint16_t value )
+{
+    out[0] = value;
+    out[1] = value >> 8;
+    return out + 2;
+}
+
+
+static uint8_t * sniffer_put32( uint8_t * out, uint32_t value )
+{
+    out = sniffer_put16( out, value );
+    return sniffer_put16( out, value >> 16 );
+}
+
+
+/**
+ * Extends the microsecond time base past its wrap, which takes being called
+ * at least every ~71 minutes
+ */
+static uint64_t sniffer_clock_us( void )
+{
+    sniffer_clock += ( uint32_t ) ( systime_us( ) - ( uint32_t ) sniffer_clock );
+    return sniffer_clock;
+}
+
+
+/**
+ * Encodes a record with COBS between zero delimiters and sends it
+ *
+ * @param   [in]    size    The bytes of sniffer_record before its crc
+ */
+static void sniffer_send( uint32_t size )
+{
+    uint32_t code_idx = 1;
+    uint32_t out = 2;
+    uint8_t code = 1;
+
+    sniffer_record[size] = crc8_calculate( sniffer_record, size, 0 );
+    size++;
+
+    sniffer_encoded[0] = 0x00;
+    for ( uint32_t i = 0; i < size; i++ )
+    {
+        if ( sniffer_record[i] != 0x00 )
+        {
+            sniffer_encoded[out++] = sniffer_record[i];
+            code++;
+        }
+
+        if ( sniffer_record[i] == 0x00 || code == 0xFF )
+        {
+            sniffer_encoded[code_idx] = code;
+            code_idx = out++;
+            code = 1;
+        }
+    }
+    sniffer_encoded[code_idx] = code;
+    sniffer_encoded[out++] = 0x00;
+
+    uwrite( sniffer_encoded, out );
+    sniffer_counts.bytes += out;
+}
+
+
+/**
+ * Sends the pcap file header, so a dump can be joined at any start
+ */
+static void sniffer_send_header( void )
+{
+    uint8_t * out = sniffer_record;
+
+    *out++ = SNIFFER_MAGIC;
+    *out++ = SNIFFER_RECORD_HEADER;
+    out = sniffer_put32( out, SNIFFER_PCAP_MAGIC );
+    out = sniffer_put16( out, 2 );
+    out = sniffer_put16( out, 4 );
+    out = sniffer_put32( out, 0 );          // time zone
+    out = sniffer_put32( out, 0 );          // accuracy
+    out = sniffer_put32( out, SNIFFER_SNAPLEN );
+    out = sniffer_put32( out, SNIFFER_LINKTYPE );
+
+    sniffer_send( out - sniffer_record );
+}
+
+
+/**
+ * Sends a received frame, called from network_service()
+ */
+static void sniffer_frame( const network_sniff_frame_t * frame )
+{
+    uint64_t now = sniffer_clock_us( );
+    uint64_t start = now - ( uint32_t ) ( ( uint32_t ) now - frame->start_us );
+    uint32_t length = SNIFFER_PSEUDO_HEADER_SIZE + frame->size;
+    uint8_t * out = sniffer_record;
+
+    sniffer_counts.frames++;
+    sniffer_counts.crc_errors += ( frame->status & NETWORK_SNIFF_CRC_ERROR ) != 0;
+    sniffer_counts.linecode_errors +=
+        ( frame->status & ( NETWORK_SNIFF_LINECODE_ERROR | NETWORK_SNIFF_PREAMBLE_ERROR ) ) != 0;
+    sniffer_counts.collisions += ( frame->status & NETWORK_SNIFF_COLLISION ) != 0;
+
+    *out++ = SNIFFER_MAGIC;
+    *out++ = SNIFFER_RECORD_FRAME;
+    out = sniffer_put32( out, start / 1000000U );
+    out = sniffer_put32( out, start % 1000000U );
+    out = sniffer_put32( out, length );
+    out = sniffer_put32( out, length );
+
+    *out++ = SNIFFER_VERSION;
+    *out++ = frame->status;
+    *out++ = frame->linecode;
+    *out++ = 0;
+    out = sniffer_put16( out, frame->violations );
+    out = sniffer_put16( out, 0 );
+    out = sniffer_put32( out, frame->end_us - frame->start_us );
+
+    for ( uint16_t i = 0; i < frame->size; i++ )
+    {
+        *out++ = frame->bytes[i];
+    }
+
+    sniffer_send( out - sniffer_record );
+}
+
+
+/* ------------------------------- Functions -------------------------------- */
+
+
+/**
+ * Starts streaming every frame on the bus, receiving frames for every
+ * destination until stopped
+ *
+ * @return  Error code
+ */
+ERROR_CODE sniffer_start( void )
+{
+    if ( sniffer_running )
+    {
+        THROW_ERROR( ERROR_CODE_SNIFF_ALREADY_RUNNING );
+    }
+
+    sniffer_counts = ( sniffer_stats_t ) { .running = true };
+    sniffer_clock = systime_us( );
+    sniffer_send_header( );
+
+    sniffer_promiscuous = network_rx_is_promiscuous( );
+    network_rx_set_promiscuous( true );
+    network_rx_set_sniffer( sniffer_frame );
+    sniffer_running = true;
+
+    RETURN_NO_ERROR( );
+}
+
+
+/**
+ * Stops streaming frames, restoring the receive filter
+ */
+void sniffer_stop( void )
+{
+    if ( !sniffer_running )
+    {
+        return;
+    }
+
+    network_rx_set_sniffer( NULL );
+    network_rx_set_promiscuous( sniffer_promiscuous );
+    sniffer_running = false;
+    sniffer_counts.running = false;
+}
+
+
+/**
+ * Keeps the time stamps counting past the time base's wrap, called from the
+ * main loop
+ */
+void sniffer_service( void )
+{
+    if ( sniffer_running )
+    {
+        sniffer_clock_us( );
+    }
+}
+
+
+/**
+ * Gets the counters of the frames sniffed since the sniffer was started
+ */
+void sniffer_stats( sniffer_stats_t * stats )
+{
+    *stats = sniffer_counts;
+}
+
+
+# endif // NETWORK_SNIFF
+
+
+/* -------------------------------------------------------------------------- */
@@ -0,0 +1,105 @@
+/* --------------------------------- Header --------------------------------- */
+
+
+/**
+ * @file    sniffer.h
+ * @brief   Contains a sniffer streaming every frame on the bus out over the
+ *          serial port as pcap records
+ *
+ * Only built with NETWORK_SNIFF defined, which the host build always does and
+ * the firmware does with the CE4951_SNIFF option. While sniffing the board is
+ * promiscuous, and every frame it receives is sent as a pcap record of link
+ * type SNIFFER_LINKTYPE. Frames cut off by a collision and glitches too short
+ * to be a frame are sent too.
+ *
+ * Records are binary, so they are COBS encoded and put between zero bytes,
+ * which the console's text never holds:
+ *
+ *      0x00 COBS( 0xCE type body crc8 ) 0x00
+ *
+ * where the crc8 is crc8_calculate() of everything before it, and the body
+ * of a SNIFFER_RECORD_HEADER is the pcap file header and that of a
+ * SNIFFER_RECORD_FRAME a pcap record header and the packet. The packet is a
+ * SNIFFER_PSEUDO_HEADER_SIZE byte header, all little endian,
+ *
+ *      version             SNIFFER_VERSION
+ *      status              NETWORK_SNIFF_ flags
+ *      linecode            a linecode_t, or NETWORK_SNIFF_LINECODE_UNKNOWN
+ *      reserved
+ *      violations          uint16_t, line code violations in the frame
+ *      reserved            uint16_t
+ *      duration            uint32_t, us from the first edge to the line idling
+ *
+ * followed by the frame's bytes from the preamble on, as far as they were
+ * decoded. Time stamps count microseconds since the board started.
+ *
+ * tools/pcap/sniff2pcapng.c writes the records of a serial dump to a pcapng
+ * file and tools/pcap/ce4951.lua dissects them in Wireshark.
+ */
+
+
+/* ------------------------------ Header Guard ------------------------------ */
+
+
+# ifndef DRIVER_SNIFFER_H
+# define DRIVER_SNIFFER_H
+
+
+/* -------------------------------- Includes -------------------------------- */
+
+
+# include <stdint.h>
+# include <stdbool.h>
+# include "error.h"
+
+
+/* --------------------------------- Defines -------------------------------- */
+
+
+# define SNIFFER_VERSION                ( 1 )
+# define SNIFFER_MAGIC                  ( 0xCE )
+
+# define SNIFFER_RECORD_HEADER          ( 0x01 )
+# define SNIFFER_RECORD_FRAME           ( 0x02 )
+
+/**
+ * LINKTYPE_USER0, reserved for private use
+ */
+# define SNIFFER_LINKTYPE               ( 147 )
+
+# define SNIFFER_PSEUDO_HEADER_SIZE     ( 12 )
+
+
+/* ---------------------------------- Types --------------------------------- */
+
+
+/**
+ * Counters of the frames sniffed since the sniffer was started
+ */
+typedef struct
+{
+    bool running;
+    uint32_t frames;
+    uint32_t crc_errors;
+    uint32_t linecode_errors;   // preamble and code violations
+    uint32_t collisions;
+    uint32_t bytes;             // of records streamed out
+} sniffer_stats_t;
+
+
+/* ------------------------------- Functions -------------------------------- */
+
+
+ERROR_CODE sniffer_start( void );
+void sniffer_stop( void );
+void sniffer_service( void );
+void sniffer_stats( sniffer_stats_t * stats );
+
+
+/* --------------------------------- Footer --------------------------------- */
+
+
+# endif // DRIVER_SNIFFER_H
+
+
+/* -------------------------------------------------------------------------- */
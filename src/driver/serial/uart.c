@@ -15,7 +15,7 @@
 # include "error.h"
 # include "uart.h"
 # include "uio.h"
-# include "circular_queue.h"
+# include "ring.h"
 
 
 /* ------------------------------------------ Defines ------------------------------------------- */
@@ -39,6 +39,12 @@
 # define TIMEOUT_TIMER_TICKS_PER_SECOND         ( 1000000U )
 
 
+/**
+ * @brief   The size of the input buffer in bytes, a power of two
+ */
+# define UART_INPUT_BUFFER_SIZE                 ( 2048U )
+
+
 /* ----------------------------------- Static Global Variables ---------------------------------- */
 
 
@@ -47,7 +53,11 @@
  */
 static bool uartIsInit = false;
 
-static circular_queue input_buffer;
+/**
+ * @brief   Characters received by the USART ISR and read by _read()
+ */
+static uint8_t input_storage[UART_INPUT_BUFFER_SIZE];
+static ring_t input_buffer;
 
 
 /* ---------------------------------- Constructors / Destructors -------------------------------- */
@@ -72,8 +82,8 @@ uartInit
 	    THROW_ERROR( ERROR_CODE_DRIVER_SERIAL_UART_ALREADY_INITIALIZED );
     }
 
-    // circular queue
-    input_buffer = cq_init();
+    // input buffer
+    ring_init( &input_buffer, input_storage, sizeof( input_storage ) );
 
     // enable USART module (USART2), timeout timer (TIM7), and GPIO port (GPIOA) in RCC
     RCC->APB1ENR |= RCC_APB1ENR_USART2EN;
@@ -202,7 +212,9 @@ uartRxBuffer
 bool
 uartRxReady()
 {
-    return !cq_isempty(&input_buffer) && input_buffer.buffer[input_buffer.pusher - 1] =='\n';
+    uint8_t last;
+    uint32_t count = ring_count(&input_buffer);
+    return count > 0 && ring_peek(&input_buffer, count - 1, &last) && last == '\n';
 }
 
 /**
@@ -213,12 +225,11 @@ uartRxReady()
 
 void uartRxReprint()
 {
-    int i = input_buffer.puller;
+    uint8_t c;
 
-    while (i != input_buffer.pusher)
+    for (uint32_t i = 0; ring_peek(&input_buffer, i, &c); i++)
     {
-        uartTxByte(input_buffer.buffer[i], 10000);
-        i = i + 1 % CIRCULAR_QUEUE_SIZE;
+        uartTxByte(c, 10000);
     }
 }
 
@@ -320,18 +331,12 @@ uartRxByte
 int _read(int file, char * ptr, int len) {
 
     // wait until the input buffer receives some data
-    while (cq_isempty(&input_buffer));
-
-    int char_count = 0;
+    while (ring_is_empty(&input_buffer));
 
-    // pull from the circular queue until it is empty
-    while (!cq_isempty(&input_buffer)) {
-        char_count++;
-        *ptr = cq_pull(&input_buffer);
-        ptr++;
-    }
+    // take as much of the input buffer as fits
+    int char_count = ring_read(&input_buffer, (uint8_t *) ptr, len);
 
-    if (*ptr == '\r') *ptr = '\n';
+    if (char_count > 0 && ptr[char_count - 1] == '\r') ptr[char_count - 1] = '\n';
 
     return char_count;
 
@@ -345,15 +350,14 @@ int _read(int file, char * ptr, int len) {
  * USART2 interrupt request handler
  */
 void USART2_IRQHandler(void) {
-    if ((USART2->SR & USART_SR_RXNE) && !cq_isfull(&input_buffer)) {
-        // read the RDR
+    if (USART2->SR & USART_SR_RXNE) {
+        // read the RDR, which clears the interrupt even when the input buffer is full
         char c = USART2->DR;
 
-        // push the char in the RDR into the input buffer
-        cq_push(&input_buffer, c);
-
-        // echo the character to the output buffer
-        ERROR_HANDLE_NON_FATAL(uartTxByte(c, 1000));
+        // push the char in the RDR into the input buffer and echo it to the output buffer
+        if (ring_push(&input_buffer, c)) {
+            ERROR_HANDLE_NON_FATAL(uartTxByte(c, 1000));
+        }
     }
 }
 
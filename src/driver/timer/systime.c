@@ -0,0 +1,101 @@
+/* --------------------------------- Header --------------------------------- */
+
+
+/**
+ * @file    systime.c
+ * @brief   Contains functions for reading the system time base (SysTick) and
+ *          the microsecond time base (TIM2)
+ */
+
+
+/* -------------------------------- Includes -------------------------------- */
+
+
+# include <stdbool.h>
+# include "stm32f4xx_hal.h"
+# include "stm32f446xx.h"
+
+# include "systime.h"
+
+
+/* --------------------------------- Defines -------------------------------- */
+
+
+/**
+ * The number of microsecond timer ticks per microsecond
+ * (TIM2 is on APB1_TIMER)
+ */
+# define SYSTIME_TICKS_PER_US   ( 84U )
+
+
+/* ---------------------------- Global Variables ---------------------------- */
+
+
+/**
+ * Microsecond timer initialization flag
+ */
+static bool systime_is_init = false;
+
+
+/* ------------------------------- Functions -------------------------------- */
+
+
+/**
+ * Starts the microsecond time base, a free running 32 bit count of TIM2
+ *
+ * @return  Error code
+ */
+ERROR_CODE systime_init()
+{
+    // throw an error if the microsecond timer is already initialized
+    if ( systime_is_init )
+    {
+        THROW_ERROR( ERROR_CODE_DRIVER_TIMER_SYSTIME_ALREADY_INITIALIZED );
+    }
+
+    systime_is_init = true;
+
+    // enable microsecond timer (TIM2) in RCC
+    RCC->APB1ENR |= RCC_APB1ENR_TIM2EN;
+
+    // count microseconds across the whole 32 bits, loading the prescaler now
+    TIM2->PSC = SYSTIME_TICKS_PER_US - 1;
+    TIM2->ARR = 0xFFFFFFFFUL;
+    TIM2->EGR = TIM_EGR_UG;
+    TIM2->CNT = 0;
+    TIM2->CR1 |= TIM_CR1_CEN;
+
+    RETURN_NO_ERROR();
+}
+
+
+/**
+ * Gets the number of milliseconds elapsed since HAL_Init()
+ *
+ * NOTE:
+ * The value wraps after ~49 days, so compare times with unsigned subtraction
+ *
+ * @return  The system time in milliseconds
+ */
+uint32_t systime_ms()
+{
+    return HAL_GetTick();
+}
+
+
+/**
+ * Gets the number of microseconds elapsed since systime_init()
+ *
+ * NOTE:
+ * The value wraps after ~71 minutes, so compare times with unsigned
+ * subtraction. It reads zero until systime_init() is called.
+ *
+ * @return  The system time in microseconds
+ */
+uint32_t systime_us()
+{
+    return TIM2->CNT;
+}
+
+
+/* -------------------------------------------------------------------------- */
@@ -0,0 +1,39 @@
+/* --------------------------------- Header --------------------------------- */
+
+
+/**
+ * @file    systime.h
+ * @brief   Contains functions for reading the system time base (SysTick) and
+ *          the microsecond time base (TIM2)
+ */
+
+
+/* ------------------------------ Header Guard ------------------------------ */
+
+
+# ifndef DRIVER_SYSTIME_H
+# define DRIVER_SYSTIME_H
+
+
+/* -------------------------------- Includes -------------------------------- */
+
+
+#include <stdint.h>
+#include "error.h"
+
+
+/* ------------------------------- Functions -------------------------------- */
+
+
+ERROR_CODE systime_init();
+uint32_t systime_ms();
+uint32_t systime_us();
+
+
+/* --------------------------------- Footer --------------------------------- */
+
+
+# endif // DRIVER_SYSTIME_H
+
+
+/* -------------------------------------------------------------------------- */
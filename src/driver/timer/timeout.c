@@ -214,6 +214,27 @@ ERROR_CODE timeout_set_timeout( uint16_t us )
 }
 
 
+/**
+ * Sets how long after the last edge the timeout timer repeats the last bit
+ *
+ * @param   us  The repeat period in microseconds, less than the timeout
+ *
+ * @return  Error code
+ */
+ERROR_CODE timeout_set_compare( uint16_t us )
+{
+    // throw an error if the timeout timer is not initialized
+    if ( !timeout_timer_is_init )
+    {
+        THROW_ERROR( ERROR_CODE_DRIVER_TIMER_TIMEOUT_NOT_INITIALIZED );
+    }
+
+    TIM3->CCR1 = us;
+
+    RETURN_NO_ERROR();
+}
+
+
 /* --------------------------- Interrupt Handlers --------------------------- */
 
 
@@ -246,7 +267,7 @@ void TIM3_IRQHandler()
             // uprintf("COLLISION\n");
             ERROR_HANDLE_NON_FATAL( timeout_stop() );
             ERROR_HANDLE_NON_FATAL( state_set( COLLISION ) );
-            network_rx_queue_reset();
+            network_rx_queue_collide();
         }
     } else if ( TIM3->SR & TIM_SR_CC1IF )
     {
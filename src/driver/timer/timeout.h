@@ -31,6 +31,7 @@ ERROR_CODE timeout_stop();
 ERROR_CODE timeout_reset();
 
 ERROR_CODE timeout_set_timeout( uint16_t us );
+ERROR_CODE timeout_set_compare( uint16_t us );
 
 bool timeout_is_running();
 
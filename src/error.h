@@ -68,6 +68,32 @@ typedef enum
     ERROR_CODE_DRIVER_TIMER_BACKOFF_ALREADY_RUNNING,            // 0x20
 
     ERROR_CODE_INVALID_UART_INPUT,                              // 0x21
+
+    ERROR_CODE_NETWORK_INVALID_TX_CLASS,                        // 0x22
+    ERROR_CODE_SHAPER_TABLE_FULL,                               // 0x23
+    ERROR_CODE_NETWORK_GROUP_TABLE_FULL,                        // 0x24
+    ERROR_CODE_NETWORK_PORT_ALREADY_OPEN,                       // 0x25
+    ERROR_CODE_NETWORK_PORT_NOT_OPEN,                           // 0x26
+    ERROR_CODE_NETWORK_PORT_TABLE_FULL,                         // 0x27
+    ERROR_CODE_NETWORK_INVALID_COMPRESSED_MESSAGE,              // 0x28
+    ERROR_CODE_NETWORK_FEC_UNCORRECTABLE,                       // 0x29
+    ERROR_CODE_NETWORK_INVALID_LINECODE,                        // 0x2A
+    ERROR_CODE_NETWORK_BUF_POOL_EMPTY,                          // 0x2B
+    ERROR_CODE_NETWORK_BENCH_FAILED,                            // 0x2C
+    ERROR_CODE_FLOOD_INVALID_CONFIG,                            // 0x2D
+    ERROR_CODE_FLOOD_ALREADY_RUNNING,                           // 0x2E
+    ERROR_CODE_DRIVER_TIMER_SYSTIME_ALREADY_INITIALIZED,        // 0x2F
+    ERROR_CODE_PING_INVALID_CONFIG,                             // 0x30
+    ERROR_CODE_PING_ALREADY_RUNNING,                            // 0x31
+    ERROR_CODE_CAPTURE_ALREADY_RUNNING,                         // 0x32
+    ERROR_CODE_SNIFF_ALREADY_RUNNING,                           // 0x33
+    ERROR_CODE_NETWORK_INVALID_HALF_BIT_PERIOD,                 // 0x34
+    ERROR_CODE_NETWORK_BUSY,                                    // 0x35
+    ERROR_CODE_BERT_INVALID_CONFIG,                             // 0x36
+    ERROR_CODE_BERT_ALREADY_RUNNING,                            // 0x37
+    ERROR_CODE_SHAPER_INVALID_INDEX,                            // 0x38
+    ERROR_CODE_SHAPER_INVALID_BURST,                            // 0x39
+    ERROR_CODE_NETWORK_INVALID_TX_SCHED,                        // 0x3A
 } ERROR_CODE;
 
 
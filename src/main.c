@@ -21,6 +21,16 @@
 
 # include "leds.h"
 # include "network.h"
+# include "shaper.h"
+# include "phy_impair.h"
+# include "network_bench.h"
+# include "flood.h"
+# include "ping.h"
+# include "bert.h"
+# include "capture.h"
+# include "sniffer.h"
+# include "systime.h"
+# include "microbench.h"
 # include "channel_monitor.h"
 # include "timeout.h"
 # include "state.h"
@@ -34,11 +44,146 @@
 # define CE4981_NETWORK_MAX_MESSAGE_SIZE    ( 256 + 5) // I added 5 bytes due to Address Size in the UART
 
 
+/* ----------------------------------- Static Global Variables ---------------------------------- */
+
+
+/**
+ * @brief   Display names of the transmit traffic classes
+ */
+static const char * txClassNames[NETWORK_TX_CLASS_COUNT] = { "control", "normal", "bulk" };
+
+
 
 
 /* ----------------------------------------- Functions ------------------------------------------ */
 
 
+/**
+ * @brief  Prints the round trips of the probes sent last, with a histogram
+ */
+static void pingReport( void )
+{
+    ping_stats_t stats;
+    uint32_t peak = 0;
+
+    ping_stats(&stats);
+    uprintf("[ ping 0x%02X %s: %lu sent, %lu received, %lu lost, %lu echoed for others ]\n",
+            stats.destination, stats.running ? "running" : "done", stats.sent, stats.received,
+            stats.lost, stats.echoed);
+    if (stats.received == 0)
+    {
+        return;
+    }
+
+    uprintf("[ rtt us: min %lu, mean %lu, p50 %lu, p99 %lu, max %lu ]\n",
+            stats.min_us, stats.mean_us, stats.p50_us, stats.p99_us, stats.max_us);
+    uprintf("[ mean us: queue %lu, backoff %lu, wire %lu, return %lu, %lu collisions ]\n",
+            stats.queue_us, stats.backoff_us, stats.wire_us, stats.return_us, stats.collisions);
+
+    for (int bucket = 0; bucket < PING_HISTOGRAM_BUCKETS; bucket++)
+    {
+        peak = stats.histogram[bucket] > peak ? stats.histogram[bucket] : peak;
+    }
+    for (int bucket = 0; bucket < PING_HISTOGRAM_BUCKETS; bucket++)
+    {
+        if (stats.histogram[bucket] > 0)
+        {
+            char bar[41];
+            unsigned int length = (stats.histogram[bucket] * 40 + peak - 1) / peak;
+            memset(bar, '#', length);
+            bar[length] = '\0';
+            uprintf("[ %8lu - %8lu us %6lu %s ]\n", bucket ? 1UL << bucket : 0UL, (2UL << bucket) - 1,
+                    stats.histogram[bucket], bar);
+        }
+    }
+}
+
+
+/**
+ * @brief  Prints the flood this board generated last and every flood it received
+ */
+static void floodReport( void )
+{
+    flood_tx_stats_t tx;
+    flood_rx_stats_t rx[FLOOD_SOURCES_MAX];
+    uint32_t totalBytes = 0, firstMs = 0, lastMs = 0;
+
+    flood_tx_stats(&tx);
+    if (tx.sent > 0)
+    {
+        uprintf("[ flood %s, session %u: %lu sent, %lu bytes in %lu ms, %lu B/s offered, %lu behind ]\n",
+                tx.running ? "running" : "done", tx.session, tx.sent, tx.bytes, tx.elapsed_ms,
+                tx.elapsed_ms ? tx.bytes * 1000UL / tx.elapsed_ms : 0UL, tx.behind);
+    }
+
+    unsigned int sources = flood_rx_stats(rx, FLOOD_SOURCES_MAX);
+    for (unsigned int idx = 0; idx < sources; idx++)
+    {
+        uint32_t spanMs = rx[idx].last_ms - rx[idx].first_ms;
+        uprintf("[ from 0x%02X, session %u: %lu received, %lu B/s goodput, %lu lost, %lu duplicate, "
+                "%lu reordered, %lu corrupt ]\n", rx[idx].source, rx[idx].session, rx[idx].received,
+                spanMs ? rx[idx].bytes * 1000UL / spanMs : 0UL, rx[idx].lost, rx[idx].duplicates,
+                rx[idx].reordered, rx[idx].corrupt);
+
+        // the bus carried every flood between the first message and the last
+        totalBytes += rx[idx].bytes;
+        firstMs = (idx == 0 || (int32_t) (rx[idx].first_ms - firstMs) < 0) ? rx[idx].first_ms : firstMs;
+        lastMs = (idx == 0 || (int32_t) (rx[idx].last_ms - lastMs) > 0) ? rx[idx].last_ms : lastMs;
+    }
+    if (sources > 1)
+    {
+        uprintf("[ %u floods received, %lu B/s goodput together ]\n", sources,
+                lastMs != firstMs ? totalBytes * 1000UL / (lastMs - firstMs) : 0UL);
+    }
+}
+
+
+#ifdef NETWORK_BERT
+/**
+ * @brief  Prints the rates the last bit error rate test tried and the fastest that passed
+ */
+static void bertReport( void )
+{
+    static const char * patternNames[BERT_PATTERN_COUNT] = { "prbs7", "prbs15" };
+    bert_stats_t stats;
+
+    bert_stats(&stats);
+    uprintf("[ bert 0x%02X %s %s, threshold %lu ppm, %lu tests received from others ]\n", stats.destination,
+            patternNames[stats.pattern], stats.running ? "running" : "done", stats.threshold_ppm, stats.received);
+
+    for (unsigned int idx = 0; idx < stats.steps; idx++)
+    {
+        const bert_result_t * result = &stats.results[idx];
+        if (!result->answered)
+        {
+            uprintf("[ %5u us half bit: %lu frames sent, no report, fail ]\n", result->half_bit_us,
+                    result->frames_sent);
+            continue;
+        }
+
+        uint32_t ppb = result->bits ? (uint64_t) result->errors * 1000000000U / result->bits : 0;
+        uprintf("[ %5u us half bit: %lu/%lu frames, %lu bits, %lu errors, %lu.%03lu ppm, %u slips, "
+                "%u sync losses, %s ]\n", result->half_bit_us, result->frames_received, result->frames_sent,
+                result->bits, result->errors, ppb / 1000, ppb % 1000, result->slips, result->sync_losses,
+                result->passed ? "pass" : "fail");
+    }
+
+    if (!stats.running && stats.steps > 0)
+    {
+        if (stats.safe_half_bit_us)
+        {
+            uprintf("[ fastest passing: %u us half bit, %lu bit/s ]\n", stats.safe_half_bit_us,
+                    1000000UL / (2UL * stats.safe_half_bit_us));
+        }
+        else
+        {
+            uprintf("[ no rate passed ]\n");
+        }
+    }
+}
+#endif
+
+
 /**
  * @brief  Firmware entry point
  *
@@ -64,9 +209,17 @@ int main( void )
     // print reset header
     uprintf("/* ---------- DEVICE RESET ---------- */\n\n");
 
+    // start the microsecond time base
+    ERROR_HANDLE_FATAL( systime_init() );
+
     // start network
     ERROR_HANDLE_FATAL( network_init() );
     ERROR_HANDLE_FATAL( channel_monitor_init() );
+    ERROR_HANDLE_FATAL( flood_init() );
+    ERROR_HANDLE_FATAL( ping_init() );
+#ifdef NETWORK_BERT
+    ERROR_HANDLE_FATAL( bert_init() );
+#endif
 
     // start timeout timer
     ERROR_HANDLE_FATAL( timeout_init( CE4981_NETWORK_TIMEOUT_PERIOD_US ) );
@@ -79,11 +232,9 @@ int main( void )
 
     // UART buffer
     char uartRxBuffer[CE4981_NETWORK_MAX_MESSAGE_SIZE];
-    // network recive buffer
-    char networkRxBuffer[CE4981_NETWORK_MAX_MESSAGE_SIZE];
+    // messages borrowed from the network, read in place
+    const network_message_t * rxMessages[NETWORK_PORT_QUEUE_DEPTH];
 
-    uint8_t receiveAddr;
-    uint8_t destinationAddr;
     unsigned int rxBufferSize;
 
     // TODO: These line is a temporary fix. The first transmission after reset
@@ -95,22 +246,68 @@ int main( void )
 
     while(1)
     {
-        //try a network read to check buffer.
-        if(network_rx((uint8_t *) networkRxBuffer, &receiveAddr, &destinationAddr))
+        //queue the flood being generated, reporting it once it finishes
+        if (flood_service())
         {
-            if(destinationAddr == 0x00)
-            {
-                uprintf("[ Broadcast from 0x%02X: %s ]\n", receiveAddr, networkRxBuffer);
-                uartRxReprint();
-            }
-            else if(destinationAddr == get_local_machine_address())
-            {
-                //print message
-                uprintf("[ From 0x%02X: %s ]\n", receiveAddr, networkRxBuffer);
-                uartRxReprint();
-            }
+            floodReport();
+        }
+
+        //send the probes that are due, reporting them once the last is answered
+        if (ping_service())
+        {
+            pingReport();
+        }
+
+#ifdef NETWORK_BERT
+        //run this board's part of bit error rate tests, reporting the one it started once it finishes
+        if (bert_service())
+        {
+            bertReport();
+        }
+#endif
+
+#ifdef NETWORK_CAPTURE
+        //stream the edges captured, reporting the capture once it's all out
+        if (capture_service())
+        {
+            capture_stats_t stats;
+            capture_stats(&stats);
+            uprintf("[ Captured %lu edges in %lu bytes, %lu dropped ]\n", stats.edges, stats.bytes, stats.dropped);
+        }
+#endif
+
+#ifdef NETWORK_SNIFF
+        //keep the sniffer's time stamps counting
+        sniffer_service();
+#endif
 
+        //decode received frames and print every message waiting on the default port
+        network_service();
+        unsigned int rxCount = network_port_borrow_batch(NETWORK_PORT_DEFAULT, rxMessages, NETWORK_PORT_QUEUE_DEPTH);
+        if(rxCount > 0)
+        {
+            for (unsigned int idx = 0; idx < rxCount; idx++)
+            {
+                const network_message_t * rxMessage = rxMessages[idx];
+                const char * text = (const char *) rxMessage->data;
 
+                if(rxMessage->destination == 0x00)
+                {
+                    uprintf("[ Broadcast from 0x%02X: %s ]\n", rxMessage->source, text);
+                }
+                else if(rxMessage->destination == get_local_machine_address())
+                {
+                    //print message
+                    uprintf("[ From 0x%02X: %s ]\n", rxMessage->source, text);
+                }
+                else
+                {
+                    //the receive filter only passes joined groups and, when promiscuous, everything
+                    uprintf("[ From 0x%02X to 0x%02X: %s ]\n", rxMessage->source, rxMessage->destination, text);
+                }
+            }
+            network_port_release(NETWORK_PORT_DEFAULT, rxCount);
+            uartRxReprint();
         }
         //if uart has full string get it and place it in transmit buffer.
         else if (uartRxReady())
@@ -130,6 +327,364 @@ int main( void )
                 set_local_machine_address((uint8_t)strtol(newAddress, NULL, 16));
                 uprintf("[ Local address set to 0x%02X ]\n", get_local_machine_address());
             }
+            //check if printing the per-class queueing delay
+            else if(!strncmp(uartRxBuffer, "/qstats", 7))
+            {
+                for (int txClass = 0; txClass < NETWORK_TX_CLASS_COUNT; txClass++)
+                {
+                    network_tx_class_stats_t stats;
+                    network_tx_class_stats(txClass, &stats);
+                    uprintf("[ %-7s frames: %lu, mean delay: %lu ms, max delay: %lu ms ]\n",
+                            txClassNames[txClass], stats.frames,
+                            stats.frames ? stats.delay_total_ms / stats.frames : 0,
+                            stats.delay_max_ms);
+                }
+                uprintf("[ expired frames: %lu ]\n", network_tx_expired_count());
+
+                netbuf_stats_t bufStats;
+                netbuf_stats(&bufStats);
+                uprintf("[ buffers: %lu allocated, %lu freed, %lu in use, %lu peak, %lu failed ]\n",
+                        bufStats.allocs, bufStats.frees, bufStats.in_use, bufStats.peak, bufStats.failures);
+                network_tx_class_stats_reset();
+            }
+            //check if configuring or printing the traffic shapers
+            else if(!strncmp(uartRxBuffer, "/shaper", 7))
+            {
+                unsigned int txClass, address, rate, burst;
+                if (sscanf(uartRxBuffer, "/shaper class %u %u %u", &txClass, &rate, &burst) == 3)
+                {
+                    if (rate > UINT16_MAX || burst > UINT16_MAX)
+                    {
+                        ERROR_HANDLE_NON_FATAL(ERROR_CODE_INVALID_UART_INPUT);
+                        continue;
+                    }
+                    ERROR_HANDLE_NON_FATAL(shaper_set_class(txClass, rate, burst));
+                }
+                else if (sscanf(uartRxBuffer, "/shaper dest %x %u %u", &address, &rate, &burst) == 3)
+                {
+                    if (address > UINT8_MAX || rate > UINT16_MAX || burst > UINT16_MAX)
+                    {
+                        ERROR_HANDLE_NON_FATAL(ERROR_CODE_INVALID_UART_INPUT);
+                        continue;
+                    }
+                    ERROR_HANDLE_NON_FATAL(shaper_set_dest(address, rate, burst));
+                }
+
+                // print the token level of every enabled shaper
+                shaper_info_t info;
+                for (int txClass = 0; txClass < NETWORK_TX_CLASS_COUNT; txClass++)
+                {
+                    shaper_get_class(txClass, &info);
+                    if (info.enabled)
+                    {
+                        uprintf("[ class %-7s %u/%u tokens, %u B/s ]\n", txClassNames[txClass],
+                                info.tokens_bytes, info.burst_bytes, info.rate_bytes_per_s);
+                    }
+                }
+                for (int idx = 0; idx < SHAPER_DEST_TABLE_SIZE; idx++)
+                {
+                    shaper_get_dest(idx, &info);
+                    if (info.enabled)
+                    {
+                        uprintf("[ dest 0x%02X %u/%u tokens, %u B/s ]\n", info.address,
+                                info.tokens_bytes, info.burst_bytes, info.rate_bytes_per_s);
+                    }
+                }
+            }
+            //check if toggling promiscuous receive
+            else if(!strncmp(uartRxBuffer, "/promisc", 8))
+            {
+                bool enable = rxBufferSize > 9 && !strcmp(uartRxBuffer + 9, "on");
+                network_rx_set_promiscuous(enable);
+                uprintf("[ Promiscuous mode %s, %lu frames filtered ]\n", enable ? "on" : "off",
+                        network_rx_filtered_count());
+            }
+            //check if toggling payload compression
+            else if(!strncmp(uartRxBuffer, "/compress", 9))
+            {
+                bool enable = rxBufferSize > 10 && !strcmp(uartRxBuffer + 10, "on");
+                network_compress_stats_t stats;
+                network_tx_set_compression(enable);
+                network_tx_compress_stats(&stats);
+                uprintf("[ Compression %s, %lu bytes sent as %lu ]\n", enable ? "on" : "off",
+                        stats.raw_bytes, stats.sent_bytes);
+            }
+            //check if toggling forward error correction
+            else if(!strncmp(uartRxBuffer, "/fec", 4))
+            {
+                bool enable = rxBufferSize > 5 && !strcmp(uartRxBuffer + 5, "on");
+                network_fec_stats_t stats;
+                network_tx_set_fec(enable);
+                network_rx_fec_stats(&stats);
+                uprintf("[ FEC %s, %lu frames received with %lu bits corrected, %lu uncorrectable ]\n",
+                        enable ? "on" : "off", stats.frames, stats.corrected_bits, stats.uncorrectable);
+            }
+            //check if selecting the transmit line code
+            else if(!strncmp(uartRxBuffer, "/linecode", 9))
+            {
+                if (rxBufferSize > 10 && !strcmp(uartRxBuffer + 10, "stuffed"))
+                {
+                    ERROR_HANDLE_NON_FATAL(network_tx_set_linecode(LINECODE_STUFFED));
+                    uprintf("[ Transmitting with bit stuffing ]\n");
+                }
+                else
+                {
+                    ERROR_HANDLE_NON_FATAL(network_tx_set_linecode(LINECODE_MANCHESTER));
+                    uprintf("[ Transmitting with Manchester ]\n");
+                }
+            }
+            //check if joining or leaving a multicast group
+            else if(!strncmp(uartRxBuffer, "/join", 5) || !strncmp(uartRxBuffer, "/leave", 6))
+            {
+                unsigned int group;
+                if (sscanf(uartRxBuffer, "/%*s %x", &group) != 1)
+                {
+                    ERROR_HANDLE_NON_FATAL(ERROR_CODE_INVALID_UART_INPUT);
+                }
+                else if (uartRxBuffer[1] == 'j')
+                {
+                    ERROR_HANDLE_NON_FATAL(network_rx_group_join(group));
+                    uprintf("[ Joined group 0x%02X ]\n", group);
+                }
+                else
+                {
+                    ERROR_HANDLE_NON_FATAL(network_rx_group_leave(group));
+                    uprintf("[ Left group 0x%02X ]\n", group);
+                }
+            }
+            //check if selecting the transmit scheduler
+            else if(!strncmp(uartRxBuffer, "/sched", 6))
+            {
+                if (rxBufferSize > 7 && !strcmp(uartRxBuffer + 7, "wrr"))
+                {
+                    ERROR_HANDLE_NON_FATAL(network_tx_set_sched(NETWORK_TX_SCHED_WEIGHTED));
+                    uprintf("[ Scheduler set to weighted round robin ]\n");
+                }
+                else if (rxBufferSize <= 7 || !strcmp(uartRxBuffer + 7, "strict"))
+                {
+                    ERROR_HANDLE_NON_FATAL(network_tx_set_sched(NETWORK_TX_SCHED_STRICT));
+                    uprintf("[ Scheduler set to strict priority ]\n");
+                }
+                else
+                {
+                    ERROR_HANDLE_NON_FATAL(ERROR_CODE_INVALID_UART_INPUT);
+                }
+            }
+#ifdef NETWORK_PHY_IMPAIR
+            //check if configuring or printing the channel impairments
+            else if(!strncmp(uartRxBuffer, "/impair", 7))
+            {
+                phy_impair_config_t config;
+                unsigned long seed, flipPpm, burstPpm;
+                unsigned int burstLength, jitterUs;
+                int skewPpm;
+                if (sscanf(uartRxBuffer, "/impair %lu %lu %lu %u %u %d", &seed, &flipPpm, &burstPpm,
+                           &burstLength, &jitterUs, &skewPpm) == 6)
+                {
+                    config = (phy_impair_config_t) { seed, flipPpm, burstPpm, burstLength, jitterUs, skewPpm };
+                    phy_impair_configure(&config);
+                }
+
+                phy_impair_stats_t stats;
+                phy_impair_get_config(&config);
+                phy_impair_stats(&stats);
+                uprintf("[ seed %lu, flip %lu ppm, burst %lu ppm x %u slots, jitter %u us, skew %d ppm ]\n",
+                        config.seed, config.bit_flip_ppm, config.burst_start_ppm, config.burst_length,
+                        config.jitter_us, config.skew_ppm);
+                uprintf("[ %lu slots received, %lu flipped in %lu bursts and alone, %lu edges sent ]\n",
+                        stats.slots, stats.flips, stats.bursts, stats.edges);
+            }
+#endif
+            //check if sending probes or reporting them:
+            //  /ping <dest> [size] [interval ms] [count, 0 until stopped]
+            //  /ping stop|stats
+            else if(!strncmp(uartRxBuffer, "/ping", 5))
+            {
+                unsigned int destination, size = 16, intervalMs = 1000, count = 10;
+
+                if (!strcmp(uartRxBuffer, "/ping stop"))
+                {
+                    ping_stop();
+                }
+                else if (strcmp(uartRxBuffer, "/ping stats") != 0)
+                {
+                    if (sscanf(uartRxBuffer, "/ping %x %u %u %u", &destination, &size, &intervalMs, &count) < 1 ||
+                        size > PING_SIZE_MAX || intervalMs > UINT16_MAX || count > UINT16_MAX)
+                    {
+                        ERROR_HANDLE_NON_FATAL(ERROR_CODE_INVALID_UART_INPUT);
+                        continue;
+                    }
+
+                    ping_config_t config = {
+                        .destination = destination,
+                        .size = size,
+                        .interval_ms = intervalMs,
+                        .count = count
+                    };
+                    ERROR_HANDLE_NON_FATAL(ping_start(&config));
+                    continue;
+                }
+
+                pingReport();
+            }
+#ifdef NETWORK_BERT
+            //check if testing the bit error rate of a rate, sweeping for the fastest rate or reporting:
+            //  /bert test <dest> <half bit us> [7|15] [size] [frames, 0 for enough]
+            //  /bert sweep <dest> [7|15] [threshold ppm] [size] [frames, 0 for enough]
+            //  /bert stop|stats
+            else if(!strncmp(uartRxBuffer, "/bert", 5))
+            {
+                unsigned int destination, halfBitUs = 0, order = 7, size = 64, frames = 0;
+                unsigned long thresholdPpm = 100;
+                int fields;
+
+                if (!strcmp(uartRxBuffer, "/bert stop"))
+                {
+                    bert_stop();
+                }
+                else if (strcmp(uartRxBuffer, "/bert stats") != 0)
+                {
+                    if (!strncmp(uartRxBuffer, "/bert test ", 11))
+                    {
+                        fields = sscanf(uartRxBuffer, "/bert test %x %u %u %u %u", &destination, &halfBitUs,
+                                        &order, &size, &frames);
+                        fields = fields >= 2 && halfBitUs > 0;
+                    }
+                    else
+                    {
+                        fields = sscanf(uartRxBuffer, "/bert sweep %x %u %lu %u %u", &destination, &order,
+                                        &thresholdPpm, &size, &frames) >= 1;
+                    }
+                    if (!fields || (order != 7 && order != 15) || size > UINT8_MAX || frames > UINT16_MAX ||
+                        halfBitUs > UINT16_MAX)
+                    {
+                        ERROR_HANDLE_NON_FATAL(ERROR_CODE_INVALID_UART_INPUT);
+                        continue;
+                    }
+
+                    bert_config_t config = {
+                        .destination = destination,
+                        .pattern = order == 7 ? BERT_PRBS7 : BERT_PRBS15,
+                        .size = size,
+                        .frames = frames,
+                        .half_bit_us = halfBitUs,
+                        .threshold_ppm = thresholdPpm
+                    };
+                    ERROR_HANDLE_NON_FATAL(bert_start(&config));
+                    continue;
+                }
+
+                bertReport();
+            }
+#endif
+            //check if generating a flood or reporting floods:
+            //  /flood <dest> <size|min-max|imix> <rate|max> <seconds> [zeros|ones|counter|random]
+            //  /flood stop|stats|reset
+            else if(!strncmp(uartRxBuffer, "/flood", 6))
+            {
+                char sizes[16], rate[16], pattern[16] = "counter";
+                unsigned int destination, seconds, sizeMin, sizeMax;
+                flood_config_t config = { .sizes = FLOOD_SIZES_UNIFORM };
+
+                if (!strcmp(uartRxBuffer, "/flood stop"))
+                {
+                    flood_stop();
+                }
+                else if (!strcmp(uartRxBuffer, "/flood reset"))
+                {
+                    flood_rx_reset();
+                }
+                else if (strcmp(uartRxBuffer, "/flood stats") != 0)
+                {
+                    if (sscanf(uartRxBuffer, "/flood %x %15s %15s %u %15s", &destination, sizes, rate,
+                               &seconds, pattern) < 4 ||
+                        !flood_pattern_from_name(pattern, &config.pattern))
+                    {
+                        ERROR_HANDLE_NON_FATAL(ERROR_CODE_INVALID_UART_INPUT);
+                        continue;
+                    }
+
+                    if (!strcmp(sizes, "imix"))
+                    {
+                        config.sizes = FLOOD_SIZES_IMIX;
+                        sizeMin = FLOOD_SIZE_MIN;
+                        sizeMax = FLOOD_SIZE_MAX;
+                    }
+                    else if (sscanf(sizes, "%u-%u", &sizeMin, &sizeMax) != 2)
+                    {
+                        config.sizes = FLOOD_SIZES_FIXED;
+                        sizeMin = sizeMax = strtoul(sizes, NULL, 10);
+                    }
+
+                    config.destination = destination;
+                    config.size_min = sizeMin > FLOOD_SIZE_MAX ? 0 : sizeMin;
+                    config.size_max = sizeMax > FLOOD_SIZE_MAX ? 0 : sizeMax;
+                    config.rate = strcmp(rate, "max") ? strtoul(rate, NULL, 10) : 0;
+                    config.duration_ms = seconds * 1000UL;
+                    ERROR_HANDLE_NON_FATAL(flood_start(&config));
+                }
+
+                floodReport();
+            }
+#ifdef NETWORK_CAPTURE
+            //check if capturing the edges on the bus: /capture start|stop
+            else if(!strncmp(uartRxBuffer, "/capture", 8))
+            {
+                if (!strcmp(uartRxBuffer, "/capture start"))
+                {
+                    ERROR_HANDLE_NON_FATAL(capture_start());
+                }
+                else if (!strcmp(uartRxBuffer, "/capture stop"))
+                {
+                    capture_stop();
+                }
+                else
+                {
+                    ERROR_HANDLE_NON_FATAL(ERROR_CODE_INVALID_UART_INPUT);
+                }
+            }
+#endif
+#ifdef NETWORK_SNIFF
+            //check if streaming every frame as pcap records or reporting them: /sniff start|stop|stats
+            else if(!strncmp(uartRxBuffer, "/sniff", 6))
+            {
+                if (!strcmp(uartRxBuffer, "/sniff start"))
+                {
+                    ERROR_HANDLE_NON_FATAL(sniffer_start());
+                }
+                else if (!strcmp(uartRxBuffer, "/sniff stop"))
+                {
+                    sniffer_stop();
+                }
+                else if (strcmp(uartRxBuffer, "/sniff stats") != 0)
+                {
+                    ERROR_HANDLE_NON_FATAL(ERROR_CODE_INVALID_UART_INPUT);
+                    continue;
+                }
+
+                sniffer_stats_t stats;
+                sniffer_stats(&stats);
+                uprintf("[ Sniffer %s: %lu frames, %lu crc errors, %lu line code errors, %lu collisions, %lu bytes sent ]\n",
+                        stats.running ? "running" : "stopped", stats.frames, stats.crc_errors,
+                        stats.linecode_errors, stats.collisions, stats.bytes);
+            }
+#endif
+#ifdef NETWORK_BENCH
+            //check if running the microbenchmarks, optionally with a number of samples
+            else if(!strncmp(uartRxBuffer, "/bench", 6))
+            {
+                unsigned int samples = 31;
+                sscanf(uartRxBuffer, "/bench %u", &samples);
+                if (samples == 0 || samples > MICROBENCH_SAMPLES_MAX)
+                {
+                    ERROR_HANDLE_NON_FATAL(ERROR_CODE_INVALID_UART_INPUT);
+                }
+                else
+                {
+                    ERROR_HANDLE_NON_FATAL(network_bench_run(samples));
+                }
+            }
+#endif
             else if(uartRxBuffer[0] != '0' || (uartRxBuffer[1] != 'x' && uartRxBuffer[1] != 'X') ||
                 !isxdigit(uartRxBuffer[2]) || !isxdigit(uartRxBuffer[3]) || uartRxBuffer[4] != ' ')
             {
@@ -141,11 +696,18 @@ int main( void )
                 char address[2] = {uartRxBuffer[2], uartRxBuffer[3]};
                 uint8_t destinationAddress = (uint8_t)strtol(address, NULL, 16);
 
-                // Get Message from input
-                char message[CE4981_NETWORK_MAX_MESSAGE_SIZE];
-                memcpy(message, uartRxBuffer+5, CE4981_NETWORK_MAX_MESSAGE_SIZE);
+                // Get Message from input, copied once into the buffer the network sends from
+                netbuf_t * buf = netbuf_alloc();
+                if (buf == NULL)
+                {
+                    ERROR_HANDLE_NON_FATAL(ERROR_CODE_NETWORK_BUF_POOL_EMPTY);
+                    continue;
+                }
+                char * message = (char *) buf->data;
                 // Size of the message
                 unsigned int messageSize = rxBufferSize - 5;
+                memcpy(message, uartRxBuffer + 5, messageSize);
+                message[messageSize] = '\0';
 
                 //check for preset transmissions
                 if(!strcmp(message,".zeros")) {
@@ -164,7 +726,21 @@ int main( void )
                     uprintf("[ To 0x%02X: %s ]\n", destinationAddress, message);
                 }
 
-                ERROR_HANDLE_FATAL(network_tx(destinationAddress, (uint8_t *) message, messageSize));
+                network_tx_params_t params = {
+                    .tx_class = NETWORK_TX_CLASS_NORMAL,
+                    .ttl_ms = NETWORK_TX_NO_TTL
+                };
+                buf->length = messageSize;
+
+                // a paused or shaped destination can fill the queue, so the
+                // message is dropped rather than halting the board
+                ERROR_CODE txError = network_tx_buf(destinationAddress, buf, &params, NULL);
+                if (txError == ERROR_CODE_NETWORK_MSG_QUEUE_FULL)
+                {
+                    uprintf("[ Transmit queue full, message dropped ]\n");
+                }
+                ERROR_HANDLE_NON_FATAL(txError);
+                netbuf_free(buf);
             }
         }
     }
@@ -0,0 +1,260 @@
+/* --------------------------------- Header --------------------------------- */
+
+
+/**
+ * @file    bipbuf.c
+ * @brief   Contains a byte ring buffer of variable length records
+ *
+ * Records are kept contiguous like in a bip buffer. A record that doesn't fit
+ * before the end of the storage is written at its start instead, leaving a
+ * wrap marker where it would have gone. Records are padded to a multiple of
+ * four bytes so they can hold structures.
+ *
+ * The producer publishes a record by storing tail with release ordering
+ * after writing it, and the consumer loads tail with acquire ordering before
+ * reading it. Head is handed back the same way, so neither side ever sees a
+ * record or free space before the other side is done with it.
+ */
+
+
+/* -------------------------------- Includes -------------------------------- */
+
+
+# include "bipbuf.h"
+
+
+/* --------------------------------- Defines -------------------------------- */
+
+
+/**
+ * Length prefix of the marker left where a record would not fit
+ */
+# define BIPBUF_WRAP    ( 0xFFFFFFFFUL )
+
+
+/* ------------------------------- Functions -------------------------------- */
+
+
+/**
+ * Initializes an empty ring
+ *
+ * @param   [out]   buf         The ring
+ * @param   [in]    storage     Storage for records, aligned to four bytes
+ * @param   [in]    capacity    The size of storage in bytes, a power of two
+ *
+ * @return  bool if the capacity is a power of two of at least four bytes
+ */
+bool bipbuf_init( bipbuf_t * buf, void * storage, uint32_t capacity )
+{
+    if ( capacity < sizeof( uint32_t ) || ( capacity & ( capacity - 1 ) ) )
+    {
+        return false;
+    }
+
+    buf->data = storage;
+    buf->mask = capacity - 1;
+    atomic_init( &buf->head, 0 );
+    atomic_init( &buf->tail, 0 );
+    atomic_init( &buf->pushed, 0 );
+    atomic_init( &buf->popped, 0 );
+
+    return true;
+}
+
+
+/**
+ * Finds room for a record without adding it
+ *
+ * NOTE:
+ * Nothing is changed until the record is committed, so a reservation can be
+ * abandoned or made again freely. Only the producer may reserve.
+ *
+ * @param   [in]    buf     The ring
+ * @param   [in]    size    The largest size the record may have
+ *
+ * @return  Where to write the record, or NULL if there is no room
+ */
+void * bipbuf_reserve( const bipbuf_t * buf, uint32_t size )
+{
+    uint32_t head = atomic_load_explicit( &buf->head, memory_order_acquire );
+    uint32_t tail = atomic_load_explicit( &buf->tail, memory_order_relaxed );
+    uint32_t capacity = buf->mask + 1;
+    uint32_t free = capacity - ( tail - head );
+    uint32_t offset = tail & buf->mask;
+    uint32_t need = BIPBUF_RECORD_BYTES( size );
+
+    // after the newest record
+    if ( offset + need <= capacity )
+    {
+        return need <= free ? buf->data + offset + sizeof( uint32_t ) : NULL;
+    }
+
+    // at the start of the storage, skipping the rest of it
+    return capacity - offset + need <= free ? buf->data + sizeof( uint32_t ) : NULL;
+}
+
+
+/**
+ * Adds a reserved record to the ring
+ *
+ * @param   [in]    buf     The ring
+ * @param   [in]    record  The record returned by bipbuf_reserve()
+ * @param   [in]    size    The size of the record, no more than was reserved
+ */
+void bipbuf_commit( bipbuf_t * buf, void * record, uint32_t size )
+{
+    uint32_t tail = atomic_load_explicit( &buf->tail, memory_order_relaxed );
+    uint32_t offset = tail & buf->mask;
+    uint32_t record_offset = ( uint8_t * ) record - buf->data - sizeof( uint32_t );
+
+    // the record went to the start of the storage
+    if ( record_offset != offset )
+    {
+        *( uint32_t * ) ( buf->data + offset ) = BIPBUF_WRAP;
+        tail += buf->mask + 1 - offset;
+    }
+    *( uint32_t * ) ( buf->data + record_offset ) = size;
+    tail += BIPBUF_RECORD_BYTES( size );
+
+    // publish the record after it has been written
+    atomic_store_explicit( &buf->tail, tail, memory_order_release );
+    atomic_fetch_add_explicit( &buf->pushed, 1, memory_order_relaxed );
+}
+
+
+/**
+ * Follows wrap markers from a position to the record there
+ */
+static void * bipbuf_record_at( const bipbuf_t * buf, uint32_t position, uint32_t * size )
+{
+    if ( position == atomic_load_explicit( &buf->tail, memory_order_acquire ) )
+    {
+        return NULL;
+    }
+
+    uint32_t offset = position & buf->mask;
+    uint32_t length = *( uint32_t * ) ( buf->data + offset );
+    if ( length == BIPBUF_WRAP )
+    {
+        offset = 0;
+        length = *( uint32_t * ) buf->data;
+    }
+
+    if ( size != NULL )
+    {
+        *size = length;
+    }
+
+    return buf->data + offset + sizeof( uint32_t );
+}
+
+
+/**
+ * Gets the position just past a record
+ */
+static uint32_t bipbuf_record_end( const bipbuf_t * buf, const void * record )
+{
+    uint32_t head = atomic_load_explicit( &buf->head, memory_order_relaxed );
+    uint32_t offset = ( const uint8_t * ) record - buf->data - sizeof( uint32_t );
+    uint32_t length = *( const uint32_t * ) ( buf->data + offset );
+
+    // records sit no more than one lap past head
+    return head + ( ( offset - head ) & buf->mask ) + BIPBUF_RECORD_BYTES( length );
+}
+
+
+/**
+ * Gets the oldest record
+ *
+ * NOTE:
+ * Only the consumer may read records
+ *
+ * @param   [in]    buf     The ring
+ * @param   [out]   size    The size of the record (may be NULL)
+ *
+ * @return  The record, or NULL if the ring is empty
+ */
+void * bipbuf_peek( const bipbuf_t * buf, uint32_t * size )
+{
+    return bipbuf_record_at( buf, atomic_load_explicit( &buf->head, memory_order_relaxed ), size );
+}
+
+
+/**
+ * Gets the record after another
+ *
+ * @param   [in]    buf     The ring
+ * @param   [in]    record  A record in the ring
+ * @param   [out]   size    The size of the next record (may be NULL)
+ *
+ * @return  The next record, or NULL if record is the newest
+ */
+void * bipbuf_next( const bipbuf_t * buf, const void * record, uint32_t * size )
+{
+    return bipbuf_record_at( buf, bipbuf_record_end( buf, record ), size );
+}
+
+
+/**
+ * Removes the oldest record
+ *
+ * @param   [in]    buf     The ring
+ */
+void bipbuf_pop( bipbuf_t * buf )
+{
+    void * record = bipbuf_peek( buf, NULL );
+
+    if ( record == NULL )
+    {
+        return;
+    }
+
+    // hand the space back after the record has been read
+    atomic_store_explicit( &buf->head, bipbuf_record_end( buf, record ), memory_order_release );
+    atomic_fetch_add_explicit( &buf->popped, 1, memory_order_relaxed );
+}
+
+
+/**
+ * Determines whether a ring is empty
+ *
+ * @param   [in]    buf     The ring
+ *
+ * @return  True if the ring holds no records
+ */
+bool bipbuf_is_empty( const bipbuf_t * buf )
+{
+    return atomic_load_explicit( &buf->head, memory_order_relaxed ) ==
+           atomic_load_explicit( &buf->tail, memory_order_relaxed );
+}
+
+
+/**
+ * Gets the number of records in a ring
+ *
+ * @param   [in]    buf     The ring
+ *
+ * @return  The number of records
+ */
+uint32_t bipbuf_count( const bipbuf_t * buf )
+{
+    return atomic_load_explicit( &buf->pushed, memory_order_relaxed ) -
+           atomic_load_explicit( &buf->popped, memory_order_relaxed );
+}
+
+
+/**
+ * Gets the number of bytes records take in a ring
+ *
+ * @param   [in]    buf     The ring
+ *
+ * @return  The number of bytes used, including any wrap padding
+ */
+uint32_t bipbuf_used( const bipbuf_t * buf )
+{
+    return atomic_load_explicit( &buf->tail, memory_order_relaxed ) -
+           atomic_load_explicit( &buf->head, memory_order_relaxed );
+}
+
+
+/* -------------------------------------------------------------------------- */
@@ -0,0 +1,82 @@
+/* --------------------------------- Header --------------------------------- */
+
+
+/**
+ * @file    bipbuf.h
+ * @brief   Contains a byte ring buffer of variable length records
+ */
+
+
+/* ------------------------------ Header Guard ------------------------------ */
+
+
+# ifndef UTIL_BIPBUF_H
+# define UTIL_BIPBUF_H
+
+
+/* -------------------------------- Includes -------------------------------- */
+
+
+# include <stddef.h>
+# include <stdint.h>
+# include <stdbool.h>
+# include <stdatomic.h>
+
+
+/* --------------------------------- Defines -------------------------------- */
+
+
+/**
+ * Bytes taken by a record of a given size, including its length prefix
+ */
+# define BIPBUF_RECORD_BYTES( size ) ( sizeof( uint32_t ) + ( ( ( size ) + 3 ) & ~3UL ) )
+
+
+/* ---------------------------------- Types --------------------------------- */
+
+
+/**
+ * A ring of records, each a length prefix followed by its data
+ *
+ * NOTE:
+ * One producer may push records while one consumer pops them, either of
+ * which may run in an interrupt. The producer only writes tail and pushed,
+ * the consumer only writes head and popped. Head and tail count bytes
+ * forever and are masked into the storage, so a full ring is never mistaken
+ * for an empty one.
+ */
+typedef struct
+{
+    uint8_t * data;
+    uint32_t mask;
+    _Atomic uint32_t head;      // position of the oldest record
+    _Atomic uint32_t tail;      // position the next record is written at
+    _Atomic uint32_t pushed;
+    _Atomic uint32_t popped;
+} bipbuf_t;
+
+
+/* ------------------------------- Functions -------------------------------- */
+
+
+bool bipbuf_init( bipbuf_t * buf, void * storage, uint32_t capacity );
+
+void * bipbuf_reserve( const bipbuf_t * buf, uint32_t size );
+void bipbuf_commit( bipbuf_t * buf, void * record, uint32_t size );
+
+void * bipbuf_peek( const bipbuf_t * buf, uint32_t * size );
+void * bipbuf_next( const bipbuf_t * buf, const void * record, uint32_t * size );
+void bipbuf_pop( bipbuf_t * buf );
+
+bool bipbuf_is_empty( const bipbuf_t * buf );
+uint32_t bipbuf_count( const bipbuf_t * buf );
+uint32_t bipbuf_used( const bipbuf_t * buf );
+
+
+/* --------------------------------- Footer --------------------------------- */
+
+
+# endif // UTIL_BIPBUF_H
+
+
+/* -------------------------------------------------------------------------- */
@@ -0,0 +1,67 @@
+/* --------------------------------- Header --------------------------------- */
+
+
+/**
+ * @file    crc8.c
+ * @brief   Contains the 8 bit CRC frames are checked with
+ */
+
+
+/* -------------------------------- Includes -------------------------------- */
+
+
+# include <stdbool.h>
+# include "crc8.h"
+
+
+/* --------------------------------- Defines -------------------------------- */
+
+
+# define CRC8_POLYNOMIAL    ( 0x07 )
+
+
+/* ------------------------------- Functions -------------------------------- */
+
+
+/**
+ * Calculates an 8-bit CRC value for a given buffer of bytes
+ *
+ * @param   [in]    buffer      The input buffer to calculate CRC from
+ * @param   [in]    size        The size of the input buffer
+ * @param   [in]    initial     Initial value for the remainder byte. Can be
+ *                              used to save state between multiple calls, or
+ *                              use a non-zero initial value, as some protocols do
+ *
+ * @return  the result of the CRC calculation on the buffer
+ */
+uint8_t crc8_calculate( const uint8_t * buffer, size_t size, uint8_t initial )
+{
+    uint8_t result = initial;
+    for ( size_t byteIdx = 0; byteIdx < size; ++byteIdx )
+    {
+        uint8_t input = buffer[byteIdx];
+        for ( unsigned short bitIdx = 0; bitIdx < 8; ++bitIdx )
+        {
+            /*
+             * instead of xoring each bit of the result specific to the polynomial with the input
+             * we can xor the entire byte with the polynmomial bits if the input XOR MSB of result is a 1
+             * xor-ing with 0 causes no change and xor-ing with 1 causes bit toggle
+             * therefore only the bits with a 1 in the polynomial (corresponding to xor in the circuit in class)
+             * will be toggled, and only when the input bit is a 1 and would have toggled the bits
+             */
+            bool invert = ( ( input >> ( 7 - bitIdx ) ) & 0x01 ) ^ ( result >> 7 );
+
+            // shift, LSB of result will be 0, and will take the value of invert since LSB of CRC8_POLYNOMIAL is always a 1
+            result = result << 1;
+
+            if ( invert )
+            {
+                result ^= CRC8_POLYNOMIAL;
+            }
+        }
+    }
+    return result;
+}
+
+
+/* -------------------------------------------------------------------------- */
@@ -0,0 +1,36 @@
+/* --------------------------------- Header --------------------------------- */
+
+
+/**
+ * @file    crc8.h
+ * @brief   Contains the 8 bit CRC frames are checked with
+ */
+
+
+/* ------------------------------ Header Guard ------------------------------ */
+
+
+# ifndef UTIL_CRC8_H
+# define UTIL_CRC8_H
+
+
+/* -------------------------------- Includes -------------------------------- */
+
+
+# include <stddef.h>
+# include <stdint.h>
+
+
+/* ------------------------------- Functions -------------------------------- */
+
+
+uint8_t crc8_calculate( const uint8_t * buffer, size_t size, uint8_t initial );
+
+
+/* --------------------------------- Footer --------------------------------- */
+
+
+# endif // UTIL_CRC8_H
+
+
+/* -------------------------------------------------------------------------- */
@@ -0,0 +1,60 @@
+/* --------------------------------- Header --------------------------------- */
+
+
+/**
+ * @file    critical.h
+ * @brief   Contains critical sections for state shared with interrupts
+ */
+
+
+/* ------------------------------ Header Guard ------------------------------ */
+
+
+# ifndef UTIL_CRITICAL_H
+# define UTIL_CRITICAL_H
+
+
+/* -------------------------------- Includes -------------------------------- */
+
+
+# include <stdint.h>
+# include "stm32f446xx.h"
+
+
+/* ------------------------------- Functions -------------------------------- */
+
+
+/**
+ * Masks interrupts until the matching critical_exit()
+ *
+ * NOTE:
+ * Critical sections nest, each one restores the mask it found
+ *
+ * @return  The previous interrupt mask to pass to critical_exit()
+ */
+static inline uint32_t critical_enter( void )
+{
+    uint32_t primask = __get_PRIMASK( );
+    __disable_irq( );
+    return primask;
+}
+
+
+/**
+ * Restores the interrupt mask saved by critical_enter()
+ *
+ * @param   [in]    primask     The mask returned by critical_enter()
+ */
+static inline void critical_exit( uint32_t primask )
+{
+    __set_PRIMASK( primask );
+}
+
+
+/* --------------------------------- Footer --------------------------------- */
+
+
+# endif // UTIL_CRITICAL_H
+
+
+/* -------------------------------------------------------------------------- */
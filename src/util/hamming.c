@@ -0,0 +1,139 @@
+/* --------------------------------- Header --------------------------------- */
+
+
+/**
+ * @file    hamming.c
+ * @brief   Contains an extended Hamming (8,4) forward error correcting code
+ *
+ * Every nibble is sent as one codeword byte, high nibble first. Bits 0 to 6
+ * of a codeword are Hamming (7,4) positions 1 to 7, with parity bits at the
+ * power of two positions 1, 2 and 4, and bit 7 is the parity of the whole
+ * codeword. Any single bit error in a codeword is corrected and any double
+ * bit error is detected.
+ */
+
+
+/* -------------------------------- Includes -------------------------------- */
+
+
+# include "hamming.h"
+
+
+/* ---------------------------- Global Variables ---------------------------- */
+
+
+/**
+ * Codewords of every nibble
+ */
+static const uint8_t hamming84_codewords[16] = {
+    0x00, 0x87, 0x99, 0x1E, 0xAA, 0x2D, 0x33, 0xB4,
+    0x4B, 0xCC, 0xD2, 0x55, 0xE1, 0x66, 0x78, 0xFF
+};
+
+
+/* ------------------------------- Functions -------------------------------- */
+
+
+/**
+ * Decodes a single codeword
+ *
+ * @param   [in]    codeword    The received codeword
+ * @param   [out]   nibble      The decoded nibble
+ *
+ * @return  The number of bits corrected (0 or 1), or -1 if the codeword has
+ *          more errors than can be corrected
+ */
+static int hamming84_decode_codeword( uint8_t codeword, uint8_t * nibble )
+{
+    // xor of the positions of every set bit is the position of a single error
+    uint8_t syndrome = 0;
+    for ( uint8_t position = 1; position <= 7; position++ )
+    {
+        if ( codeword & ( 1 << ( position - 1 ) ) )
+        {
+            syndrome ^= position;
+        }
+    }
+
+    uint8_t parity = codeword;
+    parity ^= parity >> 4;
+    parity ^= parity >> 2;
+    parity ^= parity >> 1;
+    parity &= 1;
+
+    int corrected = 0;
+    if ( parity )
+    {
+        // odd number of errors, assume one, at the overall parity bit if the syndrome is clear
+        codeword ^= syndrome ? 1 << ( syndrome - 1 ) : 0x80;
+        corrected = 1;
+    }
+    else if ( syndrome )
+    {
+        return -1;
+    }
+
+    // data bits are at positions 3, 5, 6 and 7
+    *nibble = ( ( codeword >> 2 ) & 0x01 ) | ( ( codeword >> 3 ) & 0x0E );
+
+    return corrected;
+}
+
+
+/**
+ * Encodes a buffer
+ *
+ * @param   [in]    in      The data to encode
+ * @param   [in]    size    The number of bytes to encode
+ * @param   [out]   out     Buffer of 2 * size bytes to place the codewords in
+ */
+void hamming84_encode( const uint8_t * in, size_t size, uint8_t * out )
+{
+    for ( size_t i = 0; i < size; i++ )
+    {
+        out[i * 2] = hamming84_codewords[in[i] >> 4];
+        out[i * 2 + 1] = hamming84_codewords[in[i] & 0x0F];
+    }
+}
+
+
+/**
+ * Decodes a buffer, correcting single bit errors in every codeword
+ *
+ * @param   [in]    in          The codewords to decode
+ * @param   [in]    size        The number of bytes to decode (2 * size codewords)
+ * @param   [out]   out         Buffer to place the decoded data in
+ * @param   [out]   corrected   Incremented by the number of bits corrected (may be NULL)
+ *
+ * @return  bool if every codeword could be decoded
+ */
+bool hamming84_decode( const uint8_t * in, size_t size, uint8_t * out, unsigned int * corrected )
+{
+    unsigned int total = 0;
+
+    for ( size_t i = 0; i < size; i++ )
+    {
+        uint8_t high;
+        uint8_t low;
+        int high_corrected = hamming84_decode_codeword( in[i * 2], &high );
+        int low_corrected = hamming84_decode_codeword( in[i * 2 + 1], &low );
+
+        if ( high_corrected < 0 || low_corrected < 0 )
+        {
+            return false;
+        }
+
+        out[i] = high << 4 | low;
+        total += high_corrected + low_corrected;
+    }
+
+    if ( corrected != NULL )
+    {
+        *corrected += total;
+    }
+
+    return true;
+}
+
+
+/* -------------------------------------------------------------------------- */
@@ -0,0 +1,38 @@
+/* --------------------------------- Header --------------------------------- */
+
+
+/**
+ * @file    hamming.h
+ * @brief   Contains an extended Hamming (8,4) forward error correcting code
+ */
+
+
+/* ------------------------------ Header Guard ------------------------------ */
+
+
+# ifndef UTIL_HAMMING_H
+# define UTIL_HAMMING_H
+
+
+/* -------------------------------- Includes -------------------------------- */
+
+
+# include <stddef.h>
+# include <stdint.h>
+# include <stdbool.h>
+
+
+/* ------------------------------- Functions -------------------------------- */
+
+
+void hamming84_encode( const uint8_t * in, size_t size, uint8_t * out );
+bool hamming84_decode( const uint8_t * in, size_t size, uint8_t * out, unsigned int * corrected );
+
+
+/* --------------------------------- Footer --------------------------------- */
+
+
+# endif // UTIL_HAMMING_H
+
+
+/* -------------------------------------------------------------------------- */
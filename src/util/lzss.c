@@ -0,0 +1,181 @@
+/* --------------------------------- Header --------------------------------- */
+
+
+/**
+ * @file    lzss.c
+ * @brief   Contains a small LZSS compressor for network payloads
+ *
+ * The compressed stream is a sequence of groups, each a control byte followed
+ * by up to eight items. Bit n of the control byte, starting from the least
+ * significant bit, says whether item n is a literal byte (0) or a two byte
+ * match (1) of { distance - 1, length - LZSS_MIN_MATCH }.
+ *
+ * The encoder searches the window directly instead of keeping a dictionary,
+ * so neither side uses any memory beyond the caller's buffers.
+ */
+
+
+/* -------------------------------- Includes -------------------------------- */
+
+
+# include "lzss.h"
+
+
+/* ------------------------------- Functions -------------------------------- */
+
+
+/**
+ * Compresses a buffer
+ *
+ * @param   [in]    in          The data to compress
+ * @param   [in]    in_size     The number of bytes to compress
+ * @param   [out]   out         Buffer to place the compressed data in
+ * @param   [in]    out_max     The size of the out buffer
+ *
+ * @return  The compressed size, or 0 if the data doesn't compress to less
+ *          than out_max bytes
+ */
+size_t lzss_compress( const uint8_t * in, size_t in_size, uint8_t * out, size_t out_max )
+{
+    size_t in_idx = 0;
+    size_t out_idx = 0;
+    size_t control_idx = 0;
+    uint8_t control_bit = 8;
+
+    while ( in_idx < in_size )
+    {
+        // start a new group
+        if ( control_bit == 8 )
+        {
+            if ( out_idx >= out_max )
+            {
+                return 0;
+            }
+            control_idx = out_idx++;
+            out[control_idx] = 0;
+            control_bit = 0;
+        }
+
+        // find the longest match in the window
+        size_t max_len = in_size - in_idx;
+        if ( max_len > LZSS_MAX_MATCH )
+        {
+            max_len = LZSS_MAX_MATCH;
+        }
+        size_t best_len = 0;
+        size_t best_dist = 0;
+        size_t window_start = in_idx > LZSS_WINDOW_SIZE ? in_idx - LZSS_WINDOW_SIZE : 0;
+
+        for ( size_t candidate = window_start; candidate < in_idx && best_len < max_len; candidate++ )
+        {
+            // the byte that would extend the best match must match first
+            if ( in[candidate + best_len] != in[in_idx + best_len] )
+            {
+                continue;
+            }
+
+            size_t len = 0;
+            while ( len < max_len && in[candidate + len] == in[in_idx + len] )
+            {
+                len++;
+            }
+
+            if ( len > best_len )
+            {
+                best_len = len;
+                best_dist = in_idx - candidate;
+            }
+        }
+
+        if ( best_len >= LZSS_MIN_MATCH )
+        {
+            if ( out_idx + 2 > out_max )
+            {
+                return 0;
+            }
+            out[control_idx] |= 1 << control_bit;
+            out[out_idx++] = best_dist - 1;
+            out[out_idx++] = best_len - LZSS_MIN_MATCH;
+            in_idx += best_len;
+        }
+        else
+        {
+            if ( out_idx + 1 > out_max )
+            {
+                return 0;
+            }
+            out[out_idx++] = in[in_idx++];
+        }
+        control_bit++;
+    }
+
+    // only report success when the data actually got smaller
+    if ( out_idx >= out_max )
+    {
+        return 0;
+    }
+
+    return out_idx;
+}
+
+
+/**
+ * Decompresses a buffer
+ *
+ * @param   [in]    in          The compressed data
+ * @param   [in]    in_size     The number of compressed bytes
+ * @param   [out]   out         Buffer to place the decompressed data in
+ * @param   [in]    out_max     The size of the out buffer
+ * @param   [out]   out_size    The decompressed size
+ *
+ * @return  bool if the data was valid and fit in out
+ */
+bool lzss_decompress( const uint8_t * in, size_t in_size, uint8_t * out, size_t out_max, size_t * out_size )
+{
+    size_t in_idx = 0;
+    size_t out_idx = 0;
+
+    while ( in_idx < in_size )
+    {
+        uint8_t control = in[in_idx++];
+
+        for ( uint8_t control_bit = 0; control_bit < 8 && in_idx < in_size; control_bit++ )
+        {
+            if ( control & ( 1 << control_bit ) )
+            {
+                if ( in_idx + 2 > in_size )
+                {
+                    return false;
+                }
+                size_t dist = in[in_idx++] + 1;
+                size_t len = in[in_idx++] + LZSS_MIN_MATCH;
+
+                if ( dist > out_idx || out_idx + len > out_max )
+                {
+                    return false;
+                }
+
+                // copy forwards so matches may overlap their own output
+                for ( size_t i = 0; i < len; i++, out_idx++ )
+                {
+                    out[out_idx] = out[out_idx - dist];
+                }
+            }
+            else
+            {
+                if ( out_idx >= out_max )
+                {
+                    return false;
+                }
+                out[out_idx++] = in[in_idx++];
+            }
+        }
+    }
+
+    *out_size = out_idx;
+
+    return true;
+}
+
+
+/* -------------------------------------------------------------------------- */
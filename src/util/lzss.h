@@ -0,0 +1,50 @@
+/* --------------------------------- Header --------------------------------- */
+
+
+/**
+ * @file    lzss.h
+ * @brief   Contains a small LZSS compressor for network payloads
+ */
+
+
+/* ------------------------------ Header Guard ------------------------------ */
+
+
+# ifndef UTIL_LZSS_H
+# define UTIL_LZSS_H
+
+
+/* -------------------------------- Includes -------------------------------- */
+
+
+# include <stddef.h>
+# include <stdint.h>
+# include <stdbool.h>
+
+
+/* --------------------------------- Defines -------------------------------- */
+
+
+/**
+ * Matches are back references of LZSS_MIN_MATCH to LZSS_MAX_MATCH bytes up to
+ * LZSS_WINDOW_SIZE bytes back
+ */
+# define LZSS_WINDOW_SIZE   ( 256 )
+# define LZSS_MIN_MATCH     ( 3 )
+# define LZSS_MAX_MATCH     ( LZSS_MIN_MATCH + 255 )
+
+
+/* ------------------------------- Functions -------------------------------- */
+
+
+size_t lzss_compress( const uint8_t * in, size_t in_size, uint8_t * out, size_t out_max );
+bool lzss_decompress( const uint8_t * in, size_t in_size, uint8_t * out, size_t out_max, size_t * out_size );
+
+
+/* --------------------------------- Footer --------------------------------- */
+
+
+# endif // UTIL_LZSS_H
+
+
+/* -------------------------------------------------------------------------- */
@@ -0,0 +1,161 @@
+/* --------------------------------- Header --------------------------------- */
+
+
+/**
+ * @file    microbench.c
+ * @brief   Contains a cycle counting harness for microbenchmarks
+ *
+ * Every sample times a batch of calls and is divided by the batch, less the
+ * cost of reading the counter. Interrupts are left running, so a sample that
+ * an interrupt landed in reads high. The minimum and median are the figures
+ * to compare, and a mean well above the median shows the interference.
+ */
+
+
+/* -------------------------------- Includes -------------------------------- */
+
+
+# include "microbench.h"
+# include "uio.h"
+
+# if defined( __ARM_ARCH )
+# include "stm32f446xx.h"
+# elif defined( __x86_64__ ) || defined( __i386__ )
+# include <x86intrin.h>
+# else
+# include <time.h>
+# endif
+
+
+/* ----------------------------- Static Globals ----------------------------- */
+
+
+static uint32_t microbench_overhead;    // cycles between two back to back counter reads
+
+
+/* ------------------------------- Functions -------------------------------- */
+
+
+/**
+ * Starts the cycle counter and measures the cost of reading it
+ */
+void microbench_init( void )
+{
+# if defined( __ARM_ARCH )
+    CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+    DWT->CYCCNT = 0;
+    DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+# endif
+
+    microbench_overhead = UINT32_MAX;
+    for ( int i = 0; i < 16; i++ )
+    {
+        uint32_t start = microbench_cycles( );
+        uint32_t cycles = microbench_cycles( ) - start;
+        if ( cycles < microbench_overhead )
+        {
+            microbench_overhead = cycles;
+        }
+    }
+}
+
+
+/**
+ * Reads the cycle counter, differences are valid across one wrap
+ */
+uint32_t microbench_cycles( void )
+{
+# if defined( __ARM_ARCH )
+    return DWT->CYCCNT;
+# elif defined( __x86_64__ ) || defined( __i386__ )
+    return ( uint32_t ) __rdtsc( );
+# else
+    struct timespec ts;
+    clock_gettime( CLOCK_MONOTONIC, &ts );
+    return ( uint32_t ) ( ts.tv_sec * 1000000000ULL + ts.tv_nsec );
+# endif
+}
+
+
+/**
+ * Times an operation
+ *
+ * @param   [in]    fn          The operation
+ * @param   [in]    context     Passed to every call
+ * @param   [in]    samples     Samples to take, up to MICROBENCH_SAMPLES_MAX
+ * @param   [in]    batch       Calls timed together in every sample
+ * @param   [out]   result      Cycles per call over the samples
+ *
+ * @return  bool if the samples and batch were in range
+ */
+bool microbench_measure( microbench_fn_t fn, void * context, unsigned int samples, unsigned int batch,
+                         microbench_result_t * result )
+{
+    uint32_t cycles[MICROBENCH_SAMPLES_MAX];
+    uint64_t total = 0;
+
+    if ( samples == 0 || samples > MICROBENCH_SAMPLES_MAX || batch == 0 )
+    {
+        return false;
+    }
+
+    // warm the caches and branch predictors
+    fn( context );
+
+    for ( unsigned int sample = 0; sample < samples; sample++ )
+    {
+        uint32_t start = microbench_cycles( );
+        for ( unsigned int call = 0; call < batch; call++ )
+        {
+            fn( context );
+        }
+        uint32_t elapsed = microbench_cycles( ) - start;
+
+        elapsed = elapsed > microbench_overhead ? elapsed - microbench_overhead : 0;
+        uint32_t per_call = elapsed / batch;
+
+        // insertion sort, the samples are few
+        unsigned int i = sample;
+        for ( ; i > 0 && cycles[i - 1] > per_call; i-- )
+        {
+            cycles[i] = cycles[i - 1];
+        }
+        cycles[i] = per_call;
+        total += per_call;
+    }
+
+    result->samples = samples;
+    result->min = cycles[0];
+    result->median = cycles[samples / 2];
+    result->mean = ( uint32_t ) ( total / samples );
+    result->max = cycles[samples - 1];
+
+    return true;
+}
+
+
+/**
+ * Prints the names of the columns microbench_report() prints
+ */
+void microbench_report_header( void )
+{
+    uprintf( "bench,case,bytes,samples,min,median,mean,max\n" );
+}
+
+
+/**
+ * Prints a measurement in cycles per call
+ *
+ * @param   [in]    name    The operation measured
+ * @param   [in]    bytes   The bytes every call handles
+ * @param   [in]    result  The measurement
+ */
+void microbench_report( const char * name, size_t bytes, const microbench_result_t * result )
+{
+    uprintf( "bench,%s,%u,%lu,%lu,%lu,%lu,%lu\n", name, ( unsigned int ) bytes,
+             ( unsigned long ) result->samples, ( unsigned long ) result->min, ( unsigned long ) result->median,
+             ( unsigned long ) result->mean, ( unsigned long ) result->max );
+}
+
+
+/* -------------------------------------------------------------------------- */
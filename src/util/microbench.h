@@ -0,0 +1,80 @@
+/* --------------------------------- Header --------------------------------- */
+
+
+/**
+ * @file    microbench.h
+ * @brief   Contains a cycle counting harness for microbenchmarks
+ *
+ * On the target cycles are counted by the DWT cycle counter, on a host by
+ * the time stamp counter, or in nanoseconds where there isn't one. Results
+ * are printed as comma separated lines starting with "bench," so they can be
+ * picked out of the console and compared between builds.
+ */
+
+
+/* ------------------------------ Header Guard ------------------------------ */
+
+
+# ifndef UTIL_MICROBENCH_H
+# define UTIL_MICROBENCH_H
+
+
+/* -------------------------------- Includes -------------------------------- */
+
+
+# include <stddef.h>
+# include <stdint.h>
+# include <stdbool.h>
+
+
+/* --------------------------------- Defines -------------------------------- */
+
+
+/**
+ * The most samples a measurement takes
+ */
+# define MICROBENCH_SAMPLES_MAX     ( 63 )
+
+
+/* ---------------------------------- Types --------------------------------- */
+
+
+/**
+ * An operation to measure
+ */
+typedef void ( * microbench_fn_t )( void * context );
+
+
+/**
+ * Cycles per call of a measured operation
+ */
+typedef struct
+{
+    uint32_t samples;
+    uint32_t min;
+    uint32_t median;
+    uint32_t mean;
+    uint32_t max;
+} microbench_result_t;
+
+
+/* ------------------------------- Functions -------------------------------- */
+
+
+void microbench_init( void );
+uint32_t microbench_cycles( void );
+
+bool microbench_measure( microbench_fn_t fn, void * context, unsigned int samples, unsigned int batch,
+                         microbench_result_t * result );
+
+void microbench_report_header( void );
+void microbench_report( const char * name, size_t bytes, const microbench_result_t * result );
+
+
+/* --------------------------------- Footer --------------------------------- */
+
+
+# endif // UTIL_MICROBENCH_H
+
+
+/* -------------------------------------------------------------------------- */
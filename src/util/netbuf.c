@@ -0,0 +1,152 @@
+/* --------------------------------- Header --------------------------------- */
+
+
+/**
+ * @file    netbuf.c
+ * @brief   Contains a pool of fixed size reference counted message buffers
+ *
+ * Free buffers are tracked in a bitmap, one bit per buffer. Allocating
+ * clears the lowest set bit with a compare and swap and freeing sets it
+ * again, so buffers may be freed from interrupts while the main loop
+ * allocates without masking interrupts.
+ */
+
+
+/* -------------------------------- Includes -------------------------------- */
+
+
+# include "netbuf.h"
+
+
+/* --------------------------------- Defines -------------------------------- */
+
+
+# define NETBUF_MAP_WORDS   ( ( NETBUF_POOL_SIZE + 31 ) / 32 )
+
+
+/* ----------------------------- Static Globals ----------------------------- */
+
+
+static netbuf_t netbuf_pool[NETBUF_POOL_SIZE];
+static _Atomic uint32_t netbuf_free_map[NETBUF_MAP_WORDS];
+
+static _Atomic uint32_t netbuf_allocs;
+static _Atomic uint32_t netbuf_frees;
+static _Atomic uint32_t netbuf_failures;
+static _Atomic uint32_t netbuf_peak;
+
+
+/* ------------------------------- Functions -------------------------------- */
+
+
+/**
+ * Frees every buffer of the pool and clears its counters
+ */
+void netbuf_init( void )
+{
+    for ( unsigned int word = 0; word < NETBUF_MAP_WORDS; word++ )
+    {
+        unsigned int count = NETBUF_POOL_SIZE - word * 32;
+        atomic_store( &netbuf_free_map[word], count >= 32 ? 0xFFFFFFFFUL : ( 1UL << count ) - 1 );
+    }
+
+    atomic_store( &netbuf_allocs, 0 );
+    atomic_store( &netbuf_frees, 0 );
+    atomic_store( &netbuf_failures, 0 );
+    atomic_store( &netbuf_peak, 0 );
+}
+
+
+/**
+ * Takes a buffer from the pool
+ *
+ * @return  An empty buffer holding one reference, or NULL if the pool is empty
+ */
+netbuf_t * netbuf_alloc( void )
+{
+    for ( unsigned int word = 0; word < NETBUF_MAP_WORDS; word++ )
+    {
+        uint32_t map = atomic_load_explicit( &netbuf_free_map[word], memory_order_relaxed );
+
+        while ( map != 0 )
+        {
+            uint32_t bit = map & -map;
+
+            if ( atomic_compare_exchange_weak_explicit( &netbuf_free_map[word], &map, map & ~bit,
+                                                        memory_order_acquire, memory_order_relaxed ) )
+            {
+                netbuf_t * buf = &netbuf_pool[word * 32 + __builtin_ctz( bit )];
+                atomic_store_explicit( &buf->refs, 1, memory_order_relaxed );
+                buf->length = 0;
+
+                uint32_t in_use = atomic_fetch_add_explicit( &netbuf_allocs, 1, memory_order_relaxed ) + 1 -
+                                  atomic_load_explicit( &netbuf_frees, memory_order_relaxed );
+                uint32_t peak = atomic_load_explicit( &netbuf_peak, memory_order_relaxed );
+                while ( in_use > peak &&
+                        !atomic_compare_exchange_weak_explicit( &netbuf_peak, &peak, in_use,
+                                                                memory_order_relaxed, memory_order_relaxed ) )
+                {
+                }
+
+                return buf;
+            }
+        }
+    }
+
+    atomic_fetch_add_explicit( &netbuf_failures, 1, memory_order_relaxed );
+    return NULL;
+}
+
+
+/**
+ * Takes another reference to a buffer
+ *
+ * @param   [in]    buf     The buffer, which the caller holds a reference to
+ *
+ * @return  The buffer
+ */
+netbuf_t * netbuf_ref( netbuf_t * buf )
+{
+    atomic_fetch_add_explicit( &buf->refs, 1, memory_order_relaxed );
+    return buf;
+}
+
+
+/**
+ * Drops a reference to a buffer, returning it to the pool with its last one
+ *
+ * @param   [in]    buf     The buffer, may be NULL
+ */
+void netbuf_free( netbuf_t * buf )
+{
+    if ( buf == NULL )
+    {
+        return;
+    }
+
+    // every holder's writes to the buffer happen before it is reused
+    if ( atomic_fetch_sub_explicit( &buf->refs, 1, memory_order_acq_rel ) == 1 )
+    {
+        unsigned int idx = buf - netbuf_pool;
+        atomic_fetch_add_explicit( &netbuf_frees, 1, memory_order_relaxed );
+        atomic_fetch_or_explicit( &netbuf_free_map[idx / 32], 1UL << ( idx % 32 ), memory_order_release );
+    }
+}
+
+
+/**
+ * Gets the pool counters
+ *
+ * @param   [out]   stats   The counters
+ */
+void netbuf_stats( netbuf_stats_t * stats )
+{
+    stats->allocs = atomic_load( &netbuf_allocs );
+    stats->frees = atomic_load( &netbuf_frees );
+    stats->failures = atomic_load( &netbuf_failures );
+    stats->in_use = stats->allocs - stats->frees;
+    stats->peak = atomic_load( &netbuf_peak );
+}
+
+
+/* -------------------------------------------------------------------------- */
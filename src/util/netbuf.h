@@ -0,0 +1,111 @@
+/* --------------------------------- Header --------------------------------- */
+
+
+/**
+ * @file    netbuf.h
+ * @brief   Contains a pool of fixed size reference counted message buffers
+ */
+
+
+/* ------------------------------ Header Guard ------------------------------ */
+
+
+# ifndef UTIL_NETBUF_H
+# define UTIL_NETBUF_H
+
+
+/* -------------------------------- Includes -------------------------------- */
+
+
+# include <stddef.h>
+# include <stdint.h>
+# include <stdbool.h>
+
+
+/* --------------------------------- Defines -------------------------------- */
+
+
+/**
+ * Bytes of data in every buffer, a whole message and a null terminator
+ */
+# define NETBUF_DATA_SIZE   ( 256 )
+
+/**
+ * Number of buffers in the pool
+ */
+# ifndef NETBUF_POOL_SIZE
+# define NETBUF_POOL_SIZE   ( 32 )
+# endif
+
+/**
+ * C++ has no _Atomic before C++23, so the host tools that include this see
+ * the reference count as the std::atomic the C type is laid out the same as
+ */
+# ifdef __cplusplus
+extern "C++" {
+# include <atomic>
+}
+# define NETBUF_ATOMIC( TYPE )  std::atomic< TYPE >
+# else
+# include <stdatomic.h>
+# define NETBUF_ATOMIC( TYPE )  _Atomic( TYPE )
+# endif
+
+
+/* ---------------------------------- Types --------------------------------- */
+
+
+/**
+ * A message buffer
+ *
+ * NOTE:
+ * Every holder of a buffer owns one reference and drops it with
+ * netbuf_free(). The data must not change while anyone else holds a
+ * reference, such as a transmit queue that has not sent it yet.
+ */
+typedef struct
+{
+    NETBUF_ATOMIC( uint8_t ) refs;
+    uint16_t length;
+    uint8_t data[NETBUF_DATA_SIZE];
+} netbuf_t;
+
+# ifdef __cplusplus
+static_assert( sizeof( NETBUF_ATOMIC( uint8_t ) ) == sizeof( uint8_t ) &&
+               NETBUF_ATOMIC( uint8_t )::is_always_lock_free,
+               "netbuf_t must match its C layout" );
+# endif
+
+
+/**
+ * Pool counters since netbuf_init()
+ */
+typedef struct
+{
+    uint32_t allocs;
+    uint32_t frees;
+    uint32_t failures;      // allocations made while the pool was empty
+    uint32_t in_use;
+    uint32_t peak;
+} netbuf_stats_t;
+
+
+/* ------------------------------- Functions -------------------------------- */
+
+
+void netbuf_init( void );
+
+netbuf_t * netbuf_alloc( void );
+netbuf_t * netbuf_ref( netbuf_t * buf );
+void netbuf_free( netbuf_t * buf );
+
+void netbuf_stats( netbuf_stats_t * stats );
+
+
+/* --------------------------------- Footer --------------------------------- */
+
+
+# endif // UTIL_NETBUF_H
+
+
+/* -------------------------------------------------------------------------- */
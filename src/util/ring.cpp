@@ -0,0 +1,185 @@
+/* --------------------------------- Header --------------------------------- */
+
+
+/**
+ * @file    ring.cpp
+ * @brief   Contains the C interface of the single producer, single consumer
+ *          byte ring
+ */
+
+
+/* -------------------------------- Includes -------------------------------- */
+
+
+# include "ring.hpp"
+
+
+/* ------------------------------- Functions -------------------------------- */
+
+
+/**
+ * Initializes an empty ring
+ *
+ * @param   [out]   ring        The ring
+ * @param   [in]    storage     Storage for the elements
+ * @param   [in]    capacity    The size of storage in bytes, a power of two
+ *
+ * @return  bool if the capacity is a power of two of at least two bytes
+ */
+bool ring_init( ring_t * ring, void * storage, uint32_t capacity )
+{
+    if ( capacity < 2 || ( capacity & ( capacity - 1 ) ) )
+    {
+        return false;
+    }
+
+    ring->data = storage;
+    ring->mask = capacity - 1;
+    ring->head = 0;
+    ring->tail = 0;
+
+    return true;
+}
+
+
+/**
+ * Pushes a byte, producer only
+ *
+ * @return  bool if there was room for it
+ */
+bool ring_push( ring_t * ring, uint8_t value )
+{
+    return util::ring_ops::push( *ring, value );
+}
+
+
+/**
+ * Pushes as many bytes as fit, producer only
+ *
+ * @return  The number of bytes pushed
+ */
+uint32_t ring_write( ring_t * ring, const uint8_t * values, uint32_t count )
+{
+    return util::ring_ops::write( *ring, values, count );
+}
+
+
+/**
+ * Finds the contiguous free bytes at the tail, producer only
+ *
+ * @param   [out]   span    Where the bytes can be written
+ *
+ * @return  The number of bytes that can be written, publish them with
+ *          ring_produce()
+ */
+uint32_t ring_write_span( const ring_t * ring, uint8_t ** span )
+{
+    return util::ring_ops::write_span( *ring, span );
+}
+
+
+/**
+ * Publishes bytes written into the write span, producer only
+ */
+void ring_produce( ring_t * ring, uint32_t count )
+{
+    util::ring_ops::produce( *ring, count );
+}
+
+
+/**
+ * Pops a byte, consumer only
+ *
+ * @return  bool if there was a byte
+ */
+bool ring_pop( ring_t * ring, uint8_t * value )
+{
+    return util::ring_ops::pop( *ring, *value );
+}
+
+
+/**
+ * Pops up to a number of bytes, consumer only
+ *
+ * @return  The number of bytes popped
+ */
+uint32_t ring_read( ring_t * ring, uint8_t * values, uint32_t count )
+{
+    return util::ring_ops::read( *ring, values, count );
+}
+
+
+/**
+ * Finds the contiguous bytes at the head, consumer only
+ *
+ * @param   [out]   span    Where the bytes can be read
+ *
+ * @return  The number of bytes that can be read, free them with
+ *          ring_consume()
+ */
+uint32_t ring_read_span( const ring_t * ring, const uint8_t ** span )
+{
+    return util::ring_ops::read_span( *ring, span );
+}
+
+
+/**
+ * Frees bytes read from the read span, consumer only
+ */
+void ring_consume( ring_t * ring, uint32_t count )
+{
+    util::ring_ops::consume( *ring, count );
+}
+
+
+/**
+ * Gets a byte without popping it, consumer only
+ *
+ * @param   [in]    index   Position from the oldest byte
+ * @param   [out]   value   The byte
+ *
+ * @return  bool if the ring holds that many bytes
+ */
+bool ring_peek( const ring_t * ring, uint32_t index, uint8_t * value )
+{
+    return util::ring_ops::peek( *ring, index, *value );
+}
+
+
+/**
+ * Pops every byte, consumer only
+ */
+void ring_clear( ring_t * ring )
+{
+    util::ring_ops::clear( *ring );
+}
+
+
+/**
+ * Gets the number of bytes in the ring
+ */
+uint32_t ring_count( const ring_t * ring )
+{
+    return util::ring_ops::count( *ring );
+}
+
+
+/**
+ * Determines whether the ring is empty
+ */
+bool ring_is_empty( const ring_t * ring )
+{
+    return ring_count( ring ) == 0;
+}
+
+
+/**
+ * Determines whether the ring is full
+ */
+bool ring_is_full( const ring_t * ring )
+{
+    return ring_count( ring ) > ring->mask;
+}
+
+
+/* -------------------------------------------------------------------------- */
@@ -0,0 +1,83 @@
+/* --------------------------------- Header --------------------------------- */
+
+
+/**
+ * @file    ring.h
+ * @brief   Contains the C interface of the single producer, single consumer
+ *          byte ring, see ring.hpp for the element type template
+ */
+
+
+/* ------------------------------ Header Guard ------------------------------ */
+
+
+# ifndef UTIL_RING_H
+# define UTIL_RING_H
+
+
+/* -------------------------------- Includes -------------------------------- */
+
+
+# include <stddef.h>
+# include <stdint.h>
+# include <stdbool.h>
+
+
+/* ---------------------------------- Types --------------------------------- */
+
+
+/**
+ * State of a ring over caller supplied storage
+ *
+ * NOTE:
+ * One producer may push while one consumer pops, either of which may run in
+ * an interrupt. The producer only writes tail, the consumer only writes head.
+ * Both count elements forever and are masked into the storage, so every
+ * element of the storage is usable.
+ */
+typedef struct
+{
+    void * data;
+    uint32_t mask;
+    uint32_t head;      // index of the oldest element
+    uint32_t tail;      // index the next element is pushed at
+} ring_t;
+
+
+/* ------------------------------- Functions -------------------------------- */
+
+
+# ifdef __cplusplus
+extern "C" {
+# endif
+
+bool ring_init( ring_t * ring, void * storage, uint32_t capacity );
+
+bool ring_push( ring_t * ring, uint8_t value );
+uint32_t ring_write( ring_t * ring, const uint8_t * values, uint32_t count );
+uint32_t ring_write_span( const ring_t * ring, uint8_t ** span );
+void ring_produce( ring_t * ring, uint32_t count );
+
+bool ring_pop( ring_t * ring, uint8_t * value );
+uint32_t ring_read( ring_t * ring, uint8_t * values, uint32_t count );
+uint32_t ring_read_span( const ring_t * ring, const uint8_t ** span );
+void ring_consume( ring_t * ring, uint32_t count );
+bool ring_peek( const ring_t * ring, uint32_t index, uint8_t * value );
+void ring_clear( ring_t * ring );
+
+uint32_t ring_count( const ring_t * ring );
+bool ring_is_empty( const ring_t * ring );
+bool ring_is_full( const ring_t * ring );
+
+# ifdef __cplusplus
+}
+# endif
+
+
+/* --------------------------------- Footer --------------------------------- */
+
+
+# endif // UTIL_RING_H
+
+
+/* -------------------------------------------------------------------------- */
@@ -0,0 +1,278 @@
+/* --------------------------------- Header --------------------------------- */
+
+
+/**
+ * @file    ring.hpp
+ * @brief   Contains a single producer, single consumer ring of any element
+ *          type and power of two capacity
+ *
+ * The operations work on a ring_t so the C interface in ring.h and the ring
+ * class below share them. The producer publishes elements by storing tail
+ * with release ordering after writing them, and the consumer loads tail with
+ * acquire ordering before reading them. Head is handed back the same way.
+ *
+ * The span operations expose the contiguous run of elements that can be
+ * read or written in place, for DMA or a memcpy, and are completed with
+ * consume() or produce().
+ */
+
+
+/* ------------------------------ Header Guard ------------------------------ */
+
+
+# ifndef UTIL_RING_HPP
+# define UTIL_RING_HPP
+
+
+/* -------------------------------- Includes -------------------------------- */
+
+
+# include <cstddef>
+# include <cstdint>
+# include <cstring>
+# include <type_traits>
+# include "ring.h"
+
+
+/* -------------------------------- Functions ------------------------------- */
+
+
+namespace util
+{
+namespace ring_ops
+{
+
+/**
+ * Gets the number of elements in the ring
+ */
+inline uint32_t count( const ring_t & ring )
+{
+    return __atomic_load_n( &ring.tail, __ATOMIC_ACQUIRE ) - __atomic_load_n( &ring.head, __ATOMIC_ACQUIRE );
+}
+
+
+/**
+ * Finds the contiguous free elements at the tail, producer only
+ *
+ * @return  The number of elements that can be written at span
+ */
+template < typename T >
+inline uint32_t write_span( const ring_t & ring, T ** span )
+{
+    uint32_t tail = __atomic_load_n( &ring.tail, __ATOMIC_RELAXED );
+    uint32_t room = ring.mask + 1 - ( tail - __atomic_load_n( &ring.head, __ATOMIC_ACQUIRE ) );
+    uint32_t to_end = ring.mask + 1 - ( tail & ring.mask );
+
+    *span = static_cast< T * >( ring.data ) + ( tail & ring.mask );
+    return room < to_end ? room : to_end;
+}
+
+
+/**
+ * Publishes elements written into the write span, producer only
+ */
+inline void produce( ring_t & ring, uint32_t count )
+{
+    __atomic_store_n( &ring.tail, __atomic_load_n( &ring.tail, __ATOMIC_RELAXED ) + count, __ATOMIC_RELEASE );
+}
+
+
+/**
+ * Finds the contiguous elements at the head, consumer only
+ *
+ * @return  The number of elements that can be read at span
+ */
+template < typename T >
+inline uint32_t read_span( const ring_t & ring, const T ** span )
+{
+    uint32_t head = __atomic_load_n( &ring.head, __ATOMIC_RELAXED );
+    uint32_t used = __atomic_load_n( &ring.tail, __ATOMIC_ACQUIRE ) - head;
+    uint32_t to_end = ring.mask + 1 - ( head & ring.mask );
+
+    *span = static_cast< const T * >( ring.data ) + ( head & ring.mask );
+    return used < to_end ? used : to_end;
+}
+
+
+/**
+ * Frees elements read from the read span, consumer only
+ */
+inline void consume( ring_t & ring, uint32_t count )
+{
+    __atomic_store_n( &ring.head, __atomic_load_n( &ring.head, __ATOMIC_RELAXED ) + count, __ATOMIC_RELEASE );
+}
+
+
+/**
+ * Pushes one element, producer only
+ *
+ * @return  bool if there was room for it
+ */
+template < typename T >
+inline bool push( ring_t & ring, const T & value )
+{
+    uint32_t tail = __atomic_load_n( &ring.tail, __ATOMIC_RELAXED );
+    if ( tail - __atomic_load_n( &ring.head, __ATOMIC_ACQUIRE ) > ring.mask )
+    {
+        return false;
+    }
+
+    static_cast< T * >( ring.data )[tail & ring.mask] = value;
+    __atomic_store_n( &ring.tail, tail + 1, __ATOMIC_RELEASE );
+    return true;
+}
+
+
+/**
+ * Pops one element, consumer only
+ *
+ * @return  bool if there was an element
+ */
+template < typename T >
+inline bool pop( ring_t & ring, T & value )
+{
+    uint32_t head = __atomic_load_n( &ring.head, __ATOMIC_RELAXED );
+    if ( __atomic_load_n( &ring.tail, __ATOMIC_ACQUIRE ) == head )
+    {
+        return false;
+    }
+
+    value = static_cast< const T * >( ring.data )[head & ring.mask];
+    __atomic_store_n( &ring.head, head + 1, __ATOMIC_RELEASE );
+    return true;
+}
+
+
+/**
+ * Pushes as many elements as fit, producer only
+ *
+ * @return  The number of elements pushed
+ */
+template < typename T >
+inline uint32_t write( ring_t & ring, const T * values, uint32_t count )
+{
+    static_assert( std::is_trivially_copyable< T >::value, "ring elements are copied bytewise" );
+    uint32_t written = 0;
+
+    // at most two spans, before and after the end of the storage
+    for ( int pass = 0; pass < 2 && written < count; pass++ )
+    {
+        T * span;
+        uint32_t size = write_span( ring, &span );
+        size = size < count - written ? size : count - written;
+        std::memcpy( span, values + written, size * sizeof( T ) );
+        written += size;
+        produce( ring, size );
+    }
+
+    return written;
+}
+
+
+/**
+ * Pops up to a number of elements, consumer only
+ *
+ * @return  The number of elements popped
+ */
+template < typename T >
+inline uint32_t read( ring_t & ring, T * values, uint32_t count )
+{
+    static_assert( std::is_trivially_copyable< T >::value, "ring elements are copied bytewise" );
+    uint32_t taken = 0;
+
+    for ( int pass = 0; pass < 2 && taken < count; pass++ )
+    {
+        const T * span;
+        uint32_t size = read_span( ring, &span );
+        size = size < count - taken ? size : count - taken;
+        std::memcpy( values + taken, span, size * sizeof( T ) );
+        taken += size;
+        consume( ring, size );
+    }
+
+    return taken;
+}
+
+
+/**
+ * Gets an element without popping it, consumer only
+ *
+ * @param   [in]    index   Position from the oldest element
+ *
+ * @return  bool if the ring holds that many elements
+ */
+template < typename T >
+inline bool peek( const ring_t & ring, uint32_t index, T & value )
+{
+    uint32_t head = __atomic_load_n( &ring.head, __ATOMIC_RELAXED );
+    if ( __atomic_load_n( &ring.tail, __ATOMIC_ACQUIRE ) - head <= index )
+    {
+        return false;
+    }
+
+    value = static_cast< const T * >( ring.data )[( head + index ) & ring.mask];
+    return true;
+}
+
+
+/**
+ * Pops every element, consumer only
+ */
+inline void clear( ring_t & ring )
+{
+    __atomic_store_n( &ring.head, __atomic_load_n( &ring.tail, __ATOMIC_ACQUIRE ), __ATOMIC_RELEASE );
+}
+
+} // namespace ring_ops
+
+
+/* ---------------------------------- Types --------------------------------- */
+
+
+/**
+ * A ring holding its own storage of Capacity elements of type T
+ */
+template < typename T, uint32_t Capacity >
+class ring
+{
+    static_assert( Capacity >= 2 && ( Capacity & ( Capacity - 1 ) ) == 0,
+                   "ring capacity must be a power of two" );
+
+public:
+    ring( ) : state_{ storage_, Capacity - 1, 0, 0 } { }
+
+    ring( const ring & ) = delete;
+    ring & operator=( const ring & ) = delete;
+
+    bool push( const T & value ) { return ring_ops::push( state_, value ); }
+    uint32_t write( const T * values, uint32_t count ) { return ring_ops::write( state_, values, count ); }
+    uint32_t write_span( T ** span ) const { return ring_ops::write_span( state_, span ); }
+    void produce( uint32_t count ) { ring_ops::produce( state_, count ); }
+
+    bool pop( T & value ) { return ring_ops::pop( state_, value ); }
+    uint32_t read( T * values, uint32_t count ) { return ring_ops::read( state_, values, count ); }
+    uint32_t read_span( const T ** span ) const { return ring_ops::read_span( state_, span ); }
+    void consume( uint32_t count ) { ring_ops::consume( state_, count ); }
+    bool peek( uint32_t index, T & value ) const { return ring_ops::peek( state_, index, value ); }
+    void clear( ) { ring_ops::clear( state_ ); }
+
+    uint32_t count( ) const { return ring_ops::count( state_ ); }
+    bool empty( ) const { return count( ) == 0; }
+    bool full( ) const { return count( ) == Capacity; }
+    static constexpr uint32_t capacity( ) { return Capacity; }
+
+private:
+    T storage_[Capacity];
+    ring_t state_;
+};
+
+} // namespace util
+
+
+/* --------------------------------- Footer --------------------------------- */
+
+
+# endif // UTIL_RING_HPP
+
+
+/* -------------------------------------------------------------------------- */
@@ -119,6 +119,41 @@ uprintf
 }
 
 
+/**
+ * @brief   Writes raw bytes via UART, for binary streams sent alongside the
+ *          console output
+ *
+ * @param   [in]    *data   The bytes to write
+ * @param   [in]    size    The number of bytes
+ *
+ * @return  Error code
+ */
+ERROR_CODE
+uwrite
+(
+    const void  *data,
+    uint32_t    size
+)
+{
+    ERROR_CODE errorCode;
+
+    // throw an error if UIO is not initialized
+    if ( !uioIsInit )
+    {
+        THROW_ERROR( ERROR_CODE_UTIL_UIO_NOT_INITIALIZED );
+    }
+
+    errorCode = uartTxBuffer(
+        ( uint8_t * ) data,
+        size,
+        uioTimeout
+    );
+    ELEVATE_IF_ERROR( errorCode );
+
+    RETURN_NO_ERROR();
+}
+
+
 /**
  * @brief   Prints a hex dump of the memory at the specified address via UART.
  *          Source code adapted from https://stackoverflow.com/a/7776146.
@@ -19,6 +19,7 @@
 
 # include <stdio.h>
 # include <stdarg.h>
+# include <stdint.h>
 # include "error.h"
 
 
@@ -57,6 +58,23 @@ uprintf
 );
 
 
+/**
+ * @brief   Writes raw bytes via UART, for binary streams sent alongside the
+ *          console output
+ *
+ * @param   [in]    *data   The bytes to write
+ * @param   [in]    size    The number of bytes
+ *
+ * @return  Error code
+ */
+ERROR_CODE
+uwrite
+(
+    const void  *data,
+    uint32_t    size
+);
+
+
 /**
  * @brief   Prints a hex dump of the memory at the specified address via UART.
  *          Source code adapted from https://stackoverflow.com/a/7776146.
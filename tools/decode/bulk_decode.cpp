@@ -0,0 +1,625 @@
+/* --------------------------------- Header --------------------------------- */
+
+
+/**
+ * @file    bulk_decode.cpp
+ * @brief   Contains the chunking of captures across workers and the decoding
+ *          of their frames
+ */
+
+
+/* -------------------------------- Includes -------------------------------- */
+
+
+# include <algorithm>
+# include <atomic>
+# include <cstdio>
+# include <cstring>
+# include <memory>
+# include <thread>
+
+# include <fcntl.h>
+# include <sys/mman.h>
+# include <sys/stat.h>
+# include <unistd.h>
+
+# include "bulk_decode.hpp"
+
+extern "C" {
+# include "hamming.h"
+}
+
+
+/* --------------------------------- Defines -------------------------------- */
+
+
+/**
+ * The bytes of slots of the smallest frame, as network.c takes it
+ */
+# define BULK_MIN_FRAME_SLOT_BYTES  ( LINECODE_PREAMBLE_SLOTS / 8 + sizeof( frame_header_t ) - 1 + sizeof( frame_trailer_t ) )
+
+# define BULK_CRC_FLAG_MASK         ( 0x01 )
+# define BULK_CRC_FLAG_ON           ( 0x01 )
+# define BULK_CRC_OFF_TRAILER_VALUE ( 0xAA )
+# define BULK_FRAME_FLAG_FEC        ( 0x10 )
+
+static_assert( ( BULK_STATUS_GAP & ( NETWORK_SNIFF_CRC_OK | NETWORK_SNIFF_CRC_ERROR | NETWORK_SNIFF_LINECODE_ERROR |
+                                     NETWORK_SNIFF_PREAMBLE_ERROR | NETWORK_SNIFF_LENGTH_ERROR |
+                                     NETWORK_SNIFF_COLLISION | NETWORK_SNIFF_FEC_CORRECTED ) ) == 0,
+               "the gap status must not take a sniffer status" );
+
+
+/* ---------------------------------- Types --------------------------------- */
+
+
+namespace
+{
+
+/**
+ * A capture mapped read only into memory
+ */
+class mapped_file
+{
+public:
+    explicit mapped_file( const std::string & path )
+    {
+        int fd = open( path.c_str( ), O_RDONLY );
+        struct stat st;
+
+        if ( fd < 0 || fstat( fd, &st ) != 0 )
+        {
+            perror( path.c_str( ) );
+            if ( fd >= 0 )
+            {
+                close( fd );
+            }
+            return;
+        }
+
+        size_ = st.st_size;
+        if ( size_ > 0 )
+        {
+            void * map = mmap( NULL, size_, PROT_READ, MAP_PRIVATE, fd, 0 );
+            if ( map == MAP_FAILED )
+            {
+                perror( path.c_str( ) );
+                size_ = 0;
+            }
+            else
+            {
+                // every worker reads its chunk from front to back
+                madvise( map, size_, MADV_SEQUENTIAL );
+                data_ = static_cast< const uint8_t * >( map );
+            }
+        }
+        close( fd );
+    }
+
+    ~mapped_file( )
+    {
+        if ( data_ != NULL )
+        {
+            munmap( const_cast< uint8_t * >( data_ ), size_ );
+        }
+    }
+
+    mapped_file( const mapped_file & ) = delete;
+    mapped_file & operator=( const mapped_file & ) = delete;
+
+    const uint8_t * data( ) const { return data_; }
+    size_t size( ) const { return data_ != NULL ? size_ : 0; }
+
+private:
+    const uint8_t * data_ = NULL;
+    size_t size_ = 0;
+};
+
+
+/**
+ * A chunk of a capture and what a worker made of it
+ */
+struct chunk
+{
+    uint32_t file;
+    size_t begin;               // byte the worker starts looking from
+    size_t limit;               // and the byte the next chunk does
+    uint64_t span_us;           // from its first edge to the next chunk's
+    std::vector< bulk::frame > frames;
+    std::vector< uint8_t > bytes;
+    bulk::stats stats;
+};
+
+
+/**
+ * Turns the edges of a chunk into frames of slots, and decodes them
+ */
+class chunk_decoder
+{
+public:
+    chunk_decoder( const bulk::options & opts, bulk::kernel manchester, chunk & out )
+        : opts_( opts ), manchester_( manchester ), out_( out )
+    {
+    }
+
+    void run( const uint8_t * data, size_t size );
+
+private:
+    void decode( size_t slot_count, uint64_t start_us, uint64_t end_us, uint8_t status );
+
+    const bulk::options & opts_;
+    bulk::kernel manchester_;
+    chunk & out_;
+
+    // a frame's slot bytes start at the second, the first takes the stores
+    // made before a byte is whole and the last those past the end
+    uint8_t slots_[1 + BULK_FRAME_SLOT_BYTES + 1];
+
+    uint8_t bytes_[NETWORK_SNIFF_FRAME_MAX];
+};
+
+
+/* ---------------------------- Static Functions ---------------------------- */
+
+
+/**
+ * Reads an unsigned LEB128 varint
+ *
+ * @return  bool if it was whole
+ */
+bool read_varint( const uint8_t * data, size_t size, size_t * offset, uint64_t * value )
+{
+    *value = 0;
+    for ( unsigned int shift = 0; *offset < size && shift < 64; shift += 7 )
+    {
+        uint8_t byte = data[( *offset )++];
+        *value |= ( uint64_t ) ( byte & 0x7F ) << shift;
+        if ( !( byte & 0x80 ) )
+        {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+
+/**
+ * Finds the first record wholly past an offset. A byte below 0x80 ends a
+ * varint, so the record after it starts a record, unless the byte was a gap
+ * and the record its count.
+ */
+size_t sync_records( const uint8_t * data, size_t size, size_t offset )
+{
+    if ( offset <= CAPTURE_HEADER_SIZE )
+    {
+        return CAPTURE_HEADER_SIZE;
+    }
+
+    while ( offset < size && data[offset] & 0x80 )
+    {
+        offset++;
+    }
+    if ( offset >= size )
+    {
+        return size;
+    }
+
+    if ( data[offset++] == 0 )
+    {
+        uint64_t dropped;
+        if ( !read_varint( data, size, &offset, &dropped ) )
+        {
+            return size;
+        }
+    }
+
+    return offset;
+}
+
+
+/* ------------------------------- Functions -------------------------------- */
+
+
+/**
+ * Decodes the frames that start in the chunk, the first chunk of a capture
+ * starts at its first edge and every other at the first edge after the line
+ * idled, and goes on to the next chunk's first edge
+ *
+ * NOTE:
+ * The receiver is kept in locals, every store of a slot byte could alias a
+ * member and would have them all reloaded. The edges of random data are a
+ * half or a whole bit apart at random, so every edge stores the last whole
+ * byte of slots rather than branching on whether one was completed.
+ */
+void chunk_decoder::run( const uint8_t * data, size_t size )
+{
+    size_t offset = sync_records( data, size, out_.begin );
+    bool started = out_.begin <= CAPTURE_HEADER_SIZE;
+    uint64_t edges = 0;
+
+    uint64_t now_us = 0;        // of the last edge
+    uint64_t start_us = 0;      // of the frame the receiver is sampling
+    bool line = true;
+    bool active = false;
+    uint8_t status = 0;
+    size_t slot_count = 0;
+    uint32_t pending = 0;       // slots not stored yet, the newest lowest
+
+    // samples slots the way network_rx_queue_push_bit() does
+    auto sample = [ & ]( uint32_t slots, unsigned int count )
+    {
+        pending = pending << count | slots;
+        slot_count += count;
+        slots_[std::min( slot_count / 8, ( size_t ) BULK_FRAME_SLOT_BYTES + 1 )] = pending >> ( slot_count % 8 );
+    };
+
+    // ends the frame as the line idles or collides, BULK_IDLE_US after the last edge
+    auto finish = [ & ]( )
+    {
+        if ( active )
+        {
+            // the timeout timer repeats the last slot before it ends the frame
+            sample( line, 1 );
+            active = false;
+            decode( slot_count, start_us, now_us + BULK_IDLE_US, status | ( line ? 0 : NETWORK_SNIFF_COLLISION ) );
+        }
+        status = 0;
+    };
+
+    while ( offset < size )
+    {
+        size_t record = offset;
+        uint64_t value = data[offset];
+
+        // most edges are a half or a whole bit apart, which takes two bytes
+        if ( value < 0x80 )
+        {
+            offset++;
+        }
+        else if ( offset + 1 < size && data[offset + 1] < 0x80 )
+        {
+            value = ( value & 0x7F ) | ( uint64_t ) data[offset + 1] << 7;
+            offset += 2;
+        }
+        else if ( !read_varint( data, size, &offset, &value ) )
+        {
+            break;
+        }
+
+        if ( value == 0 )
+        {
+            uint64_t dropped;
+            if ( !read_varint( data, size, &offset, &dropped ) )
+            {
+                break;
+            }
+            if ( started )
+            {
+                out_.stats.gaps++;
+                out_.stats.dropped += dropped;
+                status |= BULK_STATUS_GAP;
+            }
+            continue;
+        }
+
+        bool level = ( value - 1 ) & 1;
+        uint64_t delta = ( value - 1 ) >> 1;
+
+        if ( delta >= BULK_IDLE_US )
+        {
+            // the edges before the first idle line belong to the last chunk,
+            // and those from the next chunk's first to the next chunk
+            if ( record >= out_.limit )
+            {
+                if ( started )
+                {
+                    finish( );
+                    out_.span_us = now_us + delta;
+                }
+                out_.stats.edges += edges;
+                return;
+            }
+            if ( !started )
+            {
+                started = true;
+                delta = 0;
+            }
+            finish( );
+        }
+        else if ( !started )
+        {
+            continue;
+        }
+
+        now_us += delta;
+        edges++;
+
+        if ( !active )
+        {
+            // the first slot is the idle line before the first edge
+            active = true;
+            start_us = now_us;
+            slot_count = 0;
+            sample( 0x02 | level, 2 );
+        }
+        else
+        {
+            // the timeout timer repeats the last slot when the edge is late
+            unsigned int repeat = delta >= BULK_REPEAT_US;
+            sample( ( line & repeat ) << 1 | level, 1 + repeat );
+        }
+        line = level;
+    }
+
+    // the line is let go once the capture ends
+    if ( active && !line )
+    {
+        sample( 1, 1 );
+        line = true;
+    }
+    finish( );
+    out_.stats.edges += edges;
+}
+
+
+/**
+ * Decodes and checks a frame the way network_rx_sniff() does
+ */
+void chunk_decoder::decode( size_t slot_count, uint64_t start_us, uint64_t end_us, uint8_t status )
+{
+    size_t size = std::min( slot_count, ( size_t ) BULK_FRAME_SLOT_BYTES * 8 ) / 8;
+    linecode_decoder_t decoder;
+    unsigned int violations = 0;
+    size_t expected = sizeof( frame_header_t ) + sizeof( frame_trailer_t );
+    size_t decoded = 0;
+    bulk::stats & stats = out_.stats;
+
+    // the receiver drops glitches and commits runts and overflows as errors
+    if ( size == 0 )
+    {
+        return;
+    }
+    if ( size < BULK_MIN_FRAME_SLOT_BYTES || slot_count > BULK_FRAME_SLOT_BYTES * 8 )
+    {
+        status |= NETWORK_SNIFF_LENGTH_ERROR;
+    }
+
+    bulk::frame record = { };
+    record.start_us = start_us;
+    record.duration_us = end_us - start_us;
+    record.linecode = NETWORK_SNIFF_LINECODE_UNKNOWN;
+    record.file = out_.file;
+    stats.slot_bytes += size;
+
+    if ( !linecode_decoder_init( &decoder, slots_ + 1, size * 8 ) )
+    {
+        status |= NETWORK_SNIFF_PREAMBLE_ERROR;
+    }
+    else if ( decoder.code == LINECODE_MANCHESTER )
+    {
+        // the slots after the preamble are byte aligned, two to a byte
+        const uint8_t * slots = slots_ + 1 + LINECODE_PREAMBLE_SLOTS / 8;
+        size_t available = ( size - LINECODE_PREAMBLE_SLOTS / 8 ) / 2;
+        size_t header = std::min( available, sizeof( frame_header_t ) - 1 );
+
+        record.linecode = LINECODE_MANCHESTER;
+        bytes_[0] = LINECODE_PREAMBLE_MANCHESTER;
+        violations = bulk::manchester_decode( manchester_, slots, bytes_ + 1, header );
+        decoded = 1 + header;
+
+        if ( decoded == sizeof( frame_header_t ) )
+        {
+            expected += ( ( frame_header_t * ) bytes_ )->length;
+            size_t rest = std::min( available, expected - 1 ) - header;
+            violations += bulk::manchester_decode( manchester_, slots + 2 * header, bytes_ + decoded, rest );
+            decoded += rest;
+        }
+
+        decoder.slot_idx += 16 * ( decoded - 1 );
+    }
+    else
+    {
+        record.linecode = decoder.code;
+        bytes_[decoded++] = linecode_preamble( decoder.code );
+
+        while ( decoded < expected && linecode_decode( &decoder, &bytes_[decoded], 1, &violations ) )
+        {
+            if ( ++decoded == sizeof( frame_header_t ) )
+            {
+                expected += ( ( frame_header_t * ) bytes_ )->length;
+            }
+        }
+    }
+
+    if ( violations )
+    {
+        status |= NETWORK_SNIFF_LINECODE_ERROR;
+    }
+
+    if ( !( status & NETWORK_SNIFF_PREAMBLE_ERROR ) )
+    {
+        if ( decoded < expected || linecode_decoder_remaining( &decoder ) >= BULK_TRAILING_SLOTS_MAX )
+        {
+            status |= NETWORK_SNIFF_LENGTH_ERROR;
+        }
+        else
+        {
+            // the crc covers the message once the fec has corrected it
+            const frame_header_t * header = ( const frame_header_t * ) bytes_;
+            const uint8_t * message = bytes_ + sizeof( frame_header_t );
+            uint8_t length = header->length;
+            uint8_t fcs = message[length];
+            uint8_t fec_message[NETWORK_SNIFF_FRAME_MAX];
+            bool crc_ok = true;
+
+            if ( header->crc_flag & BULK_FRAME_FLAG_FEC )
+            {
+                unsigned int corrected_bits = 0;
+                if ( length % 2 || !hamming84_decode( message, length / 2, fec_message, &corrected_bits ) )
+                {
+                    crc_ok = false;
+                }
+                message = fec_message;
+                length /= 2;
+                status |= corrected_bits > 0 ? NETWORK_SNIFF_FEC_CORRECTED : 0;
+            }
+
+            if ( crc_ok && ( header->crc_flag & BULK_CRC_FLAG_MASK ) == BULK_CRC_FLAG_ON )
+            {
+                crc_ok = bulk::crc8( &fcs, sizeof( fcs ), bulk::crc8( message, length, 0 ) ) == 0;
+            }
+            else if ( crc_ok )
+            {
+                crc_ok = fcs == BULK_CRC_OFF_TRAILER_VALUE;
+            }
+            status |= crc_ok ? NETWORK_SNIFF_CRC_OK : NETWORK_SNIFF_CRC_ERROR;
+        }
+    }
+
+    record.status = status;
+    record.violations = std::min( violations, 0xFFFFU );
+    record.size = decoded;
+
+    stats.frames++;
+    stats.crc_ok += ( status & NETWORK_SNIFF_CRC_OK ) != 0;
+    stats.crc_errors += ( status & NETWORK_SNIFF_CRC_ERROR ) != 0;
+    stats.linecode_errors += ( status & ( NETWORK_SNIFF_LINECODE_ERROR | NETWORK_SNIFF_PREAMBLE_ERROR ) ) != 0;
+    stats.length_errors += ( status & NETWORK_SNIFF_LENGTH_ERROR ) != 0;
+    stats.collisions += ( status & NETWORK_SNIFF_COLLISION ) != 0;
+
+    if ( opts_.keep_frames )
+    {
+        record.offset = out_.bytes.size( );
+        out_.bytes.insert( out_.bytes.end( ), bytes_, bytes_ + decoded );
+        out_.frames.push_back( record );
+    }
+}
+
+
+void add_stats( bulk::stats & total, const bulk::stats & part )
+{
+    total.edges += part.edges;
+    total.frames += part.frames;
+    total.crc_ok += part.crc_ok;
+    total.crc_errors += part.crc_errors;
+    total.linecode_errors += part.linecode_errors;
+    total.length_errors += part.length_errors;
+    total.collisions += part.collisions;
+    total.gaps += part.gaps;
+    total.dropped += part.dropped;
+    total.slot_bytes += part.slot_bytes;
+}
+
+} // namespace
+
+
+namespace bulk
+{
+
+/**
+ * Decodes every frame of a list of raw captures, see capture.h
+ *
+ * @param   [in]    paths   The captures
+ * @param   [in]    opts    How to run
+ * @param   [out]   out     The frames in capture and time order, and totals
+ *
+ * @return  bool if every capture could be read
+ */
+bool decode_files( const std::vector< std::string > & paths, const options & opts, result & out )
+{
+    std::vector< std::unique_ptr< mapped_file > > files;
+    std::vector< chunk > chunks;
+    bool ok = true;
+
+    kernel manchester = opts.manchester == kernel::count ? best_kernel( ) : opts.manchester;
+    if ( !kernel_supported( manchester ) )
+    {
+        fprintf( stderr, "the %s kernel isn't supported here\n", kernel_name( manchester ) );
+        return false;
+    }
+
+    unsigned int threads = opts.threads ? opts.threads : std::max( 1U, std::thread::hardware_concurrency( ) );
+
+    for ( const std::string & path : paths )
+    {
+        files.emplace_back( new mapped_file( path ) );
+        const uint8_t * data = files.back( )->data( );
+        size_t size = files.back( )->size( );
+
+        if ( size < CAPTURE_HEADER_SIZE || memcmp( data, "CECP", 4 ) != 0 || data[4] != CAPTURE_VERSION )
+        {
+            fprintf( stderr, "%s: not a version %u capture\n", path.c_str( ), CAPTURE_VERSION );
+            ok = false;
+            continue;
+        }
+
+        size_t records = size - CAPTURE_HEADER_SIZE;
+        size_t step = opts.chunk ? opts.chunk : std::max( ( size_t ) BULK_CHUNK_MIN, ( records + threads - 1 ) / threads );
+        size_t first = chunks.size( );
+
+        for ( size_t begin = CAPTURE_HEADER_SIZE; begin < size; begin += step )
+        {
+            chunks.push_back( chunk( ) );
+            chunks.back( ).file = files.size( ) - 1;
+            chunks.back( ).begin = begin;
+        }
+        for ( size_t idx = first; idx < chunks.size( ); idx++ )
+        {
+            chunks[idx].limit = idx + 1 < chunks.size( ) ?
+                                sync_records( data, size, chunks[idx + 1].begin ) : size;
+        }
+    }
+
+    std::atomic< size_t > next( 0 );
+    auto work = [ & ]( )
+    {
+        for ( size_t idx = next++; idx < chunks.size( ); idx = next++ )
+        {
+            chunk & c = chunks[idx];
+            chunk_decoder decoder( opts, manchester, c );
+            decoder.run( files[c.file]->data( ), files[c.file]->size( ) );
+        }
+    };
+
+    std::vector< std::thread > workers;
+    for ( unsigned int idx = 1; idx < std::min( threads, ( unsigned int ) chunks.size( ) ); idx++ )
+    {
+        workers.emplace_back( work );
+    }
+    work( );
+    for ( std::thread & worker : workers )
+    {
+        worker.join( );
+    }
+
+    // every chunk counted from its first edge
+    out = result( );
+    uint64_t base_us = 0;
+    for ( size_t idx = 0; idx < chunks.size( ); idx++ )
+    {
+        chunk & c = chunks[idx];
+        if ( idx == 0 || chunks[idx - 1].file != c.file )
+        {
+            base_us = 0;
+        }
+
+        for ( frame f : c.frames )
+        {
+            f.start_us += base_us;
+            f.offset += out.bytes.size( );
+            out.frames.push_back( f );
+        }
+        out.bytes.insert( out.bytes.end( ), c.bytes.begin( ), c.bytes.end( ) );
+        add_stats( out.stats, c.stats );
+
+        base_us += c.span_us;
+    }
+
+    return ok;
+}
+
+
+} // namespace bulk
+
+
+/* -------------------------------------------------------------------------- */
@@ -0,0 +1,208 @@
+/* --------------------------------- Header --------------------------------- */
+
+
+/**
+ * @file    bulk_decode.hpp
+ * @brief   Contains a host library decoding long bus edge captures into
+ *          frames across threads
+ *
+ * A capture, see capture.h, is mapped into memory and split into chunks, one
+ * per worker at a time. Records are LEB128 varints, and a byte below 0x80
+ * always ends one, so a worker can find the record boundaries from any
+ * offset. Frames are separated by the line idling, an edge more than
+ * BULK_IDLE_US after the last one, so every chunk starts at the first such
+ * edge past its offset and ends where the next chunk starts. Time stamps are
+ * counted from every chunk's start and shifted once all chunks are done.
+ *
+ * The edges of a frame are turned into the slots the receiver samples, one
+ * at every edge and the last level again when no edge comes BULK_REPEAT_US
+ * later. The slots are then decoded and checked the way network_rx_sniff()
+ * does for the sniffer, with the same NETWORK_SNIFF_ statuses, so the frames
+ * match those /sniff streams from the board.
+ *
+ * Manchester takes the bulk of the time, and after the preamble a Manchester
+ * frame's slots are byte aligned, two slot bytes for every byte. The kernels
+ * decoding them are picked at run time from what the CPU supports:
+ *
+ *      scalar      a port of the bit loop in linecode_decode()
+ *      swar        eight slot bytes at a time in a 64 bit register
+ *      bmi2        the same with pext gathering the data bits
+ *      avx2        32 slot bytes at a time with nibble lookup shuffles
+ *
+ * Frames in the stuffed code go through linecode_decode() itself. CRCs are
+ * checked with a slicing-by-8 table.
+ */
+
+
+/* ------------------------------ Header Guard ------------------------------ */
+
+
+# ifndef TOOLS_BULK_DECODE_HPP
+# define TOOLS_BULK_DECODE_HPP
+
+
+/* -------------------------------- Includes -------------------------------- */
+
+
+# include <cstddef>
+# include <cstdint>
+# include <string>
+# include <vector>
+
+extern "C" {
+# include "network.h"
+# include "capture.h"
+}
+
+# ifndef NETWORK_SNIFF
+# error "the bulk decoder shares the frame statuses of the sniffer, see sniffer.h"
+# endif
+
+
+/* --------------------------------- Defines -------------------------------- */
+
+
+/**
+ * The receiver's timeouts in whole us. timeout.c sets TIM3's prescaler to 84
+ * rather than 83, so it ticks every 85 / 84 us, repeats the last slot at
+ * CCR1 = 750 ticks and ends the frame at ARR + 1 = 1101 ticks. Edges are
+ * stamped in whole us, so one stamped at the truncated time already came late
+ */
+# define BULK_TIMER_TICKS_US( ticks )   ( ( ( ticks ) * 85 ) / 84 )
+# define BULK_REPEAT_US                 BULK_TIMER_TICKS_US( 750 )
+# define BULK_IDLE_US                   BULK_TIMER_TICKS_US( 1101 )
+
+/**
+ * Slots a receiver may sample past the end of a frame, as network.c allows
+ */
+# define BULK_TRAILING_SLOTS_MAX    ( 16 )
+
+/**
+ * The most slot bytes the receiver holds of a frame, a whole frame in
+ * Manchester
+ */
+# define BULK_FRAME_SLOT_BYTES      ( 2 * NETWORK_SNIFF_FRAME_MAX )
+
+/**
+ * A status beyond the sniffer's, the capture lost edges during the frame
+ */
+# define BULK_STATUS_GAP            ( 0x80 )
+
+/**
+ * The smallest chunk worth a worker
+ */
+# define BULK_CHUNK_MIN             ( 64 * 1024 )
+
+
+/* ---------------------------------- Types --------------------------------- */
+
+
+namespace bulk
+{
+
+/**
+ * Manchester kernels, slowest first
+ */
+enum class kernel
+{
+    scalar,
+    swar,
+    bmi2,
+    avx2,
+    count
+};
+
+
+/**
+ * A decoded frame, its bytes from the preamble on as far as they were
+ * decoded are kept in the bytes of the result
+ */
+struct frame
+{
+    uint64_t start_us;      // of its first edge since the capture started
+    uint32_t duration_us;   // to the line idling or colliding
+    uint8_t status;         // NETWORK_SNIFF_ and BULK_STATUS_ flags
+    uint8_t linecode;       // a linecode_t, or NETWORK_SNIFF_LINECODE_UNKNOWN
+    uint16_t violations;
+    uint16_t size;
+    uint32_t file;          // index of the capture it came from
+    uint64_t offset;        // of its bytes in the result
+};
+
+
+/**
+ * Totals of a run
+ */
+struct stats
+{
+    uint64_t edges;
+    uint64_t frames;
+    uint64_t crc_ok;
+    uint64_t crc_errors;
+    uint64_t linecode_errors;   // code and preamble violations
+    uint64_t length_errors;
+    uint64_t collisions;
+    uint64_t gaps;
+    uint64_t dropped;           // edges the captures lost in their gaps
+    uint64_t slot_bytes;        // decoded from
+};
+
+
+/**
+ * The frames of every capture of a run, in capture and time order
+ */
+struct result
+{
+    std::vector< frame > frames;
+    std::vector< uint8_t > bytes;
+    bulk::stats stats;
+
+    const uint8_t * data( const frame & f ) const
+    {
+        return bytes.data( ) + f.offset;
+    }
+};
+
+
+/**
+ * Options of a run
+ */
+struct options
+{
+    kernel manchester = kernel::count;  // count for the best supported
+    unsigned int threads = 0;           // 0 for one per core
+    size_t chunk = 0;                   // bytes a worker takes, 0 to split evenly
+    bool keep_frames = true;            // false to only count them
+};
+
+
+/* ------------------------------- Functions -------------------------------- */
+
+
+const char * kernel_name( kernel k );
+bool kernel_supported( kernel k );
+kernel best_kernel( void );
+
+/**
+ * Decodes Manchester slots two bytes to a byte, the first half of every
+ * symbol must be the opposite of the second, which is the data bit
+ *
+ * @return  The number of symbols with equal halves
+ */
+unsigned int manchester_decode( kernel k, const uint8_t * slots, uint8_t * out, size_t size );
+
+uint8_t crc8( const uint8_t * data, size_t size, uint8_t initial );
+
+bool decode_files( const std::vector< std::string > & paths, const options & opts, result & out );
+
+
+} // namespace bulk
+
+
+/* --------------------------------- Footer --------------------------------- */
+
+
+# endif // TOOLS_BULK_DECODE_HPP
+
+
+/* -------------------------------------------------------------------------- */
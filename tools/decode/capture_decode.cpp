@@ -0,0 +1,130 @@
+/* --------------------------------- Header --------------------------------- */
+
+
+/**
+ * @file    capture_decode.cpp
+ * @brief   Decodes every frame of raw bus edge captures with the bulk decoder
+ *
+ * Takes the raw captures edge_replay reads, see capture.h, and prints the
+ * totals of their frames, or with --frames every frame as
+ *
+ *      <file> <start us> <duration us> <status> <line code> <violations> <bytes in hex>
+ *
+ * where the status is the NETWORK_SNIFF_ and BULK_STATUS_ flags in hex. The
+ * console logs of /capture go through edge_replay instead.
+ *
+ * Build with the host build and run from the repository root:
+ *
+ *      cmake -S . -B build-host -DCE4951_HOST_BUILD=ON
+ *      cmake --build build-host
+ *      ./build-host/tools/decode/capture_decode [--frames] [--kernel NAME] [--threads N]
+ *                                               [--chunk BYTES] capture.cap...
+ */
+
+
+/* -------------------------------- Includes -------------------------------- */
+
+
+# include <chrono>
+# include <cstdio>
+# include <cstdlib>
+# include <cstring>
+
+# include "bulk_decode.hpp"
+
+
+/* ------------------------------- Functions -------------------------------- */
+
+
+static int decode_usage( const char * name )
+{
+    fprintf( stderr, "usage: %s [--frames] [--kernel scalar|swar|bmi2|avx2] [--threads N] [--chunk BYTES] "
+                     "capture.cap...\n", name );
+    return 2;
+}
+
+
+int main( int argc, char ** argv )
+{
+    std::vector< std::string > paths;
+    bulk::options opts;
+    bool print_frames = false;
+
+    for ( int idx = 1; idx < argc; idx++ )
+    {
+        const char * arg = argv[idx];
+
+        if ( strcmp( arg, "--frames" ) == 0 )
+        {
+            print_frames = true;
+        }
+        else if ( strcmp( arg, "--kernel" ) == 0 && idx + 1 < argc )
+        {
+            const char * name = argv[++idx];
+            opts.manchester = bulk::kernel::scalar;
+            while ( opts.manchester != bulk::kernel::count && strcmp( bulk::kernel_name( opts.manchester ), name ) != 0 )
+            {
+                opts.manchester = ( bulk::kernel ) ( ( int ) opts.manchester + 1 );
+            }
+            if ( opts.manchester == bulk::kernel::count )
+            {
+                return decode_usage( argv[0] );
+            }
+        }
+        else if ( strcmp( arg, "--threads" ) == 0 && idx + 1 < argc )
+        {
+            opts.threads = strtoul( argv[++idx], NULL, 0 );
+        }
+        else if ( strcmp( arg, "--chunk" ) == 0 && idx + 1 < argc )
+        {
+            opts.chunk = strtoul( argv[++idx], NULL, 0 );
+        }
+        else if ( arg[0] == '-' )
+        {
+            return decode_usage( argv[0] );
+        }
+        else
+        {
+            paths.push_back( arg );
+        }
+    }
+
+    if ( paths.empty( ) )
+    {
+        return decode_usage( argv[0] );
+    }
+
+    opts.keep_frames = print_frames;
+    bulk::result result;
+
+    auto start = std::chrono::steady_clock::now( );
+    bool ok = bulk::decode_files( paths, opts, result );
+    double seconds = std::chrono::duration< double >( std::chrono::steady_clock::now( ) - start ).count( );
+
+    for ( const bulk::frame & f : result.frames )
+    {
+        const uint8_t * bytes = result.data( f );
+
+        printf( "%s %llu %lu %02x %u %u ", paths[f.file].c_str( ), ( unsigned long long ) f.start_us,
+                ( unsigned long ) f.duration_us, f.status, f.linecode, f.violations );
+        for ( uint16_t idx = 0; idx < f.size; idx++ )
+        {
+            printf( "%02x", bytes[idx] );
+        }
+        printf( "\n" );
+    }
+
+    const bulk::stats & s = result.stats;
+    printf( "# %llu edges, %llu frames, %llu crc ok, %llu crc errors, %llu line code errors, "
+            "%llu length errors, %llu collisions, %llu gaps of %llu edges\n",
+            ( unsigned long long ) s.edges, ( unsigned long long ) s.frames, ( unsigned long long ) s.crc_ok,
+            ( unsigned long long ) s.crc_errors, ( unsigned long long ) s.linecode_errors,
+            ( unsigned long long ) s.length_errors, ( unsigned long long ) s.collisions,
+            ( unsigned long long ) s.gaps, ( unsigned long long ) s.dropped );
+    fprintf( stderr, "# %.3f s, %.0f frames/s\n", seconds, seconds > 0 ? s.frames / seconds : 0.0 );
+
+    return ok ? 0 : 1;
+}
+
+
+/* -------------------------------------------------------------------------- */
@@ -0,0 +1,103 @@
+/* --------------------------------- Header --------------------------------- */
+
+
+/**
+ * @file    crc8_slice.cpp
+ * @brief   Contains the 8 bit CRC of crc8.c, eight bytes at a time
+ *
+ * The remainder is a byte, so feeding a byte is a lookup of the byte xor the
+ * remainder, and the remainder a byte leaves after k more zero bytes is
+ * table k of it. The eight bytes of a word each go through the table of the
+ * bytes that follow it and the results are xored together.
+ */
+
+
+/* -------------------------------- Includes -------------------------------- */
+
+
+# include <array>
+# include "bulk_decode.hpp"
+
+
+/* --------------------------------- Defines -------------------------------- */
+
+
+# define CRC8_POLYNOMIAL    ( 0x07 )
+# define CRC8_SLICES        ( 8 )
+
+
+/* ---------------------------- Static Functions ---------------------------- */
+
+
+namespace
+{
+
+using crc8_tables_t = std::array< std::array< uint8_t, 256 >, CRC8_SLICES >;
+
+
+constexpr crc8_tables_t crc8_build_tables( void )
+{
+    crc8_tables_t tables = { };
+
+    for ( unsigned int byte = 0; byte < 256; byte++ )
+    {
+        uint8_t result = byte;
+        for ( int bit_idx = 0; bit_idx < 8; bit_idx++ )
+        {
+            result = ( result & 0x80 ) ? ( uint8_t ) ( ( result << 1 ) ^ CRC8_POLYNOMIAL ) : ( uint8_t ) ( result << 1 );
+        }
+        tables[0][byte] = result;
+    }
+
+    for ( unsigned int slice = 1; slice < CRC8_SLICES; slice++ )
+    {
+        for ( unsigned int byte = 0; byte < 256; byte++ )
+        {
+            tables[slice][byte] = tables[0][tables[slice - 1][byte]];
+        }
+    }
+
+    return tables;
+}
+
+
+constexpr crc8_tables_t crc8_tables = crc8_build_tables( );
+
+} // namespace
+
+
+/* ------------------------------- Functions -------------------------------- */
+
+
+namespace bulk
+{
+
+/**
+ * Calculates the same CRC as crc8_calculate()
+ */
+uint8_t crc8( const uint8_t * data, size_t size, uint8_t initial )
+{
+    uint8_t result = initial;
+    size_t idx = 0;
+
+    for ( ; idx + CRC8_SLICES <= size; idx += CRC8_SLICES )
+    {
+        result = crc8_tables[7][data[idx] ^ result] ^ crc8_tables[6][data[idx + 1]] ^
+                 crc8_tables[5][data[idx + 2]] ^ crc8_tables[4][data[idx + 3]] ^
+                 crc8_tables[3][data[idx + 4]] ^ crc8_tables[2][data[idx + 5]] ^
+                 crc8_tables[1][data[idx + 6]] ^ crc8_tables[0][data[idx + 7]];
+    }
+
+    for ( ; idx < size; idx++ )
+    {
+        result = crc8_tables[0][data[idx] ^ result];
+    }
+
+    return result;
+}
+
+
+} // namespace bulk
+
+
+/* -------------------------------------------------------------------------- */
@@ -0,0 +1,299 @@
+/* --------------------------------- Header --------------------------------- */
+
+
+/**
+ * @file    manchester.cpp
+ * @brief   Contains the Manchester kernels of the bulk decoder and picks the
+ *          fastest the CPU supports
+ *
+ * Slots are packed most significant bit first, so a slot byte holds four
+ * symbols, each a first half followed by its data bit. The wide kernels
+ * gather the data bits and count the symbols whose halves are equal, and
+ * leave what is left of a run to the scalar kernel.
+ *
+ * The x86 kernels are built with target attributes rather than for the
+ * whole library, so it runs on any x86 CPU and only calls them once
+ * __builtin_cpu_supports() says they can run.
+ */
+
+
+/* -------------------------------- Includes -------------------------------- */
+
+
+# include <cstring>
+# include "bulk_decode.hpp"
+
+# if defined( __x86_64__ ) || defined( __i386__ )
+# include <immintrin.h>
+# define BULK_X86
+# endif
+
+
+/* --------------------------------- Defines -------------------------------- */
+
+
+/**
+ * The data bits of eight slot bytes loaded big endian
+ */
+# define BULK_DATA_MASK     ( 0x5555555555555555ULL )
+
+
+/* ---------------------------- Static Functions ---------------------------- */
+
+
+namespace
+{
+
+/**
+ * A port of the Manchester bit loop in linecode_decode()
+ */
+unsigned int decode_scalar( const uint8_t * slots, uint8_t * out, size_t size )
+{
+    unsigned int violations = 0;
+    size_t slot_idx = 0;
+
+    for ( size_t byte_idx = 0; byte_idx < size; byte_idx++ )
+    {
+        uint8_t value = 0;
+
+        for ( int bit_idx = 7; bit_idx >= 0; bit_idx-- )
+        {
+            bool first = ( slots[slot_idx / 8] >> ( 7 - slot_idx % 8 ) ) & 0x01;
+            slot_idx++;
+            bool second = ( slots[slot_idx / 8] >> ( 7 - slot_idx % 8 ) ) & 0x01;
+            slot_idx++;
+
+            if ( first == second )
+            {
+                violations++;
+            }
+
+            value |= second << bit_idx;
+        }
+
+        out[byte_idx] = value;
+    }
+
+    return violations;
+}
+
+
+/**
+ * Loads eight slot bytes with the first slot in the top bit
+ */
+inline uint64_t load_slots( const uint8_t * slots )
+{
+    uint64_t word;
+    memcpy( &word, slots, sizeof( word ) );
+    return __builtin_bswap64( word );
+}
+
+
+/**
+ * Stores four decoded bytes from the low half of a word
+ */
+inline void store_bytes( uint8_t * out, uint64_t bits )
+{
+    uint32_t word = __builtin_bswap32( ( uint32_t ) bits );
+    memcpy( out, &word, sizeof( word ) );
+}
+
+
+/**
+ * Counts the symbols of eight slot bytes with equal halves
+ */
+inline unsigned int count_violations( uint64_t word )
+{
+    return __builtin_popcountll( ~( word ^ ( word >> 1 ) ) & BULK_DATA_MASK );
+}
+
+
+unsigned int decode_swar( const uint8_t * slots, uint8_t * out, size_t size )
+{
+    unsigned int violations = 0;
+    size_t idx = 0;
+
+    for ( ; idx + 4 <= size; idx += 4 )
+    {
+        uint64_t word = load_slots( slots + 2 * idx );
+        uint64_t bits = word & BULK_DATA_MASK;
+
+        // squeeze every other bit together, halving the gaps each step
+        bits = ( bits | ( bits >> 1 ) ) & 0x3333333333333333ULL;
+        bits = ( bits | ( bits >> 2 ) ) & 0x0F0F0F0F0F0F0F0FULL;
+        bits = ( bits | ( bits >> 4 ) ) & 0x00FF00FF00FF00FFULL;
+        bits = ( bits | ( bits >> 8 ) ) & 0x0000FFFF0000FFFFULL;
+        bits = ( bits | ( bits >> 16 ) ) & 0x00000000FFFFFFFFULL;
+
+        store_bytes( out + idx, bits );
+        violations += count_violations( word );
+    }
+
+    return violations + decode_scalar( slots + 2 * idx, out + idx, size - idx );
+}
+
+
+# ifdef BULK_X86
+
+__attribute__(( target( "bmi2,popcnt" ) ))
+unsigned int decode_bmi2( const uint8_t * slots, uint8_t * out, size_t size )
+{
+    unsigned int violations = 0;
+    size_t idx = 0;
+
+    for ( ; idx + 4 <= size; idx += 4 )
+    {
+        uint64_t word = load_slots( slots + 2 * idx );
+
+        store_bytes( out + idx, _pext_u64( word, BULK_DATA_MASK ) );
+        violations += count_violations( word );
+    }
+
+    return violations + decode_scalar( slots + 2 * idx, out + idx, size - idx );
+}
+
+
+/**
+ * Splits every slot byte into nibbles of two symbols each, looks up their
+ * two data bits and violations, and joins the nibbles of slot byte pairs
+ * into a byte with a multiply add
+ */
+__attribute__(( target( "avx2" ) ))
+unsigned int decode_avx2( const uint8_t * slots, uint8_t * out, size_t size )
+{
+    // data bits 2 and 0 of a nibble, placed for the high and the low nibble
+    const __m256i data_hi = _mm256_setr_epi8(
+        0, 4, 0, 4, 8, 12, 8, 12, 0, 4, 0, 4, 8, 12, 8, 12,
+        0, 4, 0, 4, 8, 12, 8, 12, 0, 4, 0, 4, 8, 12, 8, 12 );
+    const __m256i data_lo = _mm256_setr_epi8(
+        0, 1, 0, 1, 2, 3, 2, 3, 0, 1, 0, 1, 2, 3, 2, 3,
+        0, 1, 0, 1, 2, 3, 2, 3, 0, 1, 0, 1, 2, 3, 2, 3 );
+    // symbols of a nibble with equal halves
+    const __m256i equal = _mm256_setr_epi8(
+        2, 1, 1, 2, 1, 0, 0, 1, 1, 0, 0, 1, 2, 1, 1, 2,
+        2, 1, 1, 2, 1, 0, 0, 1, 1, 0, 0, 1, 2, 1, 1, 2 );
+    const __m256i nibble = _mm256_set1_epi8( 0x0F );
+    const __m256i weights = _mm256_set1_epi16( 0x0110 );   // 16 for the first byte, 1 for the second
+    __m256i counts = _mm256_setzero_si256( );
+    size_t idx = 0;
+
+    for ( ; idx + 16 <= size; idx += 16 )
+    {
+        __m256i word = _mm256_loadu_si256( ( const __m256i * ) ( slots + 2 * idx ) );
+        __m256i hi = _mm256_and_si256( _mm256_srli_epi16( word, 4 ), nibble );
+        __m256i lo = _mm256_and_si256( word, nibble );
+
+        __m256i half = _mm256_or_si256( _mm256_shuffle_epi8( data_hi, hi ), _mm256_shuffle_epi8( data_lo, lo ) );
+        __m256i joined = _mm256_maddubs_epi16( half, weights );
+        __m256i packed = _mm256_permute4x64_epi64( _mm256_packus_epi16( joined, joined ), 0x08 );
+        _mm_storeu_si128( ( __m128i * ) ( out + idx ), _mm256_castsi256_si128( packed ) );
+
+        __m256i bad = _mm256_add_epi8( _mm256_shuffle_epi8( equal, hi ), _mm256_shuffle_epi8( equal, lo ) );
+        counts = _mm256_add_epi64( counts, _mm256_sad_epu8( bad, _mm256_setzero_si256( ) ) );
+    }
+
+    uint64_t lanes[4];
+    _mm256_storeu_si256( ( __m256i * ) lanes, counts );
+    unsigned int violations = lanes[0] + lanes[1] + lanes[2] + lanes[3];
+
+    return violations + decode_swar( slots + 2 * idx, out + idx, size - idx );
+}
+
+# endif // BULK_X86
+
+} // namespace
+
+
+/* ------------------------------- Functions -------------------------------- */
+
+
+namespace bulk
+{
+
+/**
+ * Gets the name of a kernel
+ */
+const char * kernel_name( kernel k )
+{
+    switch ( k )
+    {
+        case kernel::scalar:    return "scalar";
+        case kernel::swar:      return "swar";
+        case kernel::bmi2:      return "bmi2";
+        case kernel::avx2:      return "avx2";
+        default:                return "unknown";
+    }
+}
+
+
+/**
+ * Gets whether the CPU can run a kernel
+ */
+bool kernel_supported( kernel k )
+{
+    switch ( k )
+    {
+        case kernel::scalar:
+        case kernel::swar:
+            return true;
+
+# ifdef BULK_X86
+        case kernel::bmi2:
+            return __builtin_cpu_supports( "bmi2" ) && __builtin_cpu_supports( "popcnt" );
+
+        case kernel::avx2:
+            return __builtin_cpu_supports( "avx2" );
+# endif
+
+        default:
+            return false;
+    }
+}
+
+
+/**
+ * Gets the fastest kernel the CPU can run
+ *
+ * NOTE:
+ * pext is microcoded and slow on AMD before Zen 3, which has AVX2, so the
+ * order only goes wrong there when AVX2 is missing too
+ */
+kernel best_kernel( void )
+{
+    for ( kernel k : { kernel::avx2, kernel::bmi2 } )
+    {
+        if ( kernel_supported( k ) )
+        {
+            return k;
+        }
+    }
+
+    return kernel::swar;
+}
+
+
+unsigned int manchester_decode( kernel k, const uint8_t * slots, uint8_t * out, size_t size )
+{
+    switch ( k )
+    {
+        case kernel::swar:
+            return decode_swar( slots, out, size );
+
+# ifdef BULK_X86
+        case kernel::bmi2:
+            return decode_bmi2( slots, out, size );
+
+        case kernel::avx2:
+            return decode_avx2( slots, out, size );
+# endif
+
+        default:
+            return decode_scalar( slots, out, size );
+    }
+}
+
+
+} // namespace bulk
+
+
+/* -------------------------------------------------------------------------- */
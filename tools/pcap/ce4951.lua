@@ -0,0 +1,177 @@
+-- Wireshark dissector of the frames the CE4951 sniffer records, see
+-- src/driver/network/sniffer.h for the pseudo header and network.h for
+-- frame_header_t and frame_trailer_t.
+--
+--     wireshark -X lua_script:tools/pcap/ce4951.lua sniff.pcapng
+--
+-- or copy it into the personal plugins folder. Frames are recorded under
+-- LINKTYPE_USER0 (147), which the dissector takes over.
+
+local ce4951 = Proto("ce4951", "CE4951 Bus Frame")
+
+local STATUS_CRC_OK         = 0x01
+local STATUS_CRC_ERROR      = 0x02
+local STATUS_LINECODE_ERROR = 0x04
+local STATUS_PREAMBLE_ERROR = 0x08
+local STATUS_LENGTH_ERROR   = 0x10
+local STATUS_COLLISION      = 0x20
+local STATUS_FEC_CORRECTED  = 0x40
+
+local FLAG_CRC        = 0x01
+local FLAG_FEC        = 0x10
+local FLAG_COMPRESSED = 0x20
+local FLAG_PORT       = 0x40
+local FLAG_CONTROL    = 0x80
+
+local HEADER_SIZE = 6
+
+local linecodes = { [0] = "Manchester", [1] = "Stuffed", [255] = "Unknown" }
+local preambles = { [0x55] = "Manchester", [0x56] = "Stuffed" }
+local opcodes = { [1] = "Pause", [2] = "Resume" }
+local addresses = { [0] = "Broadcast" }
+
+local f = ce4951.fields
+
+-- pseudo header
+f.version    = ProtoField.uint8("ce4951.sniff.version", "Sniffer Version")
+f.status     = ProtoField.uint8("ce4951.sniff.status", "Status", base.HEX)
+f.crc_ok     = ProtoField.bool("ce4951.sniff.crc_ok", "CRC OK", 8, nil, STATUS_CRC_OK)
+f.crc_error  = ProtoField.bool("ce4951.sniff.crc_error", "CRC Error", 8, nil, STATUS_CRC_ERROR)
+f.code_error = ProtoField.bool("ce4951.sniff.linecode_error", "Line Code Error", 8, nil, STATUS_LINECODE_ERROR)
+f.pre_error  = ProtoField.bool("ce4951.sniff.preamble_error", "Preamble Error", 8, nil, STATUS_PREAMBLE_ERROR)
+f.len_error  = ProtoField.bool("ce4951.sniff.length_error", "Length Error", 8, nil, STATUS_LENGTH_ERROR)
+f.collision  = ProtoField.bool("ce4951.sniff.collision", "Collision", 8, nil, STATUS_COLLISION)
+f.corrected  = ProtoField.bool("ce4951.sniff.fec_corrected", "FEC Corrected", 8, nil, STATUS_FEC_CORRECTED)
+f.linecode   = ProtoField.uint8("ce4951.sniff.linecode", "Line Code", base.DEC, linecodes)
+f.violations = ProtoField.uint16("ce4951.sniff.violations", "Line Code Violations")
+f.duration   = ProtoField.uint32("ce4951.sniff.duration", "Duration (us)")
+
+-- frame_header_t
+f.preamble    = ProtoField.uint8("ce4951.preamble", "Preamble", base.HEX, preambles)
+f.fversion    = ProtoField.uint8("ce4951.version", "Version")
+f.source      = ProtoField.uint8("ce4951.src", "Source", base.HEX, addresses)
+f.destination = ProtoField.uint8("ce4951.dst", "Destination", base.HEX, addresses)
+f.length      = ProtoField.uint8("ce4951.length", "Length")
+f.flags       = ProtoField.uint8("ce4951.flags", "CRC Flag", base.HEX)
+f.flag_crc    = ProtoField.bool("ce4951.flags.crc", "CRC", 8, nil, FLAG_CRC)
+f.flag_fec    = ProtoField.bool("ce4951.flags.fec", "FEC", 8, nil, FLAG_FEC)
+f.flag_lzss   = ProtoField.bool("ce4951.flags.compressed", "Compressed", 8, nil, FLAG_COMPRESSED)
+f.flag_port   = ProtoField.bool("ce4951.flags.port", "Port", 8, nil, FLAG_PORT)
+f.flag_ctrl   = ProtoField.bool("ce4951.flags.control", "Control", 8, nil, FLAG_CONTROL)
+
+-- message and frame_trailer_t
+f.port    = ProtoField.uint8("ce4951.port", "Port", base.HEX)
+f.opcode  = ProtoField.uint8("ce4951.control.opcode", "Control Opcode", base.DEC, opcodes)
+f.payload = ProtoField.bytes("ce4951.payload", "Payload")
+f.coded   = ProtoField.bytes("ce4951.fec_payload", "Hamming (8,4) Coded Payload")
+f.fcs     = ProtoField.uint8("ce4951.fcs", "FCS", base.HEX)
+
+local e_crc       = ProtoExpert.new("ce4951.expert.crc", "CRC error", expert.group.CHECKSUM, expert.severity.ERROR)
+local e_linecode  = ProtoExpert.new("ce4951.expert.linecode", "Line code violation", expert.group.MALFORMED, expert.severity.ERROR)
+local e_preamble  = ProtoExpert.new("ce4951.expert.preamble", "No preamble", expert.group.MALFORMED, expert.severity.ERROR)
+local e_length    = ProtoExpert.new("ce4951.expert.length", "Frame cut short or overlong", expert.group.MALFORMED, expert.severity.WARN)
+local e_collision = ProtoExpert.new("ce4951.expert.collision", "Collision", expert.group.SEQUENCE, expert.severity.WARN)
+ce4951.experts = { e_crc, e_linecode, e_preamble, e_length, e_collision }
+
+function ce4951.dissector(buffer, pinfo, tree)
+    if buffer:len() < 12 then
+        return 0
+    end
+
+    pinfo.cols.protocol = "CE4951"
+
+    local root = tree:add(ce4951, buffer(), "CE4951 Bus Frame")
+    local sniff = root:add(ce4951, buffer(0, 12), "Sniffer")
+    local status = buffer(1, 1):uint()
+
+    sniff:add(f.version, buffer(0, 1))
+    local st = sniff:add(f.status, buffer(1, 1))
+    st:add(f.crc_ok, buffer(1, 1))
+    st:add(f.crc_error, buffer(1, 1))
+    st:add(f.code_error, buffer(1, 1))
+    st:add(f.pre_error, buffer(1, 1))
+    st:add(f.len_error, buffer(1, 1))
+    st:add(f.collision, buffer(1, 1))
+    st:add(f.corrected, buffer(1, 1))
+    sniff:add(f.linecode, buffer(2, 1))
+    sniff:add_le(f.violations, buffer(4, 2))
+    sniff:add_le(f.duration, buffer(8, 4))
+
+    if bit.band(status, STATUS_CRC_ERROR) ~= 0 then root:add_proto_expert_info(e_crc) end
+    if bit.band(status, STATUS_LINECODE_ERROR) ~= 0 then root:add_proto_expert_info(e_linecode) end
+    if bit.band(status, STATUS_PREAMBLE_ERROR) ~= 0 then root:add_proto_expert_info(e_preamble) end
+    if bit.band(status, STATUS_LENGTH_ERROR) ~= 0 then root:add_proto_expert_info(e_length) end
+    if bit.band(status, STATUS_COLLISION) ~= 0 then root:add_proto_expert_info(e_collision) end
+
+    local frame = buffer(12):tvb()
+    local size = frame:len()
+    if size == 0 then
+        pinfo.cols.info = "Undecoded"
+        return buffer:len()
+    end
+
+    root:add(f.preamble, frame(0, 1))
+    if size < HEADER_SIZE then
+        pinfo.cols.info = "Runt"
+        return buffer:len()
+    end
+
+    local source = frame(2, 1):uint()
+    local destination = frame(3, 1):uint()
+    local length = frame(4, 1):uint()
+    local flags = frame(5, 1):uint()
+
+    root:add(f.fversion, frame(1, 1))
+    root:add(f.source, frame(2, 1))
+    root:add(f.destination, frame(3, 1))
+    root:add(f.length, frame(4, 1))
+    local fl = root:add(f.flags, frame(5, 1))
+    fl:add(f.flag_crc, frame(5, 1))
+    fl:add(f.flag_fec, frame(5, 1))
+    fl:add(f.flag_lzss, frame(5, 1))
+    fl:add(f.flag_port, frame(5, 1))
+    fl:add(f.flag_ctrl, frame(5, 1))
+
+    pinfo.cols.src = string.format("0x%02X", source)
+    pinfo.cols.dst = string.format("0x%02X", destination)
+
+    local available = math.min(length, size - HEADER_SIZE)
+    local offset = HEADER_SIZE
+    local info = string.format("0x%02X -> 0x%02X, %u bytes", source, destination, length)
+
+    if bit.band(flags, FLAG_FEC) ~= 0 then
+        -- the port is coded along with the message
+        if available > 0 then
+            root:add(f.coded, frame(offset, available))
+        end
+        offset = offset + available
+        info = info .. ", FEC"
+    else
+        if bit.band(flags, FLAG_PORT) ~= 0 and available > 0 then
+            root:add(f.port, frame(offset, 1))
+            info = info .. string.format(", port 0x%02X", frame(offset, 1):uint())
+            offset = offset + 1
+            available = available - 1
+        end
+        if bit.band(flags, FLAG_CONTROL) ~= 0 and available > 0 then
+            root:add(f.opcode, frame(offset, 1))
+            info = info .. ", " .. (opcodes[frame(offset, 1):uint()] or "control")
+        elseif available > 0 then
+            root:add(f.payload, frame(offset, available))
+        end
+        offset = offset + available
+    end
+
+    if offset < size and offset == HEADER_SIZE + length then
+        root:add(f.fcs, frame(offset, 1))
+    end
+
+    if bit.band(flags, FLAG_COMPRESSED) ~= 0 then
+        info = info .. ", compressed"
+    end
+    pinfo.cols.info = info
+
+    return buffer:len()
+end
+
+DissectorTable.get("wtap_encap"):add(wtap.USER0, ce4951)
@@ -0,0 +1,412 @@
+/* --------------------------------- Header --------------------------------- */
+
+
+/**
+ * @file    sniff2pcapng.c
+ * @brief   Converts the record stream of the sniffer into a pcapng file
+ *
+ * Reads a dump of the serial port taken while a board ran /sniff start, for
+ * example with
+ *
+ *      stty -F /dev/ttyACM0 115200 raw && cat /dev/ttyACM0 > sniff.bin
+ *
+ * picks the records out from between the console's text, see sniffer.h, and
+ * writes every frame as an enhanced packet block. The status of a frame is
+ * kept in the pseudo header ce4951.lua dissects, and is also set in the
+ * packet's link layer error flags, so analysers without the dissector can
+ * filter on CRC, symbol and preamble errors. Frames cut off by a collision
+ * carry a comment saying so.
+ *
+ * Time stamps count from the board starting, --epoch adds the Unix time it
+ * started at. --pcap writes the classic format instead.
+ *
+ * Build with the host build and run from the repository root:
+ *
+ *      cmake -S . -B build-host -DCE4951_HOST_BUILD=ON
+ *      cmake --build build-host
+ *      ./build-host/tools/pcap/sniff2pcapng [--pcap] [--epoch SECONDS] sniff.bin sniff.pcapng
+ *      wireshark -X lua_script:tools/pcap/ce4951.lua sniff.pcapng
+ */
+
+
+/* -------------------------------- Includes -------------------------------- */
+
+
+# include <stdbool.h>
+# include <stdio.h>
+# include <stdlib.h>
+# include <string.h>
+
+# include "crc8.h"
+# include "network.h"
+# include "sniffer.h"
+
+
+/* --------------------------------- Defines -------------------------------- */
+
+
+/**
+ * The longest run between delimiters taken for a record
+ */
+# define CONVERT_CHUNK_MAX          ( 1024 )
+
+# define CONVERT_PCAP_HEADER_SIZE   ( 24 )
+# define CONVERT_PCAP_RECORD_SIZE   ( 16 )
+
+# define PCAPNG_SHB                 ( 0x0A0D0D0AUL )
+# define PCAPNG_IDB                 ( 0x00000001UL )
+# define PCAPNG_EPB                 ( 0x00000006UL )
+# define PCAPNG_BYTE_ORDER          ( 0x1A2B3C4DUL )
+
+# define PCAPNG_OPT_END             ( 0 )
+# define PCAPNG_OPT_COMMENT         ( 1 )
+# define PCAPNG_OPT_IF_NAME         ( 2 )
+# define PCAPNG_OPT_IF_TSRESOL      ( 9 )
+# define PCAPNG_OPT_EPB_FLAGS       ( 2 )
+
+/**
+ * epb_flags, an inbound packet and its link layer errors
+ */
+# define PCAPNG_FLAG_INBOUND        ( 0x00000001UL )
+# define PCAPNG_FLAG_SYMBOL_ERROR   ( 1UL << 31 )
+# define PCAPNG_FLAG_PREAMBLE_ERROR ( 1UL << 30 )
+# define PCAPNG_FLAG_TOO_SHORT      ( 1UL << 26 )
+# define PCAPNG_FLAG_CRC_ERROR      ( 1UL << 24 )
+
+
+/* ---------------------------------- Types --------------------------------- */
+
+
+typedef struct
+{
+    FILE * out;
+    bool pcap;
+    uint32_t epoch;
+
+    bool started;               // the file header has been written
+    uint32_t linktype;
+    uint32_t snaplen;
+
+    uint32_t frames;
+    uint32_t headers;
+    uint32_t damaged;           // records whose check failed
+    unsigned long skipped;      // bytes of console text between records
+} convert_t;
+
+
+/* ---------------------------- Static Functions ---------------------------- */
+
+
+static uint32_t convert_get32( const uint8_t * in )
+{
+    return in[0] | in[1] << 8 | in[2] << 16 | ( uint32_t ) in[3] << 24;
+}
+
+
+static void convert_put16( FILE * out, uint16_t value )
+{
+    fputc( value & 0xFF, out );
+    fputc( value >> 8, out );
+}
+
+
+static void convert_put32( FILE * out, uint32_t value )
+{
+    convert_put16( out, value & 0xFFFF );
+    convert_put16( out, value >> 16 );
+}
+
+
+/**
+ * Writes a pcapng option, padded to 32 bits
+ */
+static void convert_option( FILE * out, uint16_t code, const void * value, uint16_t size )
+{
+    static const uint8_t padding[3];
+
+    convert_put16( out, code );
+    convert_put16( out, size );
+    fwrite( value, 1, size, out );
+    fwrite( padding, 1, ( 4 - size % 4 ) % 4, out );
+}
+
+
+/**
+ * Gets the bytes an option takes, padded
+ */
+static uint32_t convert_option_size( uint16_t size )
+{
+    return 4 + ( size + 3U ) / 4U * 4U;
+}
+
+
+/**
+ * Writes the file header, and for pcapng the interface the frames came in on
+ */
+static void convert_start( convert_t * convert )
+{
+    static const char name[] = "ce4951";
+    const uint8_t tsresol = 6;
+
+    convert->started = true;
+
+    if ( convert->pcap )
+    {
+        convert_put32( convert->out, 0xA1B2C3D4UL );
+        convert_put16( convert->out, 2 );
+        convert_put16( convert->out, 4 );
+        convert_put32( convert->out, 0 );
+        convert_put32( convert->out, 0 );
+        convert_put32( convert->out, convert->snaplen );
+        convert_put32( convert->out, convert->linktype );
+        return;
+    }
+
+    convert_put32( convert->out, PCAPNG_SHB );
+    convert_put32( convert->out, 28 );
+    convert_put32( convert->out, PCAPNG_BYTE_ORDER );
+    convert_put16( convert->out, 1 );
+    convert_put16( convert->out, 0 );
+    convert_put32( convert->out, 0xFFFFFFFFUL );    // section length not given
+    convert_put32( convert->out, 0xFFFFFFFFUL );
+    convert_put32( convert->out, 28 );
+
+    uint32_t size = 20 + convert_option_size( sizeof( name ) - 1 ) + convert_option_size( 1 ) + 4;
+    convert_put32( convert->out, PCAPNG_IDB );
+    convert_put32( convert->out, size );
+    convert_put16( convert->out, convert->linktype );
+    convert_put16( convert->out, 0 );
+    convert_put32( convert->out, convert->snaplen );
+    convert_option( convert->out, PCAPNG_OPT_IF_NAME, name, sizeof( name ) - 1 );
+    convert_option( convert->out, PCAPNG_OPT_IF_TSRESOL, &tsresol, 1 );
+    convert_option( convert->out, PCAPNG_OPT_END, NULL, 0 );
+    convert_put32( convert->out, size );
+}
+
+
+/**
+ * Writes a frame record
+ *
+ * @param   [in]    record  The pcap record header and the packet
+ */
+static bool convert_frame( convert_t * convert, const uint8_t * record, uint32_t size )
+{
+    static const char collision[] = "collision";
+
+    uint32_t length = convert_get32( record + 8 );
+    const uint8_t * packet = record + CONVERT_PCAP_RECORD_SIZE;
+
+    if ( size != CONVERT_PCAP_RECORD_SIZE + length || length < SNIFFER_PSEUDO_HEADER_SIZE )
+    {
+        return false;
+    }
+
+    if ( !convert->started )
+    {
+        convert_start( convert );
+    }
+
+    uint64_t seconds = ( uint64_t ) convert_get32( record ) + convert->epoch;
+    uint32_t micros = convert_get32( record + 4 );
+
+    convert->frames++;
+
+    if ( convert->pcap )
+    {
+        convert_put32( convert->out, ( uint32_t ) seconds );
+        convert_put32( convert->out, micros );
+        convert_put32( convert->out, length );
+        convert_put32( convert->out, length );
+        fwrite( packet, 1, length, convert->out );
+        return true;
+    }
+
+    uint8_t status = packet[1];
+    uint32_t flags = PCAPNG_FLAG_INBOUND;
+    flags |= status & NETWORK_SNIFF_CRC_ERROR ? PCAPNG_FLAG_CRC_ERROR : 0;
+    flags |= status & NETWORK_SNIFF_LINECODE_ERROR ? PCAPNG_FLAG_SYMBOL_ERROR : 0;
+    flags |= status & NETWORK_SNIFF_PREAMBLE_ERROR ? PCAPNG_FLAG_PREAMBLE_ERROR : 0;
+    flags |= status & NETWORK_SNIFF_LENGTH_ERROR ? PCAPNG_FLAG_TOO_SHORT : 0;
+
+    bool collided = status & NETWORK_SNIFF_COLLISION;
+    uint64_t time = seconds * 1000000U + micros;
+    uint32_t padded = ( length + 3U ) / 4U * 4U;
+    uint32_t block = 32 + padded + convert_option_size( 4 ) +
+                     ( collided ? convert_option_size( sizeof( collision ) - 1 ) : 0 ) + 4;
+
+    convert_put32( convert->out, PCAPNG_EPB );
+    convert_put32( convert->out, block );
+    convert_put32( convert->out, 0 );
+    convert_put32( convert->out, time >> 32 );
+    convert_put32( convert->out, ( uint32_t ) time );
+    convert_put32( convert->out, length );
+    convert_put32( convert->out, length );
+    fwrite( packet, 1, length, convert->out );
+    fwrite( "\0\0\0", 1, padded - length, convert->out );
+
+    uint8_t flag_bytes[4] = { flags, flags >> 8, flags >> 16, flags >> 24 };
+    convert_option( convert->out, PCAPNG_OPT_EPB_FLAGS, flag_bytes, sizeof( flag_bytes ) );
+    if ( collided )
+    {
+        convert_option( convert->out, PCAPNG_OPT_COMMENT, collision, sizeof( collision ) - 1 );
+    }
+    convert_option( convert->out, PCAPNG_OPT_END, NULL, 0 );
+    convert_put32( convert->out, block );
+
+    return true;
+}
+
+
+/**
+ * Decodes the bytes between two delimiters as a record and converts it
+ *
+ * @return  bool if they were a record
+ */
+static bool convert_chunk( convert_t * convert, const uint8_t * chunk, uint32_t size )
+{
+    uint8_t record[CONVERT_CHUNK_MAX];
+    uint32_t length = 0;
+
+    // undo the COBS encoding
+    for ( uint32_t i = 0; i < size; )
+    {
+        uint8_t code = chunk[i++];
+
+        if ( code == 0 || i + code - 1 > size )
+        {
+            return false;
+        }
+        for ( uint8_t n = 1; n < code; n++ )
+        {
+            record[length++] = chunk[i++];
+        }
+        if ( code < 0xFF && i < size )
+        {
+            record[length++] = 0x00;
+        }
+    }
+
+    if ( length < 3 || record[0] != SNIFFER_MAGIC ||
+         crc8_calculate( record, length - 1, 0 ) != record[length - 1] )
+    {
+        return false;
+    }
+    length -= 3;
+
+    if ( record[1] == SNIFFER_RECORD_HEADER && length == CONVERT_PCAP_HEADER_SIZE &&
+         convert_get32( record + 2 ) == 0xA1B2C3D4UL )
+    {
+        convert->snaplen = convert_get32( record + 2 + 16 );
+        convert->linktype = convert_get32( record + 2 + 20 );
+        convert->headers++;
+        return true;
+    }
+    else if ( record[1] == SNIFFER_RECORD_FRAME && length >= CONVERT_PCAP_RECORD_SIZE )
+    {
+        return convert_frame( convert, record + 2, length );
+    }
+
+    return false;
+}
+
+
+/**
+ * Splits the dump at the delimiters and converts every record in it
+ */
+static void convert_stream( convert_t * convert, FILE * in )
+{
+    uint8_t chunk[CONVERT_CHUNK_MAX];
+    uint32_t size = 0;
+    bool overlong = false;
+    int c;
+
+    while ( ( c = fgetc( in ) ) != EOF )
+    {
+        if ( c != 0x00 )
+        {
+            if ( size < sizeof( chunk ) )
+            {
+                chunk[size++] = c;
+            }
+            else
+            {
+                overlong = true;
+                convert->skipped++;
+            }
+            continue;
+        }
+
+        if ( size > 0 && ( overlong || !convert_chunk( convert, chunk, size ) ) )
+        {
+            // text starting with the magic is most likely a damaged record
+            convert->damaged += size > 1 && chunk[1] == SNIFFER_MAGIC;
+            convert->skipped += size;
+        }
+        size = 0;
+        overlong = false;
+    }
+
+    convert->skipped += size;
+}
+
+
+/* ------------------------------- Functions -------------------------------- */
+
+
+int main( int argc, char ** argv )
+{
+    convert_t convert = { .linktype = SNIFFER_LINKTYPE, .snaplen = 0xFFFF };
+    int i;
+
+    for ( i = 1; i < argc && strncmp( argv[i], "--", 2 ) == 0; i++ )
+    {
+        if ( strcmp( argv[i], "--pcap" ) == 0 )
+        {
+            convert.pcap = true;
+        }
+        else if ( strcmp( argv[i], "--epoch" ) == 0 && i + 1 < argc )
+        {
+            convert.epoch = strtoul( argv[++i], NULL, 0 );
+        }
+        else
+        {
+            break;
+        }
+    }
+
+    if ( argc - i != 2 )
+    {
+        fprintf( stderr, "usage: %s [--pcap] [--epoch SECONDS] DUMP|- OUTPUT\n", argv[0] );
+        return 2;
+    }
+
+    FILE * in = strcmp( argv[i], "-" ) == 0 ? stdin : fopen( argv[i], "rb" );
+    if ( in == NULL )
+    {
+        perror( argv[i] );
+        return 1;
+    }
+
+    convert.out = fopen( argv[i + 1], "wb" );
+    if ( convert.out == NULL )
+    {
+        perror( argv[i + 1] );
+        return 1;
+    }
+
+    convert_stream( &convert, in );
+    if ( !convert.started )
+    {
+        convert_start( &convert );
+    }
+
+    bool ok = !ferror( in ) && fclose( convert.out ) == 0;
+    fprintf( stderr, "%s: %lu frames, %lu headers, %lu damaged records, %lu bytes of text skipped\n",
+             argv[i + 1], ( unsigned long ) convert.frames, ( unsigned long ) convert.headers,
+             ( unsigned long ) convert.damaged, convert.skipped );
+
+    return ok ? 0 : 1;
+}
+
+
+/* -------------------------------------------------------------------------- */
@@ -0,0 +1,754 @@
+/* --------------------------------- Header --------------------------------- */
+
+
+/**
+ * @file    edge_replay.c
+ * @brief   Replays bus edge captures through the receive path of the host
+ *          build
+ *
+ * A capture, see capture.h, is read either as the raw file or out of a
+ * console log holding the #cap lines a board streamed. Its edges are driven
+ * onto the simulated line at the times they were recorded, so the channel
+ * monitor, the idle timeout and network_service() decode them exactly as
+ * the board did. Every message decoded is printed with the time it was
+ * delivered, along with the decode errors the firmware reports, then a line
+ * counting the edges and messages. The output only depends on the capture,
+ * so a capture and its output make a regression case for the decoder:
+ *
+ *      ./build-host/tools/replay/edge_replay tools/replay/corpus/stuffed.cap > out.txt
+ *      diff out.txt tools/replay/corpus/stuffed.txt
+ *
+ * Every capture is replayed on a board of its own, in a child process. The
+ * replaying board is promiscuous unless given the address of the board
+ * the capture was taken on. Besides the default port, messages on up to
+ * three more ports are printed when asked for.
+ *
+ * --sniff writes the stream /sniff start would send to a file, which
+ * tools/pcap/sniff2pcapng.c converts, with the decode errors between its
+ * records.
+ *
+ * --record captures messages looped back on a simulated board instead, by
+ * the same capture module the firmware streams from, to start new cases.
+ *
+ * Build with the host build and run from the repository root:
+ *
+ *      cmake -S . -B build-host -DCE4951_HOST_BUILD=ON
+ *      cmake --build build-host
+ *      ./build-host/tools/replay/edge_replay [--address A] [--port N]... [--sniff FILE] CAPTURE...
+ *      ./build-host/tools/replay/edge_replay --record FILE [--count N] [--size BYTES]
+ *              [--linecode manchester|stuffed] [--fec] [--jitter-us US] [--seed N]
+ */
+
+
+/* -------------------------------- Includes -------------------------------- */
+
+
+# include <stdio.h>
+# include <stdlib.h>
+# include <string.h>
+# include <unistd.h>
+# include <sys/wait.h>
+
+# include "mock.h"
+# include "capture.h"
+# include "channel_monitor.h"
+# include "leds.h"
+# include "linecode.h"
+# include "network.h"
+# include "phy_impair.h"
+# include "sniffer.h"
+# include "state.h"
+# include "systime.h"
+# include "timeout.h"
+
+
+/* --------------------------------- Defines -------------------------------- */
+
+
+# define REPLAY_TIMEOUT_PERIOD_US   ( 1100U )
+
+/**
+ * Idle line before the first edge and after the last, longer than the idle
+ * timeout so the last frame is committed
+ */
+# define REPLAY_SETTLE_US           ( 5000U )
+
+# define REPLAY_CLOCKS_PER_US       ( MOCK_CLOCK_HZ / 1000000U )
+
+/**
+ * Ports printed besides the default, every other port table entry
+ */
+# define REPLAY_PORTS_MAX           ( 3 )
+
+/**
+ * The largest capture read
+ */
+# define REPLAY_CAPTURE_MAX         ( 64U * 1024U * 1024U )
+
+/**
+ * Recording drains the capture ring this often, well before it fills
+ */
+# define REPLAY_RECORD_SLICE_US     ( 10000U )
+# define REPLAY_RECORD_MAX_SLICES   ( 6000U )
+
+# define REPLAY_RECORD_SOURCE       ( 0x01 )
+# define REPLAY_RECORD_DESTINATION  ( 0x02 )
+
+
+/* ---------------------------------- Types --------------------------------- */
+
+
+typedef struct
+{
+    int address;                // of the replaying board, or -1 for promiscuous
+    uint8_t ports[REPLAY_PORTS_MAX];
+    unsigned int port_count;
+    const char * sniff;         // the file to write the sniffer's stream to
+
+    const char * record;        // the file to record to, or NULL to replay
+    unsigned int count;
+    unsigned int size;
+    linecode_t linecode;
+    bool fec;
+    uint16_t jitter_us;
+    uint32_t seed;
+} replay_options_t;
+
+
+/**
+ * Counts of one replay
+ */
+typedef struct
+{
+    uint32_t edges;
+    uint32_t pulses;            // edges to the level the line was already at
+    uint32_t gaps;
+    uint32_t dropped;           // edges the capture lost in its gaps
+    uint32_t messages;
+} replay_counts_t;
+
+
+/**
+ * A capture being read
+ */
+typedef struct
+{
+    uint8_t * data;
+    size_t size;
+    size_t capacity;
+} replay_buffer_t;
+
+
+/* ----------------------------- Static Globals ----------------------------- */
+
+
+static replay_options_t replay_options = {
+    .address = -1,
+    .count = 8,
+    .size = 32,
+    .linecode = LINECODE_MANCHESTER,
+    .seed = 1,
+};
+
+static replay_counts_t replay_counts;
+static uint64_t replay_base;    // the clock the capture started at
+
+
+/* ---------------------------- Static Functions ---------------------------- */
+
+
+/**
+ * Prints a decoded message with the time it was delivered
+ */
+static void replay_print( const network_message_t * message )
+{
+    printf( "%10.6f 0x%02X -> 0x%02X port %u len %u flags 0x%02X \"",
+            ( double ) ( mock_clock( ) - replay_base ) / MOCK_CLOCK_HZ,
+            message->source, message->destination, message->port, message->length, message->flags );
+
+    for ( unsigned int i = 0; i < message->length; i++ )
+    {
+        uint8_t c = message->data[i];
+
+        if ( c >= 0x20 && c < 0x7F && c != '"' && c != '\\' )
+        {
+            putchar( c );
+        }
+        else
+        {
+            printf( "\\x%02X", c );
+        }
+    }
+    printf( "\"\n" );
+
+    replay_counts.messages++;
+}
+
+
+/**
+ * Decodes the frames received and prints the messages on the default port,
+ * as the main loop does
+ */
+static void replay_deliver( void )
+{
+    const network_message_t * messages[NETWORK_PORT_QUEUE_DEPTH];
+    unsigned int count;
+
+    network_service( );
+    while ( ( count = network_port_borrow_batch( NETWORK_PORT_DEFAULT, messages, NETWORK_PORT_QUEUE_DEPTH ) ) > 0 )
+    {
+        for ( unsigned int i = 0; i < count; i++ )
+        {
+            replay_print( messages[i] );
+        }
+        network_port_release( NETWORK_PORT_DEFAULT, count );
+    }
+}
+
+
+/**
+ * Brings a board up the way main() does
+ *
+ * @return  bool if every driver initialized
+ */
+static bool replay_init( uint8_t address )
+{
+    mock_reset( );
+    mock_console( stdout );
+
+    return systime_init( ) == ERROR_CODE_NO_ERROR &&
+           network_init( ) == ERROR_CODE_NO_ERROR &&
+           channel_monitor_init( ) == ERROR_CODE_NO_ERROR &&
+           timeout_init( REPLAY_TIMEOUT_PERIOD_US ) == ERROR_CODE_NO_ERROR &&
+           leds_init( ) == ERROR_CODE_NO_ERROR &&
+           state_set( IDLE ) == ERROR_CODE_NO_ERROR &&
+           set_local_machine_address( address ) == ERROR_CODE_NO_ERROR;
+}
+
+
+/**
+ * Reads an unsigned LEB128 varint
+ *
+ * @return  bool if it was whole
+ */
+static bool replay_varint( const uint8_t * data, size_t size, size_t * offset, uint64_t * value )
+{
+    *value = 0;
+
+    for ( unsigned int shift = 0; *offset < size && shift < 64; shift += 7 )
+    {
+        uint8_t byte = data[( *offset )++];
+
+        *value |= ( uint64_t ) ( byte & 0x7F ) << shift;
+        if ( !( byte & 0x80 ) )
+        {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+
+/**
+ * Replays one capture on a board just initialized
+ *
+ * @return  bool if the capture was whole
+ */
+static bool replay_capture( const char * name, const uint8_t * data, size_t size )
+{
+    uint64_t time_us = 0;
+    size_t offset = CAPTURE_HEADER_SIZE;
+    bool whole = true;
+
+    if ( size < CAPTURE_HEADER_SIZE || memcmp( data, "CECP", 4 ) != 0 || data[4] != CAPTURE_VERSION )
+    {
+        fprintf( stderr, "%s: not a version %u capture\n", name, CAPTURE_VERSION );
+        return false;
+    }
+
+    if ( !replay_init( replay_options.address < 0 ? 0 : ( uint8_t ) replay_options.address ) )
+    {
+        fprintf( stderr, "%s: the board didn't initialize\n", name );
+        return false;
+    }
+
+    network_rx_set_promiscuous( replay_options.address < 0 );
+    for ( unsigned int i = 0; i < replay_options.port_count; i++ )
+    {
+        network_port_open( replay_options.ports[i], replay_print );
+    }
+
+    // the sniffer's records and the decode errors go where the console would
+    FILE * sniff = NULL;
+    if ( replay_options.sniff != NULL )
+    {
+        sniff = fopen( replay_options.sniff, "ab" );
+        if ( sniff == NULL )
+        {
+            perror( replay_options.sniff );
+            return false;
+        }
+        mock_console( sniff );
+        sniffer_start( );
+    }
+
+    replay_counts = ( replay_counts_t ) { 0 };
+    printf( "# %s: starts %s\n", name, data[5] ? "high" : "low" );
+
+    mock_run_us( REPLAY_SETTLE_US );
+    replay_base = mock_clock( );
+    mock_line_drive( data[5] );
+
+    while ( offset < size )
+    {
+        uint64_t value;
+
+        if ( !replay_varint( data, size, &offset, &value ) )
+        {
+            whole = false;
+            break;
+        }
+
+        if ( value == 0 )
+        {
+            if ( !replay_varint( data, size, &offset, &value ) )
+            {
+                whole = false;
+                break;
+            }
+            printf( "# gap of %llu edges\n", ( unsigned long long ) value );
+            replay_counts.gaps++;
+            replay_counts.dropped += value;
+            continue;
+        }
+
+        bool level = ( value - 1 ) & 1;
+        time_us += ( value - 1 ) >> 1;
+        mock_run_to( replay_base + time_us * REPLAY_CLOCKS_PER_US );
+
+        if ( level == mock_line( ) )
+        {
+            // a pulse shorter than the interrupt, which only saw it once
+            EXTI->PR |= EXTI_PR_PR12;
+            mock_irq( EXTI15_10_IRQn );
+            replay_counts.pulses++;
+        }
+        else
+        {
+            mock_line_drive( level );
+        }
+        replay_counts.edges++;
+
+        replay_deliver( );
+    }
+
+    mock_line_drive( true );
+    mock_run_us( REPLAY_SETTLE_US );
+    replay_deliver( );
+
+    printf( "# %lu edges, %lu pulses, %lu gaps of %lu edges, %lu messages, %lu on unopened ports%s\n",
+            ( unsigned long ) replay_counts.edges, ( unsigned long ) replay_counts.pulses,
+            ( unsigned long ) replay_counts.gaps, ( unsigned long ) replay_counts.dropped,
+            ( unsigned long ) replay_counts.messages,
+            ( unsigned long ) network_port_dropped_count( NETWORK_PORT_UNKNOWN ),
+            whole ? "" : ", truncated" );
+
+    if ( sniff != NULL )
+    {
+        fclose( sniff );
+    }
+
+    return whole;
+}
+
+
+/**
+ * Replays one capture in a child process, since the firmware keeps its state
+ * in file scope variables that only start out fresh once
+ *
+ * @return  bool if the capture was whole
+ */
+static bool replay_run( const char * name, const uint8_t * data, size_t size )
+{
+    int status;
+
+    fflush( stdout );
+
+    pid_t child = fork( );
+    if ( child == 0 )
+    {
+        bool whole = replay_capture( name, data, size );
+        fflush( stdout );
+        _exit( whole ? 0 : 1 );
+    }
+
+    return child > 0 && waitpid( child, &status, 0 ) == child &&
+           WIFEXITED( status ) && WEXITSTATUS( status ) == 0;
+}
+
+
+/**
+ * Appends bytes to a capture being read
+ */
+static bool replay_append( replay_buffer_t * buffer, const uint8_t * data, size_t size )
+{
+    if ( buffer->size + size > buffer->capacity )
+    {
+        size_t capacity = buffer->capacity ? buffer->capacity * 2 : 4096;
+        while ( capacity < buffer->size + size )
+        {
+            capacity *= 2;
+        }
+
+        uint8_t * grown = realloc( buffer->data, capacity );
+        if ( grown == NULL || capacity > REPLAY_CAPTURE_MAX )
+        {
+            free( grown );
+            buffer->data = NULL;
+            return false;
+        }
+        buffer->data = grown;
+        buffer->capacity = capacity;
+    }
+
+    memcpy( buffer->data + buffer->size, data, size );
+    buffer->size += size;
+
+    return true;
+}
+
+
+/**
+ * Decodes a line of base64, stopping at the padding
+ *
+ * @return  The number of bytes decoded
+ */
+static size_t replay_base64( const char * text, uint8_t * out )
+{
+    static const char digits[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+    uint32_t group = 0;
+    unsigned int bits = 0;
+    size_t size = 0;
+
+    for ( ; *text && *text != '='; text++ )
+    {
+        const char * digit = strchr( digits, *text );
+
+        if ( digit == NULL )
+        {
+            continue;
+        }
+
+        group = group << 6 | ( uint32_t ) ( digit - digits );
+        bits += 6;
+        if ( bits >= 8 )
+        {
+            bits -= 8;
+            out[size++] = ( uint8_t ) ( group >> bits );
+        }
+    }
+
+    return size;
+}
+
+
+/**
+ * Replays the raw capture in a file, or every capture in a console log
+ *
+ * @return  bool if every capture was read and replayed whole
+ */
+static bool replay_file( const char * path )
+{
+    replay_buffer_t capture = { 0 };
+    char line[512];
+    char name[600];
+    unsigned int captures = 0;
+    bool ok = true;
+    bool open = false;
+
+    FILE * file = fopen( path, "rb" );
+    if ( file == NULL )
+    {
+        perror( path );
+        return false;
+    }
+
+    // a raw capture is read whole
+    if ( fread( line, 1, 4, file ) == 4 && memcmp( line, "CECP", 4 ) == 0 )
+    {
+        size_t size;
+
+        rewind( file );
+        while ( ok && ( size = fread( line, 1, sizeof( line ), file ) ) > 0 )
+        {
+            ok = replay_append( &capture, ( uint8_t * ) line, size );
+        }
+        fclose( file );
+
+        ok = ok && replay_run( path, capture.data, capture.size );
+        free( capture.data );
+        return ok;
+    }
+
+    // otherwise pick the #cap lines out of the log, one capture from each begin
+    rewind( file );
+    while ( ok && fgets( line, sizeof( line ), file ) != NULL )
+    {
+        char * text = strstr( line, "#cap " );
+        uint8_t data[sizeof( line )];
+
+        if ( text == NULL )
+        {
+            continue;
+        }
+        text += 5;
+
+        if ( strncmp( text, "begin", 5 ) == 0 || strncmp( text, "end", 3 ) == 0 )
+        {
+            if ( open )
+            {
+                snprintf( name, sizeof( name ), "%s capture %u", path, captures );
+                ok = replay_run( name, capture.data, capture.size );
+            }
+            capture.size = 0;
+            open = strncmp( text, "begin", 5 ) == 0;
+            captures += open;
+        }
+        else if ( open )
+        {
+            ok = replay_append( &capture, data, replay_base64( text, data ) );
+        }
+    }
+    fclose( file );
+
+    // a log cut off before the capture ended
+    if ( ok && open )
+    {
+        snprintf( name, sizeof( name ), "%s capture %u", path, captures );
+        ok = replay_run( name, capture.data, capture.size );
+    }
+    else if ( captures == 0 )
+    {
+        fprintf( stderr, "%s: no capture in it\n", path );
+        ok = false;
+    }
+
+    free( capture.data );
+    return ok;
+}
+
+
+/**
+ * Takes everything out of the capture ring
+ */
+static bool replay_drain( replay_buffer_t * capture )
+{
+    uint8_t data[1024];
+    uint32_t size;
+    bool ok = true;
+
+    while ( ok && ( size = capture_read( data, sizeof( data ) ) ) > 0 )
+    {
+        ok = replay_append( capture, data, size );
+    }
+
+    return ok;
+}
+
+
+/**
+ * Records messages looped back on a board, by the capture module
+ *
+ * @return  bool if every message was sent and the capture written
+ */
+static bool replay_record( void )
+{
+    replay_buffer_t capture = { 0 };
+    phy_impair_config_t impair = { .seed = replay_options.seed, .jitter_us = replay_options.jitter_us };
+    uint8_t message[255];
+    uint32_t random = replay_options.seed ? replay_options.seed : 1;
+    bool ok;
+
+    ok = replay_init( REPLAY_RECORD_SOURCE ) &&
+         network_tx_set_linecode( replay_options.linecode ) == ERROR_CODE_NO_ERROR;
+    network_tx_set_fec( replay_options.fec );
+    phy_impair_configure( &impair );
+
+    // the capture's own #cap lines aren't wanted
+    mock_console( NULL );
+    mock_run_us( REPLAY_SETTLE_US );
+    ok = ok && capture_start( ) == ERROR_CODE_NO_ERROR;
+    mock_console( stdout );
+
+    for ( unsigned int n = 0; ok && n < replay_options.count; n++ )
+    {
+        for ( unsigned int i = 0; i < replay_options.size; i++ )
+        {
+            random ^= random << 13;
+            random ^= random >> 17;
+            random ^= random << 5;
+            message[i] = ' ' + random % 95;
+        }
+
+        ok = network_tx( REPLAY_RECORD_DESTINATION, message, replay_options.size ) == ERROR_CODE_NO_ERROR;
+        for ( unsigned int slice = 0; ok && !network_tx_queue_is_empty( ); slice++ )
+        {
+            mock_run_us( REPLAY_RECORD_SLICE_US );
+            ok = replay_drain( &capture ) && slice < REPLAY_RECORD_MAX_SLICES;
+        }
+        mock_run_us( REPLAY_SETTLE_US );
+        ok = ok && replay_drain( &capture );
+    }
+
+    capture_stats_t stats;
+    mock_console( NULL );
+    capture_stop( );
+    ok = ok && replay_drain( &capture );
+    while ( !capture_service( ) );
+    capture_stats( &stats );
+
+    FILE * file = ok ? fopen( replay_options.record, "wb" ) : NULL;
+    ok = file != NULL && fwrite( capture.data, 1, capture.size, file ) == capture.size;
+    ok = file != NULL && fclose( file ) == 0 && ok;
+
+    if ( ok )
+    {
+        printf( "%s: %u messages of %u bytes, %lu edges in %zu bytes, %lu dropped\n",
+                replay_options.record, replay_options.count, replay_options.size,
+                ( unsigned long ) stats.edges, capture.size, ( unsigned long ) stats.dropped );
+    }
+    else
+    {
+        fprintf( stderr, "%s: not recorded\n", replay_options.record );
+    }
+
+    free( capture.data );
+    return ok;
+}
+
+
+/**
+ * Parses the options in front of the captures
+ *
+ * @return  The index of the first capture, or 0 if an option wasn't understood
+ */
+static int replay_parse( int argc, char ** argv )
+{
+    int i;
+
+    for ( i = 1; i < argc && strncmp( argv[i], "--", 2 ) == 0; i++ )
+    {
+        const char * option = argv[i];
+        const char * value = i + 1 < argc ? argv[i + 1] : NULL;
+
+        if ( strcmp( option, "--fec" ) == 0 )
+        {
+            replay_options.fec = true;
+            continue;
+        }
+        else if ( value == NULL )
+        {
+            return 0;
+        }
+        else if ( strcmp( option, "--address" ) == 0 )
+        {
+            replay_options.address = strtoul( value, NULL, 0 ) & 0xFF;
+        }
+        else if ( strcmp( option, "--port" ) == 0 )
+        {
+            unsigned long port = strtoul( value, NULL, 0 );
+            if ( port == NETWORK_PORT_DEFAULT || port > 0xFF || replay_options.port_count == REPLAY_PORTS_MAX )
+            {
+                return 0;
+            }
+            replay_options.ports[replay_options.port_count++] = ( uint8_t ) port;
+        }
+        else if ( strcmp( option, "--sniff" ) == 0 )
+        {
+            replay_options.sniff = value;
+        }
+        else if ( strcmp( option, "--record" ) == 0 )
+        {
+            replay_options.record = value;
+        }
+        else if ( strcmp( option, "--count" ) == 0 )
+        {
+            replay_options.count = strtoul( value, NULL, 0 );
+        }
+        else if ( strcmp( option, "--size" ) == 0 )
+        {
+            replay_options.size = strtoul( value, NULL, 0 );
+            if ( replay_options.size < 1 || replay_options.size > 255 )
+            {
+                return 0;
+            }
+        }
+        else if ( strcmp( option, "--linecode" ) == 0 )
+        {
+            if ( strcmp( value, "stuffed" ) == 0 )
+            {
+                replay_options.linecode = LINECODE_STUFFED;
+            }
+            else if ( strcmp( value, "manchester" ) != 0 )
+            {
+                return 0;
+            }
+        }
+        else if ( strcmp( option, "--jitter-us" ) == 0 )
+        {
+            replay_options.jitter_us = strtoul( value, NULL, 0 );
+        }
+        else if ( strcmp( option, "--seed" ) == 0 )
+        {
+            replay_options.seed = strtoul( value, NULL, 0 );
+        }
+        else
+        {
+            return 0;
+        }
+        i++;
+    }
+
+    return i;
+}
+
+
+/* ------------------------------- Functions -------------------------------- */
+
+
+int main( int argc, char ** argv )
+{
+    int first = replay_parse( argc, argv );
+    bool ok = true;
+
+    if ( first == 0 || ( replay_options.record == NULL && first == argc ) )
+    {
+        fprintf( stderr, "usage: %s [--address A] [--port N]... [--sniff FILE] CAPTURE...\n"
+                         "       %s --record FILE [--count N] [--size BYTES] [--linecode manchester|stuffed]\n"
+                         "              [--fec] [--jitter-us US] [--seed N]\n", argv[0], argv[0] );
+        return 2;
+    }
+
+    if ( replay_options.record != NULL )
+    {
+        return replay_record( ) ? 0 : 1;
+    }
+
+    // every capture's board appends to the sniffer's stream
+    FILE * sniff = replay_options.sniff != NULL ? fopen( replay_options.sniff, "wb" ) : NULL;
+    if ( sniff != NULL )
+    {
+        fclose( sniff );
+    }
+
+    for ( int i = first; i < argc; i++ )
+    {
+        ok = replay_file( argv[i] ) && ok;
+    }
+
+    return ok ? 0 : 1;
+}
+
+
+/* -------------------------------------------------------------------------- */
@@ -0,0 +1,817 @@
+/* --------------------------------- Header --------------------------------- */
+
+
+/**
+ * @file    bus_sim.c
+ * @brief   Discrete event simulator of many boards sharing the bus
+ *
+ * Loads a private copy of the node module per board, so each runs its own
+ * instance of the real network stack, timers and channel monitor against
+ * the simulated peripherals of the host build. The boards share a wired AND
+ * line: a board pulling its transmit pin low is seen by every other board
+ * after the propagation delay, and by itself at once through its bridged
+ * receive pin. Events are run in time order across the boards, each board's
+ * timer interrupts firing at the clock its own timers come due.
+ *
+ * Every board sends messages to random other boards at Poisson arrival
+ * times. For every number of boards and offered load asked for, one line
+ * reports the bytes offered and delivered, the channel throughput, the delay percentiles from
+ * arrival to delivery, the collision rate and the fairness between boards.
+ * The columns are separated by spaces, and the first line names them.
+ *
+ * Build with the host build and run from the repository root:
+ *
+ *      cmake -S . -B build-host -DCE4951_HOST_BUILD=ON
+ *      cmake --build build-host
+ *      ./build-host/tools/sim/bus_sim --nodes 2,8,32 --load 0.2,0.5,1.0
+ *
+ * Options:
+ *
+ *      --nodes N[,N...]    boards on the bus, up to 255         (2,4,8,16)
+ *      --load G[,G...]     offered load, a fraction of capacity (0.1,0.3,0.6,1.0)
+ *      --size BYTES        message size, 4 to 255               (32)
+ *      --seconds S         simulated time per run               (120)
+ *      --delay-us US       propagation delay between boards     (1)
+ *      --seed N            seed of the arrival times and data   (1)
+ *      --module PATH       node module to load
+ *
+ * Channel impairments, see phy_impair.h, drawn for every board from the seed:
+ *
+ *      --flip-ppm PPM      received slots inverted                 (0)
+ *      --burst-ppm PPM     received slots starting an error burst  (0)
+ *      --burst-len SLOTS   mean length of an error burst           (0)
+ *      --jitter-us US      displacement of transmitted edges       (0)
+ *      --skew-ppm PPM      largest transmit clock skew of a board  (0)
+ */
+
+
+/* -------------------------------- Includes -------------------------------- */
+
+
+# include <dlfcn.h>
+# include <math.h>
+# include <stdio.h>
+# include <stdlib.h>
+# include <string.h>
+# include <unistd.h>
+
+# include "sim_node.h"
+
+
+/* --------------------------------- Defines -------------------------------- */
+
+
+/**
+ * The largest bus, every address but broadcast
+ */
+# define SIM_MAX_NODES          ( 255 )
+
+
+/**
+ * The most values a list option takes
+ */
+# define SIM_MAX_LIST           ( 32 )
+
+
+/**
+ * Bit timing and framing of network.c, HALF_BIT_PERIOD_US and the frame
+ * header and trailer around a message
+ */
+# define SIM_HALF_BIT_US        ( 500 )
+# define SIM_FRAME_OVERHEAD     ( 7 )
+
+
+/**
+ * Bytes of every message carrying its identifier
+ */
+# define SIM_ID_SIZE            ( sizeof( uint32_t ) )
+
+
+# define SIM_CLOCKS_PER_US      ( SIM_NODE_CLOCK_HZ / 1000000ULL )
+
+
+/* ---------------------------------- Types --------------------------------- */
+
+
+typedef enum
+{
+    SIM_EVENT_WAKE,         // a board's timer comes due
+    SIM_EVENT_LINE,         // the other boards see a board pull or release the line
+    SIM_EVENT_ARRIVAL       // a board is handed a message to send
+} sim_event_type_t;
+
+
+typedef struct
+{
+    uint64_t time;
+    uint64_t seq;           // orders events at the same time by when they were raised
+    uint16_t node;
+    uint8_t type;
+    int8_t delta;
+} sim_event_t;
+
+
+typedef struct
+{
+    const sim_node_api_t * api;
+    void * handle;
+    uint8_t address;
+    bool pulling_low;
+    int others_low;         // other boards this one sees pulling the line low
+    uint64_t wake;
+    uint32_t delivered;     // messages from this board that arrived
+} sim_node_t;
+
+
+typedef struct
+{
+    uint64_t arrival;
+    uint8_t source;
+    uint8_t destination;
+    bool delivered;
+} sim_message_t;
+
+
+typedef struct
+{
+    sim_node_t nodes[SIM_MAX_NODES];
+    unsigned int node_count;
+
+    sim_event_t * events;
+    size_t event_count;
+    size_t event_capacity;
+    uint64_t seq;
+    uint64_t now;
+
+    sim_message_t * messages;
+    size_t message_count;
+    size_t message_capacity;
+
+    uint64_t * delays;
+    size_t delay_count;
+    size_t delay_capacity;
+    uint32_t corrupt;
+    uint32_t duplicates;
+
+    uint64_t rng;
+    uint64_t delay_clocks;
+    double arrival_gap_clocks;
+    size_t size;
+} sim_t;
+
+
+typedef struct
+{
+    unsigned int nodes[SIM_MAX_LIST];
+    unsigned int node_lists;
+    double loads[SIM_MAX_LIST];
+    unsigned int load_lists;
+    size_t size;
+    double seconds;
+    double delay_us;
+    uint64_t seed;
+    const char * module;
+    phy_impair_config_t impair;
+} sim_options_t;
+
+
+/* -------------------------------- Variables ------------------------------- */
+
+
+static sim_t sim;
+
+static uint8_t * module_image;
+static size_t module_size;
+
+
+/* ------------------------------- Functions -------------------------------- */
+
+
+/**
+ * Draws the next number of an xorshift64* generator
+ */
+static uint64_t sim_random( void )
+{
+    sim.rng ^= sim.rng >> 12;
+    sim.rng ^= sim.rng << 25;
+    sim.rng ^= sim.rng >> 27;
+    return sim.rng * 0x2545F4914F6CDD1DULL;
+}
+
+
+/**
+ * Draws an exponentially distributed gap with a mean
+ */
+static uint64_t sim_random_gap( double mean )
+{
+    double uniform = ( ( sim_random( ) >> 11 ) + 1.0 ) / 9007199254740993.0;
+    return ( uint64_t ) ( -log( uniform ) * mean ) + 1;
+}
+
+
+/**
+ * Grows an array to hold one more element
+ */
+static void * sim_grow( void * array, size_t * capacity, size_t count, size_t element )
+{
+    if ( count < *capacity )
+    {
+        return array;
+    }
+
+    *capacity = *capacity ? *capacity * 2 : 1024;
+    array = realloc( array, *capacity * element );
+    if ( array == NULL )
+    {
+        fprintf( stderr, "bus_sim: out of memory\n" );
+        exit( 1 );
+    }
+
+    return array;
+}
+
+
+/**
+ * Orders two events by time, then by when they were raised
+ */
+static bool sim_event_before( const sim_event_t * a, const sim_event_t * b )
+{
+    return a->time < b->time || ( a->time == b->time && a->seq < b->seq );
+}
+
+
+/**
+ * Raises an event
+ */
+static void sim_event_push( uint64_t time, sim_event_type_t type, unsigned int node, int delta )
+{
+    sim.events = sim_grow( sim.events, &sim.event_capacity, sim.event_count, sizeof( sim_event_t ) );
+
+    sim_event_t event = { time, sim.seq++, ( uint16_t ) node, ( uint8_t ) type, ( int8_t ) delta };
+    size_t i = sim.event_count++;
+
+    while ( i > 0 && sim_event_before( &event, &sim.events[( i - 1 ) / 2] ) )
+    {
+        sim.events[i] = sim.events[( i - 1 ) / 2];
+        i = ( i - 1 ) / 2;
+    }
+    sim.events[i] = event;
+}
+
+
+/**
+ * Takes the earliest event
+ */
+static sim_event_t sim_event_pop( void )
+{
+    sim_event_t first = sim.events[0];
+    sim_event_t last = sim.events[--sim.event_count];
+    size_t i = 0;
+
+    for ( ;; )
+    {
+        size_t child = i * 2 + 1;
+        if ( child >= sim.event_count )
+        {
+            break;
+        }
+        if ( child + 1 < sim.event_count && sim_event_before( &sim.events[child + 1], &sim.events[child] ) )
+        {
+            child++;
+        }
+        if ( !sim_event_before( &sim.events[child], &last ) )
+        {
+            break;
+        }
+        sim.events[i] = sim.events[child];
+        i = child;
+    }
+    sim.events[i] = last;
+
+    return first;
+}
+
+
+/**
+ * Records a message a board received, checking it is one that was sent to it
+ */
+static void sim_deliver( void * context, uint8_t source, uint8_t destination,
+                         const uint8_t * data, size_t size )
+{
+    const sim_node_t * receiver = context;
+    uint32_t id;
+
+    // a board also hears the frames it sends, which its filter passes on
+    // only when they are addressed to it
+    if ( destination != receiver->address )
+    {
+        return;
+    }
+
+    if ( size != sim.size )
+    {
+        sim.corrupt++;
+        return;
+    }
+
+    memcpy( &id, data, SIM_ID_SIZE );
+    if ( id >= sim.message_count || sim.messages[id].source != source ||
+            sim.messages[id].destination != destination )
+    {
+        sim.corrupt++;
+        return;
+    }
+
+    sim_message_t * message = &sim.messages[id];
+    if ( message->delivered )
+    {
+        sim.duplicates++;
+        return;
+    }
+
+    message->delivered = true;
+    sim.delays = sim_grow( sim.delays, &sim.delay_capacity, sim.delay_count, sizeof( uint64_t ) );
+    sim.delays[sim.delay_count++] = sim.now - message->arrival;
+    sim.nodes[source - 1].delivered++;
+}
+
+
+/**
+ * Propagates what a board did at the current time: a change in its pull on
+ * the line, the messages it received and when its timers next come due
+ */
+static void sim_node_sync( unsigned int index )
+{
+    sim_node_t * node = &sim.nodes[index];
+
+    bool low = node->api->pulling_low( );
+    if ( low != node->pulling_low )
+    {
+        node->pulling_low = low;
+        sim_event_push( sim.now + sim.delay_clocks, SIM_EVENT_LINE, index, low ? 1 : -1 );
+    }
+
+    node->api->receive( sim_deliver, node );
+
+    uint64_t wake = node->api->next_event( );
+    if ( wake != node->wake )
+    {
+        node->wake = wake;
+        if ( wake != UINT64_MAX )
+        {
+            sim_event_push( wake, SIM_EVENT_WAKE, index, 0 );
+        }
+    }
+}
+
+
+/**
+ * Hands a board a new message to a random other board
+ */
+static void sim_node_arrival( unsigned int index )
+{
+    sim_node_t * node = &sim.nodes[index];
+    uint8_t data[255];
+    uint32_t id = ( uint32_t ) sim.message_count;
+
+    unsigned int other = ( index + 1 + sim_random( ) % ( sim.node_count - 1 ) ) % sim.node_count;
+
+    sim.messages = sim_grow( sim.messages, &sim.message_capacity, sim.message_count, sizeof( sim_message_t ) );
+    sim.messages[sim.message_count++] = ( sim_message_t ) { sim.now, node->address, sim.nodes[other].address, false };
+
+    memcpy( data, &id, SIM_ID_SIZE );
+    for ( size_t i = SIM_ID_SIZE; i < sim.size; i++ )
+    {
+        data[i] = ( uint8_t ) sim_random( );
+    }
+
+    node->api->run_to( sim.now );
+    node->api->send( sim.nodes[other].address, data, sim.size );
+    sim_node_sync( index );
+
+    sim_event_push( sim.now + sim_random_gap( sim.arrival_gap_clocks ), SIM_EVENT_ARRIVAL, index, 0 );
+}
+
+
+/**
+ * Lets every other board see a board pull or release the line
+ */
+static void sim_line_change( unsigned int source, int delta )
+{
+    for ( unsigned int index = 0; index < sim.node_count; index++ )
+    {
+        sim_node_t * node = &sim.nodes[index];
+        if ( index == source )
+        {
+            continue;
+        }
+
+        node->api->run_to( sim.now );
+        node->others_low += delta;
+        node->api->line_drive( node->others_low == 0 );
+        sim_node_sync( index );
+    }
+}
+
+
+/**
+ * Loads a private copy of the node module, whose variables no other copy
+ * shares
+ *
+ * @return  The module's handle, or NULL
+ */
+static void * sim_module_load( void )
+{
+    const char * directory = getenv( "TMPDIR" );
+    char path[4096];
+
+    snprintf( path, sizeof( path ), "%s/ce4951-node-XXXXXX.so", directory ? directory : "/tmp" );
+    int fd = mkstemps( path, 3 );
+    if ( fd < 0 )
+    {
+        return NULL;
+    }
+
+    bool written = write( fd, module_image, module_size ) == ( ssize_t ) module_size;
+    close( fd );
+
+    void * handle = written ? dlopen( path, RTLD_NOW | RTLD_LOCAL ) : NULL;
+    if ( handle == NULL && written )
+    {
+        fprintf( stderr, "bus_sim: %s\n", dlerror( ) );
+    }
+    unlink( path );
+
+    return handle;
+}
+
+
+/**
+ * Reads the node module, which is copied for every board
+ *
+ * @return  bool if it was read
+ */
+static bool sim_module_read( const char * path )
+{
+    FILE * file = fopen( path, "rb" );
+    if ( file == NULL )
+    {
+        fprintf( stderr, "bus_sim: can't open node module %s\n", path );
+        return false;
+    }
+
+    fseek( file, 0, SEEK_END );
+    module_size = ( size_t ) ftell( file );
+    fseek( file, 0, SEEK_SET );
+    module_image = malloc( module_size );
+    bool ok = module_image != NULL && fread( module_image, 1, module_size, file ) == module_size;
+    fclose( file );
+
+    return ok;
+}
+
+
+/**
+ * Brings up a fresh bus of boards
+ *
+ * @return  bool if every board came up
+ */
+static bool sim_setup( unsigned int node_count, double load, const sim_options_t * options )
+{
+    for ( unsigned int i = 0; i < sim.node_count; i++ )
+    {
+        dlclose( sim.nodes[i].handle );
+    }
+
+    sim.node_count = node_count;
+    sim.event_count = 0;
+    sim.message_count = 0;
+    sim.delay_count = 0;
+    sim.corrupt = 0;
+    sim.duplicates = 0;
+    sim.now = 0;
+    sim.rng = options->seed * 0x9E3779B97F4A7C15ULL + node_count + 1;
+    sim.size = options->size;
+    sim.delay_clocks = ( uint64_t ) ( options->delay_us * SIM_CLOCKS_PER_US );
+
+    // the load is a fraction of the frames the bus could carry back to back
+    double frame_clocks = ( double ) ( options->size + SIM_FRAME_OVERHEAD ) * 8 * 2 *
+                          SIM_HALF_BIT_US * SIM_CLOCKS_PER_US;
+    sim.arrival_gap_clocks = frame_clocks * node_count / load;
+
+    for ( unsigned int i = 0; i < node_count; i++ )
+    {
+        sim_node_t * node = &sim.nodes[i];
+        memset( node, 0, sizeof( *node ) );
+        node->address = ( uint8_t ) ( i + 1 );
+        node->wake = UINT64_MAX;
+        node->handle = sim_module_load( );
+        node->api = node->handle ? dlsym( node->handle, SIM_NODE_API_SYMBOL ) : NULL;
+
+        if ( node->api == NULL || !node->api->init( node->address ) )
+        {
+            fprintf( stderr, "bus_sim: board %u didn't come up\n", i + 1 );
+            return false;
+        }
+
+        // every board draws its own impairments and skew
+        phy_impair_config_t impair = options->impair;
+        impair.seed = ( uint32_t ) sim_random( );
+        if ( options->impair.skew_ppm )
+        {
+            impair.skew_ppm = ( int16_t ) ( ( int64_t ) ( sim_random( ) % ( 2U * options->impair.skew_ppm + 1U ) ) -
+                                            options->impair.skew_ppm );
+        }
+        node->api->impair( &impair );
+
+        sim_node_sync( i );
+        sim_event_push( sim_random_gap( sim.arrival_gap_clocks ), SIM_EVENT_ARRIVAL, i, 0 );
+    }
+
+    return true;
+}
+
+
+/**
+ * Runs events until the end of the run
+ */
+static void sim_run( uint64_t end )
+{
+    while ( sim.event_count > 0 && sim.events[0].time <= end )
+    {
+        sim_event_t event = sim_event_pop( );
+        sim.now = event.time;
+
+        switch ( event.type )
+        {
+            case SIM_EVENT_WAKE:
+                // a wake the board has since moved is stale
+                if ( sim.nodes[event.node].wake == event.time )
+                {
+                    sim.nodes[event.node].wake = UINT64_MAX;
+                    sim.nodes[event.node].api->run_to( sim.now );
+                    sim_node_sync( event.node );
+                }
+                break;
+            case SIM_EVENT_LINE:
+                sim_line_change( event.node, event.delta );
+                break;
+            case SIM_EVENT_ARRIVAL:
+                sim_node_arrival( event.node );
+                break;
+        }
+    }
+}
+
+
+static int sim_compare_delays( const void * a, const void * b )
+{
+    uint64_t x = *( const uint64_t * ) a;
+    uint64_t y = *( const uint64_t * ) b;
+    return ( x > y ) - ( x < y );
+}
+
+
+/**
+ * Gets a percentile of the sorted delays in milliseconds
+ */
+static double sim_delay_ms( double percentile )
+{
+    if ( sim.delay_count == 0 )
+    {
+        return 0;
+    }
+
+    size_t index = ( size_t ) ( percentile * ( sim.delay_count - 1 ) + 0.5 );
+    return sim.delays[index] * 1000.0 / SIM_NODE_CLOCK_HZ;
+}
+
+
+/**
+ * Prints the results of a run
+ */
+static void sim_report( double load, double seconds )
+{
+    uint32_t sent = 0;
+    uint32_t backoffs = 0;
+    uint32_t rejected = 0;
+    double sum = 0;
+    double sum_squares = 0;
+
+    for ( unsigned int i = 0; i < sim.node_count; i++ )
+    {
+        sim_node_stats_t stats;
+        sim.nodes[i].api->stats( &stats );
+
+        sent += stats.accepted - stats.queued;
+        backoffs += stats.backoffs;
+        rejected += stats.rejected;
+        sum += sim.nodes[i].delivered;
+        sum_squares += ( double ) sim.nodes[i].delivered * sim.nodes[i].delivered;
+    }
+
+    qsort( sim.delays, sim.delay_count, sizeof( uint64_t ), sim_compare_delays );
+
+    double frame_seconds = ( sim.size + SIM_FRAME_OVERHEAD ) * 8 * 2 * SIM_HALF_BIT_US / 1e6;
+
+    // the offered load is the messages that arrived during the run rather
+    // than the nominal load, which a short run's arrivals stray from
+    printf( "%5u %5.2f %11.1f %11.1f %10.3f %12.0f %12.0f %12.0f %14.3f %8.3f %8u %7u\n",
+            sim.node_count, load, sim.message_count * sim.size / seconds,
+            sim.delay_count * sim.size / seconds,
+            sim.delay_count * frame_seconds / seconds,
+            sim_delay_ms( 0.50 ), sim_delay_ms( 0.90 ), sim_delay_ms( 0.99 ),
+            backoffs + sent ? ( double ) backoffs / ( backoffs + sent ) : 0.0,
+            sum_squares > 0 ? sum * sum / ( sim.node_count * sum_squares ) : 0.0,
+            rejected, sim.corrupt + sim.duplicates );
+    fflush( stdout );
+}
+
+
+/**
+ * Parses a comma separated list of numbers
+ *
+ * @return  The number of values, or 0 if the list is malformed
+ */
+static unsigned int sim_parse_list( const char * text, double * values )
+{
+    unsigned int count = 0;
+    char * end;
+
+    while ( count < SIM_MAX_LIST )
+    {
+        values[count++] = strtod( text, &end );
+        if ( end == text )
+        {
+            return 0;
+        }
+        if ( *end != ',' )
+        {
+            return *end == '\0' ? count : 0;
+        }
+        text = end + 1;
+    }
+
+    return 0;
+}
+
+
+/**
+ * Parses the command line
+ *
+ * @return  bool if every option was understood
+ */
+static bool sim_parse( int argc, char ** argv, sim_options_t * options )
+{
+    double values[SIM_MAX_LIST];
+
+    for ( int i = 1; i < argc; i++ )
+    {
+        const char * option = argv[i];
+        const char * value = i + 1 < argc ? argv[++i] : NULL;
+
+        if ( value == NULL )
+        {
+            return false;
+        }
+        else if ( strcmp( option, "--nodes" ) == 0 )
+        {
+            options->node_lists = sim_parse_list( value, values );
+            for ( unsigned int n = 0; n < options->node_lists; n++ )
+            {
+                if ( values[n] < 2 || values[n] > SIM_MAX_NODES )
+                {
+                    return false;
+                }
+                options->nodes[n] = ( unsigned int ) values[n];
+            }
+            if ( options->node_lists == 0 )
+            {
+                return false;
+            }
+        }
+        else if ( strcmp( option, "--load" ) == 0 )
+        {
+            options->load_lists = sim_parse_list( value, options->loads );
+            for ( unsigned int n = 0; n < options->load_lists; n++ )
+            {
+                if ( options->loads[n] <= 0 )
+                {
+                    return false;
+                }
+            }
+            if ( options->load_lists == 0 )
+            {
+                return false;
+            }
+        }
+        else if ( strcmp( option, "--size" ) == 0 )
+        {
+            options->size = strtoul( value, NULL, 0 );
+            if ( options->size < SIM_ID_SIZE || options->size > 255 )
+            {
+                return false;
+            }
+        }
+        else if ( strcmp( option, "--seconds" ) == 0 )
+        {
+            options->seconds = strtod( value, NULL );
+        }
+        else if ( strcmp( option, "--delay-us" ) == 0 )
+        {
+            options->delay_us = strtod( value, NULL );
+        }
+        else if ( strcmp( option, "--seed" ) == 0 )
+        {
+            options->seed = strtoull( value, NULL, 0 );
+        }
+        else if ( strcmp( option, "--module" ) == 0 )
+        {
+            options->module = value;
+        }
+        else if ( strcmp( option, "--flip-ppm" ) == 0 )
+        {
+            options->impair.bit_flip_ppm = strtoul( value, NULL, 0 );
+        }
+        else if ( strcmp( option, "--burst-ppm" ) == 0 )
+        {
+            options->impair.burst_start_ppm = strtoul( value, NULL, 0 );
+        }
+        else if ( strcmp( option, "--burst-len" ) == 0 )
+        {
+            options->impair.burst_length = ( uint16_t ) strtoul( value, NULL, 0 );
+        }
+        else if ( strcmp( option, "--jitter-us" ) == 0 )
+        {
+            options->impair.jitter_us = ( uint16_t ) strtoul( value, NULL, 0 );
+        }
+        else if ( strcmp( option, "--skew-ppm" ) == 0 )
+        {
+            long skew = strtol( value, NULL, 0 );
+            if ( skew < 0 || skew > INT16_MAX )
+            {
+                return false;
+            }
+            options->impair.skew_ppm = ( int16_t ) skew;
+        }
+        else
+        {
+            return false;
+        }
+    }
+
+    return options->seconds > 0 && options->delay_us >= 0;
+}
+
+
+int main( int argc, char ** argv )
+{
+    sim_options_t options =
+    {
+        .nodes = { 2, 4, 8, 16 },
+        .node_lists = 4,
+        .loads = { 0.1, 0.3, 0.6, 1.0 },
+        .load_lists = 4,
+        .size = 32,
+        .seconds = 120,
+        .delay_us = 1,
+        .seed = 1,
+        .module = SIM_NODE_MODULE,
+    };
+
+    if ( !sim_parse( argc, argv, &options ) )
+    {
+        fprintf( stderr, "usage: %s [--nodes N,...] [--load G,...] [--size BYTES] [--seconds S]\n"
+                         "       [--delay-us US] [--seed N] [--module PATH] [--flip-ppm PPM]\n"
+                         "       [--burst-ppm PPM] [--burst-len SLOTS] [--jitter-us US] [--skew-ppm PPM]\n",
+                 argv[0] );
+        return 2;
+    }
+
+    if ( !sim_module_read( options.module ) )
+    {
+        return 1;
+    }
+
+    printf( "nodes  load offered_Bps goodput_Bps throughput delay_p50_ms delay_p90_ms delay_p99_ms "
+            "collision_rate fairness rejected corrupt\n" );
+
+    for ( unsigned int n = 0; n < options.node_lists; n++ )
+    {
+        for ( unsigned int l = 0; l < options.load_lists; l++ )
+        {
+            if ( !sim_setup( options.nodes[n], options.loads[l], &options ) )
+            {
+                return 1;
+            }
+
+            sim_run( ( uint64_t ) ( options.seconds * SIM_NODE_CLOCK_HZ ) );
+            sim_report( options.loads[l], options.seconds );
+        }
+    }
+
+    return 0;
+}
+
+
+/* -------------------------------------------------------------------------- */
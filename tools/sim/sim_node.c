@@ -0,0 +1,146 @@
+/* --------------------------------- Header --------------------------------- */
+
+
+/**
+ * @file    sim_node.c
+ * @brief   Contains one simulated board of the bus simulator, built into the
+ *          node module with the network stack and the simulated peripherals
+ */
+
+
+/* -------------------------------- Includes -------------------------------- */
+
+
+# include "mock.h"
+# include "sim_node.h"
+# include "channel_monitor.h"
+# include "leds.h"
+# include "network.h"
+# include "state.h"
+# include "timeout.h"
+
+
+/* --------------------------------- Defines -------------------------------- */
+
+
+/**
+ * The idle timeout main() starts the timeout timer with
+ */
+# define SIM_NODE_TIMEOUT_PERIOD_US     ( 1100U )
+
+
+_Static_assert( SIM_NODE_CLOCK_HZ == MOCK_CLOCK_HZ, "the simulator keeps time in the mock's clock" );
+
+
+/* -------------------------------- Variables ------------------------------- */
+
+
+static uint32_t sim_node_accepted;
+static uint32_t sim_node_rejected;
+
+
+/* ------------------------------- Functions -------------------------------- */
+
+
+/**
+ * Brings the board up the way main() does
+ *
+ * @param   [in]    address     The board's address on the bus
+ *
+ * @return  bool if every driver initialized
+ */
+static bool sim_node_init( uint8_t address )
+{
+    mock_reset( );
+
+    // frames mangled by collisions are reported as decode errors, which
+    // would bury the simulator's own output
+    mock_console( NULL );
+
+    return network_init( ) == ERROR_CODE_NO_ERROR &&
+           channel_monitor_init( ) == ERROR_CODE_NO_ERROR &&
+           timeout_init( SIM_NODE_TIMEOUT_PERIOD_US ) == ERROR_CODE_NO_ERROR &&
+           leds_init( ) == ERROR_CODE_NO_ERROR &&
+           state_set( IDLE ) == ERROR_CODE_NO_ERROR &&
+           set_local_machine_address( address ) == ERROR_CODE_NO_ERROR;
+}
+
+
+/**
+ * Queues a message for transmission
+ *
+ * @return  bool if the transmit queue took it
+ */
+static bool sim_node_send( uint8_t destination, const uint8_t * data, size_t size )
+{
+    if ( network_tx( destination, ( uint8_t * ) data, size ) != ERROR_CODE_NO_ERROR )
+    {
+        sim_node_rejected++;
+        return false;
+    }
+
+    sim_node_accepted++;
+    return true;
+}
+
+
+/**
+ * Decodes the received frames and hands every message on the default port to
+ * the simulator, as the main loop does
+ *
+ * @return  The number of messages delivered
+ */
+static unsigned int sim_node_receive( sim_node_deliver_t deliver, void * context )
+{
+    const network_message_t * messages[NETWORK_PORT_QUEUE_DEPTH];
+    unsigned int delivered = 0;
+    unsigned int count;
+
+    network_service( );
+    while ( ( count = network_port_borrow_batch( NETWORK_PORT_DEFAULT, messages, NETWORK_PORT_QUEUE_DEPTH ) ) > 0 )
+    {
+        for ( unsigned int i = 0; i < count; i++ )
+        {
+            deliver( context, messages[i]->source, messages[i]->destination,
+                     messages[i]->data, messages[i]->length );
+        }
+        network_port_release( NETWORK_PORT_DEFAULT, count );
+        delivered += count;
+    }
+
+    return delivered;
+}
+
+
+/**
+ * Gets the board's counters
+ */
+static void sim_node_stats( sim_node_stats_t * stats )
+{
+    stats->accepted = sim_node_accepted;
+    stats->rejected = sim_node_rejected;
+    stats->queued = network_tx_queue_count( );
+
+    // with the shapers unused, the backoff timer only runs after a collision
+    stats->backoffs = mock_irq_count( TIM5_IRQn );
+}
+
+
+/* -------------------------------- Variables ------------------------------- */
+
+
+const sim_node_api_t sim_node_api =
+{
+    .init = sim_node_init,
+    .next_event = mock_next_event,
+    .run_to = mock_run_to,
+    .line_drive = mock_line_drive,
+    .pulling_low = mock_line_pulled_low,
+    .send = sim_node_send,
+    .receive = sim_node_receive,
+    .stats = sim_node_stats,
+    .impair = phy_impair_configure,
+};
+
+
+/* -------------------------------------------------------------------------- */
@@ -0,0 +1,92 @@
+/* --------------------------------- Header --------------------------------- */
+
+
+/**
+ * @file    sim_node.h
+ * @brief   Contains the interface of one simulated board in the bus simulator
+ *
+ * The firmware keeps its state in file scope variables, so every simulated
+ * board is its own copy of the node module, which links the network stack
+ * against the simulated peripherals of the host build. The simulator loads
+ * a copy per board and reaches each through the sim_node_api table.
+ */
+
+
+/* ------------------------------ Header Guard ------------------------------ */
+
+
+# ifndef SIM_NODE_H
+# define SIM_NODE_H
+
+
+/* -------------------------------- Includes -------------------------------- */
+
+
+# include <stddef.h>
+# include <stdint.h>
+# include <stdbool.h>
+
+# include "phy_impair.h"
+
+
+/* --------------------------------- Defines -------------------------------- */
+
+
+/**
+ * The name the node module exports its table under
+ */
+# define SIM_NODE_API_SYMBOL    "sim_node_api"
+
+
+/**
+ * The clock every time is kept in, MOCK_CLOCK_HZ of the host build
+ */
+# define SIM_NODE_CLOCK_HZ      ( 84000000ULL )
+
+
+/* ---------------------------------- Types --------------------------------- */
+
+
+/**
+ * Counters of a simulated board
+ */
+typedef struct
+{
+    uint32_t accepted;      // messages the transmit queue took
+    uint32_t rejected;      // messages the transmit queue had no room for
+    uint32_t queued;        // messages still waiting to be sent
+    uint32_t backoffs;      // transmissions abandoned to a collision
+} sim_node_stats_t;
+
+
+/**
+ * Called for every message a board receives
+ */
+typedef void ( * sim_node_deliver_t )( void * context, uint8_t source, uint8_t destination,
+                                       const uint8_t * data, size_t size );
+
+
+/**
+ * The operations of a simulated board, with clocks in SIM_NODE_CLOCK_HZ
+ */
+typedef struct
+{
+    bool ( * init )( uint8_t address );
+    uint64_t ( * next_event )( void );
+    void ( * run_to )( uint64_t clock );
+    void ( * line_drive )( bool high );
+    bool ( * pulling_low )( void );
+    bool ( * send )( uint8_t destination, const uint8_t * data, size_t size );
+    unsigned int ( * receive )( sim_node_deliver_t deliver, void * context );
+    void ( * stats )( sim_node_stats_t * stats );
+    void ( * impair )( const phy_impair_config_t * config );
+} sim_node_api_t;
+
+
+/* --------------------------------- Footer --------------------------------- */
+
+
+# endif // SIM_NODE_H
+
+
+/* -------------------------------------------------------------------------- */